@@ -0,0 +1,146 @@
+/*
+ * Arena allocator benchmark
+ *
+ * Parses every spec file given on the command line, first with the system
+ * allocator and then with the arena from tree-sitter-rpmspec-arena.h, and
+ * reports the time per KiB of source for both. Each parse creates and
+ * deletes its own parser and drops its tree, the way a batch indexer does;
+ * with the arena the tree is dropped by resetting the arena instead of
+ * ts_tree_delete().
+ *
+ *     rpmspec-bench-arena [--repeat N] [--block-size BYTES] PATH...
+ *
+ * The program fails if a tree built in the arena has a different number of
+ * nodes than the one built with malloc().
+ */
+
+#include "common.h"
+
+#include <tree_sitter/api.h>
+#include <tree_sitter/tree-sitter-rpmspec-arena.h>
+#include <tree_sitter/tree-sitter-rpmspec.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void
+usage(const char *progname)
+{
+    fprintf(stderr, "usage: %s [--repeat N] [--block-size BYTES] PATH...\n",
+            progname);
+}
+
+int
+main(int argc, char **argv)
+{
+    TSRpmspecArenaStats stats;
+    struct bench_files files;
+    TSRpmspecArena *arena;
+    uint32_t *node_counts;
+    size_t block_size = 0;
+    size_t mismatches = 0;
+    uint64_t system_ns = 0;
+    uint64_t arena_ns = 0;
+    uint64_t start;
+    long repeat = 1;
+    double kib;
+    long r;
+    size_t i;
+    int argi;
+
+    for (argi = 1; argi < argc && argv[argi][0] == '-'; argi++) {
+        if (strcmp(argv[argi], "--repeat") == 0 && argi + 1 < argc) {
+            repeat = strtol(argv[++argi], NULL, 10);
+        } else if (strcmp(argv[argi], "--block-size") == 0 &&
+                   argi + 1 < argc) {
+            block_size = strtoul(argv[++argi], NULL, 10);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (argi == argc || repeat < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (bench_collect(&files, argc - argi, argv + argi) != 0 ||
+        bench_load(&files) != 0) {
+        return 1;
+    }
+    if (files.count == 0 || files.total_bytes == 0) {
+        fprintf(stderr, "no spec files found, see bench/README.md\n");
+        return 1;
+    }
+    node_counts = calloc(files.count, sizeof(*node_counts));
+    if (node_counts == NULL) {
+        return 1;
+    }
+
+    /* The system allocator must be done before the arena is installed */
+    for (r = 0; r < repeat; r++) {
+        for (i = 0; i < files.count; i++) {
+            const struct bench_file *f = &files.files[i];
+            TSParser *parser;
+            TSTree *tree;
+
+            start = bench_now_ns();
+            parser = ts_parser_new();
+            ts_parser_set_language(parser, tree_sitter_rpmspec());
+            tree = ts_parser_parse_string(parser, NULL, f->data, f->size);
+            node_counts[i] = ts_node_descendant_count(ts_tree_root_node(tree));
+            ts_tree_delete(tree);
+            ts_parser_delete(parser);
+            system_ns += bench_now_ns() - start;
+        }
+    }
+
+    tree_sitter_rpmspec_arena_install();
+    arena = tree_sitter_rpmspec_arena_new(block_size);
+    if (arena == NULL) {
+        return 1;
+    }
+
+    for (r = 0; r < repeat; r++) {
+        for (i = 0; i < files.count; i++) {
+            const struct bench_file *f = &files.files[i];
+            uint32_t nodes;
+            TSTree *tree;
+
+            start = bench_now_ns();
+            tree = tree_sitter_rpmspec_arena_parse(arena, tree_sitter_rpmspec(),
+                                                   f->data, f->size);
+            nodes = ts_node_descendant_count(ts_tree_root_node(tree));
+            tree_sitter_rpmspec_arena_reset(arena);
+            arena_ns += bench_now_ns() - start;
+
+            if (r == 0 && nodes != node_counts[i]) {
+                fprintf(stderr, "%s: %u nodes in the arena, %u with malloc\n",
+                        f->path, nodes, node_counts[i]);
+                mismatches++;
+            }
+        }
+    }
+
+    tree_sitter_rpmspec_arena_stats(arena, &stats);
+    kib = (double)files.total_bytes * (double)repeat / 1024.0;
+
+    bench_report("files", "%zu", files.count);
+    bench_report("bytes", "%llu", (unsigned long long)files.total_bytes);
+    bench_report("system_us_per_kib", "%.2f", (double)system_ns / 1e3 / kib);
+    bench_report("arena_us_per_kib", "%.2f", (double)arena_ns / 1e3 / kib);
+    bench_report("system_arena_ratio", "%.2f",
+                 arena_ns > 0 ? (double)system_ns / (double)arena_ns : 0.0);
+    bench_report("arena_peak_bytes", "%zu", stats.peak);
+    bench_report("arena_reserved_bytes", "%zu", stats.reserved);
+    bench_report("arena_blocks", "%u", stats.blocks);
+    bench_report("mismatches", "%zu", mismatches);
+
+    tree_sitter_rpmspec_arena_delete(arena);
+    tree_sitter_rpmspec_arena_uninstall();
+    free(node_counts);
+    bench_files_free(&files);
+
+    return mismatches > 0 ? 1 : 0;
+}
@@ -0,0 +1,35 @@
+Name:           bad-conditions
+Version:        1.0
+Release:        1%{?dist}
+Summary:        Conditions that are empty, unbalanced or never closed
+License:        MIT
+
+%if
+BuildRequires:  gcc
+%endif
+
+%if 0%{?fedora} >=
+BuildRequires:  make
+%endif
+
+%if (0%{?rhel} && 0%{?rhel} < 9
+BuildRequires:  cmake
+%endif
+
+%if 0%{?fedora
+BuildRequires:  ninja-build
+%endif
+
+%ifarch
+BuildRequires:  nasm
+%endif
+
+%elif 0%{?suse_version}
+BuildRequires:  meson
+%endif
+
+%description
+Every conditional above is broken in a different way.
+
+%files
+%{_bindir}/bad-conditions
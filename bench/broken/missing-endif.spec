@@ -0,0 +1,29 @@
+Name:           missing-endif
+Version:        1.0
+Release:        1%{?dist}
+Summary:        An %if block that is never closed
+License:        MIT
+
+%if 0%{?fedora}
+BuildRequires:  gcc
+BuildRequires:  make
+
+%description
+Everything after the %if is part of the unterminated block.
+
+%prep
+%autosetup
+
+%build
+%make_build
+
+%install
+%make_install
+
+%files
+%license LICENSE
+%{_bindir}/missing-endif
+
+%changelog
+* Tue May 31 2016 Jane Doe <jane@example.com> - 1.0-1
+- Initial package
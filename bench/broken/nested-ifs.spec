@@ -0,0 +1,212 @@
+Name:           nested-ifs
+Version:        1.0
+Release:        1%{?dist}
+Summary:        A hundred nested %if blocks without an %endif
+License:        MIT
+
+%if 0%{?level_1}
+BuildRequires:  level-1
+%if 0%{?level_2}
+BuildRequires:  level-2
+%if 0%{?level_3}
+BuildRequires:  level-3
+%if 0%{?level_4}
+BuildRequires:  level-4
+%if 0%{?level_5}
+BuildRequires:  level-5
+%if 0%{?level_6}
+BuildRequires:  level-6
+%if 0%{?level_7}
+BuildRequires:  level-7
+%if 0%{?level_8}
+BuildRequires:  level-8
+%if 0%{?level_9}
+BuildRequires:  level-9
+%if 0%{?level_10}
+BuildRequires:  level-10
+%if 0%{?level_11}
+BuildRequires:  level-11
+%if 0%{?level_12}
+BuildRequires:  level-12
+%if 0%{?level_13}
+BuildRequires:  level-13
+%if 0%{?level_14}
+BuildRequires:  level-14
+%if 0%{?level_15}
+BuildRequires:  level-15
+%if 0%{?level_16}
+BuildRequires:  level-16
+%if 0%{?level_17}
+BuildRequires:  level-17
+%if 0%{?level_18}
+BuildRequires:  level-18
+%if 0%{?level_19}
+BuildRequires:  level-19
+%if 0%{?level_20}
+BuildRequires:  level-20
+%if 0%{?level_21}
+BuildRequires:  level-21
+%if 0%{?level_22}
+BuildRequires:  level-22
+%if 0%{?level_23}
+BuildRequires:  level-23
+%if 0%{?level_24}
+BuildRequires:  level-24
+%if 0%{?level_25}
+BuildRequires:  level-25
+%if 0%{?level_26}
+BuildRequires:  level-26
+%if 0%{?level_27}
+BuildRequires:  level-27
+%if 0%{?level_28}
+BuildRequires:  level-28
+%if 0%{?level_29}
+BuildRequires:  level-29
+%if 0%{?level_30}
+BuildRequires:  level-30
+%if 0%{?level_31}
+BuildRequires:  level-31
+%if 0%{?level_32}
+BuildRequires:  level-32
+%if 0%{?level_33}
+BuildRequires:  level-33
+%if 0%{?level_34}
+BuildRequires:  level-34
+%if 0%{?level_35}
+BuildRequires:  level-35
+%if 0%{?level_36}
+BuildRequires:  level-36
+%if 0%{?level_37}
+BuildRequires:  level-37
+%if 0%{?level_38}
+BuildRequires:  level-38
+%if 0%{?level_39}
+BuildRequires:  level-39
+%if 0%{?level_40}
+BuildRequires:  level-40
+%if 0%{?level_41}
+BuildRequires:  level-41
+%if 0%{?level_42}
+BuildRequires:  level-42
+%if 0%{?level_43}
+BuildRequires:  level-43
+%if 0%{?level_44}
+BuildRequires:  level-44
+%if 0%{?level_45}
+BuildRequires:  level-45
+%if 0%{?level_46}
+BuildRequires:  level-46
+%if 0%{?level_47}
+BuildRequires:  level-47
+%if 0%{?level_48}
+BuildRequires:  level-48
+%if 0%{?level_49}
+BuildRequires:  level-49
+%if 0%{?level_50}
+BuildRequires:  level-50
+%if 0%{?level_51}
+BuildRequires:  level-51
+%if 0%{?level_52}
+BuildRequires:  level-52
+%if 0%{?level_53}
+BuildRequires:  level-53
+%if 0%{?level_54}
+BuildRequires:  level-54
+%if 0%{?level_55}
+BuildRequires:  level-55
+%if 0%{?level_56}
+BuildRequires:  level-56
+%if 0%{?level_57}
+BuildRequires:  level-57
+%if 0%{?level_58}
+BuildRequires:  level-58
+%if 0%{?level_59}
+BuildRequires:  level-59
+%if 0%{?level_60}
+BuildRequires:  level-60
+%if 0%{?level_61}
+BuildRequires:  level-61
+%if 0%{?level_62}
+BuildRequires:  level-62
+%if 0%{?level_63}
+BuildRequires:  level-63
+%if 0%{?level_64}
+BuildRequires:  level-64
+%if 0%{?level_65}
+BuildRequires:  level-65
+%if 0%{?level_66}
+BuildRequires:  level-66
+%if 0%{?level_67}
+BuildRequires:  level-67
+%if 0%{?level_68}
+BuildRequires:  level-68
+%if 0%{?level_69}
+BuildRequires:  level-69
+%if 0%{?level_70}
+BuildRequires:  level-70
+%if 0%{?level_71}
+BuildRequires:  level-71
+%if 0%{?level_72}
+BuildRequires:  level-72
+%if 0%{?level_73}
+BuildRequires:  level-73
+%if 0%{?level_74}
+BuildRequires:  level-74
+%if 0%{?level_75}
+BuildRequires:  level-75
+%if 0%{?level_76}
+BuildRequires:  level-76
+%if 0%{?level_77}
+BuildRequires:  level-77
+%if 0%{?level_78}
+BuildRequires:  level-78
+%if 0%{?level_79}
+BuildRequires:  level-79
+%if 0%{?level_80}
+BuildRequires:  level-80
+%if 0%{?level_81}
+BuildRequires:  level-81
+%if 0%{?level_82}
+BuildRequires:  level-82
+%if 0%{?level_83}
+BuildRequires:  level-83
+%if 0%{?level_84}
+BuildRequires:  level-84
+%if 0%{?level_85}
+BuildRequires:  level-85
+%if 0%{?level_86}
+BuildRequires:  level-86
+%if 0%{?level_87}
+BuildRequires:  level-87
+%if 0%{?level_88}
+BuildRequires:  level-88
+%if 0%{?level_89}
+BuildRequires:  level-89
+%if 0%{?level_90}
+BuildRequires:  level-90
+%if 0%{?level_91}
+BuildRequires:  level-91
+%if 0%{?level_92}
+BuildRequires:  level-92
+%if 0%{?level_93}
+BuildRequires:  level-93
+%if 0%{?level_94}
+BuildRequires:  level-94
+%if 0%{?level_95}
+BuildRequires:  level-95
+%if 0%{?level_96}
+BuildRequires:  level-96
+%if 0%{?level_97}
+BuildRequires:  level-97
+%if 0%{?level_98}
+BuildRequires:  level-98
+%if 0%{?level_99}
+BuildRequires:  level-99
+%if 0%{?level_100}
+BuildRequires:  level-100
+
+%description
+None of the blocks above is closed.
+
+%files
+%{_bindir}/nested-ifs
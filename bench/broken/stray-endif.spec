@@ -0,0 +1,20 @@
+Name:           stray-endif
+Version:        1.0
+Release:        1%{?dist}
+Summary:        An %endif and an %else without an %if
+License:        MIT
+
+BuildRequires:  gcc
+%endif
+BuildRequires:  make
+%else
+
+%description
+The conditional keywords above have nothing to close.
+
+%build
+%make_build
+%endif
+
+%files
+%{_bindir}/stray-endif
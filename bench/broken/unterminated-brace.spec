@@ -0,0 +1,17 @@
+Name:           unterminated-brace
+Version:        %{ver
+Release:        1%{?dist
+Summary:        Braced macros that are never closed
+License:        MIT
+URL:            https://example.com/%{name
+
+Source0:        %{url}/archive/%{version}.tar.gz
+
+%description
+%{summary
+
+%build
+%{__make} %{?_smp_mflags
+
+%files
+%{_bindir}/%{name
@@ -0,0 +1,18 @@
+Name:           unterminated-lua
+Version:        1.0
+Release:        1%{?dist}
+Summary:        A %{lua:} body that runs to the end of the file
+License:        MIT
+
+%{lua:
+local name = rpm.expand("%{name}")
+print("Version: " .. name)
+
+%description
+The lua body above is never closed.
+
+%build
+%make_build
+
+%files
+%{_bindir}/unterminated-lua
@@ -0,0 +1,20 @@
+Name:           unterminated-shell
+Version:        %(echo 1.0
+Release:        1%{?dist}
+Summary:        A shell expansion that is never closed
+License:        MIT
+
+%global commit %(git rev-parse HEAD
+
+%description
+The %(...) expansions above are never closed.
+
+%build
+%if %{with tests}
+for f in *.c; do
+    echo "%{name} $f"
+%endif
+done
+
+%files
+%{_bindir}/unterminated-shell
@@ -0,0 +1,228 @@
+/*
+ * Changelog id extraction benchmark
+ *
+ * Parses every spec file given on the command line once, then collects the
+ * ids mentioned in the %changelog entries into one columnar batch with the
+ * extractor from tree-sitter-rpmspec-changelog.h, and counts them with a
+ * naive walk over every node of the tree comparing type names, the way the
+ * scripts built on the bindings do it. It reports the time per KiB of source
+ * for both and the cost of exporting the batch to the Arrow C data
+ * interface, and fails if the two disagree on the number of ids.
+ *
+ *     rpmspec-bench-changelog [--repeat N] PATH...
+ */
+
+#include "common.h"
+
+#include <tree_sitter/api.h>
+#include <tree_sitter/tree-sitter-rpmspec-changelog.h>
+#include <tree_sitter/tree-sitter-rpmspec.h>
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *const id_types[] = {
+    "changelog_cve", "changelog_bdu",   "changelog_mfsa",
+    "changelog_ove", "changelog_bugid",
+};
+
+static void
+usage(const char *progname)
+{
+    fprintf(stderr, "usage: %s [--repeat N] PATH...\n", progname);
+}
+
+/* Visit every node and count the ids */
+static uint64_t
+naive_walk(const TSTree *tree)
+{
+    TSTreeCursor cursor = ts_tree_cursor_new(ts_tree_root_node(tree));
+    uint64_t ids = 0;
+
+    for (;;) {
+        const char *type = ts_node_type(ts_tree_cursor_current_node(&cursor));
+        size_t i;
+
+        for (i = 0; i < sizeof(id_types) / sizeof(id_types[0]); i++) {
+            if (strcmp(type, id_types[i]) == 0) {
+                ids++;
+                break;
+            }
+        }
+
+        if (ts_tree_cursor_goto_first_child(&cursor) ||
+            ts_tree_cursor_goto_next_sibling(&cursor)) {
+            continue;
+        }
+        while (ts_tree_cursor_goto_parent(&cursor)) {
+            if (ts_tree_cursor_goto_next_sibling(&cursor)) {
+                break;
+            }
+        }
+        if (ts_tree_cursor_current_depth(&cursor) == 0) {
+            break;
+        }
+    }
+
+    ts_tree_cursor_delete(&cursor);
+
+    return ids;
+}
+
+static size_t
+batch_bytes(const TSRpmspecChangelogBatch *batch)
+{
+    const TSRpmspecStringColumn *strings[3] = {
+        &batch->version,
+        &batch->id,
+        &batch->packages,
+    };
+    size_t bytes = (size_t)batch->rows *
+                   (sizeof(*batch->package) + sizeof(*batch->date) +
+                    sizeof(*batch->kind) + sizeof(*batch->row));
+    size_t i;
+
+    for (i = 0; i < 3; i++) {
+        if (strings[i]->count > 0) {
+            bytes += (strings[i]->count + 1) * sizeof(int32_t) +
+                     (size_t)strings[i]->offsets[strings[i]->count];
+        }
+    }
+
+    return bytes;
+}
+
+int
+main(int argc, char **argv)
+{
+    TSRpmspecChangelogExtractor *extractor;
+    TSRpmspecChangelogBatch batch = {0};
+    struct bench_files files;
+    struct ArrowSchema schema;
+    struct ArrowArray array;
+    uint64_t walk_ids = 0;
+    uint64_t extract_ns = 0;
+    uint64_t export_ns = 0;
+    uint64_t walk_ns = 0;
+    uint64_t start;
+    uint32_t rows = 0;
+    size_t bytes = 0;
+    TSParser *parser;
+    TSTree **trees;
+    long repeat = 1;
+    double kib;
+    long r;
+    size_t i;
+    int argi;
+
+    for (argi = 1; argi < argc && argv[argi][0] == '-'; argi++) {
+        if (strcmp(argv[argi], "--repeat") == 0 && argi + 1 < argc) {
+            repeat = strtol(argv[++argi], NULL, 10);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (argi == argc || repeat < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (bench_collect(&files, argc - argi, argv + argi) != 0 ||
+        bench_load(&files) != 0) {
+        return 1;
+    }
+    if (files.count == 0 || files.total_bytes == 0) {
+        fprintf(stderr, "no spec files found, see bench/README.md\n");
+        return 1;
+    }
+
+    extractor =
+        tree_sitter_rpmspec_changelog_extractor_new(tree_sitter_rpmspec());
+    if (extractor == NULL) {
+        fprintf(stderr, "failed to create the changelog extractor\n");
+        return 1;
+    }
+
+    parser = ts_parser_new();
+    ts_parser_set_language(parser, tree_sitter_rpmspec());
+    trees = calloc(files.count, sizeof(*trees));
+    if (trees == NULL) {
+        return 1;
+    }
+    for (i = 0; i < files.count; i++) {
+        trees[i] = ts_parser_parse_string(parser, NULL, files.files[i].data,
+                                          files.files[i].size);
+    }
+
+    /* Every repetition fills one batch with the whole corpus and exports it */
+    for (r = 0; r < repeat; r++) {
+        start = bench_now_ns();
+        for (i = 0; i < files.count; i++) {
+            if (!tree_sitter_rpmspec_changelog_extract(
+                    extractor, trees[i], files.files[i].data, NULL, &batch)) {
+                perror(files.files[i].path);
+                return 1;
+            }
+        }
+        extract_ns += bench_now_ns() - start;
+        rows = batch.rows;
+        bytes = batch_bytes(&batch);
+
+        start = bench_now_ns();
+        if (!tree_sitter_rpmspec_changelog_batch_export(&batch, &schema,
+                                                        &array)) {
+            perror("export");
+            return 1;
+        }
+        array.release(&array);
+        schema.release(&schema);
+        export_ns += bench_now_ns() - start;
+    }
+
+    for (r = 0; r < repeat; r++) {
+        uint64_t ids = 0;
+
+        start = bench_now_ns();
+        for (i = 0; i < files.count; i++) {
+            ids += naive_walk(trees[i]);
+        }
+        walk_ns += bench_now_ns() - start;
+        walk_ids = ids;
+    }
+
+    kib = (double)files.total_bytes * (double)repeat / 1024.0;
+
+    bench_report("files", "%zu", files.count);
+    bench_report("bytes", "%llu", (unsigned long long)files.total_bytes);
+    bench_report("rows", "%u", rows);
+    bench_report("batch_bytes", "%zu", bytes);
+    bench_report("extract_us_per_kib", "%.2f", (double)extract_ns / 1e3 / kib);
+    bench_report("walk_us_per_kib", "%.2f", (double)walk_ns / 1e3 / kib);
+    bench_report("walk_extract_ratio", "%.2f",
+                 extract_ns > 0 ? (double)walk_ns / (double)extract_ns : 0.0);
+    bench_report("rows_per_s", "%.0f",
+                 extract_ns > 0 ? (double)rows * (double)repeat * 1e9 /
+                                      (double)extract_ns
+                                : 0.0);
+    bench_report("export_us", "%.2f", (double)export_ns / 1e3 / (double)repeat);
+
+    for (i = 0; i < files.count; i++) {
+        ts_tree_delete(trees[i]);
+    }
+    free(trees);
+    tree_sitter_rpmspec_changelog_batch_free(&batch);
+    tree_sitter_rpmspec_changelog_extractor_delete(extractor);
+    ts_parser_delete(parser);
+    bench_files_free(&files);
+
+    if (walk_ids != rows) {
+        fprintf(stderr, "extractor found %u ids, tree walk %llu\n", rows,
+                (unsigned long long)walk_ids);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,258 @@
+/*
+ * Helpers shared by the benchmark programs.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "common.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <time.h>
+
+static int
+add_file(struct bench_files *files, const char *path)
+{
+    if (files->count == files->capacity) {
+        size_t capacity = files->capacity ? files->capacity * 2 : 256;
+        struct bench_file *tmp;
+
+        tmp = realloc(files->files, capacity * sizeof(*tmp));
+        if (tmp == NULL) {
+            return -1;
+        }
+        files->files = tmp;
+        files->capacity = capacity;
+    }
+
+    files->files[files->count].path = strdup(path);
+    if (files->files[files->count].path == NULL) {
+        return -1;
+    }
+    files->files[files->count].data = NULL;
+    files->files[files->count].size = 0;
+    files->count++;
+
+    return 0;
+}
+
+static int
+has_spec_suffix(const char *name)
+{
+    size_t len = strlen(name);
+
+    return len > 5 && strcmp(name + len - 5, ".spec") == 0;
+}
+
+static int
+collect_dir(struct bench_files *files, const char *dir)
+{
+    struct dirent *entry;
+    DIR *dp;
+    int rc = 0;
+
+    dp = opendir(dir);
+    if (dp == NULL) {
+        fprintf(stderr, "%s: %s\n", dir, strerror(errno));
+        return -1;
+    }
+
+    while (rc == 0 && (entry = readdir(dp)) != NULL) {
+        struct stat sb;
+        char *path;
+        size_t len;
+
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+
+        len = strlen(dir) + strlen(entry->d_name) + 2;
+        path = malloc(len);
+        if (path == NULL) {
+            rc = -1;
+            break;
+        }
+        snprintf(path, len, "%s/%s", dir, entry->d_name);
+
+        if (lstat(path, &sb) != 0) {
+            fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        } else if (S_ISDIR(sb.st_mode)) {
+            rc = collect_dir(files, path);
+        } else if (S_ISREG(sb.st_mode) && has_spec_suffix(entry->d_name)) {
+            rc = add_file(files, path);
+        }
+        free(path);
+    }
+    closedir(dp);
+
+    return rc;
+}
+
+static int
+compare_path(const void *a, const void *b)
+{
+    const struct bench_file *fa = a;
+    const struct bench_file *fb = b;
+
+    return strcmp(fa->path, fb->path);
+}
+
+int
+bench_collect(struct bench_files *files, int count, char **paths)
+{
+    int i;
+
+    memset(files, 0, sizeof(*files));
+
+    for (i = 0; i < count; i++) {
+        struct stat sb;
+        int rc;
+
+        if (stat(paths[i], &sb) != 0) {
+            fprintf(stderr, "%s: %s\n", paths[i], strerror(errno));
+            return -1;
+        }
+
+        if (S_ISDIR(sb.st_mode)) {
+            rc = collect_dir(files, paths[i]);
+        } else {
+            rc = add_file(files, paths[i]);
+        }
+        if (rc != 0) {
+            return -1;
+        }
+    }
+
+    qsort(files->files, files->count, sizeof(*files->files), compare_path);
+
+    return 0;
+}
+
+int
+bench_load(struct bench_files *files)
+{
+    size_t i;
+
+    files->total_bytes = 0;
+
+    for (i = 0; i < files->count; i++) {
+        struct bench_file *f = &files->files[i];
+        size_t nread;
+        long size;
+        FILE *fp;
+
+        fp = fopen(f->path, "rb");
+        if (fp == NULL) {
+            fprintf(stderr, "%s: %s\n", f->path, strerror(errno));
+            return -1;
+        }
+        if (fseek(fp, 0, SEEK_END) != 0 || (size = ftell(fp)) < 0 ||
+            fseek(fp, 0, SEEK_SET) != 0 || size > UINT32_MAX) {
+            fprintf(stderr, "%s: cannot determine size\n", f->path);
+            fclose(fp);
+            return -1;
+        }
+
+        f->data = malloc((size_t)size + 1);
+        if (f->data == NULL) {
+            fclose(fp);
+            return -1;
+        }
+        nread = fread(f->data, 1, (size_t)size, fp);
+        fclose(fp);
+        if (nread != (size_t)size) {
+            fprintf(stderr, "%s: short read\n", f->path);
+            return -1;
+        }
+        f->data[size] = '\0';
+        f->size = (uint32_t)size;
+        files->total_bytes += f->size;
+    }
+
+    return 0;
+}
+
+void
+bench_files_free(struct bench_files *files)
+{
+    size_t i;
+
+    for (i = 0; i < files->count; i++) {
+        free(files->files[i].path);
+        free(files->files[i].data);
+    }
+    free(files->files);
+    memset(files, 0, sizeof(*files));
+}
+
+uint64_t
+bench_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t
+bench_peak_rss(void)
+{
+    struct rusage ru;
+
+    if (getrusage(RUSAGE_SELF, &ru) != 0) {
+        return 0;
+    }
+
+#ifdef __APPLE__
+    return (uint64_t)ru.ru_maxrss;
+#else
+    return (uint64_t)ru.ru_maxrss * 1024;
+#endif
+}
+
+static int
+compare_u64(const void *a, const void *b)
+{
+    uint64_t va = *(const uint64_t *)a;
+    uint64_t vb = *(const uint64_t *)b;
+
+    return (va > vb) - (va < vb);
+}
+
+uint64_t
+bench_percentile(uint64_t *samples, size_t count, double percentile)
+{
+    size_t index;
+
+    if (count == 0) {
+        return 0;
+    }
+
+    qsort(samples, count, sizeof(*samples), compare_u64);
+
+    index = (size_t)(percentile / 100.0 * (double)(count - 1) + 0.5);
+    if (index >= count) {
+        index = count - 1;
+    }
+
+    return samples[index];
+}
+
+void
+bench_report(const char *key, const char *format, ...)
+{
+    va_list ap;
+
+    printf("%-20s ", key);
+    va_start(ap, format);
+    vprintf(format, ap);
+    va_end(ap);
+    putchar('\n');
+}
@@ -0,0 +1,57 @@
+/*
+ * Helpers shared by the benchmark programs: collecting and loading spec
+ * files, timing and resource usage.
+ */
+
+#ifndef RPMSPEC_BENCH_COMMON_H_
+#define RPMSPEC_BENCH_COMMON_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct bench_file {
+    char *path;
+    char *data;
+    uint32_t size;
+};
+
+struct bench_files {
+    struct bench_file *files;
+    size_t count;
+    size_t capacity;
+    uint64_t total_bytes;
+};
+
+/*
+ * Collect the files named on the command line. Directories are searched
+ * recursively for *.spec files. The result is sorted by path so runs are
+ * comparable. Returns 0 on success, -1 on error.
+ */
+int
+bench_collect(struct bench_files *files, int count, char **paths);
+
+/* Read every collected file into memory. Returns 0 on success, -1 on error. */
+int
+bench_load(struct bench_files *files);
+
+void
+bench_files_free(struct bench_files *files);
+
+/* Monotonic clock in nanoseconds. */
+uint64_t
+bench_now_ns(void);
+
+/* Peak resident set size of the process in bytes. */
+uint64_t
+bench_peak_rss(void);
+
+/* Sort the samples in place and return the given percentile (0-100). */
+uint64_t
+bench_percentile(uint64_t *samples, size_t count, double percentile);
+
+/* Print a "key value" line; all programs use the same format. */
+void
+bench_report(const char *key, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+#endif /* RPMSPEC_BENCH_COMMON_H_ */
@@ -0,0 +1,297 @@
+/*
+ * Dependency extraction benchmark
+ *
+ * Parses every spec file given on the command line once, then extracts the
+ * package identity and dependencies from the trees with the extractor from
+ * tree-sitter-rpmspec-deps.h and with a naive walk over every node of the
+ * tree, the way the scripts built on the bindings do it. It reports the time
+ * per KiB of source for both and fails if they disagree on Name, Version or
+ * Release.
+ *
+ * With --target, the branches of %if, %ifarch and %ifos that are not taken
+ * for ARCH on Linux are found with the macro table from
+ * tree-sitter-rpmspec-macros.h and skipped by the extractor; the time per KiB
+ * then includes loading the macros.
+ *
+ *     rpmspec-bench-deps [--repeat N] [--lazy-changelog] [--target ARCH]
+ *                        PATH...
+ */
+
+#include "common.h"
+
+#include <tree_sitter/api.h>
+#include <tree_sitter/tree-sitter-rpmspec-deps.h>
+#include <tree_sitter/tree-sitter-rpmspec-macros.h>
+#include <tree_sitter/tree-sitter-rpmspec.h>
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+struct identity {
+    TSRpmspecSlice name;
+    TSRpmspecSlice version;
+    TSRpmspecSlice release;
+    uint32_t dependency_tags;
+};
+
+static void
+usage(const char *progname)
+{
+    fprintf(stderr,
+            "usage: %s [--repeat N] [--lazy-changelog] [--target ARCH] "
+            "PATH...\n",
+            progname);
+}
+
+static bool
+text_equals(const char *source, TSNode node, const char *text)
+{
+    uint32_t start = ts_node_start_byte(node);
+    uint32_t length = ts_node_end_byte(node) - start;
+
+    return length == strlen(text) &&
+           strncasecmp(source + start, text, length) == 0;
+}
+
+static TSRpmspecSlice
+slice(TSNode node)
+{
+    uint32_t start = ts_node_start_byte(node);
+
+    return (TSRpmspecSlice){start, ts_node_end_byte(node) - start};
+}
+
+/* Visit every node and look at the `tags` ones */
+static void
+naive_walk(const TSTree *tree, const char *source, struct identity *id)
+{
+    TSTreeCursor cursor = ts_tree_cursor_new(ts_tree_root_node(tree));
+    bool in_package = false;
+
+    memset(id, 0, sizeof(*id));
+
+    for (;;) {
+        TSNode node = ts_tree_cursor_current_node(&cursor);
+        const char *type = ts_node_type(node);
+
+        if (strcmp(type, "package") == 0) {
+            in_package = true;
+        } else if (strcmp(type, "tags") == 0) {
+            TSNode tag = ts_node_named_child(node, 0);
+            TSNode value = ts_node_child_by_field_name(node, "value", 5);
+
+            if (strcmp(ts_node_type(tag), "dependency_tag") == 0) {
+                id->dependency_tags++;
+            } else if (!in_package && text_equals(source, tag, "Name")) {
+                id->name = slice(value);
+            } else if (!in_package && text_equals(source, tag, "Version")) {
+                id->version = slice(value);
+            } else if (!in_package && text_equals(source, tag, "Release")) {
+                id->release = slice(value);
+            }
+        }
+
+        if (ts_tree_cursor_goto_first_child(&cursor) ||
+            ts_tree_cursor_goto_next_sibling(&cursor)) {
+            continue;
+        }
+        while (ts_tree_cursor_goto_parent(&cursor)) {
+            if (ts_tree_cursor_goto_next_sibling(&cursor)) {
+                break;
+            }
+        }
+        if (ts_tree_cursor_current_depth(&cursor) == 0) {
+            break;
+        }
+    }
+
+    ts_tree_cursor_delete(&cursor);
+}
+
+static bool
+slice_matches(TSRpmspecSlice a, TSRpmspecSlice b)
+{
+    return a.start == b.start && a.length == b.length;
+}
+
+int
+main(int argc, char **argv)
+{
+    const TSLanguage *language = tree_sitter_rpmspec();
+    TSRpmspecDepsExtractor *extractor;
+    TSRpmspecDeps deps = {0};
+    struct bench_files files;
+    uint64_t live_dependencies = 0;
+    uint64_t dependencies = 0;
+    const char *target = NULL;
+    uint64_t live_ns = 0;
+    uint64_t dependency_tags = 0;
+    uint64_t extract_ns = 0;
+    uint64_t parse_ns = 0;
+    uint64_t walk_ns = 0;
+    uint64_t start;
+    size_t mismatches = 0;
+    TSParser *parser;
+    TSTree **trees;
+    long repeat = 1;
+    double kib;
+    long r;
+    size_t i;
+    int argi;
+
+    for (argi = 1; argi < argc && argv[argi][0] == '-'; argi++) {
+        if (strcmp(argv[argi], "--repeat") == 0 && argi + 1 < argc) {
+            repeat = strtol(argv[++argi], NULL, 10);
+        } else if (strcmp(argv[argi], "--lazy-changelog") == 0) {
+            language = tree_sitter_rpmspec_lazy_changelog();
+        } else if (strcmp(argv[argi], "--target") == 0 && argi + 1 < argc) {
+            target = argv[++argi];
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (argi == argc || repeat < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (bench_collect(&files, argc - argi, argv + argi) != 0 ||
+        bench_load(&files) != 0) {
+        return 1;
+    }
+    if (files.count == 0 || files.total_bytes == 0) {
+        fprintf(stderr, "no spec files found, see bench/README.md\n");
+        return 1;
+    }
+
+    extractor = tree_sitter_rpmspec_deps_extractor_new(language);
+    if (extractor == NULL) {
+        fprintf(stderr, "failed to create the dependency extractor\n");
+        return 1;
+    }
+
+    parser = ts_parser_new();
+    ts_parser_set_language(parser, language);
+    trees = calloc(files.count, sizeof(*trees));
+    if (trees == NULL) {
+        return 1;
+    }
+
+    for (i = 0; i < files.count; i++) {
+        start = bench_now_ns();
+        trees[i] = ts_parser_parse_string(parser, NULL, files.files[i].data,
+                                          files.files[i].size);
+        parse_ns += bench_now_ns() - start;
+    }
+
+    for (r = 0; r < repeat; r++) {
+        for (i = 0; i < files.count; i++) {
+            start = bench_now_ns();
+            if (!tree_sitter_rpmspec_deps_extract(extractor, trees[i],
+                                                  files.files[i].data, &deps)) {
+                perror(files.files[i].path);
+                return 1;
+            }
+            extract_ns += bench_now_ns() - start;
+            if (r == 0) {
+                dependencies += deps.dependency_count;
+            }
+        }
+    }
+
+    for (r = 0; r < repeat; r++) {
+        for (i = 0; i < files.count; i++) {
+            struct identity id;
+
+            start = bench_now_ns();
+            naive_walk(trees[i], files.files[i].data, &id);
+            walk_ns += bench_now_ns() - start;
+            if (r > 0) {
+                continue;
+            }
+            dependency_tags += id.dependency_tags;
+
+            tree_sitter_rpmspec_deps_extract(extractor, trees[i],
+                                             files.files[i].data, &deps);
+            if (!slice_matches(id.name, deps.name) ||
+                !slice_matches(id.version, deps.version) ||
+                !slice_matches(id.release, deps.release)) {
+                fprintf(stderr, "%s: extractor and tree walk disagree\n",
+                        files.files[i].path);
+                mismatches++;
+            }
+        }
+    }
+
+    if (target != NULL) {
+        TSRpmspecMacros *macros = tree_sitter_rpmspec_macros_new();
+
+        if (macros == NULL ||
+            !tree_sitter_rpmspec_macros_set_target(macros, target, "linux")) {
+            return 1;
+        }
+        for (r = 0; r < repeat; r++) {
+            for (i = 0; i < files.count; i++) {
+                const TSRange *dead;
+                uint32_t dead_count;
+
+                start = bench_now_ns();
+                if (!tree_sitter_rpmspec_macros_load(macros, trees[i],
+                                                     files.files[i].data)) {
+                    return 1;
+                }
+                dead = tree_sitter_rpmspec_macros_dead_ranges(macros,
+                                                              &dead_count);
+                tree_sitter_rpmspec_deps_extractor_set_dead_ranges(
+                    extractor, dead, dead_count);
+                if (!tree_sitter_rpmspec_deps_extract(
+                        extractor, trees[i], files.files[i].data, &deps)) {
+                    perror(files.files[i].path);
+                    return 1;
+                }
+                live_ns += bench_now_ns() - start;
+                if (r == 0) {
+                    live_dependencies += deps.dependency_count;
+                }
+            }
+        }
+        tree_sitter_rpmspec_deps_extractor_set_dead_ranges(extractor, NULL, 0);
+        tree_sitter_rpmspec_macros_delete(macros);
+    }
+
+    kib = (double)files.total_bytes * (double)repeat / 1024.0;
+
+    bench_report("files", "%zu", files.count);
+    bench_report("bytes", "%llu", (unsigned long long)files.total_bytes);
+    bench_report("dependency_tags", "%llu",
+                 (unsigned long long)dependency_tags);
+    bench_report("dependencies", "%llu", (unsigned long long)dependencies);
+    bench_report("parse_us_per_kib", "%.2f",
+                 (double)parse_ns / 1e3 / ((double)files.total_bytes / 1024.0));
+    bench_report("extract_us_per_kib", "%.2f", (double)extract_ns / 1e3 / kib);
+    bench_report("walk_us_per_kib", "%.2f", (double)walk_ns / 1e3 / kib);
+    bench_report("walk_extract_ratio", "%.2f",
+                 extract_ns > 0 ? (double)walk_ns / (double)extract_ns : 0.0);
+    if (target != NULL) {
+        bench_report("live_dependencies", "%llu",
+                     (unsigned long long)live_dependencies);
+        bench_report("live_extract_us_per_kib", "%.2f",
+                     (double)live_ns / 1e3 / kib);
+    }
+    bench_report("mismatches", "%zu", mismatches);
+
+    for (i = 0; i < files.count; i++) {
+        ts_tree_delete(trees[i]);
+    }
+    free(trees);
+    tree_sitter_rpmspec_deps_free(&deps);
+    tree_sitter_rpmspec_deps_extractor_delete(extractor);
+    ts_parser_delete(parser);
+    bench_files_free(&files);
+
+    return mismatches > 0 ? 1 : 0;
+}
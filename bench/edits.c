@@ -0,0 +1,485 @@
+/*
+ * Incremental reparse benchmark
+ *
+ * Replays edit scripts against a spec file the way an editor does: every
+ * edit is applied to the old tree with ts_tree_edit() and the text is
+ * reparsed with the old tree. For each edit it records the reparse time,
+ * the bytes the lexer had to scan again, how many subtrees were reused and
+ * how many nodes were built anew, and the size of the changed ranges.
+ *
+ *     rpmspec-bench-edits [--verbose] SPEC SCRIPT...
+ *
+ * An edit script has one command per line, text uses \n, \t and \\ escapes:
+ *
+ *     # comment
+ *     goto TEXT        move the cursor after the next occurrence of TEXT
+ *     type TEXT        insert TEXT one character (one edit) at a time
+ *     paste TEXT       insert TEXT as a single edit
+ *     backspace N      delete N characters before the cursor, one at a time
+ *     delete N         delete N characters after the cursor as a single edit
+ *
+ * After the last edit the incremental tree is compared with a fresh parse
+ * of the final text; the program fails if they differ.
+ */
+
+#include "common.h"
+
+#include <tree_sitter/api.h>
+#include <tree_sitter/tree-sitter-rpmspec.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct text {
+    char *data;
+    uint32_t size;
+    uint32_t capacity;
+    uint32_t cursor;
+};
+
+/* The counters except time and changed bytes come from the parser's log. */
+struct edit_sample {
+    uint64_t time_ns;
+    uint64_t lexed_bytes;
+    uint64_t lexed_tokens;
+    uint64_t reused_nodes;
+    uint64_t new_nodes;
+    uint64_t changed_bytes;
+};
+
+struct session {
+    TSParser *parser;
+    TSTree *tree;
+    struct text text;
+    struct edit_sample *samples;
+    size_t count;
+    size_t capacity;
+    bool verbose;
+};
+
+static void
+log_stats(void *payload, TSLogType type, const char *message)
+{
+    struct edit_sample *stats = payload;
+    const char *size;
+
+    if (type != TSLogTypeParse) {
+        return;
+    }
+
+    if (strncmp(message, "lexed_lookahead", 15) == 0) {
+        stats->lexed_tokens++;
+        size = strstr(message, "size:");
+        if (size != NULL) {
+            stats->lexed_bytes += strtoul(size + 5, NULL, 10);
+        }
+    } else if (strncmp(message, "reuse_node", 10) == 0) {
+        stats->reused_nodes++;
+    } else if (strncmp(message, "shift", 5) == 0 ||
+               strncmp(message, "reduce", 6) == 0) {
+        stats->new_nodes++;
+    }
+}
+
+static TSPoint
+point_at(const struct text *text, uint32_t offset)
+{
+    TSPoint point = {0, 0};
+    uint32_t i;
+
+    for (i = 0; i < offset; i++) {
+        if (text->data[i] == '\n') {
+            point.row++;
+            point.column = 0;
+        } else {
+            point.column++;
+        }
+    }
+
+    return point;
+}
+
+static TSPoint
+point_after(TSPoint start, const char *data, uint32_t length)
+{
+    uint32_t i;
+
+    for (i = 0; i < length; i++) {
+        if (data[i] == '\n') {
+            start.row++;
+            start.column = 0;
+        } else {
+            start.column++;
+        }
+    }
+
+    return start;
+}
+
+static TSTree *
+parse(struct session *s)
+{
+    return ts_parser_parse_string(s->parser, s->tree, s->text.data,
+                                  s->text.size);
+}
+
+/*
+ * Replace LENGTH bytes at the cursor with INSERT, update the tree and
+ * reparse it, recording one sample.
+ */
+static int
+apply_edit(struct session *s, uint32_t length, const char *insert,
+           uint32_t insert_length)
+{
+    struct text *t = &s->text;
+    struct edit_sample sample;
+    TSInputEdit edit;
+    TSRange *ranges;
+    uint32_t nranges;
+    uint32_t i;
+    TSTree *tree;
+    uint64_t start;
+
+    if (t->size - length + insert_length + 1 > t->capacity) {
+        uint32_t capacity = (t->size + insert_length + 1) * 2;
+        char *tmp = realloc(t->data, capacity);
+
+        if (tmp == NULL) {
+            return -1;
+        }
+        t->data = tmp;
+        t->capacity = capacity;
+    }
+
+    edit.start_byte = t->cursor;
+    edit.old_end_byte = t->cursor + length;
+    edit.new_end_byte = t->cursor + insert_length;
+    edit.start_point = point_at(t, edit.start_byte);
+    edit.old_end_point = point_at(t, edit.old_end_byte);
+    edit.new_end_point = point_after(edit.start_point, insert, insert_length);
+
+    memmove(t->data + edit.new_end_byte, t->data + edit.old_end_byte,
+            t->size - edit.old_end_byte + 1);
+    memcpy(t->data + t->cursor, insert, insert_length);
+    t->size = t->size - length + insert_length;
+    t->cursor = edit.new_end_byte;
+
+    ts_tree_edit(s->tree, &edit);
+
+    /* Collect the counters in a separate run, logging is slow. */
+    memset(&sample, 0, sizeof(sample));
+    ts_parser_set_logger(s->parser,
+                         (TSLogger){.payload = &sample,
+                                    .log = log_stats});
+    tree = parse(s);
+    ts_tree_delete(tree);
+    ts_parser_set_logger(s->parser, (TSLogger){0});
+
+    start = bench_now_ns();
+    tree = parse(s);
+    sample.time_ns = bench_now_ns() - start;
+    if (tree == NULL) {
+        return -1;
+    }
+
+    ranges = ts_tree_get_changed_ranges(s->tree, tree, &nranges);
+    for (i = 0; i < nranges; i++) {
+        sample.changed_bytes += ranges[i].end_byte - ranges[i].start_byte;
+    }
+    free(ranges);
+
+    ts_tree_delete(s->tree);
+    s->tree = tree;
+
+    if (s->verbose) {
+        printf("edit %zu at %u: %.1f us, lexed %llu bytes, reused %llu, "
+               "new %llu, changed %llu bytes\n",
+               s->count + 1, edit.start_byte, (double)sample.time_ns / 1e3,
+               (unsigned long long)sample.lexed_bytes,
+               (unsigned long long)sample.reused_nodes,
+               (unsigned long long)sample.new_nodes,
+               (unsigned long long)sample.changed_bytes);
+    }
+
+    if (s->count == s->capacity) {
+        size_t capacity = s->capacity ? s->capacity * 2 : 256;
+        struct edit_sample *tmp;
+
+        tmp = realloc(s->samples, capacity * sizeof(*tmp));
+        if (tmp == NULL) {
+            return -1;
+        }
+        s->samples = tmp;
+        s->capacity = capacity;
+    }
+    s->samples[s->count++] = sample;
+
+    return 0;
+}
+
+/* Decode the escapes of a script argument in place, returns its length. */
+static uint32_t
+unescape(char *arg)
+{
+    char *out = arg;
+    char *in = arg;
+
+    while (*in != '\0') {
+        if (in[0] == '\\' && in[1] != '\0') {
+            in++;
+            switch (*in) {
+            case 'n':
+                *out++ = '\n';
+                break;
+            case 't':
+                *out++ = '\t';
+                break;
+            default:
+                *out++ = *in;
+                break;
+            }
+            in++;
+        } else {
+            *out++ = *in++;
+        }
+    }
+    *out = '\0';
+
+    return (uint32_t)(out - arg);
+}
+
+static int
+run_command(struct session *s, const char *script, unsigned lineno,
+            char *command, char *arg)
+{
+    struct text *t = &s->text;
+    uint32_t length = unescape(arg);
+    unsigned long n = strtoul(arg, NULL, 10);
+    uint32_t i;
+
+    if (strcmp(command, "goto") == 0) {
+        char *found = strstr(t->data + t->cursor, arg);
+
+        if (found == NULL) {
+            fprintf(stderr, "%s:%u: text not found\n", script, lineno);
+            return -1;
+        }
+        t->cursor = (uint32_t)(found - t->data) + length;
+    } else if (strcmp(command, "type") == 0) {
+        for (i = 0; i < length; i++) {
+            if (apply_edit(s, 0, arg + i, 1) != 0) {
+                return -1;
+            }
+        }
+    } else if (strcmp(command, "paste") == 0) {
+        return apply_edit(s, 0, arg, length);
+    } else if (strcmp(command, "backspace") == 0) {
+        if (n > t->cursor) {
+            n = t->cursor;
+        }
+        for (i = 0; i < n; i++) {
+            t->cursor--;
+            if (apply_edit(s, 1, "", 0) != 0) {
+                return -1;
+            }
+        }
+    } else if (strcmp(command, "delete") == 0) {
+        if (n > t->size - t->cursor) {
+            n = t->size - t->cursor;
+        }
+        return apply_edit(s, (uint32_t)n, "", 0);
+    } else {
+        fprintf(stderr, "%s:%u: unknown command '%s'\n", script, lineno,
+                command);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int
+run_script(struct session *s, const char *script)
+{
+    unsigned lineno = 0;
+    char line[4096];
+    FILE *fp;
+    int rc = 0;
+
+    fp = fopen(script, "r");
+    if (fp == NULL) {
+        perror(script);
+        return -1;
+    }
+
+    while (rc == 0 && fgets(line, sizeof(line), fp) != NULL) {
+        char *arg;
+
+        lineno++;
+        line[strcspn(line, "\n")] = '\0';
+        if (line[0] == '#' || line[0] == '\0') {
+            continue;
+        }
+
+        arg = strchr(line, ' ');
+        if (arg == NULL) {
+            fprintf(stderr, "%s:%u: missing argument\n", script, lineno);
+            rc = -1;
+            break;
+        }
+        *arg++ = '\0';
+
+        rc = run_command(s, script, lineno, line, arg);
+    }
+    fclose(fp);
+
+    return rc;
+}
+
+/* The incremental tree must be identical to a tree parsed from scratch. */
+static int
+check_tree(struct session *s, const char *script)
+{
+    TSTree *fresh;
+    char *expected;
+    char *actual;
+    int rc = 0;
+
+    fresh = ts_parser_parse_string(s->parser, NULL, s->text.data,
+                                   s->text.size);
+    expected = ts_node_string(ts_tree_root_node(fresh));
+    actual = ts_node_string(ts_tree_root_node(s->tree));
+
+    if (strcmp(expected, actual) != 0) {
+        fprintf(stderr, "%s: incremental tree differs from a fresh parse\n",
+                script);
+        rc = -1;
+    }
+
+    free(expected);
+    free(actual);
+    ts_tree_delete(fresh);
+
+    return rc;
+}
+
+static void
+report_mean_max(const struct session *s, const char *key, size_t offset)
+{
+    uint64_t max = 0;
+    uint64_t sum = 0;
+    char name[64];
+    size_t i;
+
+    for (i = 0; i < s->count; i++) {
+        uint64_t v;
+
+        memcpy(&v, (const char *)&s->samples[i] + offset, sizeof(v));
+        sum += v;
+        max = v > max ? v : max;
+    }
+
+    snprintf(name, sizeof(name), "mean_%s", key);
+    bench_report(name, "%.1f", (double)sum / (double)s->count);
+    snprintf(name, sizeof(name), "max_%s", key);
+    bench_report(name, "%llu", (unsigned long long)max);
+}
+
+static void
+report(struct session *s, const char *script)
+{
+    uint64_t *times;
+    size_t i;
+
+    bench_report("script", "%s", script);
+    bench_report("edits", "%zu", s->count);
+    if (s->count == 0) {
+        return;
+    }
+
+    times = malloc(s->count * sizeof(*times));
+    if (times == NULL) {
+        return;
+    }
+    for (i = 0; i < s->count; i++) {
+        times[i] = s->samples[i].time_ns;
+    }
+    bench_report("p50_us", "%.1f",
+                 (double)bench_percentile(times, s->count, 50) / 1e3);
+    bench_report("p99_us", "%.1f",
+                 (double)bench_percentile(times, s->count, 99) / 1e3);
+    bench_report("max_us", "%.1f",
+                 (double)bench_percentile(times, s->count, 100) / 1e3);
+    free(times);
+
+    report_mean_max(s, "lexed_bytes",
+                    offsetof(struct edit_sample, lexed_bytes));
+    report_mean_max(s, "reused_nodes",
+                    offsetof(struct edit_sample, reused_nodes));
+    report_mean_max(s, "new_nodes", offsetof(struct edit_sample, new_nodes));
+    report_mean_max(s, "changed_bytes",
+                    offsetof(struct edit_sample, changed_bytes));
+}
+
+int
+main(int argc, char **argv)
+{
+    struct bench_files files;
+    struct session s;
+    int rc = 0;
+    int argi = 1;
+    int i;
+
+    memset(&s, 0, sizeof(s));
+
+    if (argi < argc && strcmp(argv[argi], "--verbose") == 0) {
+        s.verbose = true;
+        argi++;
+    }
+    if (argc - argi < 2) {
+        fprintf(stderr, "usage: %s [--verbose] SPEC SCRIPT...\n", argv[0]);
+        return 2;
+    }
+
+    if (bench_collect(&files, 1, argv + argi) != 0 ||
+        bench_load(&files) != 0 || files.count != 1) {
+        return 1;
+    }
+
+    s.parser = ts_parser_new();
+    ts_parser_set_language(s.parser, tree_sitter_rpmspec());
+
+    for (i = argi + 1; rc == 0 && i < argc; i++) {
+        const struct bench_file *spec = &files.files[0];
+
+        s.text.size = spec->size;
+        s.text.capacity = spec->size + 1;
+        s.text.cursor = 0;
+        s.text.data = malloc(s.text.capacity);
+        if (s.text.data == NULL) {
+            return 1;
+        }
+        memcpy(s.text.data, spec->data, spec->size + 1);
+        s.count = 0;
+        s.tree = parse(&s);
+
+        rc = run_script(&s, argv[i]);
+        if (rc == 0) {
+            rc = check_tree(&s, argv[i]);
+        }
+        if (rc == 0) {
+            report(&s, argv[i]);
+        }
+
+        ts_tree_delete(s.tree);
+        free(s.text.data);
+    }
+
+    free(s.samples);
+    ts_parser_delete(s.parser);
+    bench_files_free(&files);
+
+    return rc == 0 ? 0 : 1;
+}
@@ -0,0 +1,83 @@
+#!/bin/sh
+#
+# Download the benchmark corpus listed in corpus.list into bench/corpus and
+# check it against corpus.sha256.
+#
+#     fetch-corpus.sh [--update] [DIR]
+#
+# Every package of the list must be downloaded and match its checksum,
+# otherwise the script fails: a benchmark over part of the corpus, or over
+# other contents, is not comparable with one over all of it. --update
+# downloads every file again and writes corpus.sha256 afresh, to commit
+# when the list changes.
+
+set -eu
+
+here=$(cd "$(dirname "$0")" && pwd)
+list="$here/corpus.list"
+lock="$here/corpus.sha256"
+update=false
+
+if [ "${1:-}" = "--update" ]; then
+    update=true
+    shift
+fi
+dest="${1:-$here/corpus}"
+
+branch=$(sed -n 's/^# branch: *//p' "$list")
+if [ -z "$branch" ]; then
+    echo "corpus.list: missing branch" >&2
+    exit 1
+fi
+if ! $update && [ ! -f "$lock" ]; then
+    echo "$lock is missing, run $0 --update to record it" >&2
+    exit 1
+fi
+
+mkdir -p "$dest"
+packages=$(grep -v '^#' "$list" | grep -v '^$')
+
+failed=0
+for pkg in $packages; do
+    out="$dest/$pkg.spec"
+    if ! $update && [ -s "$out" ]; then
+        continue
+    fi
+    url="https://src.fedoraproject.org/rpms/$pkg/raw/$branch/f/$pkg.spec"
+    if ! curl -fsSL --retry 3 -o "$out.tmp" "$url"; then
+        echo "$pkg: cannot fetch $url" >&2
+        rm -f "$out.tmp"
+        failed=$((failed + 1))
+        continue
+    fi
+    mv "$out.tmp" "$out"
+done
+if [ "$failed" -gt 0 ]; then
+    echo "$failed packages could not be fetched" >&2
+    exit 1
+fi
+
+cd "$dest"
+if $update; then
+    for pkg in $packages; do
+        sha256sum -- "$pkg.spec"
+    done > "$lock"
+    echo "wrote $lock, commit it to pin the corpus"
+    exit 0
+fi
+
+# Every package has its checksum and there is none for a package the list
+# no longer has
+for pkg in $packages; do
+    echo "$pkg.spec"
+done | sort > "$dest/.corpus.expected"
+sed 's/^[0-9a-f]*  //' "$lock" | sort > "$dest/.corpus.locked"
+if ! cmp -s "$dest/.corpus.expected" "$dest/.corpus.locked"; then
+    echo "$lock does not match corpus.list, run $0 --update" >&2
+    diff "$dest/.corpus.locked" "$dest/.corpus.expected" >&2 || true
+    rm -f "$dest/.corpus.expected" "$dest/.corpus.locked"
+    exit 1
+fi
+rm -f "$dest/.corpus.expected" "$dest/.corpus.locked"
+
+sha256sum --quiet --strict -c "$lock"
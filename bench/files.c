@@ -0,0 +1,301 @@
+/*
+ * %files ownership index benchmark
+ *
+ * Parses every spec file given on the command line, expands its macros and
+ * records its %files sections in the index of tree-sitter-rpmspec-files.h.
+ * Then it looks up the owners of the indexed paths, and compares that with
+ * what answering the same question by walking the trees costs: one pass
+ * over every %files section of the corpus per lookup. Reports the size of
+ * the index and the time per lookup for both.
+ *
+ *     rpmspec-bench-files [--repeat N] [--target ARCH] PATH...
+ *
+ * Paths are expanded with the usual rpm directory macros for ARCH, x86_64
+ * by default. The program fails if an indexed path has no owner.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "common.h"
+
+#include <tree_sitter/api.h>
+#include <tree_sitter/tree-sitter-rpmspec-files.h>
+#include <tree_sitter/tree-sitter-rpmspec-macros.h>
+#include <tree_sitter/tree-sitter-rpmspec.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Paths looked up, taken from the index */
+#define MAX_QUERIES 10000
+#define MAX_DEPTH 8
+
+static const char *const directories[][2] = {
+    {"_prefix", "/usr"},
+    {"_exec_prefix", "%{_prefix}"},
+    {"_bindir", "%{_exec_prefix}/bin"},
+    {"_sbindir", "%{_exec_prefix}/sbin"},
+    {"_libexecdir", "%{_exec_prefix}/libexec"},
+    {"_datadir", "%{_prefix}/share"},
+    {"_sysconfdir", "/etc"},
+    {"_localstatedir", "/var"},
+    {"_sharedstatedir", "/var/lib"},
+    {"_includedir", "%{_prefix}/include"},
+    {"_infodir", "%{_datadir}/info"},
+    {"_mandir", "%{_datadir}/man"},
+    {"_docdir", "%{_datadir}/doc"},
+    {"_unitdir", "%{_prefix}/lib/systemd/system"},
+    {"_userunitdir", "%{_prefix}/lib/systemd/user"},
+    {"_tmpfilesdir", "%{_prefix}/lib/tmpfiles.d"},
+    {"_datarootdir", "%{_prefix}/share"},
+    {"_rundir", "/run"},
+    {"_pkgconfigdir", "%{_libdir}/pkgconfig"},
+};
+
+struct queries {
+    char **paths;
+    size_t count;
+};
+
+static void
+usage(const char *progname)
+{
+    fprintf(stderr, "usage: %s [--repeat N] [--target ARCH] PATH...\n",
+            progname);
+}
+
+static bool
+collect_query(const TSRpmspecFilesOwner *owner, void *payload)
+{
+    struct queries *queries = payload;
+
+    if (queries->count == MAX_QUERIES) {
+        return false;
+    }
+    if ((owner->flags & (TSRpmspecFileGlob | TSRpmspecFileList)) != 0 ||
+        owner->path[0] != '/' ||
+        (queries->count > 0 &&
+         strcmp(queries->paths[queries->count - 1], owner->path) == 0)) {
+        return true;
+    }
+    queries->paths[queries->count] = strdup(owner->path);
+    if (queries->paths[queries->count] != NULL) {
+        queries->count++;
+    }
+
+    return true;
+}
+
+static bool
+count_owner(const TSRpmspecFilesOwner *owner, void *payload)
+{
+    (void)owner;
+    (*(uint64_t *)payload)++;
+
+    return true;
+}
+
+static TSRpmspecMacros *
+new_macros(const char *arch)
+{
+    TSRpmspecMacros *macros = tree_sitter_rpmspec_macros_new();
+    bool lib64 = strstr(arch, "64") != NULL || strcmp(arch, "s390x") == 0;
+    const char *libdir = lib64 ? "%{_prefix}/lib64" : "%{_prefix}/lib";
+    size_t i;
+
+    if (macros == NULL ||
+        !tree_sitter_rpmspec_macros_set_target(macros, arch, "linux") ||
+        !tree_sitter_rpmspec_macros_define(macros, "_libdir", libdir)) {
+        return NULL;
+    }
+    for (i = 0; i < sizeof(directories) / sizeof(directories[0]); i++) {
+        if (!tree_sitter_rpmspec_macros_define(macros, directories[i][0],
+                                               directories[i][1])) {
+            return NULL;
+        }
+    }
+
+    return macros;
+}
+
+/* Add every spec to a new builder, which is what one walk costs */
+static TSRpmspecFilesBuilder *
+build(const struct bench_files *files,
+      TSTree **trees,
+      TSRpmspecMacros *macros)
+{
+    TSRpmspecFilesBuilder *builder;
+    size_t i;
+
+    builder = tree_sitter_rpmspec_files_builder_new(tree_sitter_rpmspec());
+    if (builder == NULL) {
+        return NULL;
+    }
+    for (i = 0; i < files->count; i++) {
+        if (!tree_sitter_rpmspec_macros_load(macros, trees[i],
+                                             files->files[i].data) ||
+            !tree_sitter_rpmspec_files_builder_add(
+                builder, files->files[i].path, trees[i],
+                files->files[i].data, macros)) {
+            perror(files->files[i].path);
+            tree_sitter_rpmspec_files_builder_delete(builder);
+            return NULL;
+        }
+    }
+
+    return builder;
+}
+
+int
+main(int argc, char **argv)
+{
+    TSRpmspecFilesIndexStats stats;
+    TSRpmspecFilesBuilder *builder;
+    TSRpmspecFilesIndex *index;
+    struct queries queries = {0};
+    const char *arch = "x86_64";
+    struct bench_files files;
+    TSRpmspecMacros *macros;
+    char pattern[3 * MAX_DEPTH + 1] = "";
+    uint64_t owners = 0;
+    uint64_t lookup_ns = 0;
+    uint64_t build_ns;
+    uint64_t walk_ns;
+    uint64_t *samples;
+    uint64_t start;
+    TSParser *parser;
+    TSTree **trees;
+    void *data;
+    size_t sample = 0;
+    long repeat = 1;
+    size_t size;
+    long r;
+    size_t i;
+    int argi;
+
+    for (argi = 1; argi < argc && argv[argi][0] == '-'; argi++) {
+        if (strcmp(argv[argi], "--repeat") == 0 && argi + 1 < argc) {
+            repeat = strtol(argv[++argi], NULL, 10);
+        } else if (strcmp(argv[argi], "--target") == 0 && argi + 1 < argc) {
+            arch = argv[++argi];
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (argi == argc || repeat < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (bench_collect(&files, argc - argi, argv + argi) != 0 ||
+        bench_load(&files) != 0) {
+        return 1;
+    }
+    if (files.count == 0 || files.total_bytes == 0) {
+        fprintf(stderr, "no spec files found, see bench/README.md\n");
+        return 1;
+    }
+
+    macros = new_macros(arch);
+    parser = ts_parser_new();
+    ts_parser_set_language(parser, tree_sitter_rpmspec());
+    trees = calloc(files.count, sizeof(*trees));
+    queries.paths = calloc(MAX_QUERIES, sizeof(*queries.paths));
+    if (macros == NULL || trees == NULL || queries.paths == NULL) {
+        return 1;
+    }
+    for (i = 0; i < files.count; i++) {
+        trees[i] = ts_parser_parse_string(parser, NULL, files.files[i].data,
+                                          files.files[i].size);
+    }
+
+    start = bench_now_ns();
+    builder = build(&files, trees, macros);
+    walk_ns = bench_now_ns() - start;
+    if (builder == NULL) {
+        return 1;
+    }
+    start = bench_now_ns();
+    data = tree_sitter_rpmspec_files_builder_serialize(builder, &size);
+    build_ns = walk_ns + bench_now_ns() - start;
+    if (data == NULL) {
+        perror("serialize");
+        return 1;
+    }
+    index = tree_sitter_rpmspec_files_index_from_buffer(data, size);
+    if (index == NULL) {
+        perror("index");
+        return 1;
+    }
+    tree_sitter_rpmspec_files_index_stats(index, &stats);
+
+    /* Patterns of one to MAX_DEPTH "*" components find every entry */
+    for (i = 0; i < MAX_DEPTH; i++) {
+        strcat(pattern, "/*");
+        tree_sitter_rpmspec_files_index_find(index, pattern, collect_query,
+                                             &queries);
+    }
+    if (queries.count == 0) {
+        fprintf(stderr, "no absolute paths in the %%files sections\n");
+        return 1;
+    }
+
+    samples = calloc(queries.count * (size_t)repeat, sizeof(*samples));
+    if (samples == NULL) {
+        return 1;
+    }
+    for (r = 0; r < repeat; r++) {
+        for (i = 0; i < queries.count; i++) {
+            uint64_t found = 0;
+
+            start = bench_now_ns();
+            tree_sitter_rpmspec_files_index_owners(index, queries.paths[i],
+                                                   count_owner, &found);
+            samples[sample] = bench_now_ns() - start;
+            lookup_ns += samples[sample++];
+            if (found == 0) {
+                fprintf(stderr, "%s: no owner\n", queries.paths[i]);
+                return 1;
+            }
+            owners += found;
+        }
+    }
+
+    bench_report("files", "%zu", files.count);
+    bench_report("packages", "%u", stats.packages);
+    bench_report("entries", "%u", stats.entries);
+    bench_report("trie_nodes", "%u", stats.nodes);
+    bench_report("string_bytes", "%u", stats.string_bytes);
+    bench_report("index_bytes", "%zu", stats.size);
+    bench_report("queries", "%zu", queries.count);
+    bench_report("owners_per_query", "%.2f",
+                 (double)owners / (double)sample);
+    bench_report("build_ms", "%.2f", (double)build_ns / 1e6);
+    bench_report("walk_us_per_query", "%.2f", (double)walk_ns / 1e3);
+    bench_report("lookup_us_per_query", "%.3f",
+                 (double)lookup_ns / 1e3 / (double)sample);
+    bench_report("p99_lookup_us", "%.3f",
+                 (double)bench_percentile(samples, sample, 99) / 1e3);
+    bench_report("walk_lookup_ratio", "%.0f",
+                 (double)walk_ns * (double)sample / (double)lookup_ns);
+
+    for (i = 0; i < queries.count; i++) {
+        free(queries.paths[i]);
+    }
+    free(queries.paths);
+    free(samples);
+    tree_sitter_rpmspec_files_index_delete(index);
+    free(data);
+    tree_sitter_rpmspec_files_builder_delete(builder);
+    tree_sitter_rpmspec_macros_delete(macros);
+    for (i = 0; i < files.count; i++) {
+        ts_tree_delete(trees[i]);
+    }
+    free(trees);
+    ts_parser_delete(parser);
+    bench_files_free(&files);
+
+    return 0;
+}
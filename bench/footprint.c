@@ -0,0 +1,347 @@
+/*
+ * Report the static footprint of the generated parse tables.
+ *
+ * The numbers are read straight from the TSLanguage struct, so this does not
+ * need the tree-sitter runtime. With --check, every key listed in the given
+ * baseline file must not grow; this is how table size regressions are caught.
+ * With --update, the keys listed in the baseline file are set to the values
+ * just measured, to commit after regenerating the parser.
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "tree_sitter/parser.h"
+#include "tree_sitter/tree-sitter-rpmspec.h"
+
+struct footprint {
+    unsigned long state_count;
+    unsigned long large_state_count;
+    unsigned long symbol_count;
+    unsigned long token_count;
+    unsigned long dense_table_bytes;
+    unsigned long small_table_bytes;
+    unsigned long parse_action_bytes;
+    unsigned long lex_mode_bytes;
+    unsigned long library_bytes;
+    unsigned long rss_bytes;
+};
+
+static unsigned long
+small_table_length(const TSLanguage *language)
+{
+    uint32_t small_states = language->state_count - language->large_state_count;
+    const uint16_t *table = language->small_parse_table;
+    unsigned long length = 0;
+    uint32_t state;
+
+    for (state = 0; state < small_states; state++) {
+        uint32_t offset = language->small_parse_table_map[state];
+        uint16_t group_count = table[offset++];
+        uint16_t i;
+
+        for (i = 0; i < group_count; i++) {
+            offset += 2 + table[offset + 1];
+        }
+        if (offset > length) {
+            length = offset;
+        }
+    }
+
+    return length;
+}
+
+static unsigned long
+parse_action_length(const TSLanguage *language)
+{
+    uint32_t small_states = language->state_count - language->large_state_count;
+    const uint16_t *table = language->small_parse_table;
+    uint32_t max_index = 0;
+    uint32_t state;
+    uint32_t symbol;
+
+    for (state = 0; state < language->large_state_count; state++) {
+        const uint16_t *row = &language->parse_table[state *
+                                                      language->symbol_count];
+
+        for (symbol = 0; symbol < language->token_count; symbol++) {
+            if (row[symbol] > max_index) {
+                max_index = row[symbol];
+            }
+        }
+    }
+
+    for (state = 0; state < small_states; state++) {
+        uint32_t offset = language->small_parse_table_map[state];
+        uint16_t group_count = table[offset++];
+        uint16_t i;
+
+        for (i = 0; i < group_count; i++) {
+            uint16_t value = table[offset];
+            uint16_t symbol_count = table[offset + 1];
+
+            /* Only terminal groups refer into ts_parse_actions. */
+            if (table[offset + 2] < language->token_count &&
+                value > max_index) {
+                max_index = value;
+            }
+            offset += 2 + symbol_count;
+        }
+    }
+
+    return max_index + 1 + language->parse_actions[max_index].entry.count;
+}
+
+static unsigned long
+resident_bytes(void)
+{
+    unsigned long size = 0;
+    unsigned long resident = 0;
+    FILE *fp;
+
+    fp = fopen("/proc/self/statm", "r");
+    if (fp == NULL) {
+        return 0;
+    }
+    if (fscanf(fp, "%lu %lu", &size, &resident) != 2) {
+        resident = 0;
+    }
+    fclose(fp);
+
+    return resident * (unsigned long)sysconf(_SC_PAGESIZE);
+}
+
+/* Touch every page of the tables, as the first parse of a large file would. */
+static void
+page_in_tables(const TSLanguage *language, const struct footprint *fp)
+{
+    const volatile unsigned char *p;
+    unsigned long page = (unsigned long)sysconf(_SC_PAGESIZE);
+    unsigned long sum = 0;
+    unsigned long i;
+
+    p = (const volatile unsigned char *)language->parse_table;
+    for (i = 0; i < fp->dense_table_bytes; i += page) {
+        sum += p[i];
+    }
+    p = (const volatile unsigned char *)language->small_parse_table;
+    for (i = 0; i < fp->small_table_bytes; i += page) {
+        sum += p[i];
+    }
+    p = (const volatile unsigned char *)language->parse_actions;
+    for (i = 0; i < fp->parse_action_bytes; i += page) {
+        sum += p[i];
+    }
+    p = (const volatile unsigned char *)language->lex_modes;
+    for (i = 0; i < fp->lex_mode_bytes; i += page) {
+        sum += p[i];
+    }
+    (void)sum;
+}
+
+static void
+measure(const char *library, struct footprint *fp)
+{
+    const TSLanguage *language = tree_sitter_rpmspec();
+    unsigned long rss_before;
+    struct stat sb;
+
+    memset(fp, 0, sizeof(*fp));
+
+    /* Sizing the tables below reads them, so sample the RSS first. */
+    rss_before = resident_bytes();
+
+    fp->state_count = language->state_count;
+    fp->large_state_count = language->large_state_count;
+    fp->symbol_count = language->symbol_count;
+    fp->token_count = language->token_count;
+    fp->dense_table_bytes = (unsigned long)language->large_state_count *
+                            language->symbol_count * sizeof(uint16_t);
+    fp->small_table_bytes = small_table_length(language) * sizeof(uint16_t);
+    fp->parse_action_bytes = parse_action_length(language) *
+                             sizeof(TSParseActionEntry);
+    fp->lex_mode_bytes = (unsigned long)language->state_count *
+                         sizeof(TSLexerMode);
+
+    if (library != NULL && stat(library, &sb) == 0) {
+        fp->library_bytes = (unsigned long)sb.st_size;
+    }
+
+    page_in_tables(language, fp);
+    fp->rss_bytes = resident_bytes() - rss_before;
+}
+
+#define FOOTPRINT_KEYS(X)                                                      \
+    X(state_count)                                                             \
+    X(large_state_count)                                                       \
+    X(symbol_count)                                                            \
+    X(token_count)                                                             \
+    X(dense_table_bytes)                                                       \
+    X(small_table_bytes)                                                       \
+    X(parse_action_bytes)                                                      \
+    X(lex_mode_bytes)                                                          \
+    X(library_bytes)                                                           \
+    X(rss_bytes)
+
+static const unsigned long *
+lookup(const struct footprint *fp, const char *key)
+{
+#define X(name)                                                                \
+    if (strcmp(key, #name) == 0) {                                             \
+        return &fp->name;                                                      \
+    }
+    FOOTPRINT_KEYS(X)
+#undef X
+    return NULL;
+}
+
+static void
+print(const struct footprint *fp)
+{
+#define X(name) printf("%-20s %lu\n", #name, fp->name);
+    FOOTPRINT_KEYS(X)
+#undef X
+}
+
+static int
+check(const struct footprint *fp, const char *path)
+{
+    char line[256];
+    int rc = 0;
+    FILE *in;
+
+    in = fopen(path, "r");
+    if (in == NULL) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    while (fgets(line, sizeof(line), in) != NULL) {
+        const unsigned long *current;
+        unsigned long limit;
+        char key[64];
+
+        if (line[0] == '#' || sscanf(line, "%63s %lu", key, &limit) != 2) {
+            continue;
+        }
+
+        current = lookup(fp, key);
+        if (current == NULL) {
+            fprintf(stderr, "%s: unknown key '%s'\n", path, key);
+            rc = 1;
+        } else if (*current > limit) {
+            fprintf(stderr,
+                    "%s grew: %lu > %lu (baseline)\n",
+                    key,
+                    *current,
+                    limit);
+            rc = 1;
+        }
+    }
+    fclose(in);
+
+    return rc;
+}
+
+/* Rewrite the values of the baseline file, keeping its comments and keys */
+static int
+update(const struct footprint *fp, const char *path)
+{
+    char tmp[4096];
+    char line[256];
+    FILE *out;
+    FILE *in;
+    int rc = 0;
+
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp)) {
+        fprintf(stderr, "%s: %s\n", path, strerror(ENAMETOOLONG));
+        return 1;
+    }
+    in = fopen(path, "r");
+    if (in == NULL) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    out = fopen(tmp, "w");
+    if (out == NULL) {
+        fprintf(stderr, "%s: %s\n", tmp, strerror(errno));
+        fclose(in);
+        return 1;
+    }
+
+    while (fgets(line, sizeof(line), in) != NULL) {
+        const unsigned long *current;
+        unsigned long limit;
+        char key[64];
+
+        if (line[0] == '#' || sscanf(line, "%63s %lu", key, &limit) != 2) {
+            fputs(line, out);
+            continue;
+        }
+
+        current = lookup(fp, key);
+        if (current == NULL) {
+            fprintf(stderr, "%s: unknown key '%s'\n", path, key);
+            rc = 1;
+            fputs(line, out);
+            continue;
+        }
+        fprintf(out, "%-20s %lu\n", key, *current);
+    }
+    fclose(in);
+
+    if (fclose(out) != 0) {
+        fprintf(stderr, "%s: %s\n", tmp, strerror(errno));
+        rc = 1;
+    }
+    if (rc == 0 && rename(tmp, path) != 0) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        rc = 1;
+    }
+    if (rc != 0) {
+        remove(tmp);
+    }
+
+    return rc;
+}
+
+int
+main(int argc, char **argv)
+{
+    const char *library = NULL;
+    const char *baseline = NULL;
+    bool write_baseline = false;
+    struct footprint fp;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--check") == 0 && i + 1 < argc) {
+            baseline = argv[++i];
+        } else if (strcmp(argv[i], "--update") == 0 && i + 1 < argc) {
+            baseline = argv[++i];
+            write_baseline = true;
+        } else if (argv[i][0] != '-') {
+            library = argv[i];
+        } else {
+            fprintf(stderr,
+                    "usage: %s [--check BASELINE | --update BASELINE] "
+                    "[LIBRARY]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+
+    measure(library, &fp);
+    print(&fp);
+
+    if (baseline != NULL) {
+        return write_baseline ? update(&fp, baseline) : check(&fp, baseline);
+    }
+
+    return 0;
+}
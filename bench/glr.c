@@ -0,0 +1,182 @@
+/*
+ * GLR stack statistics
+ *
+ * Parses spec files with a logger attached and reports how many parse stack
+ * versions the runtime kept alive: the peak number of versions, how often a
+ * version was forked and how many versions were processed per token. A
+ * grammar without ambiguity keeps a single version for the whole file.
+ *
+ *     rpmspec-glr-stats [--top N] [--max-peak N] [--max-forks N] PATH...
+ *
+ * The program fails if the peak number of versions over all files is above
+ * --max-peak or the forks of all files add up to more than --max-forks, so
+ * a grammar change can be held to the numbers measured before it.
+ *
+ * The counts are taken from the "process version:V, version_count:N" lines
+ * of the parse log, which the runtime emits for every version it advances.
+ */
+
+#include "common.h"
+
+#include <tree_sitter/api.h>
+#include <tree_sitter/tree-sitter-rpmspec.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct glr_stats {
+    const char *path;
+    uint64_t steps;
+    uint64_t forks;
+    uint32_t peak_versions;
+    uint32_t versions;
+};
+
+static void
+log_versions(void *payload, TSLogType type, const char *message)
+{
+    struct glr_stats *stats = payload;
+    const char *count;
+    unsigned long versions;
+
+    if (type != TSLogTypeParse || strncmp(message, "process version:", 16)) {
+        return;
+    }
+
+    count = strstr(message, "version_count:");
+    if (count == NULL) {
+        return;
+    }
+    versions = strtoul(count + 14, NULL, 10);
+
+    stats->steps++;
+    if (versions > stats->versions) {
+        stats->forks += versions - stats->versions;
+    }
+    if (versions > stats->peak_versions) {
+        stats->peak_versions = (uint32_t)versions;
+    }
+    stats->versions = (uint32_t)versions;
+}
+
+static int
+compare_peak(const void *a, const void *b)
+{
+    const struct glr_stats *sa = a;
+    const struct glr_stats *sb = b;
+
+    if (sa->peak_versions != sb->peak_versions) {
+        return sa->peak_versions < sb->peak_versions ? 1 : -1;
+    }
+
+    return (sa->forks < sb->forks) - (sa->forks > sb->forks);
+}
+
+int
+main(int argc, char **argv)
+{
+    struct bench_files files;
+    struct glr_stats *stats;
+    uint64_t steps = 0;
+    uint64_t forks = 0;
+    uint32_t peak = 0;
+    size_t forked = 0;
+    long max_forks = -1;
+    long max_peak = -1;
+    int failed = 0;
+    TSParser *parser;
+    long top = 10;
+    size_t i;
+    int argi;
+
+    for (argi = 1; argi + 1 < argc && argv[argi][0] == '-'; argi += 2) {
+        if (strcmp(argv[argi], "--top") == 0) {
+            top = strtol(argv[argi + 1], NULL, 10);
+        } else if (strcmp(argv[argi], "--max-peak") == 0) {
+            max_peak = strtol(argv[argi + 1], NULL, 10);
+        } else if (strcmp(argv[argi], "--max-forks") == 0) {
+            max_forks = strtol(argv[argi + 1], NULL, 10);
+        } else {
+            break;
+        }
+    }
+    if (argi == argc || argv[argi][0] == '-') {
+        fprintf(stderr,
+                "usage: %s [--top N] [--max-peak N] [--max-forks N] "
+                "PATH...\n",
+                argv[0]);
+        return 2;
+    }
+
+    if (bench_collect(&files, argc - argi, argv + argi) != 0 ||
+        bench_load(&files) != 0) {
+        return 1;
+    }
+
+    stats = calloc(files.count, sizeof(*stats));
+    parser = ts_parser_new();
+    if (stats == NULL || parser == NULL ||
+        !ts_parser_set_language(parser, tree_sitter_rpmspec())) {
+        fprintf(stderr, "cannot set up the parser\n");
+        return 1;
+    }
+
+    for (i = 0; i < files.count; i++) {
+        const struct bench_file *f = &files.files[i];
+        TSTree *tree;
+
+        stats[i].path = f->path;
+        ts_parser_set_logger(parser,
+                             (TSLogger){.payload = &stats[i],
+                                        .log = log_versions});
+        tree = ts_parser_parse_string(parser, NULL, f->data, f->size);
+        ts_tree_delete(tree);
+
+        steps += stats[i].steps;
+        forks += stats[i].forks;
+        if (stats[i].forks > 0) {
+            forked++;
+        }
+        if (stats[i].peak_versions > peak) {
+            peak = stats[i].peak_versions;
+        }
+    }
+    ts_parser_set_logger(parser, (TSLogger){0});
+
+    bench_report("files", "%zu", files.count);
+    bench_report("files_with_forks", "%zu", forked);
+    bench_report("forks", "%llu", (unsigned long long)forks);
+    bench_report("peak_versions", "%u", peak);
+    bench_report("version_steps", "%llu", (unsigned long long)steps);
+
+    qsort(stats, files.count, sizeof(*stats), compare_peak);
+    if (top > 0 && forked > 0) {
+        printf("\n%8s %10s  %s\n", "peak", "forks", "file");
+    }
+    for (i = 0; i < files.count && i < (size_t)top; i++) {
+        if (stats[i].forks == 0) {
+            break;
+        }
+        printf("%8u %10llu  %s\n",
+               stats[i].peak_versions,
+               (unsigned long long)stats[i].forks,
+               stats[i].path);
+    }
+
+    if (max_peak >= 0 && peak > (unsigned long)max_peak) {
+        fprintf(stderr, "peak_versions %u above %ld\n", peak, max_peak);
+        failed = 1;
+    }
+    if (max_forks >= 0 && forks > (unsigned long long)max_forks) {
+        fprintf(stderr, "forks %llu above %ld\n", (unsigned long long)forks,
+                max_forks);
+        failed = 1;
+    }
+
+    free(stats);
+    ts_parser_delete(parser);
+    bench_files_free(&files);
+
+    return failed;
+}
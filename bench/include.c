@@ -0,0 +1,283 @@
+/*
+ * %include fragment benchmark
+ *
+ * Generates --fragments macro files in a temporary directory and --specs
+ * specs that %include every one of them, the way a distribution shares its
+ * macro fragments, then goes through the specs twice: once parsing every
+ * fragment again for each spec that includes it, and once with the
+ * resolver of tree-sitter-rpmspec-include.h, which parses each fragment
+ * once and hands every spec a copy of the shared tree.
+ *
+ *     rpmspec-bench-include [--repeat N] [--specs N] [--fragments N]
+ *                           [--min-speedup X]
+ *
+ * Each pass is run N times and its fastest run counts. The program fails if
+ * the resolver parses a fragment twice, misses one, or is less than
+ * --min-speedup times faster than parsing the fragments again.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "common.h"
+
+#include <tree_sitter/api.h>
+#include <tree_sitter/tree-sitter-rpmspec-include.h>
+#include <tree_sitter/tree-sitter-rpmspec-input.h>
+#include <tree_sitter/tree-sitter-rpmspec.h>
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Definitions per fragment, about the size of a language macro file */
+#define FRAGMENT_MACROS 64
+
+static void
+usage(const char *progname)
+{
+    fprintf(stderr,
+            "usage: %s [--repeat N] [--specs N] [--fragments N] "
+            "[--min-speedup X]\n",
+            progname);
+}
+
+static bool
+write_fragment(const char *path, long index)
+{
+    FILE *fp = fopen(path, "w");
+    int i;
+
+    if (fp == NULL) {
+        return false;
+    }
+    fprintf(fp, "# Shared macros %ld\n", index);
+    for (i = 0; i < FRAGMENT_MACROS; i++) {
+        fprintf(fp, "%%global frag%ld_m%d %%{?dist}%%{_prefix}/lib/frag%d\n",
+                index, i, i);
+    }
+    fprintf(fp, "%%define frag%ld_build() %%{_bindir}/make %%{?_smp_mflags}\n",
+            index);
+
+    return fclose(fp) == 0;
+}
+
+/* A spec that includes every fragment, NULL if out of memory */
+static char *
+generate_spec(long index, long fragments, uint32_t *length)
+{
+    size_t capacity = 256 + (size_t)fragments * 32;
+    char *spec = malloc(capacity);
+    size_t size;
+    long i;
+
+    if (spec == NULL) {
+        return NULL;
+    }
+    size = (size_t)snprintf(spec, capacity,
+                            "Name: spec%ld\nVersion: 1\nRelease: 1%%{?dist}\n"
+                            "Summary: Including shared macros\n"
+                            "License: MIT\n\n",
+                            index);
+    for (i = 0; i < fragments; i++) {
+        size += (size_t)snprintf(spec + size, capacity - size,
+                                 "%%include frag%ld.macros\n", i);
+    }
+    size += (size_t)snprintf(spec + size, capacity - size,
+                             "\n%%description\nIncludes shared macros.\n");
+    *length = (uint32_t)size;
+
+    return spec;
+}
+
+int
+main(int argc, char **argv)
+{
+    const TSLanguage *language = tree_sitter_rpmspec();
+    char temporary[] = "/tmp/rpmspec-bench-include-XXXXXX";
+    TSRpmspecIncludeStats stats = {0};
+    uint64_t naive_ns = UINT64_MAX;
+    uint64_t resolved_ns = UINT64_MAX;
+    uint64_t naive_parses = 0;
+    double min_speedup = 0.0;
+    uint64_t fragment_bytes = 0;
+    long fragments = 16;
+    long specs = 64;
+    long repeat = 3;
+    size_t failed = 0;
+    const char *directory;
+    TSParser *parser;
+    uint32_t *lengths;
+    char **sources;
+    char path[512];
+    long r;
+    long i;
+    int argi;
+
+    for (argi = 1; argi < argc && argv[argi][0] == '-'; argi++) {
+        if (strcmp(argv[argi], "--repeat") == 0 && argi + 1 < argc) {
+            repeat = strtol(argv[++argi], NULL, 10);
+        } else if (strcmp(argv[argi], "--specs") == 0 && argi + 1 < argc) {
+            specs = strtol(argv[++argi], NULL, 10);
+        } else if (strcmp(argv[argi], "--fragments") == 0 &&
+                   argi + 1 < argc) {
+            fragments = strtol(argv[++argi], NULL, 10);
+        } else if (strcmp(argv[argi], "--min-speedup") == 0 &&
+                   argi + 1 < argc) {
+            min_speedup = strtod(argv[++argi], NULL);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (argi != argc || repeat < 1 || specs < 1 || fragments < 1 ||
+        fragments > 100000) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    directory = mkdtemp(temporary);
+    if (directory == NULL) {
+        perror("mkdtemp");
+        return 1;
+    }
+    for (i = 0; i < fragments; i++) {
+        snprintf(path, sizeof(path), "%s/frag%ld.macros", directory, i);
+        if (!write_fragment(path, i)) {
+            perror(path);
+            return 1;
+        }
+    }
+
+    sources = calloc((size_t)specs, sizeof(*sources));
+    lengths = calloc((size_t)specs, sizeof(*lengths));
+    parser = ts_parser_new();
+    if (sources == NULL || lengths == NULL || parser == NULL ||
+        !ts_parser_set_language(parser, language)) {
+        fprintf(stderr, "cannot set up the parser\n");
+        return 1;
+    }
+    for (i = 0; i < specs; i++) {
+        sources[i] = generate_spec(i, fragments, &lengths[i]);
+        if (sources[i] == NULL) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+    }
+
+    /* Every spec parses every fragment it includes again */
+    for (r = 0; r < repeat; r++) {
+        uint64_t start = bench_now_ns();
+        uint64_t elapsed;
+        uint64_t parses = 0;
+        uint64_t bytes = 0;
+
+        for (i = 0; i < specs; i++) {
+            TSTree *tree = ts_parser_parse_string(parser, NULL, sources[i],
+                                                  lengths[i]);
+            long f;
+
+            ts_tree_delete(tree);
+            for (f = 0; f < fragments; f++) {
+                TSRpmspecParseStats parse_stats;
+
+                snprintf(path, sizeof(path), "%s/frag%ld.macros", directory,
+                         f);
+                tree = tree_sitter_rpmspec_parse_file(parser, NULL, path,
+                                                      &parse_stats);
+                if (tree == NULL) {
+                    perror(path);
+                    return 1;
+                }
+                ts_tree_delete(tree);
+                parses++;
+                bytes += parse_stats.bytes;
+            }
+        }
+        elapsed = bench_now_ns() - start;
+        if (elapsed < naive_ns) {
+            naive_ns = elapsed;
+        }
+        naive_parses = parses;
+        fragment_bytes = bytes;
+    }
+
+    /* Each fragment is parsed once per run, the specs share its tree */
+    for (r = 0; r < repeat; r++) {
+        TSRpmspecIncludeResolver *resolver;
+        uint64_t start = bench_now_ns();
+        uint64_t elapsed;
+
+        resolver = tree_sitter_rpmspec_include_resolver_new(language);
+        if (resolver == NULL) {
+            fprintf(stderr, "failed to create the include resolver\n");
+            return 1;
+        }
+        for (i = 0; i < specs; i++) {
+            TSTree *tree = ts_parser_parse_string(parser, NULL, sources[i],
+                                                  lengths[i]);
+            TSRpmspecFragment *included;
+            uint32_t count;
+
+            if (!tree_sitter_rpmspec_include_resolve(resolver, tree,
+                                                     sources[i], directory,
+                                                     NULL, &included,
+                                                     &count)) {
+                perror("resolve");
+                return 1;
+            }
+            if (count != (uint32_t)fragments) {
+                fprintf(stderr, "spec%ld: %u fragments, expected %ld\n", i,
+                        count, fragments);
+                failed++;
+            }
+            tree_sitter_rpmspec_include_fragments_free(included, count);
+            ts_tree_delete(tree);
+        }
+        tree_sitter_rpmspec_include_stats(resolver, &stats);
+        tree_sitter_rpmspec_include_resolver_delete(resolver);
+        elapsed = bench_now_ns() - start;
+        if (elapsed < resolved_ns) {
+            resolved_ns = elapsed;
+        }
+    }
+
+    bench_report("specs", "%ld", specs);
+    bench_report("fragments", "%ld", fragments);
+    bench_report("fragment_bytes", "%llu",
+                 (unsigned long long)fragment_bytes);
+    bench_report("naive_parses", "%llu", (unsigned long long)naive_parses);
+    bench_report("resolved_parses", "%u", stats.parsed);
+    bench_report("cache_hits", "%llu", (unsigned long long)stats.hits);
+    bench_report("naive_ms", "%.2f", (double)naive_ns / 1e6);
+    bench_report("resolved_ms", "%.2f", (double)resolved_ns / 1e6);
+    bench_report("speedup", "%.2f",
+                 resolved_ns > 0 ? (double)naive_ns / (double)resolved_ns
+                                 : 0.0);
+
+    if (stats.parsed != (uint32_t)fragments || stats.missing > 0) {
+        fprintf(stderr, "%u fragments parsed, %llu missing, expected %ld\n",
+                stats.parsed, (unsigned long long)stats.missing, fragments);
+        failed++;
+    }
+    if (min_speedup > 0 &&
+        (double)naive_ns < min_speedup * (double)resolved_ns) {
+        fprintf(stderr, "speedup below %.2f\n", min_speedup);
+        failed++;
+    }
+
+    for (i = 0; i < fragments; i++) {
+        snprintf(path, sizeof(path), "%s/frag%ld.macros", directory, i);
+        unlink(path);
+    }
+    rmdir(directory);
+    for (i = 0; i < specs; i++) {
+        free(sources[i]);
+    }
+    free(sources);
+    free(lengths);
+    ts_parser_delete(parser);
+
+    return failed > 0 ? 1 : 0;
+}
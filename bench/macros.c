@@ -0,0 +1,270 @@
+/*
+ * Macro preview benchmark
+ *
+ * Parses every spec file given on the command line once, then loads each
+ * tree into a macro table from tree-sitter-rpmspec-macros.h and expands
+ * %{name}-%{version}-%{release}. Reports the time per file for loading and
+ * expanding, how many macro values came from the memo and how many %if
+ * conditions could not be evaluated.
+ *
+ *     rpmspec-bench-macros [--repeat N] [--define NAME BODY]...
+ *                          [--rpmspec PROGRAM] PATH...
+ *
+ * Then a %global line is inserted before the last child of the root and
+ * the table is brought up to date with tree_sitter_rpmspec_macros_update(),
+ * which is compared with loading the edited tree from scratch.
+ *
+ * With --rpmspec every file is also run through `PROGRAM -P FILE`, the
+ * out-of-process way of getting the same answer, for comparison.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "common.h"
+
+#include <tree_sitter/api.h>
+#include <tree_sitter/tree-sitter-rpmspec-macros.h>
+#include <tree_sitter/tree-sitter-rpmspec.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char nvr[] = "%{name}-%{version}-%{release}";
+static const char inserted[] = "%global rpmspec_bench_edit 1\n";
+
+struct edited {
+    char *source;
+    uint32_t length;
+    TSTree *old_tree; /* A copy of the original tree, edited */
+    TSTree *new_tree;
+};
+
+/* Insert a line before the last child of the root and reparse */
+static void
+edit(TSParser *parser,
+     TSTree *tree,
+     const struct bench_file *file,
+     struct edited *edited)
+{
+    TSNode root = ts_tree_root_node(tree);
+    uint32_t count = ts_node_child_count(root);
+    uint32_t length = sizeof(inserted) - 1;
+    TSInputEdit input_edit = {0};
+    uint32_t at = 0;
+
+    if (count > 0) {
+        TSNode last = ts_node_child(root, count - 1);
+
+        at = ts_node_start_byte(last);
+        input_edit.start_point = ts_node_start_point(last);
+    }
+    edited->length = (uint32_t)file->size + length;
+    edited->source = malloc(edited->length + 1);
+    if (edited->source == NULL) {
+        exit(1);
+    }
+    memcpy(edited->source, file->data, at);
+    memcpy(edited->source + at, inserted, length);
+    memcpy(edited->source + at + length, file->data + at, file->size - at);
+    edited->source[edited->length] = '\0';
+
+    input_edit.start_byte = at;
+    input_edit.old_end_byte = at;
+    input_edit.new_end_byte = at + length;
+    input_edit.old_end_point = input_edit.start_point;
+    input_edit.new_end_point.row = input_edit.start_point.row + 1;
+    input_edit.new_end_point.column = 0;
+
+    edited->old_tree = ts_tree_copy(tree);
+    ts_tree_edit(edited->old_tree, &input_edit);
+    edited->new_tree = ts_parser_parse_string(
+        parser, edited->old_tree, edited->source, edited->length);
+}
+
+static void
+usage(const char *progname)
+{
+    fprintf(stderr,
+            "usage: %s [--repeat N] [--define NAME BODY]... "
+            "[--rpmspec PROGRAM] PATH...\n",
+            progname);
+}
+
+static uint64_t
+run_rpmspec(const char *program, const struct bench_files *files)
+{
+    uint64_t start = bench_now_ns();
+    size_t i;
+
+    for (i = 0; i < files->count; i++) {
+        char command[4096];
+
+        snprintf(command, sizeof(command), "'%s' -P '%s' >/dev/null 2>&1",
+                 program, files->files[i].path);
+        if (system(command) != 0) {
+            fprintf(stderr, "%s: rpmspec failed\n", files->files[i].path);
+        }
+    }
+
+    return bench_now_ns() - start;
+}
+
+int
+main(int argc, char **argv)
+{
+    const char *rpmspec = NULL;
+    TSRpmspecMacrosStats stats;
+    TSRpmspecMacros *macros;
+    struct bench_files files;
+    uint64_t unresolved = 0;
+    uint64_t conditions = 0;
+    uint64_t expansions = 0;
+    uint64_t memo_hits = 0;
+    uint64_t update_ns = 0;
+    uint64_t replayed = 0;
+    uint64_t walked = 0;
+    uint64_t load_ns = 0;
+    struct edited *edits;
+    uint64_t *samples;
+    TSParser *parser;
+    TSTree **trees;
+    long repeat = 1;
+    size_t sample = 0;
+    long r;
+    size_t i;
+    int argi;
+
+    macros = tree_sitter_rpmspec_macros_new();
+    if (macros == NULL) {
+        return 1;
+    }
+
+    for (argi = 1; argi < argc && argv[argi][0] == '-'; argi++) {
+        if (strcmp(argv[argi], "--repeat") == 0 && argi + 1 < argc) {
+            repeat = strtol(argv[++argi], NULL, 10);
+        } else if (strcmp(argv[argi], "--define") == 0 && argi + 2 < argc) {
+            tree_sitter_rpmspec_macros_define(macros, argv[argi + 1],
+                                              argv[argi + 2]);
+            argi += 2;
+        } else if (strcmp(argv[argi], "--rpmspec") == 0 && argi + 1 < argc) {
+            rpmspec = argv[++argi];
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (argi == argc || repeat < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (bench_collect(&files, argc - argi, argv + argi) != 0 ||
+        bench_load(&files) != 0) {
+        return 1;
+    }
+    if (files.count == 0 || files.total_bytes == 0) {
+        fprintf(stderr, "no spec files found, see bench/README.md\n");
+        return 1;
+    }
+
+    parser = ts_parser_new();
+    ts_parser_set_language(parser, tree_sitter_rpmspec());
+    trees = calloc(files.count, sizeof(*trees));
+    edits = calloc(files.count, sizeof(*edits));
+    samples = calloc(files.count * (size_t)repeat, sizeof(*samples));
+    if (trees == NULL || edits == NULL || samples == NULL) {
+        return 1;
+    }
+    for (i = 0; i < files.count; i++) {
+        trees[i] = ts_parser_parse_string(parser, NULL, files.files[i].data,
+                                          files.files[i].size);
+        edit(parser, trees[i], &files.files[i], &edits[i]);
+    }
+
+    for (r = 0; r < repeat; r++) {
+        for (i = 0; i < files.count; i++) {
+            uint64_t start = bench_now_ns();
+            char *value;
+
+            if (!tree_sitter_rpmspec_macros_load(macros, trees[i],
+                                                 files.files[i].data)) {
+                fprintf(stderr, "%s: failed to load the macros\n",
+                        files.files[i].path);
+                return 1;
+            }
+            value = tree_sitter_rpmspec_macros_expand(macros, nvr,
+                                                      sizeof(nvr) - 1, NULL);
+            samples[sample] = bench_now_ns() - start;
+            load_ns += samples[sample++];
+            free(value);
+
+            if (r == 0) {
+                tree_sitter_rpmspec_macros_stats(macros, &stats);
+                conditions += stats.conditions;
+                unresolved += stats.unresolved_conditions;
+                expansions += stats.expansions;
+                memo_hits += stats.memo_hits;
+            }
+
+            start = bench_now_ns();
+            if (!tree_sitter_rpmspec_macros_update(macros, edits[i].old_tree,
+                                                   edits[i].new_tree,
+                                                   edits[i].source)) {
+                fprintf(stderr, "%s: failed to update the macros\n",
+                        files.files[i].path);
+                return 1;
+            }
+            update_ns += bench_now_ns() - start;
+
+            if (r == 0) {
+                tree_sitter_rpmspec_macros_stats(macros, &stats);
+                walked += stats.walked;
+                replayed += stats.replayed;
+            }
+        }
+    }
+
+    bench_report("files", "%zu", files.count);
+    bench_report("bytes", "%llu", (unsigned long long)files.total_bytes);
+    bench_report("load_us_per_file", "%.2f",
+                 (double)load_ns / 1e3 / (double)sample);
+    bench_report("p99_load_us", "%.2f",
+                 (double)bench_percentile(samples, sample, 99) / 1e3);
+    bench_report("expansions", "%llu", (unsigned long long)expansions);
+    bench_report("memo_hits", "%llu", (unsigned long long)memo_hits);
+    bench_report("conditions", "%llu", (unsigned long long)conditions);
+    bench_report("unresolved_conditions", "%llu",
+                 (unsigned long long)unresolved);
+    bench_report("update_us_per_file", "%.2f",
+                 (double)update_ns / 1e3 / (double)sample);
+    bench_report("load_update_ratio", "%.1f",
+                 (double)load_ns / (double)update_ns);
+    bench_report("replayed_children", "%llu", (unsigned long long)replayed);
+    bench_report("walked_children", "%llu", (unsigned long long)walked);
+
+    if (rpmspec != NULL) {
+        uint64_t rpmspec_ns = run_rpmspec(rpmspec, &files);
+
+        bench_report("rpmspec_us_per_file", "%.2f",
+                     (double)rpmspec_ns / 1e3 / (double)files.count);
+        bench_report("rpmspec_load_ratio", "%.1f",
+                     (double)rpmspec_ns / (double)files.count /
+                         ((double)load_ns / (double)sample));
+    }
+
+    for (i = 0; i < files.count; i++) {
+        ts_tree_delete(trees[i]);
+        ts_tree_delete(edits[i].old_tree);
+        ts_tree_delete(edits[i].new_tree);
+        free(edits[i].source);
+    }
+    free(trees);
+    free(edits);
+    free(samples);
+    tree_sitter_rpmspec_macros_delete(macros);
+    ts_parser_delete(parser);
+    bench_files_free(&files);
+
+    return 0;
+}
@@ -0,0 +1,323 @@
+/*
+ * Macro nesting stress benchmark
+ *
+ * Generates specs that nest macros deeper and deeper, the way templated
+ * specs do, and reports the parse time, the node count and the memory the
+ * runtime allocates for each depth, from 16 up to --max-depth, doubling
+ * each time:
+ *
+ *     conditional  Release: %{?n1:%{?n2:...1...}}
+ *     call         %global v %{?n1:%f1 x %{?n2:%f2 x ...x...}}
+ *     arguments    %global v %dirname %{?n1:a} %{?n2:a} ... on one line
+ *     if           %if 0%{?n1} ... %endif, nested
+ *
+ *     rpmspec-bench-nesting [--repeat N] [--max-depth N] [--max-growth X]
+ *                           [--max-time-growth X]
+ *
+ * The memory is the peak of an arena from tree-sitter-rpmspec-arena.h that
+ * the parse runs in. The growth of a shape is the cost per byte at the
+ * deepest level divided by the cost per byte at half of it: about 1 when
+ * the parse is linear in the depth, 2 when it is quadratic. The program
+ * fails if a generated spec has errors, if the node or memory growth
+ * exceeds --max-growth, or the time growth --max-time-growth. Node counts
+ * and memory do not depend on the load of the machine, so only those are
+ * checked by default.
+ */
+
+#include "common.h"
+
+#include <tree_sitter/api.h>
+#include <tree_sitter/tree-sitter-rpmspec-arena.h>
+#include <tree_sitter/tree-sitter-rpmspec.h>
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MIN_DEPTH 16
+
+struct text {
+    char *data;
+    size_t size;
+    size_t capacity;
+};
+
+enum shape {
+    SHAPE_CONDITIONAL,
+    SHAPE_CALL,
+    SHAPE_ARGUMENTS,
+    SHAPE_IF,
+    SHAPE_COUNT,
+};
+
+static const char *const shape_names[SHAPE_COUNT] = {
+    "conditional",
+    "call",
+    "arguments",
+    "if",
+};
+
+struct sample {
+    size_t bytes;
+    uint64_t ns;
+    uint32_t nodes;
+    size_t peak;
+};
+
+static void
+usage(const char *progname)
+{
+    fprintf(stderr,
+            "usage: %s [--repeat N] [--max-depth N] [--max-growth X] "
+            "[--max-time-growth X]\n",
+            progname);
+}
+
+static bool
+append(struct text *text, const char *format, ...)
+{
+    va_list args;
+    size_t capacity;
+    char *tmp;
+    int length;
+
+    for (;;) {
+        size_t room = text->capacity - text->size;
+
+        va_start(args, format);
+        length = vsnprintf(room > 0 ? text->data + text->size : NULL, room,
+                           format, args);
+        va_end(args);
+        if (length < 0) {
+            return false;
+        }
+        if ((size_t)length < room) {
+            text->size += (size_t)length;
+            return true;
+        }
+
+        capacity = text->capacity ? text->capacity * 2 : 4096;
+        while (capacity - text->size <= (size_t)length) {
+            capacity *= 2;
+        }
+        tmp = realloc(text->data, capacity);
+        if (tmp == NULL) {
+            return false;
+        }
+        text->data = tmp;
+        text->capacity = capacity;
+    }
+}
+
+static bool
+generate(struct text *text, enum shape shape, unsigned depth)
+{
+    bool ok = true;
+    unsigned i;
+
+    text->size = 0;
+    ok = ok && append(text, "Name: nesting\n");
+
+    switch (shape) {
+    case SHAPE_CONDITIONAL:
+        ok = ok && append(text, "Release: ");
+        for (i = 1; i <= depth; i++) {
+            ok = ok && append(text, "%%{?n%u:", i);
+        }
+        ok = ok && append(text, "1");
+        for (i = 0; i < depth; i++) {
+            ok = ok && append(text, "}");
+        }
+        ok = ok && append(text, "\n");
+        break;
+    case SHAPE_CALL:
+        ok = ok && append(text, "%%global v");
+        for (i = 1; i <= depth; i++) {
+            ok = ok && append(text, " %%{?n%u:%%f%u x", i, i);
+        }
+        ok = ok && append(text, " x");
+        for (i = 0; i < depth; i++) {
+            ok = ok && append(text, "}");
+        }
+        ok = ok && append(text, "\n");
+        break;
+    case SHAPE_ARGUMENTS:
+        ok = ok && append(text, "%%global v %%dirname");
+        for (i = 1; i <= depth; i++) {
+            ok = ok && append(text, " %%{?n%u:a}", i);
+        }
+        ok = ok && append(text, "\n");
+        break;
+    case SHAPE_IF:
+        for (i = 1; i <= depth; i++) {
+            ok = ok && append(text, "%%if 0%%{?n%u}\n", i);
+        }
+        ok = ok && append(text, "BuildRequires: x\n");
+        for (i = 0; i < depth; i++) {
+            ok = ok && append(text, "%%endif\n");
+        }
+        break;
+    case SHAPE_COUNT:
+        break;
+    }
+
+    return ok;
+}
+
+/* Fastest of `repeat` parses, each in a fresh arena; false on errors */
+static bool
+measure(const struct text *text, long repeat, struct sample *sample)
+{
+    bool clean = true;
+    long r;
+
+    sample->bytes = text->size;
+    sample->ns = UINT64_MAX;
+    sample->nodes = 0;
+    sample->peak = 0;
+
+    for (r = 0; r < repeat; r++) {
+        TSRpmspecArena *arena = tree_sitter_rpmspec_arena_new(0);
+        TSRpmspecArenaStats stats;
+        uint64_t start;
+        uint64_t elapsed;
+        TSTree *tree;
+
+        if (arena == NULL) {
+            return false;
+        }
+        start = bench_now_ns();
+        tree = tree_sitter_rpmspec_arena_parse(arena, tree_sitter_rpmspec(),
+                                               text->data,
+                                               (uint32_t)text->size);
+        elapsed = bench_now_ns() - start;
+        if (tree == NULL || ts_node_has_error(ts_tree_root_node(tree))) {
+            clean = false;
+        } else {
+            sample->nodes = ts_node_descendant_count(ts_tree_root_node(tree));
+        }
+        tree_sitter_rpmspec_arena_stats(arena, &stats);
+        tree_sitter_rpmspec_arena_delete(arena);
+
+        if (elapsed < sample->ns) {
+            sample->ns = elapsed;
+        }
+        if (stats.peak > sample->peak) {
+            sample->peak = stats.peak;
+        }
+    }
+
+    return clean;
+}
+
+static double
+growth(double deep, size_t deep_bytes, double half, size_t half_bytes)
+{
+    if (half <= 0.0 || deep_bytes == 0) {
+        return 0.0;
+    }
+
+    return (deep / (double)deep_bytes) / (half / (double)half_bytes);
+}
+
+int
+main(int argc, char **argv)
+{
+    struct text text = {0};
+    double max_time_growth = 0.0;
+    double max_growth = 0.0;
+    long max_depth = 1024;
+    long repeat = 5;
+    size_t failed = 0;
+    int shape;
+    int argi;
+
+    for (argi = 1; argi < argc && argv[argi][0] == '-'; argi++) {
+        if (strcmp(argv[argi], "--repeat") == 0 && argi + 1 < argc) {
+            repeat = strtol(argv[++argi], NULL, 10);
+        } else if (strcmp(argv[argi], "--max-depth") == 0 &&
+                   argi + 1 < argc) {
+            max_depth = strtol(argv[++argi], NULL, 10);
+        } else if (strcmp(argv[argi], "--max-growth") == 0 &&
+                   argi + 1 < argc) {
+            max_growth = strtod(argv[++argi], NULL);
+        } else if (strcmp(argv[argi], "--max-time-growth") == 0 &&
+                   argi + 1 < argc) {
+            max_time_growth = strtod(argv[++argi], NULL);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (argi != argc || repeat < 1 || max_depth < 2 * MIN_DEPTH) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    /* Must happen before the first parser exists */
+    tree_sitter_rpmspec_arena_install();
+
+    printf("%-12s %6s %10s %10s %10s %10s %12s\n", "shape", "depth", "bytes",
+           "us", "ns_per_b", "nodes", "peak_bytes");
+
+    for (shape = 0; shape < SHAPE_COUNT; shape++) {
+        struct sample half = {0};
+        struct sample deep = {0};
+        double time_growth;
+        double node_growth;
+        double memory_growth;
+        char key[64];
+        long depth;
+
+        for (depth = MIN_DEPTH; depth <= max_depth; depth *= 2) {
+            if (!generate(&text, (enum shape)shape, (unsigned)depth)) {
+                fprintf(stderr, "out of memory\n");
+                return 1;
+            }
+            half = deep;
+            if (!measure(&text, repeat, &deep)) {
+                fprintf(stderr, "%s: depth %ld does not parse cleanly\n",
+                        shape_names[shape], depth);
+                failed++;
+            }
+            printf("%-12s %6ld %10zu %10.1f %10.1f %10u %12zu\n",
+                   shape_names[shape], depth, deep.bytes,
+                   (double)deep.ns / 1e3,
+                   (double)deep.ns / (double)deep.bytes, deep.nodes,
+                   deep.peak);
+        }
+
+        time_growth = growth((double)deep.ns, deep.bytes, (double)half.ns,
+                             half.bytes);
+        node_growth = growth((double)deep.nodes, deep.bytes,
+                             (double)half.nodes, half.bytes);
+        memory_growth = growth((double)deep.peak, deep.bytes,
+                               (double)half.peak, half.bytes);
+
+        snprintf(key, sizeof(key), "%s_time_growth", shape_names[shape]);
+        bench_report(key, "%.2f", time_growth);
+        snprintf(key, sizeof(key), "%s_node_growth", shape_names[shape]);
+        bench_report(key, "%.2f", node_growth);
+        snprintf(key, sizeof(key), "%s_memory_growth", shape_names[shape]);
+        bench_report(key, "%.2f", memory_growth);
+
+        if (max_growth > 0 &&
+            (node_growth > max_growth || memory_growth > max_growth)) {
+            fprintf(stderr, "%s: growth above %.2f\n", shape_names[shape],
+                    max_growth);
+            failed++;
+        }
+        if (max_time_growth > 0 && time_growth > max_time_growth) {
+            fprintf(stderr, "%s: time growth above %.2f\n",
+                    shape_names[shape], max_time_growth);
+            failed++;
+        }
+    }
+
+    tree_sitter_rpmspec_arena_uninstall();
+    free(text.data);
+
+    return failed > 0 ? 1 : 0;
+}
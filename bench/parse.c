@@ -0,0 +1,210 @@
+/*
+ * Parse throughput benchmark
+ *
+ * Parses every spec file given on the command line (directories are searched
+ * for *.spec files) and reports throughput in bytes and nodes per second,
+ * per-file latency percentiles and the peak resident set size.
+ *
+ *     rpmspec-bench [--repeat N] [--lazy-changelog] [--mmap] [--preamble]
+ *                   PATH...
+ *
+ * By default all files are read into memory before the timed parses; io_ms
+ * is the time that took. With --mmap every parse maps its file through
+ * tree_sitter_rpmspec_parse_file() instead and io_ms is the time spent
+ * outside the parser.
+ *
+ * --preamble cuts every file before its first %description, which leaves
+ * the tags and conditionals of the main package.
+ *
+ * first_parse_us is the first parse of the process, which also faults in
+ * the parse tables.
+ */
+
+#include "common.h"
+
+#include <tree_sitter/api.h>
+#include <tree_sitter/tree-sitter-rpmspec-input.h>
+#include <tree_sitter/tree-sitter-rpmspec.h>
+
+#include <stdbool.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void
+usage(const char *progname)
+{
+    fprintf(stderr,
+            "usage: %s [--repeat N] [--lazy-changelog] [--mmap] [--preamble] "
+            "PATH...\n",
+            progname);
+}
+
+static void
+cut_preambles(struct bench_files *files)
+{
+    size_t i;
+
+    files->total_bytes = 0;
+    for (i = 0; i < files->count; i++) {
+        struct bench_file *f = &files->files[i];
+        char *end = strstr(f->data, "\n%description");
+
+        if (end != NULL) {
+            f->size = (uint32_t)(end - f->data) + 1;
+            f->data[f->size] = '\0';
+        }
+        files->total_bytes += f->size;
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    const TSLanguage *language = tree_sitter_rpmspec();
+    struct bench_files files;
+    uint64_t *samples;
+    uint64_t nodes = 0;
+    uint64_t elapsed = 0;
+    uint64_t io = 0;
+    bool use_mmap = false;
+    bool preamble = false;
+    size_t nsamples = 0;
+    size_t errors = 0;
+    TSParser *parser;
+    long repeat = 1;
+    long r;
+    size_t i;
+    int argi;
+
+    for (argi = 1; argi < argc && argv[argi][0] == '-'; argi++) {
+        if (strcmp(argv[argi], "--repeat") == 0 && argi + 1 < argc) {
+            repeat = strtol(argv[++argi], NULL, 10);
+            if (repeat < 1) {
+                usage(argv[0]);
+                return 2;
+            }
+        } else if (strcmp(argv[argi], "--lazy-changelog") == 0) {
+            language = tree_sitter_rpmspec_lazy_changelog();
+        } else if (strcmp(argv[argi], "--mmap") == 0) {
+            use_mmap = true;
+        } else if (strcmp(argv[argi], "--preamble") == 0) {
+            preamble = true;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (argi == argc || (use_mmap && preamble)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (bench_collect(&files, argc - argi, argv + argi) != 0) {
+        return 1;
+    }
+    if (!use_mmap) {
+        uint64_t start = bench_now_ns();
+
+        if (bench_load(&files) != 0) {
+            return 1;
+        }
+        io = bench_now_ns() - start;
+    }
+    if (preamble) {
+        cut_preambles(&files);
+    }
+    if (files.count == 0) {
+        fprintf(stderr, "no spec files found, see bench/README.md\n");
+        return 1;
+    }
+
+    samples = calloc(files.count * (size_t)repeat, sizeof(*samples));
+    parser = ts_parser_new();
+    if (samples == NULL || parser == NULL ||
+        !ts_parser_set_language(parser, language)) {
+        fprintf(stderr, "cannot set up the parser\n");
+        return 1;
+    }
+
+    for (r = 0; r < repeat; r++) {
+        for (i = 0; i < files.count; i++) {
+            const struct bench_file *f = &files.files[i];
+            uint64_t start;
+            uint64_t duration;
+            TSTree *tree;
+            TSNode root;
+
+            if (use_mmap) {
+                TSRpmspecParseStats stats;
+
+                start = bench_now_ns();
+                tree = tree_sitter_rpmspec_parse_file(parser, NULL, f->path,
+                                                      &stats);
+                if (tree != NULL) {
+                    io += bench_now_ns() - start - stats.parse_time_ns;
+                    if (r == 0) {
+                        files.total_bytes += stats.bytes;
+                    }
+                }
+                duration = stats.parse_time_ns;
+            } else {
+                start = bench_now_ns();
+                tree = ts_parser_parse_string(parser, NULL, f->data, f->size);
+                duration = bench_now_ns() - start;
+            }
+
+            if (tree == NULL) {
+                fprintf(stderr, "%s: parse failed\n", f->path);
+                return 1;
+            }
+
+            root = ts_tree_root_node(tree);
+            if (r == 0) {
+                nodes += ts_node_descendant_count(root);
+                if (ts_node_has_error(root)) {
+                    errors++;
+                }
+            }
+            ts_tree_delete(tree);
+
+            samples[nsamples++] = duration;
+            elapsed += duration;
+        }
+    }
+
+    bench_report("files", "%zu", files.count);
+    bench_report("bytes", "%llu", (unsigned long long)files.total_bytes);
+    bench_report("nodes", "%llu", (unsigned long long)nodes);
+    bench_report("files_with_errors", "%zu", errors);
+    bench_report("repeat", "%ld", repeat);
+    bench_report("time_ms", "%.1f", (double)elapsed / 1e6);
+    bench_report("first_parse_us", "%.1f", (double)samples[0] / 1e3);
+    bench_report("io_ms", "%.1f", (double)io / 1e6);
+    bench_report("bytes_per_sec",
+                 "%.0f",
+                 (double)files.total_bytes * (double)repeat /
+                     ((double)elapsed / 1e9));
+    bench_report("nodes_per_sec",
+                 "%.0f",
+                 (double)nodes * (double)repeat / ((double)elapsed / 1e9));
+    bench_report("p50_us",
+                 "%.1f",
+                 (double)bench_percentile(samples, nsamples, 50) / 1e3);
+    bench_report("p99_us",
+                 "%.1f",
+                 (double)bench_percentile(samples, nsamples, 99) / 1e3);
+    bench_report("max_us",
+                 "%.1f",
+                 (double)bench_percentile(samples, nsamples, 100) / 1e3);
+    bench_report("peak_rss_bytes",
+                 "%llu",
+                 (unsigned long long)bench_peak_rss());
+
+    ts_parser_delete(parser);
+    free(samples);
+    bench_files_free(&files);
+
+    return 0;
+}
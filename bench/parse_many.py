@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+"""
+parse_many() benchmark
+
+Parses a set of spec files with tree_sitter_rpmspec.parse_many(), once
+with a single worker and once with --workers threads, and reports how much
+faster the thread pool is. tree_sitter.Parser.parse() releases the GIL
+while it parses, so the speedup should approach the number of workers on
+an idle machine; a speedup of about 1 means the parses are serialized on
+the GIL.
+
+    python3 bench/parse_many.py [--repeat N] [--workers N]
+                                [--min-speedup X] PATH...
+
+The program fails if the speedup is below --min-speedup.
+"""
+
+import argparse
+import os
+import sys
+import time
+
+import tree_sitter_rpmspec
+
+
+# Same format as bench_report() in common.c
+def report(key, value):
+    print(f"{key:<20} {value}")
+
+
+def collect(paths):
+    files = []
+    for path in paths:
+        if os.path.isdir(path):
+            for parent, _, names in os.walk(path):
+                files.extend(
+                    os.path.join(parent, name)
+                    for name in names
+                    if name.endswith(".spec")
+                )
+        else:
+            files.append(path)
+    return sorted(files)
+
+
+# The fastest of several runs, as with the parse benchmarks
+def best_ms(files, workers, repeat):
+    best = float("inf")
+    for _ in range(repeat):
+        start = time.perf_counter()
+        tree_sitter_rpmspec.parse_many(files, workers=workers, summary=True)
+        best = min(best, (time.perf_counter() - start) * 1e3)
+    return best
+
+
+def main():
+    parser = argparse.ArgumentParser(description="parse_many() benchmark")
+    parser.add_argument("--repeat", type=int, default=3)
+    parser.add_argument("--workers", type=int, default=os.cpu_count())
+    parser.add_argument("--min-speedup", type=float, default=0)
+    parser.add_argument("paths", nargs="+")
+    args = parser.parse_args()
+
+    files = collect(args.paths)
+    if not files:
+        print("no spec files found", file=sys.stderr)
+        return 1
+
+    # Warm the page cache
+    tree_sitter_rpmspec.parse_many(files, workers=args.workers, summary=True)
+
+    serial_ms = best_ms(files, 1, args.repeat)
+    parallel_ms = best_ms(files, args.workers, args.repeat)
+    speedup = serial_ms / parallel_ms
+
+    report("files", len(files))
+    report("workers", args.workers)
+    report("serial_ms", f"{serial_ms:.2f}")
+    report("parallel_ms", f"{parallel_ms:.2f}")
+    report("speedup", f"{speedup:.2f}")
+
+    if speedup < args.min_speedup:
+        print(
+            f"speedup {speedup:.2f} with {args.workers} workers, "
+            f"floor {args.min_speedup}",
+            file=sys.stderr,
+        )
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,675 @@
+/*
+ * Parse profile by rule and parse state
+ *
+ * Parses spec files twice, once plain and once with a logger attached, and
+ * reports where the parse goes:
+ *
+ * - the split of the parse time between the lexer and the parser, taken from
+ *   the time between consecutive log messages;
+ * - per rule, hidden ones like _macro_body included, the number of
+ *   reductions and the time that follows them until the next message;
+ * - the parse states with the most shift and reduce actions;
+ * - per symbol, the number of nodes in the trees, and the number of ERROR
+ *   and MISSING nodes.
+ *
+ *     rpmspec-profile [--top N] [--folded FILE] PATH...
+ *
+ * The runtime formats every log message before handing it over, so logged
+ * parses are several times slower. The cost of one message is estimated
+ * from the difference with the plain parses and subtracted again from every
+ * interval, so the times add up to the plain parse time.
+ *
+ * --folded writes the actions as "phase;symbol;state N count" lines, the
+ * folded stack format of flamegraph.pl, inferno and speedscope.
+ */
+
+#include "common.h"
+
+#include <tree_sitter/api.h>
+#include <tree_sitter/tree-sitter-rpmspec.h>
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum phase {
+    PHASE_OTHER,
+    PHASE_LEX,
+    PHASE_SHIFT,
+    PHASE_REDUCE,
+    PHASE_MAX,
+};
+
+static const char *const phase_names[PHASE_MAX] = {
+    [PHASE_OTHER] = "other",
+    [PHASE_LEX] = "lex",
+    [PHASE_SHIFT] = "shift",
+    [PHASE_REDUCE] = "reduce",
+};
+
+/* Symbols and states without a name or number in the log */
+#define NO_STATE UINT32_MAX
+
+struct symbol_stats {
+    uint64_t nodes;
+    uint64_t reductions;
+    uint64_t reduce_ns;
+    uint64_t reduce_messages;
+};
+
+struct state_stats {
+    uint64_t shifts;
+    uint64_t reductions;
+    /* The symbol that the state reduced most, taken from the folded counts */
+    uint32_t top_symbol;
+    uint64_t top_count;
+};
+
+/* A count per (phase, symbol, state), in an open addressing table */
+struct action_entry {
+    uint64_t key;
+    uint64_t count;
+};
+
+struct profile {
+    const TSLanguage *language;
+    uint32_t symbol_count;
+    uint32_t state_count;
+
+    /* Symbol names hashed to their first symbol, symbol_count is "other" */
+    uint32_t *name_table;
+    uint32_t name_table_size;
+    struct symbol_stats *symbols;
+    struct state_stats *states;
+    struct action_entry *actions;
+    uint32_t action_count;
+    uint32_t action_capacity;
+
+    /* What the interval after the last message belongs to */
+    enum phase phase;
+    uint32_t phase_symbol;
+    uint32_t state;
+    uint32_t lookahead;
+    uint64_t last_ns;
+    uint64_t phase_ns[PHASE_MAX];
+    uint64_t phase_messages[PHASE_MAX];
+    uint64_t messages;
+    bool failed;
+};
+
+static void
+usage(const char *progname)
+{
+    fprintf(stderr, "usage: %s [--top N] [--folded FILE] PATH...\n",
+            progname);
+}
+
+static uint32_t
+hash_name(const char *name, size_t length)
+{
+    uint32_t hash = 2166136261u;
+    size_t i;
+
+    for (i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char)name[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+static bool
+build_name_table(struct profile *profile)
+{
+    uint32_t size = 64;
+    uint32_t symbol;
+
+    while (size < profile->symbol_count * 2) {
+        size *= 2;
+    }
+    profile->name_table = malloc(size * sizeof(*profile->name_table));
+    if (profile->name_table == NULL) {
+        return false;
+    }
+    memset(profile->name_table, 0xff, size * sizeof(*profile->name_table));
+    profile->name_table_size = size;
+
+    for (symbol = 0; symbol < profile->symbol_count; symbol++) {
+        const char *name =
+            ts_language_symbol_name(profile->language, (TSSymbol)symbol);
+        uint32_t slot = hash_name(name, strlen(name)) & (size - 1);
+
+        /* The first symbol of a name wins, as with aliases in the tree */
+        while (profile->name_table[slot] != UINT32_MAX) {
+            const char *other = ts_language_symbol_name(
+                profile->language, (TSSymbol)profile->name_table[slot]);
+
+            if (strcmp(other, name) == 0) {
+                break;
+            }
+            slot = (slot + 1) & (size - 1);
+        }
+        if (profile->name_table[slot] == UINT32_MAX) {
+            profile->name_table[slot] = symbol;
+        }
+    }
+
+    return true;
+}
+
+static uint32_t
+lookup_name(const struct profile *profile, const char *name, size_t length)
+{
+    uint32_t mask = profile->name_table_size - 1;
+    uint32_t slot = hash_name(name, length) & mask;
+
+    while (profile->name_table[slot] != UINT32_MAX) {
+        const char *other = ts_language_symbol_name(
+            profile->language, (TSSymbol)profile->name_table[slot]);
+
+        if (strncmp(other, name, length) == 0 && other[length] == '\0') {
+            return profile->name_table[slot];
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    return profile->symbol_count;
+}
+
+static const char *
+symbol_name(const struct profile *profile, uint32_t symbol)
+{
+    if (symbol >= profile->symbol_count) {
+        return "(other)";
+    }
+
+    return ts_language_symbol_name(profile->language, (TSSymbol)symbol);
+}
+
+/* The symbol name after `prefix` in `message`, up to `end` */
+static uint32_t
+message_symbol(const struct profile *profile,
+               const char *message,
+               const char *prefix,
+               const char *end)
+{
+    const char *name = strstr(message, prefix);
+    const char *stop;
+
+    if (name == NULL) {
+        return profile->symbol_count;
+    }
+    name += strlen(prefix);
+    stop = strstr(name, end);
+
+    return lookup_name(profile, name,
+                       stop != NULL ? (size_t)(stop - name) : strlen(name));
+}
+
+static uint32_t
+message_number(const char *message, const char *prefix)
+{
+    const char *number = strstr(message, prefix);
+
+    if (number == NULL) {
+        return NO_STATE;
+    }
+
+    return (uint32_t)strtoul(number + strlen(prefix), NULL, 10);
+}
+
+static uint64_t
+action_key(enum phase phase, uint32_t symbol, uint32_t state)
+{
+    return ((uint64_t)phase << 48) | ((uint64_t)(symbol & 0xffff) << 32) |
+           state;
+}
+
+static bool
+count_action(struct profile *profile, uint64_t key)
+{
+    uint32_t mask;
+    uint32_t slot;
+
+    if (profile->action_count * 2 >= profile->action_capacity) {
+        uint32_t capacity = profile->action_capacity > 0
+                                ? profile->action_capacity * 2
+                                : 4096;
+        struct action_entry *actions = calloc(capacity, sizeof(*actions));
+        uint32_t i;
+
+        if (actions == NULL) {
+            return false;
+        }
+        for (i = 0; i < profile->action_capacity; i++) {
+            struct action_entry *entry = &profile->actions[i];
+
+            if (entry->count == 0) {
+                continue;
+            }
+            slot = (uint32_t)(entry->key * 0x9e3779b97f4a7c15u >> 32) &
+                   (capacity - 1);
+            while (actions[slot].count != 0) {
+                slot = (slot + 1) & (capacity - 1);
+            }
+            actions[slot] = *entry;
+        }
+        free(profile->actions);
+        profile->actions = actions;
+        profile->action_capacity = capacity;
+    }
+
+    mask = profile->action_capacity - 1;
+    slot = (uint32_t)(key * 0x9e3779b97f4a7c15u >> 32) & mask;
+    while (profile->actions[slot].count != 0 &&
+           profile->actions[slot].key != key) {
+        slot = (slot + 1) & mask;
+    }
+    if (profile->actions[slot].count == 0) {
+        profile->actions[slot].key = key;
+        profile->action_count++;
+    }
+    profile->actions[slot].count++;
+
+    return true;
+}
+
+/* The interval since the last message belongs to what it announced */
+static void
+close_interval(struct profile *profile)
+{
+    uint64_t elapsed = bench_now_ns() - profile->last_ns;
+
+    profile->phase_ns[profile->phase] += elapsed;
+    profile->phase_messages[profile->phase]++;
+    if (profile->phase == PHASE_REDUCE) {
+        profile->symbols[profile->phase_symbol].reduce_ns += elapsed;
+        profile->symbols[profile->phase_symbol].reduce_messages++;
+    }
+}
+
+static void
+log_message(void *payload, TSLogType type, const char *message)
+{
+    struct profile *profile = payload;
+    struct state_stats *state = NULL;
+    uint32_t symbol;
+
+    close_interval(profile);
+    profile->messages++;
+
+    if (profile->state < profile->state_count) {
+        state = &profile->states[profile->state];
+    }
+
+    if (type == TSLogTypeLex) {
+        /* "consume character", "skip character": the lexer carries on */
+    } else if (strncmp(message, "process version:", 16) == 0) {
+        profile->state = message_number(message, "state:");
+        profile->phase = PHASE_OTHER;
+    } else if (strncmp(message, "lex_", 4) == 0) {
+        profile->phase = PHASE_LEX;
+    } else if (strncmp(message, "lexed_lookahead sym:", 20) == 0) {
+        profile->lookahead =
+            message_symbol(profile, message, "sym:", ", size:");
+        profile->failed |= !count_action(
+            profile, action_key(PHASE_LEX, profile->lookahead, NO_STATE));
+        profile->phase = PHASE_OTHER;
+    } else if (strncmp(message, "shift", 5) == 0) {
+        if (state != NULL) {
+            state->shifts++;
+        }
+        profile->failed |= !count_action(
+            profile,
+            action_key(PHASE_SHIFT, profile->lookahead, profile->state));
+        profile->phase = PHASE_SHIFT;
+    } else if (strncmp(message, "reduce sym:", 11) == 0) {
+        symbol = message_symbol(profile, message, "sym:", ", child_count:");
+        profile->symbols[symbol].reductions++;
+        if (state != NULL) {
+            state->reductions++;
+        }
+        profile->failed |= !count_action(
+            profile, action_key(PHASE_REDUCE, symbol, profile->state));
+        profile->phase = PHASE_REDUCE;
+        profile->phase_symbol = symbol;
+    } else {
+        /* Error recovery, version merges, accept */
+        profile->phase = PHASE_OTHER;
+    }
+
+    /* Formatting this message is charged to the next interval */
+    profile->last_ns = bench_now_ns();
+}
+
+static void
+count_nodes(struct profile *profile,
+            const TSTree *tree,
+            uint64_t *errors,
+            uint64_t *missing)
+{
+    TSTreeCursor cursor = ts_tree_cursor_new(ts_tree_root_node(tree));
+
+    for (;;) {
+        TSNode node = ts_tree_cursor_current_node(&cursor);
+        uint32_t symbol = ts_node_symbol(node);
+
+        if (ts_node_is_error(node)) {
+            (*errors)++;
+        } else if (ts_node_is_missing(node)) {
+            (*missing)++;
+        }
+        if (symbol >= profile->symbol_count) {
+            symbol = profile->symbol_count;
+        }
+        profile->symbols[symbol].nodes++;
+
+        if (ts_tree_cursor_goto_first_child(&cursor) ||
+            ts_tree_cursor_goto_next_sibling(&cursor)) {
+            continue;
+        }
+        while (ts_tree_cursor_goto_parent(&cursor)) {
+            if (ts_tree_cursor_goto_next_sibling(&cursor)) {
+                break;
+            }
+        }
+        if (ts_tree_cursor_current_depth(&cursor) == 0) {
+            break;
+        }
+    }
+
+    ts_tree_cursor_delete(&cursor);
+}
+
+/* The time of `messages` intervals without the estimated logging cost */
+static uint64_t
+corrected(uint64_t ns, uint64_t messages, double message_ns)
+{
+    double cost = (double)messages * message_ns;
+
+    return (double)ns > cost ? ns - (uint64_t)cost : 0;
+}
+
+static const struct profile *sort_profile;
+
+static int
+compare_reductions(const void *a, const void *b)
+{
+    const struct symbol_stats *sa = 
+        &sort_profile->symbols[*(const uint32_t *)a];
+    const struct symbol_stats *sb = 
+        &sort_profile->symbols[*(const uint32_t *)b];
+
+    if (sa->reduce_ns != sb->reduce_ns) {
+        return sa->reduce_ns < sb->reduce_ns ? 1 : -1;
+    }
+
+    return (sa->reductions < sb->reductions) -
+           (sa->reductions > sb->reductions);
+}
+
+static int
+compare_nodes(const void *a, const void *b)
+{
+    const struct symbol_stats *sa = 
+        &sort_profile->symbols[*(const uint32_t *)a];
+    const struct symbol_stats *sb = 
+        &sort_profile->symbols[*(const uint32_t *)b];
+
+    return (sa->nodes < sb->nodes) - (sa->nodes > sb->nodes);
+}
+
+static int
+compare_states(const void *a, const void *b)
+{
+    const struct state_stats *sa = 
+        &sort_profile->states[*(const uint32_t *)a];
+    const struct state_stats *sb = 
+        &sort_profile->states[*(const uint32_t *)b];
+    uint64_t ta = sa->shifts + sa->reductions;
+    uint64_t tb = sb->shifts + sb->reductions;
+
+    return (ta < tb) - (ta > tb);
+}
+
+static bool
+write_folded(const struct profile *profile, const char *path)
+{
+    FILE *file = fopen(path, "w");
+    uint32_t i;
+
+    if (file == NULL) {
+        perror(path);
+        return false;
+    }
+    for (i = 0; i < profile->action_capacity; i++) {
+        const struct action_entry *entry = &profile->actions[i];
+        enum phase phase = (enum phase)(entry->key >> 48);
+        uint32_t symbol = (uint32_t)(entry->key >> 32) & 0xffff;
+        uint32_t state = (uint32_t)entry->key;
+
+        if (entry->count == 0) {
+            continue;
+        }
+        fprintf(file, "%s;%s", phase_names[phase],
+                symbol_name(profile, symbol));
+        if (state != NO_STATE) {
+            fprintf(file, ";state %u", state);
+        }
+        fprintf(file, " %llu\n", (unsigned long long)entry->count);
+    }
+    if (fclose(file) != 0) {
+        perror(path);
+        return false;
+    }
+
+    return true;
+}
+
+int
+main(int argc, char **argv)
+{
+    struct profile profile = {0};
+    const char *folded = NULL;
+    struct bench_files files;
+    uint64_t plain_ns = 0;
+    uint64_t logged_ns = 0;
+    uint64_t errors = 0;
+    uint64_t missing = 0;
+    uint64_t nodes = 0;
+    double message_ns;
+    uint32_t *order;
+    TSParser *parser;
+    uint32_t count;
+    long top = 20;
+    uint32_t i;
+    size_t f;
+    int argi;
+
+    for (argi = 1; argi < argc && argv[argi][0] == '-'; argi++) {
+        if (strcmp(argv[argi], "--top") == 0 && argi + 1 < argc) {
+            top = strtol(argv[++argi], NULL, 10);
+        } else if (strcmp(argv[argi], "--folded") == 0 && argi + 1 < argc) {
+            folded = argv[++argi];
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (argi == argc) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (bench_collect(&files, argc - argi, argv + argi) != 0 ||
+        bench_load(&files) != 0) {
+        return 1;
+    }
+    if (files.count == 0 || files.total_bytes == 0) {
+        fprintf(stderr, "no spec files found, see bench/README.md\n");
+        return 1;
+    }
+
+    profile.language = tree_sitter_rpmspec();
+    profile.symbol_count = ts_language_symbol_count(profile.language);
+    profile.state_count = ts_language_state_count(profile.language);
+    profile.symbols =
+        calloc(profile.symbol_count + 1, sizeof(*profile.symbols));
+    profile.states = calloc(profile.state_count, sizeof(*profile.states));
+    count = profile.symbol_count > profile.state_count ? profile.symbol_count
+                                                       : profile.state_count;
+    order = calloc(count + 1, sizeof(*order));
+    parser = ts_parser_new();
+    if (profile.symbols == NULL || profile.states == NULL || order == NULL ||
+        !build_name_table(&profile) || parser == NULL ||
+        !ts_parser_set_language(parser, profile.language)) {
+        fprintf(stderr, "cannot set up the parser\n");
+        return 1;
+    }
+
+    for (f = 0; f < files.count; f++) {
+        const struct bench_file *file = &files.files[f];
+        uint64_t start;
+        TSTree *tree;
+
+        start = bench_now_ns();
+        tree = ts_parser_parse_string(parser, NULL, file->data, file->size);
+        plain_ns += bench_now_ns() - start;
+        count_nodes(&profile, tree, &errors, &missing);
+        ts_tree_delete(tree);
+
+        ts_parser_set_logger(parser, (TSLogger){.payload = &profile,
+                                                .log = log_message});
+        profile.phase = PHASE_OTHER;
+        profile.state = NO_STATE;
+        profile.lookahead = profile.symbol_count;
+        start = profile.last_ns = bench_now_ns();
+        tree = ts_parser_parse_string(parser, NULL, file->data, file->size);
+        close_interval(&profile);
+        logged_ns += bench_now_ns() - start;
+        ts_parser_set_logger(parser, (TSLogger){0});
+        ts_tree_delete(tree);
+    }
+    if (profile.failed) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    for (i = 0; i <= profile.symbol_count; i++) {
+        nodes += profile.symbols[i].nodes;
+    }
+    message_ns = profile.messages > 0 && logged_ns > plain_ns
+                     ? (double)(logged_ns - plain_ns) /
+                           (double)profile.messages
+                     : 0.0;
+    for (i = 0; i < PHASE_MAX; i++) {
+        profile.phase_ns[i] = corrected(profile.phase_ns[i],
+                                        profile.phase_messages[i], message_ns);
+    }
+    for (i = 0; i <= profile.symbol_count; i++) {
+        struct symbol_stats *symbol = &profile.symbols[i];
+
+        symbol->reduce_ns = corrected(symbol->reduce_ns,
+                                      symbol->reduce_messages, message_ns);
+    }
+
+    /* The symbol each state reduces most */
+    for (i = 0; i < profile.action_capacity; i++) {
+        const struct action_entry *entry = &profile.actions[i];
+        uint32_t state = (uint32_t)entry->key;
+
+        if (entry->count == 0 || entry->key >> 48 != PHASE_REDUCE ||
+            state >= profile.state_count) {
+            continue;
+        }
+        if (entry->count > profile.states[state].top_count) {
+            profile.states[state].top_count = entry->count;
+            profile.states[state].top_symbol =
+                (uint32_t)(entry->key >> 32) & 0xffff;
+        }
+    }
+
+    bench_report("files", "%zu", files.count);
+    bench_report("bytes", "%llu", (unsigned long long)files.total_bytes);
+    bench_report("nodes", "%llu", (unsigned long long)nodes);
+    bench_report("error_nodes", "%llu", (unsigned long long)errors);
+    bench_report("missing_nodes", "%llu", (unsigned long long)missing);
+    bench_report("parse_ms", "%.2f", (double)plain_ns / 1e6);
+    bench_report("logged_parse_ms", "%.2f", (double)logged_ns / 1e6);
+    bench_report("log_messages", "%llu",
+                 (unsigned long long)profile.messages);
+    bench_report("message_ns", "%.1f", message_ns);
+    for (i = 0; i < PHASE_MAX; i++) {
+        char key[32];
+
+        snprintf(key, sizeof(key), "%s_ms", phase_names[i]);
+        bench_report(key, "%.2f", (double)profile.phase_ns[i] / 1e6);
+    }
+    bench_report("lex_share", "%.2f",
+                 plain_ns > 0
+                     ? (double)profile.phase_ns[PHASE_LEX] / (double)plain_ns
+                     : 0.0);
+
+    sort_profile = &profile;
+    for (i = 0; i <= profile.symbol_count; i++) {
+        order[i] = i;
+    }
+    qsort(order, profile.symbol_count + 1, sizeof(*order), compare_reductions);
+    printf("\n%12s %12s  %s\n", "reduce_us", "reductions", "rule");
+    for (i = 0; i <= profile.symbol_count && i < (uint32_t)top; i++) {
+        const struct symbol_stats *symbol = &profile.symbols[order[i]];
+
+        if (symbol->reductions == 0) {
+            break;
+        }
+        printf("%12.1f %12llu  %s\n", (double)symbol->reduce_ns / 1e3,
+               (unsigned long long)symbol->reductions,
+               symbol_name(&profile, order[i]));
+    }
+
+    qsort(order, profile.symbol_count + 1, sizeof(*order), compare_nodes);
+    printf("\n%12s  %s\n", "nodes", "symbol");
+    for (i = 0; i <= profile.symbol_count && i < (uint32_t)top; i++) {
+        if (profile.symbols[order[i]].nodes == 0) {
+            break;
+        }
+        printf("%12llu  %s\n",
+               (unsigned long long)profile.symbols[order[i]].nodes,
+               order[i] == profile.symbol_count
+                   ? "ERROR"
+                   : symbol_name(&profile, order[i]));
+    }
+
+    for (i = 0; i < profile.state_count; i++) {
+        order[i] = i;
+    }
+    qsort(order, profile.state_count, sizeof(*order), compare_states);
+    printf("\n%8s %12s %12s  %s\n", "state", "shifts", "reductions",
+           "top reduction");
+    for (i = 0; i < profile.state_count && i < (uint32_t)top; i++) {
+        const struct state_stats *state = &profile.states[order[i]];
+
+        if (state->shifts + state->reductions == 0) {
+            break;
+        }
+        printf("%8u %12llu %12llu  %s\n", order[i],
+               (unsigned long long)state->shifts,
+               (unsigned long long)state->reductions,
+               state->top_count > 0 ? symbol_name(&profile, state->top_symbol)
+                                    : "-");
+    }
+
+    if (folded != NULL && !write_folded(&profile, folded)) {
+        return 1;
+    }
+
+    free(order);
+    free(profile.actions);
+    free(profile.name_table);
+    free(profile.states);
+    free(profile.symbols);
+    ts_parser_delete(parser);
+    bench_files_free(&files);
+
+    return 0;
+}
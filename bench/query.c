@@ -0,0 +1,170 @@
+/*
+ * Highlight query benchmark
+ *
+ * Parses every spec file given on the command line and runs the highlights
+ * query over the tree the way a highlighter does, capture by capture. It
+ * reports the time per KiB of source for parsing and for the query, so the
+ * two can be compared.
+ *
+ *     rpmspec-bench-query [--repeat N] [--query FILE] [--max-ratio R] PATH...
+ *
+ * With --max-ratio the program fails when the query takes longer than R
+ * times the parse.
+ */
+
+#include "common.h"
+
+#include <tree_sitter/api.h>
+#include <tree_sitter/tree-sitter-rpmspec.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef RPMSPEC_HIGHLIGHTS_QUERY
+#define RPMSPEC_HIGHLIGHTS_QUERY "queries/highlights.scm"
+#endif
+
+static void
+usage(const char *progname)
+{
+    fprintf(stderr,
+            "usage: %s [--repeat N] [--query FILE] [--max-ratio R] PATH...\n",
+            progname);
+}
+
+static TSQuery *
+load_query(const char *path)
+{
+    struct bench_files files;
+    TSQueryError error;
+    uint32_t offset;
+    TSQuery *query;
+
+    if (bench_collect(&files, 1, (char **)&path) != 0 ||
+        bench_load(&files) != 0) {
+        return NULL;
+    }
+
+    query = ts_query_new(tree_sitter_rpmspec(),
+                         files.files[0].data,
+                         files.files[0].size,
+                         &offset,
+                         &error);
+    if (query == NULL) {
+        fprintf(stderr, "%s: query error %d at byte %u\n", path, error,
+                offset);
+    }
+    bench_files_free(&files);
+
+    return query;
+}
+
+int
+main(int argc, char **argv)
+{
+    const char *query_path = RPMSPEC_HIGHLIGHTS_QUERY;
+    struct bench_files files;
+    TSQueryCursor *cursor;
+    uint64_t parse_ns = 0;
+    uint64_t query_ns = 0;
+    uint64_t captures = 0;
+    double max_ratio = 0;
+    double kib;
+    TSParser *parser;
+    TSQuery *query;
+    long repeat = 1;
+    long r;
+    size_t i;
+    int argi;
+
+    for (argi = 1; argi < argc && argv[argi][0] == '-'; argi++) {
+        if (strcmp(argv[argi], "--repeat") == 0 && argi + 1 < argc) {
+            repeat = strtol(argv[++argi], NULL, 10);
+        } else if (strcmp(argv[argi], "--query") == 0 && argi + 1 < argc) {
+            query_path = argv[++argi];
+        } else if (strcmp(argv[argi], "--max-ratio") == 0 &&
+                   argi + 1 < argc) {
+            max_ratio = strtod(argv[++argi], NULL);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (argi == argc || repeat < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (bench_collect(&files, argc - argi, argv + argi) != 0 ||
+        bench_load(&files) != 0) {
+        return 1;
+    }
+    if (files.count == 0 || files.total_bytes == 0) {
+        fprintf(stderr, "no spec files found, see bench/README.md\n");
+        return 1;
+    }
+
+    query = load_query(query_path);
+    if (query == NULL) {
+        return 1;
+    }
+
+    parser = ts_parser_new();
+    ts_parser_set_language(parser, tree_sitter_rpmspec());
+    cursor = ts_query_cursor_new();
+
+    for (r = 0; r < repeat; r++) {
+        for (i = 0; i < files.count; i++) {
+            const struct bench_file *f = &files.files[i];
+            uint32_t capture_index;
+            TSQueryMatch match;
+            uint64_t start;
+            TSTree *tree;
+
+            start = bench_now_ns();
+            tree = ts_parser_parse_string(parser, NULL, f->data, f->size);
+            parse_ns += bench_now_ns() - start;
+
+            start = bench_now_ns();
+            ts_query_cursor_exec(cursor, query, ts_tree_root_node(tree));
+            while (ts_query_cursor_next_capture(cursor, &match,
+                                                &capture_index)) {
+                if (r == 0) {
+                    captures++;
+                }
+            }
+            query_ns += bench_now_ns() - start;
+
+            ts_tree_delete(tree);
+        }
+    }
+
+    kib = (double)files.total_bytes * (double)repeat / 1024.0;
+
+    bench_report("query", "%s", query_path);
+    bench_report("patterns", "%u", ts_query_pattern_count(query));
+    bench_report("files", "%zu", files.count);
+    bench_report("bytes", "%llu", (unsigned long long)files.total_bytes);
+    bench_report("captures", "%llu", (unsigned long long)captures);
+    bench_report("parse_us_per_kib", "%.2f", (double)parse_ns / 1e3 / kib);
+    bench_report("query_us_per_kib", "%.2f", (double)query_ns / 1e3 / kib);
+    bench_report("query_parse_ratio", "%.2f",
+                 (double)query_ns / (double)parse_ns);
+    bench_report("match_limit_exceeded", "%s",
+                 ts_query_cursor_did_exceed_match_limit(cursor) ? "yes"
+                                                                 : "no");
+
+    ts_query_cursor_delete(cursor);
+    ts_query_delete(query);
+    ts_parser_delete(parser);
+    bench_files_free(&files);
+
+    if (max_ratio > 0 && (double)query_ns > max_ratio * (double)parse_ns) {
+        fprintf(stderr, "query takes more than %.2f times the parse\n",
+                max_ratio);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,216 @@
+/*
+ * Error recovery benchmark
+ *
+ * Parses broken spec files, and every spec file cut off at evenly spaced
+ * offsets the way an editor sees a file while it is being typed, and reports
+ * how long the parses take and how far the errors spread: the ERROR nodes,
+ * the number of lines the largest one spans and the MISSING nodes the parser
+ * inserted instead. bench/broken holds specs that are broken on purpose.
+ *
+ *     rpmspec-bench-recovery [--repeat N] [--cuts N] [--max-ms MS]
+ *                            [--max-error-lines N] PATH...
+ *
+ * Each variant is parsed N times and its fastest parse counts. The program
+ * fails if a variant takes longer than --max-ms or has an ERROR node that
+ * spans more than --max-error-lines lines.
+ */
+
+#include "common.h"
+
+#include <tree_sitter/api.h>
+#include <tree_sitter/tree-sitter-rpmspec.h>
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct recovery_stats {
+    uint64_t errors;
+    uint64_t missing;
+    uint32_t max_error_lines;
+};
+
+static void
+usage(const char *progname)
+{
+    fprintf(stderr,
+            "usage: %s [--repeat N] [--cuts N] [--max-ms MS] "
+            "[--max-error-lines N] PATH...\n",
+            progname);
+}
+
+/*
+ * Count the outermost ERROR nodes and the MISSING nodes of the tree. Only
+ * subtrees that contain an error are entered.
+ */
+static void
+scan_errors(const TSTree *tree, struct recovery_stats *stats)
+{
+    TSTreeCursor cursor = ts_tree_cursor_new(ts_tree_root_node(tree));
+
+    for (;;) {
+        TSNode node = ts_tree_cursor_current_node(&cursor);
+        bool descend = ts_node_has_error(node);
+
+        if (ts_node_is_missing(node)) {
+            stats->missing++;
+        } else if (ts_node_is_error(node)) {
+            uint32_t lines = ts_node_end_point(node).row -
+                             ts_node_start_point(node).row + 1;
+
+            stats->errors++;
+            if (lines > stats->max_error_lines) {
+                stats->max_error_lines = lines;
+            }
+            descend = false;
+        }
+
+        if (descend && ts_tree_cursor_goto_first_child(&cursor)) {
+            continue;
+        }
+        while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+            if (!ts_tree_cursor_goto_parent(&cursor)) {
+                ts_tree_cursor_delete(&cursor);
+                return;
+            }
+        }
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    struct recovery_stats total = {0};
+    struct bench_files files;
+    const char *worst_path = NULL;
+    uint32_t worst_size = 0;
+    uint64_t *samples;
+    uint64_t worst_ns = 0;
+    uint64_t sum_ns = 0;
+    size_t variants = 0;
+    size_t failed = 0;
+    double max_ms = 0.0;
+    long max_error_lines = 0;
+    long repeat = 3;
+    long cuts = 8;
+    TSParser *parser;
+    size_t i;
+    int argi;
+
+    for (argi = 1; argi < argc && argv[argi][0] == '-'; argi++) {
+        if (strcmp(argv[argi], "--repeat") == 0 && argi + 1 < argc) {
+            repeat = strtol(argv[++argi], NULL, 10);
+        } else if (strcmp(argv[argi], "--cuts") == 0 && argi + 1 < argc) {
+            cuts = strtol(argv[++argi], NULL, 10);
+        } else if (strcmp(argv[argi], "--max-ms") == 0 && argi + 1 < argc) {
+            max_ms = strtod(argv[++argi], NULL);
+        } else if (strcmp(argv[argi], "--max-error-lines") == 0 &&
+                   argi + 1 < argc) {
+            max_error_lines = strtol(argv[++argi], NULL, 10);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (argi == argc || repeat < 1 || cuts < 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (bench_collect(&files, argc - argi, argv + argi) != 0 ||
+        bench_load(&files) != 0) {
+        return 1;
+    }
+    if (files.count == 0) {
+        fprintf(stderr, "no spec files found, see bench/README.md\n");
+        return 1;
+    }
+
+    samples = calloc(files.count * (size_t)(cuts + 1), sizeof(*samples));
+    parser = ts_parser_new();
+    if (samples == NULL || parser == NULL ||
+        !ts_parser_set_language(parser, tree_sitter_rpmspec())) {
+        fprintf(stderr, "cannot set up the parser\n");
+        return 1;
+    }
+
+    for (i = 0; i < files.count; i++) {
+        const struct bench_file *f = &files.files[i];
+        long cut;
+
+        /* The whole file first, then its prefixes from the shortest on */
+        for (cut = 0; cut <= cuts; cut++) {
+            struct recovery_stats stats = {0};
+            uint32_t size = cut == 0 ? f->size
+                                     : (uint32_t)((uint64_t)f->size *
+                                                  (uint64_t)cut /
+                                                  (uint64_t)(cuts + 1));
+            uint64_t best = UINT64_MAX;
+            TSTree *tree = NULL;
+            long r;
+
+            for (r = 0; r < repeat; r++) {
+                uint64_t start = bench_now_ns();
+                uint64_t elapsed;
+
+                ts_tree_delete(tree);
+                tree = ts_parser_parse_string(parser, NULL, f->data, size);
+                elapsed = bench_now_ns() - start;
+                if (elapsed < best) {
+                    best = elapsed;
+                }
+            }
+            scan_errors(tree, &stats);
+            ts_tree_delete(tree);
+
+            samples[variants++] = best;
+            sum_ns += best;
+            total.errors += stats.errors;
+            total.missing += stats.missing;
+            if (stats.max_error_lines > total.max_error_lines) {
+                total.max_error_lines = stats.max_error_lines;
+            }
+            if (best > worst_ns) {
+                worst_ns = best;
+                worst_path = f->path;
+                worst_size = size;
+            }
+
+            if (max_ms > 0 && (double)best / 1e6 > max_ms) {
+                fprintf(stderr, "%s: %u bytes took %.2f ms, ceiling %.2f\n",
+                        f->path, size, (double)best / 1e6, max_ms);
+                failed++;
+            }
+            if (max_error_lines > 0 &&
+                stats.max_error_lines > (uint32_t)max_error_lines) {
+                fprintf(stderr,
+                        "%s: %u bytes have an error over %u lines, "
+                        "ceiling %ld\n",
+                        f->path, size, stats.max_error_lines,
+                        max_error_lines);
+                failed++;
+            }
+        }
+    }
+
+    bench_report("files", "%zu", files.count);
+    bench_report("variants", "%zu", variants);
+    bench_report("error_nodes", "%llu", (unsigned long long)total.errors);
+    bench_report("missing_nodes", "%llu", (unsigned long long)total.missing);
+    bench_report("max_error_lines", "%u", total.max_error_lines);
+    bench_report("mean_us", "%.2f", (double)sum_ns / 1e3 / (double)variants);
+    bench_report("p50_us", "%.2f",
+                 (double)bench_percentile(samples, variants, 50) / 1e3);
+    bench_report("p99_us", "%.2f",
+                 (double)bench_percentile(samples, variants, 99) / 1e3);
+    bench_report("max_us", "%.2f", (double)worst_ns / 1e3);
+    bench_report("worst", "%s:%u", worst_path != NULL ? worst_path : "-",
+                 worst_size);
+
+    free(samples);
+    ts_parser_delete(parser);
+    bench_files_free(&files);
+
+    return failed > 0 ? 1 : 0;
+}
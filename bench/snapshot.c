@@ -0,0 +1,227 @@
+/*
+ * Snapshot cache benchmark
+ *
+ * Parses every spec file given on the command line and compares that with
+ * getting its tree from the snapshot cache of tree-sitter-rpmspec-snapshot.h
+ * once the cache is warm. Reports the time per file for both, the size of
+ * the snapshots and the cache hits and misses.
+ *
+ *     rpmspec-bench-snapshot [--repeat N] [--cache DIRECTORY] PATH...
+ *
+ * Without --cache the snapshots go to a temporary directory that is removed
+ * afterwards. The program fails if a snapshot does not have as many nodes
+ * of a symbol as the tree it was made from.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "common.h"
+
+#include <tree_sitter/api.h>
+#include <tree_sitter/tree-sitter-rpmspec-snapshot.h>
+#include <tree_sitter/tree-sitter-rpmspec.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static void
+usage(const char *progname)
+{
+    fprintf(stderr, "usage: %s [--repeat N] [--cache DIRECTORY] PATH...\n",
+            progname);
+}
+
+static uint32_t
+count_symbol(TSNode node, TSSymbol symbol)
+{
+    TSTreeCursor cursor = ts_tree_cursor_new(node);
+    uint32_t count = 0;
+
+    for (;;) {
+        if (ts_node_symbol(ts_tree_cursor_current_node(&cursor)) == symbol) {
+            count++;
+        }
+        if (ts_tree_cursor_goto_first_child(&cursor)) {
+            continue;
+        }
+        while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+            if (!ts_tree_cursor_goto_parent(&cursor)) {
+                ts_tree_cursor_delete(&cursor);
+                return count;
+            }
+        }
+    }
+}
+
+static void
+remove_snapshots(const char *directory, const struct bench_files *files)
+{
+    char path[4096];
+    size_t i;
+
+    for (i = 0; i < files->count; i++) {
+        uint64_t hash = tree_sitter_rpmspec_snapshot_hash(
+            files->files[i].data, files->files[i].size);
+
+        snprintf(path, sizeof(path), "%s/%016llx.snap", directory,
+                 (unsigned long long)hash);
+        unlink(path);
+    }
+    rmdir(directory);
+}
+
+int
+main(int argc, char **argv)
+{
+    const TSLanguage *language = tree_sitter_rpmspec();
+    char temporary[] = "/tmp/rpmspec-bench-snapshot-XXXXXX";
+    TSRpmspecSnapshotCacheStats stats = {0};
+    const char *directory = NULL;
+    uint64_t snapshot_bytes = 0;
+    uint64_t parse_ns = 0;
+    uint64_t load_ns = 0;
+    uint64_t nodes = 0;
+    struct bench_files files;
+    uint32_t *expected;
+    uint64_t *samples;
+    TSParser *parser;
+    TSSymbol symbol;
+    long repeat = 1;
+    size_t sample = 0;
+    long r;
+    size_t i;
+    int argi;
+
+    for (argi = 1; argi < argc && argv[argi][0] == '-'; argi++) {
+        if (strcmp(argv[argi], "--repeat") == 0 && argi + 1 < argc) {
+            repeat = strtol(argv[++argi], NULL, 10);
+        } else if (strcmp(argv[argi], "--cache") == 0 && argi + 1 < argc) {
+            directory = argv[++argi];
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (argi == argc || repeat < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (bench_collect(&files, argc - argi, argv + argi) != 0 ||
+        bench_load(&files) != 0) {
+        return 1;
+    }
+    if (files.count == 0 || files.total_bytes == 0) {
+        fprintf(stderr, "no spec files found, see bench/README.md\n");
+        return 1;
+    }
+    if (directory == NULL) {
+        directory = mkdtemp(temporary);
+        if (directory == NULL) {
+            perror("mkdtemp");
+            return 1;
+        }
+    }
+
+    parser = ts_parser_new();
+    ts_parser_set_language(parser, language);
+    symbol = ts_language_symbol_for_name(language, "dependency_tag",
+                                         sizeof("dependency_tag") - 1, true);
+    expected = calloc(files.count, sizeof(*expected));
+    samples = calloc(files.count * (size_t)repeat, sizeof(*samples));
+    if (expected == NULL || samples == NULL) {
+        return 1;
+    }
+
+    /* Parsing, and filling the cache if it is cold */
+    for (r = 0; r < repeat; r++) {
+        for (i = 0; i < files.count; i++) {
+            uint64_t start = bench_now_ns();
+            TSTree *tree;
+
+            tree = ts_parser_parse_string(parser, NULL, files.files[i].data,
+                                          files.files[i].size);
+            parse_ns += bench_now_ns() - start;
+            if (r == 0) {
+                expected[i] = count_symbol(ts_tree_root_node(tree), symbol);
+            }
+            ts_tree_delete(tree);
+        }
+    }
+    for (i = 0; i < files.count; i++) {
+        TSRpmspecSnapshot *snapshot = tree_sitter_rpmspec_snapshot_cache_get(
+            directory, parser, files.files[i].data, files.files[i].size,
+            &stats);
+
+        if (snapshot == NULL) {
+            perror(files.files[i].path);
+            return 1;
+        }
+        tree_sitter_rpmspec_snapshot_delete(snapshot);
+    }
+
+    for (r = 0; r < repeat; r++) {
+        for (i = 0; i < files.count; i++) {
+            uint64_t start = bench_now_ns();
+            TSRpmspecSnapshot *snapshot;
+            uint32_t count;
+
+            snapshot = tree_sitter_rpmspec_snapshot_cache_get(
+                directory, parser, files.files[i].data, files.files[i].size,
+                &stats);
+            if (snapshot == NULL) {
+                perror(files.files[i].path);
+                return 1;
+            }
+            tree_sitter_rpmspec_snapshot_nodes_of_symbol(snapshot, symbol,
+                                                         &count);
+            samples[sample] = bench_now_ns() - start;
+            load_ns += samples[sample++];
+
+            if (count != expected[i]) {
+                fprintf(stderr, "%s: %u dependency tags, expected %u\n",
+                        files.files[i].path, count, expected[i]);
+                return 1;
+            }
+            if (r == 0) {
+                uint32_t node_count;
+
+                tree_sitter_rpmspec_snapshot_nodes(snapshot, &node_count);
+                nodes += node_count;
+                snapshot_bytes +=
+                    (uint64_t)node_count *
+                    (sizeof(TSRpmspecSnapshotNode) + sizeof(uint32_t));
+            }
+            tree_sitter_rpmspec_snapshot_delete(snapshot);
+        }
+    }
+
+    bench_report("files", "%zu", files.count);
+    bench_report("bytes", "%llu", (unsigned long long)files.total_bytes);
+    bench_report("nodes", "%llu", (unsigned long long)nodes);
+    bench_report("snapshot_node_bytes", "%llu",
+                 (unsigned long long)snapshot_bytes);
+    bench_report("parse_us_per_file", "%.2f",
+                 (double)parse_ns / 1e3 / (double)sample);
+    bench_report("load_us_per_file", "%.2f",
+                 (double)load_ns / 1e3 / (double)sample);
+    bench_report("p99_load_us", "%.2f",
+                 (double)bench_percentile(samples, sample, 99) / 1e3);
+    bench_report("parse_load_ratio", "%.1f",
+                 (double)parse_ns / (double)load_ns);
+    bench_report("cache_hits", "%llu", (unsigned long long)stats.hits);
+    bench_report("cache_misses", "%llu", (unsigned long long)stats.misses);
+    bench_report("cache_rejected", "%llu", (unsigned long long)stats.rejected);
+
+    if (directory == temporary) {
+        remove_snapshots(directory, &files);
+    }
+    free(expected);
+    free(samples);
+    ts_parser_delete(parser);
+    bench_files_free(&files);
+
+    return 0;
+}
@@ -0,0 +1,152 @@
+#!/usr/bin/env node
+/*
+ * WebAssembly build benchmark
+ *
+ * Reports the size of tree-sitter-rpmspec.wasm as built by the ts-wasm
+ * target, raw and compressed the way a web server sends it, and how long
+ * compiling it takes. With web-tree-sitter installed it also reports the
+ * time to load the language, i.e. compile, instantiate and link it the way
+ * a browser does, and parses the spec files given after it.
+ *
+ *     node bench/wasm.js [--repeat N] [--max-bytes N] WASM [PATH...]
+ *
+ * The program fails if the file is larger than --max-bytes or cannot be
+ * loaded.
+ */
+
+"use strict";
+
+const fs = require("node:fs");
+const path = require("node:path");
+const zlib = require("node:zlib");
+
+function usage() {
+  console.error(
+    "usage: node bench/wasm.js [--repeat N] [--max-bytes N] WASM [PATH...]",
+  );
+  process.exit(2);
+}
+
+// Same format as bench_report() in common.c
+function report(key, value) {
+  console.log(`${key.padEnd(20)} ${value}`);
+}
+
+function collect(paths) {
+  const files = [];
+  const visit = (file) => {
+    if (fs.statSync(file).isDirectory()) {
+      for (const entry of fs.readdirSync(file)) {
+        const child = path.join(file, entry);
+        if (fs.statSync(child).isDirectory() || entry.endsWith(".spec")) {
+          visit(child);
+        }
+      }
+    } else {
+      files.push(file);
+    }
+  };
+  paths.forEach(visit);
+  return files.sort();
+}
+
+function elapsedMs(start) {
+  return Number(process.hrtime.bigint() - start) / 1e6;
+}
+
+async function main(args) {
+  let maxBytes = 0;
+  let repeat = 5;
+
+  while (args.length > 0 && args[0].startsWith("--")) {
+    const option = args.shift();
+    const value = Number(args.shift());
+    if (option === "--repeat" && value >= 1) {
+      repeat = value;
+    } else if (option === "--max-bytes" && value >= 0) {
+      maxBytes = value;
+    } else {
+      usage();
+    }
+  }
+  if (args.length === 0) {
+    usage();
+  }
+
+  const bytes = fs.readFileSync(args[0]);
+  const brotli = zlib.brotliCompressSync(bytes, {
+    params: { [zlib.constants.BROTLI_PARAM_QUALITY]: 11 },
+  });
+
+  report("wasm_bytes", bytes.length);
+  report("gzip_bytes", zlib.gzipSync(bytes, { level: 9 }).length);
+  report("brotli_bytes", brotli.length);
+
+  // The fastest of several compiles, as with the parse benchmarks
+  let compileMs = Infinity;
+  for (let r = 0; r < repeat; r++) {
+    const start = process.hrtime.bigint();
+    await WebAssembly.compile(bytes);
+    compileMs = Math.min(compileMs, elapsedMs(start));
+  }
+  report("compile_ms", compileMs.toFixed(2));
+
+  let Parser;
+  let Language;
+  try {
+    ({ Parser, Language } = require("web-tree-sitter"));
+  } catch {
+    console.error("web-tree-sitter not installed, skipping the load time");
+  }
+
+  if (Parser !== undefined) {
+    await Parser.init();
+
+    // web-tree-sitter compiles and links the module again on every load,
+    // so each one costs what the first load in a browser does
+    let loadMs = Infinity;
+    let language;
+    for (let r = 0; r < repeat; r++) {
+      const start = process.hrtime.bigint();
+      language = await Language.load(bytes);
+      loadMs = Math.min(loadMs, elapsedMs(start));
+    }
+    report("load_ms", loadMs.toFixed(2));
+
+    const files = collect(args.slice(1));
+    const parser = new Parser();
+    let errorFiles = 0;
+    let parseMs = 0;
+    let total = 0;
+
+    parser.setLanguage(language);
+    for (const file of files) {
+      const source = fs.readFileSync(file, "utf8");
+      const start = process.hrtime.bigint();
+      const tree = parser.parse(source);
+      parseMs += elapsedMs(start);
+      total += Buffer.byteLength(source);
+      if (tree.rootNode.hasError) {
+        errorFiles++;
+      }
+      tree.delete();
+    }
+    parser.delete();
+
+    if (files.length > 0) {
+      report("files", files.length);
+      report("error_files", errorFiles);
+      report("parse_us_per_kib", ((parseMs * 1e3) / (total / 1024)).toFixed(2));
+    }
+  }
+
+  if (maxBytes > 0 && bytes.length > maxBytes) {
+    console.error(`${args[0]}: ${bytes.length} bytes, ceiling ${maxBytes}`);
+    process.exitCode = 1;
+  }
+}
+
+main(process.argv.slice(2)).catch((error) => {
+  console.error(error.message);
+  process.exit(1);
+});
@@ -1,4 +1,12 @@
 {
+  "variables": {
+    # parseAsync() needs the tree-sitter runtime. Link against the one built
+    # into the addon of the tree-sitter peer dependency when it is installed,
+    # so that a process has a single runtime, of the ABI the parser is
+    # generated for.
+    "tree_sitter_dir": "<!(node -p \"try { require('path').dirname(require.resolve('tree-sitter/package.json')) } catch (_) { '' }\")",
+    "tree_sitter_runtime": "<!(node -p \"try { require('node-gyp-build').path(require('path').dirname(require.resolve('tree-sitter/package.json'))) } catch (_) { '' }\")",
+  },
   "targets": [
     {
       "target_name": "tree_sitter_rpmspec_binding",
@@ -11,11 +19,26 @@
       "sources": [
         "bindings/node/binding.cc",
         "src/parser.c",
-        # NOTE: if your language has an external scanner, add it here.
+        "src/scanner.c",
       ],
       "cflags_c": [
         "-std=c11",
       ],
+      "conditions": [
+        # Only ELF shared objects can be linked against, a .node file on
+        # macOS is a bundle and on Windows has no import library.
+        ["OS == 'linux' and tree_sitter_runtime != ''", {
+          "defines": [
+            "RPMSPEC_PARSE_ASYNC",
+          ],
+          "include_dirs": [
+            "<(tree_sitter_dir)/vendor/tree-sitter/lib/include",
+          ],
+          "libraries": [
+            "<(tree_sitter_runtime)",
+          ],
+        }],
+      ],
     }
   ]
 }
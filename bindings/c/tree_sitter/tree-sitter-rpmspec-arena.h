@@ -0,0 +1,73 @@
+#ifndef TREE_SITTER_RPMSPEC_ARENA_H_
+#define TREE_SITTER_RPMSPEC_ARENA_H_
+
+#include <tree_sitter/api.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A bump allocator for parsing many files in a row. Everything the runtime
+// allocates while an arena is current on the calling thread is carved out of
+// the arena's blocks and released at once by
+// tree_sitter_rpmspec_arena_reset(), instead of being freed node by node.
+typedef struct TSRpmspecArena TSRpmspecArena;
+
+typedef struct TSRpmspecArenaStats {
+    size_t used;      // Bytes handed out since the last reset
+    size_t peak;      // Largest `used` seen since the arena was created
+    size_t reserved;  // Bytes held in blocks
+    uint32_t blocks;
+} TSRpmspecArenaStats;
+
+// Route the runtime's allocations through the arena allocator with
+// ts_set_allocator(). This affects the whole process and must happen before
+// any parser, tree or query exists, or after all of them were deleted.
+// Allocations made while no arena is current go to malloc(). Memory that the
+// runtime hands out to be released by the caller, e.g. ts_node_string(),
+// must then be released with tree_sitter_rpmspec_arena_free().
+void tree_sitter_rpmspec_arena_install(void);
+
+// Undo tree_sitter_rpmspec_arena_install(); the same rules apply.
+void tree_sitter_rpmspec_arena_uninstall(void);
+
+// Create an arena that allocates blocks of at least `block_size` bytes, or
+// a default size if 0. Returns NULL if out of memory.
+TSRpmspecArena *tree_sitter_rpmspec_arena_new(size_t block_size);
+
+void tree_sitter_rpmspec_arena_delete(TSRpmspecArena *self);
+
+// Make `self` the current arena of the calling thread, or none if NULL.
+// Returns the previous one.
+TSRpmspecArena *tree_sitter_rpmspec_arena_enter(TSRpmspecArena *self);
+
+// Release everything allocated from `self`. Trees, parsers and cursors
+// allocated from it become invalid and must not be deleted afterwards.
+// After a parse that needed several blocks they are merged into one, so in
+// a batch the arena settles on a single block.
+void tree_sitter_rpmspec_arena_reset(TSRpmspecArena *self);
+
+void tree_sitter_rpmspec_arena_stats(const TSRpmspecArena *self,
+                                     TSRpmspecArenaStats *stats);
+
+// Parse `source` with a parser created inside `self` and deleted again,
+// which keeps the parser's reusable subtree pool from outliving the arena.
+// The tree stays valid until the next tree_sitter_rpmspec_arena_reset();
+// deleting it is not necessary. Requires tree_sitter_rpmspec_arena_install().
+TSTree *tree_sitter_rpmspec_arena_parse(TSRpmspecArena *self,
+                                        const TSLanguage *language,
+                                        const char *source,
+                                        uint32_t length);
+
+// Release memory the runtime allocated while the arena allocator was
+// installed, whether it came from an arena or not.
+void tree_sitter_rpmspec_arena_free(void *ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TREE_SITTER_RPMSPEC_ARENA_H_
@@ -0,0 +1,129 @@
+#ifndef TREE_SITTER_RPMSPEC_CHANGELOG_H_
+#define TREE_SITTER_RPMSPEC_CHANGELOG_H_
+
+#include <tree_sitter/api.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The structures of the Arrow C data interface, as the Arrow specification
+// has them. Including arrow/c/abi.h first uses those instead.
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+struct ArrowSchema {
+    const char *format;
+    const char *name;
+    const char *metadata;
+    int64_t flags;
+    int64_t n_children;
+    struct ArrowSchema **children;
+    struct ArrowSchema *dictionary;
+    void (*release)(struct ArrowSchema *);
+    void *private_data;
+};
+
+struct ArrowArray {
+    int64_t length;
+    int64_t null_count;
+    int64_t offset;
+    int64_t n_buffers;
+    int64_t n_children;
+    const void **buffers;
+    struct ArrowArray **children;
+    struct ArrowArray *dictionary;
+    void (*release)(struct ArrowArray *);
+    void *private_data;
+};
+
+#endif // ARROW_C_DATA_INTERFACE
+
+typedef enum TSRpmspecChangelogIdKind {
+    TSRpmspecChangelogCve,  // CVE-2024-1234, or the older CAN-2004-0001
+    TSRpmspecChangelogBdu,  // BDU:2024-00001
+    TSRpmspecChangelogMfsa, // MFSA-2024-01
+    TSRpmspecChangelogOve,  // OVE-20240101-0001
+    TSRpmspecChangelogBug,  // rhbz#123456, #123
+} TSRpmspecChangelogIdKind;
+
+// A column of strings in the Arrow layout: string `i` is the bytes from
+// `offsets[i]` to `offsets[i + 1]` of `data`, without a NUL.
+typedef struct TSRpmspecStringColumn {
+    int32_t *offsets;
+    char *data;
+    uint32_t count;
+    uint32_t offset_capacity;
+    uint32_t data_capacity;
+} TSRpmspecStringColumn;
+
+// The ids mentioned in changelog entries, one row per mention, as columns.
+// Reset it with `= {0}` before first use. Extractions append to it, so one
+// batch can collect many specs; the strings are copied out of the sources.
+typedef struct TSRpmspecChangelogBatch {
+    uint32_t rows;
+    uint32_t row_capacity;
+    int32_t *package; // Index into `packages`
+    int32_t *date;    // Of the entry, in days since 1970-01-01
+    int8_t *kind;     // TSRpmspecChangelogIdKind
+    uint32_t *row;    // Zero-based line of the id in its spec
+    // The version-release of the entry header, e.g. "1.2-3", or "" if the
+    // header has none. Trailing ")", "," and "." of an id are cut.
+    TSRpmspecStringColumn version;
+    TSRpmspecStringColumn id;
+    // One per extraction that added rows
+    TSRpmspecStringColumn packages;
+} TSRpmspecChangelogBatch;
+
+typedef struct TSRpmspecChangelogExtractor TSRpmspecChangelogExtractor;
+
+// Create an extractor for trees parsed with `language`. The query is
+// compiled once here. Returns NULL if it does not compile against
+// `language`. Trees of tree_sitter_rpmspec_lazy_changelog() have no ids.
+TSRpmspecChangelogExtractor *
+tree_sitter_rpmspec_changelog_extractor_new(const TSLanguage *language);
+
+void tree_sitter_rpmspec_changelog_extractor_delete(
+    TSRpmspecChangelogExtractor *self);
+
+// Append a row to `batch` for every id in the %changelog of `tree`, which
+// was parsed from `source`. Only the %changelog section is queried. The
+// rows get the package `package`, or with NULL the value of the Name tag of
+// the main preamble as written, "" without one. Returns false and sets
+// errno if out of memory or the strings of the batch outgrow 2 GiB, which
+// leaves the rows of earlier extractions in place.
+bool tree_sitter_rpmspec_changelog_extract(TSRpmspecChangelogExtractor *self,
+                                           const TSTree *tree,
+                                           const char *source,
+                                           const char *package,
+                                           TSRpmspecChangelogBatch *batch);
+
+// Drop the rows of `batch` and keep its arrays for the next extractions.
+void tree_sitter_rpmspec_changelog_batch_clear(TSRpmspecChangelogBatch *batch);
+
+// Release the arrays of `batch`, not `batch` itself.
+void tree_sitter_rpmspec_changelog_batch_free(TSRpmspecChangelogBatch *batch);
+
+// Move the rows of `batch` into a struct array of the Arrow C data interface
+// without copying them, e.g. for pyarrow.RecordBatch._import_from_c(). The
+// columns are "package" (dictionary of utf8), "version" (utf8), "date"
+// (date32), "kind" (dictionary of utf8: "CVE", "BDU", "MFSA", "OVE" or
+// "BUG"), "id" (utf8) and "row" (uint32), none nullable. `batch` is left
+// empty. Returns false and sets errno if out of memory, which leaves `batch`
+// as it was.
+bool tree_sitter_rpmspec_changelog_batch_export(TSRpmspecChangelogBatch *batch,
+                                                struct ArrowSchema *schema,
+                                                struct ArrowArray *array);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TREE_SITTER_RPMSPEC_CHANGELOG_H_
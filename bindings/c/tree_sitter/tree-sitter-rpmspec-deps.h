@@ -0,0 +1,103 @@
+#ifndef TREE_SITTER_RPMSPEC_DEPS_H_
+#define TREE_SITTER_RPMSPEC_DEPS_H_
+
+#include <tree_sitter/api.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A byte range of the parsed source. Empty if `length` is 0.
+typedef struct TSRpmspecSlice {
+    uint32_t start;
+    uint32_t length;
+} TSRpmspecSlice;
+
+typedef enum TSRpmspecDependencyKind {
+    TSRpmspecRequires,
+    TSRpmspecBuildRequires,
+    TSRpmspecProvides,
+    TSRpmspecConflicts,
+    TSRpmspecBuildConflicts,
+    TSRpmspecObsoletes,
+    TSRpmspecRecommends,
+    TSRpmspecSuggests,
+    TSRpmspecSupplements,
+    TSRpmspecEnhances,
+    TSRpmspecOrderWithRequires,
+} TSRpmspecDependencyKind;
+
+// The value is a rich (boolean) dependency, e.g. "(foo or bar)". `name`
+// covers the whole expression and `op` and `version` are empty.
+#define TS_RPMSPEC_DEPENDENCY_RICH 0x1u
+
+// One dependency. "Requires: a, b >= 1" yields two of them.
+typedef struct TSRpmspecDependency {
+    TSRpmspecDependencyKind kind;
+    uint32_t flags;
+    // Index into TSRpmspecDeps.packages plus one, 0 for the main package.
+    uint32_t package;
+    // Zero-based line of the tag.
+    uint32_t row;
+    TSRpmspecSlice qualifier; // "post" in "Requires(post):"
+    TSRpmspecSlice name;
+    TSRpmspecSlice op; // "<", "<=", "=", "==", ">=" or ">"
+    TSRpmspecSlice version;
+} TSRpmspecDependency;
+
+// Everything extracted from one spec. Reset it with `= {0}` before first
+// use; tree_sitter_rpmspec_deps_extract() reuses the arrays of a record that
+// is passed again.
+typedef struct TSRpmspecDeps {
+    TSRpmspecSlice name;
+    TSRpmspecSlice epoch;
+    TSRpmspecSlice version;
+    TSRpmspecSlice release;
+    // Name arguments of the %package sections, "-n" included if present.
+    TSRpmspecSlice *packages;
+    uint32_t package_count;
+    uint32_t package_capacity;
+    TSRpmspecDependency *dependencies;
+    uint32_t dependency_count;
+    uint32_t dependency_capacity;
+} TSRpmspecDeps;
+
+typedef struct TSRpmspecDepsExtractor TSRpmspecDepsExtractor;
+
+// Create an extractor for trees parsed with `language` (tree_sitter_rpmspec()
+// or tree_sitter_rpmspec_lazy_changelog()). The query is compiled once here.
+// Returns NULL if it does not compile against `language`.
+TSRpmspecDepsExtractor *
+tree_sitter_rpmspec_deps_extractor_new(const TSLanguage *language);
+
+void tree_sitter_rpmspec_deps_extractor_delete(TSRpmspecDepsExtractor *self);
+
+// Skip what lies in `ranges`, sorted by start and not overlapping, in the
+// next extractions: the branches of %if, %ifarch and %ifos that are not
+// taken for a target, from tree_sitter_rpmspec_macros_dead_ranges(). The
+// ranges are used in place and must outlive those calls. NULL and 0 go back
+// to extracting every branch.
+void tree_sitter_rpmspec_deps_extractor_set_dead_ranges(
+    TSRpmspecDepsExtractor *self, const TSRange *ranges, uint32_t count);
+
+// Fill `deps` from `tree`, which was parsed from `source`. Only the preamble,
+// %package sections and the conditionals around them are visited; scriptlets,
+// %files, %description and %changelog are skipped without descending into
+// them. All slices point into `source`. Returns false and sets errno if an
+// allocation fails.
+bool tree_sitter_rpmspec_deps_extract(TSRpmspecDepsExtractor *self,
+                                      const TSTree *tree,
+                                      const char *source,
+                                      TSRpmspecDeps *deps);
+
+// Release the arrays of `deps`, not `deps` itself.
+void tree_sitter_rpmspec_deps_free(TSRpmspecDeps *deps);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TREE_SITTER_RPMSPEC_DEPS_H_
@@ -0,0 +1,132 @@
+#ifndef TREE_SITTER_RPMSPEC_FILES_H_
+#define TREE_SITTER_RPMSPEC_FILES_H_
+
+#include <tree_sitter/api.h>
+#include <tree_sitter/tree-sitter-rpmspec-macros.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// An index of the paths that the packages of many specs ship, to answer
+// which package owns a file without walking a single tree.
+//
+// A builder collects the entries of every %files section of the specs it is
+// given and serializes them into a trie of path components in which the
+// children of a directory are sorted, so a lookup is a binary search per
+// component. The serialized index is written in the byte order of the host
+// and is memory-mapped as it is.
+typedef struct TSRpmspecFilesBuilder TSRpmspecFilesBuilder;
+typedef struct TSRpmspecFilesIndex TSRpmspecFilesIndex;
+
+// How an entry is listed in its %files section.
+enum {
+    TSRpmspecFileDir = 1 << 0,      // %dir, the directory without its content
+    TSRpmspecFileDoc = 1 << 1,      // %doc
+    TSRpmspecFileLicense = 1 << 2,  // %license
+    TSRpmspecFileConfig = 1 << 3,   // %config
+    TSRpmspecFileGhost = 1 << 4,    // %ghost
+    TSRpmspecFileExclude = 1 << 5,  // %exclude, left out of the package
+    TSRpmspecFileGlob = 1 << 6,     // The path has *, ? or [...]
+    TSRpmspecFileList = 1 << 7,     // The file list of "%files -f"
+};
+
+typedef struct TSRpmspecFilesOwner {
+    // The name given to tree_sitter_rpmspec_files_builder_add()
+    const char *spec;
+    // The full package name, e.g. "foo-devel" for "%files devel"
+    const char *package;
+    // The entry that matched, e.g. a glob or a parent directory
+    const char *path;
+    uint32_t flags;
+} TSRpmspecFilesOwner;
+
+typedef struct TSRpmspecFilesIndexStats {
+    uint32_t packages;
+    uint32_t entries;    // Paths listed, over all packages
+    uint32_t nodes;      // Path components in the trie
+    uint32_t string_bytes;
+    size_t size;         // Bytes of the serialized index
+} TSRpmspecFilesIndexStats;
+
+// Called for every owner that a lookup finds. The strings are valid until
+// the index is deleted, except `path`, which is valid during the call only.
+// Return false to end the lookup.
+typedef bool (*TSRpmspecFilesCallback)(const TSRpmspecFilesOwner *owner,
+                                       void *payload);
+
+// Create a builder for trees parsed with `language`. Returns NULL if out of
+// memory or `language` lacks a symbol the builder needs.
+TSRpmspecFilesBuilder *
+tree_sitter_rpmspec_files_builder_new(const TSLanguage *language);
+
+void tree_sitter_rpmspec_files_builder_delete(TSRpmspecFilesBuilder *self);
+
+// Record the %files sections of `tree`, which was parsed from `source`,
+// under the name `spec`, e.g. its path. With `macros` loaded from the same
+// tree the paths and package names are expanded, e.g. "%{_libdir}/lib*.so"
+// to "/usr/lib64/lib*.so" once "_libdir" is defined, and the branches of
+// its dead ranges are skipped; with NULL they are indexed as written.
+// Brace alternatives like "{bin,sbin}" are indexed one by one, and relative
+// paths of %doc and %license are indexed as written. Returns false and sets
+// errno if out of memory.
+bool tree_sitter_rpmspec_files_builder_add(TSRpmspecFilesBuilder *self,
+                                           const char *spec,
+                                           const TSTree *tree,
+                                           const char *source,
+                                           TSRpmspecMacros *macros);
+
+// Serialize everything recorded so far into a buffer to release with
+// free(). Returns NULL and sets errno if out of memory or the strings do not
+// fit in 4 GiB.
+void *tree_sitter_rpmspec_files_builder_serialize(TSRpmspecFilesBuilder *self,
+                                                  size_t *size);
+
+// Serialize into the file `path`, replaced in one rename(). Returns false
+// and sets errno on error.
+bool tree_sitter_rpmspec_files_builder_save(TSRpmspecFilesBuilder *self,
+                                            const char *path);
+
+// Map the index file `path`. Returns NULL and sets errno to EINVAL if it is
+// not an index of this version, or as open() and mmap() do.
+TSRpmspecFilesIndex *tree_sitter_rpmspec_files_index_open(const char *path);
+
+// Use `size` bytes at `data` as an index without copying them; they must
+// stay valid and aligned to 8 bytes until the index is deleted.
+TSRpmspecFilesIndex *
+tree_sitter_rpmspec_files_index_from_buffer(const void *data, size_t size);
+
+void tree_sitter_rpmspec_files_index_delete(TSRpmspecFilesIndex *self);
+
+// Call `callback` for every package that ships the file `path`: entries of
+// the path itself, globs that match it, and parent directories listed
+// without %dir, which rpm packages with everything below them. Entries with
+// TSRpmspecFileExclude are reported as well. Returns how many owners were
+// reported.
+uint32_t tree_sitter_rpmspec_files_index_owners(
+    const TSRpmspecFilesIndex *self,
+    const char *path,
+    TSRpmspecFilesCallback callback,
+    void *payload);
+
+// Call `callback` for every entry that matches the glob `pattern`, e.g.
+// "/usr/lib64/libfoo.so*" or "/usr/share/man/*/foo.1*". A "*" does not
+// match across a "/". Parent directories are not reported. Returns how many
+// entries were reported.
+uint32_t tree_sitter_rpmspec_files_index_find(const TSRpmspecFilesIndex *self,
+                                              const char *pattern,
+                                              TSRpmspecFilesCallback callback,
+                                              void *payload);
+
+void tree_sitter_rpmspec_files_index_stats(const TSRpmspecFilesIndex *self,
+                                           TSRpmspecFilesIndexStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TREE_SITTER_RPMSPEC_FILES_H_
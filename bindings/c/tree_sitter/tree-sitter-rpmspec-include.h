@@ -0,0 +1,81 @@
+#ifndef TREE_SITTER_RPMSPEC_INCLUDE_H_
+#define TREE_SITTER_RPMSPEC_INCLUDE_H_
+
+#include <tree_sitter/api.h>
+#include <tree_sitter/tree-sitter-rpmspec-macros.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Resolves the macro fragments a spec pulls in with %include, %load and
+// %{load:...}, and parses each fragment once however many specs of a run
+// include it. A fragment is identified by its device and inode, so the
+// same file reached through different paths is parsed once as well.
+//
+// Only the directives of the spec itself are resolved; the directives of a
+// fragment are resolved by passing its tree and source back in. Directives
+// in the body of a %define or %global are not followed, since rpm only
+// runs them when the macro is used.
+typedef struct TSRpmspecIncludeResolver TSRpmspecIncludeResolver;
+
+typedef struct TSRpmspecFragment {
+    const char *path;    // Path the fragment was read from
+    const char *source;  // Its contents, NUL-terminated
+    uint32_t length;     // Length of `source`
+    TSTree *tree;        // A ts_tree_copy() of the shared tree
+    TSRange directive;   // The %include or %load of the spec
+    bool load;           // %load or %{load:...} rather than %include
+} TSRpmspecFragment;
+
+typedef struct TSRpmspecIncludeStats {
+    uint32_t parsed;     // Distinct fragments read and parsed
+    uint64_t hits;       // Directives resolved to a fragment parsed before
+    uint64_t missing;    // Directives naming a file that cannot be read
+    uint64_t unresolved; // Directives whose target still has a macro
+} TSRpmspecIncludeStats;
+
+// Fragments are parsed as `language`. Returns NULL if out of memory.
+TSRpmspecIncludeResolver *
+tree_sitter_rpmspec_include_resolver_new(const TSLanguage *language);
+
+// Fragment trees handed out stay valid, their paths and sources do not.
+void tree_sitter_rpmspec_include_resolver_delete(
+    TSRpmspecIncludeResolver *self);
+
+// Find the directives of `tree`, which was parsed from `source`, and
+// return the fragment of each in source order in `*fragments`, to release
+// with tree_sitter_rpmspec_include_fragments_free(). Relative targets are
+// taken relative to `base_dir`, or to the working directory if it is NULL.
+//
+// With a `macros` table loaded from `tree`, targets such as
+// %{_sourcedir}/macros.foo are expanded first and the directives in the
+// branches tree_sitter_rpmspec_macros_dead_ranges() lists are skipped.
+// `macros` may be NULL, which only resolves literal targets. Directives
+// that cannot be resolved are counted in the stats and left out.
+//
+// Returns false and sets errno if out of memory or a fragment fails to
+// parse.
+bool tree_sitter_rpmspec_include_resolve(TSRpmspecIncludeResolver *self,
+                                         const TSTree *tree,
+                                         const char *source,
+                                         const char *base_dir,
+                                         TSRpmspecMacros *macros,
+                                         TSRpmspecFragment **fragments,
+                                         uint32_t *count);
+
+// Delete the tree copies of `fragments` and the array itself.
+void tree_sitter_rpmspec_include_fragments_free(TSRpmspecFragment *fragments,
+                                                uint32_t count);
+
+void tree_sitter_rpmspec_include_stats(const TSRpmspecIncludeResolver *self,
+                                       TSRpmspecIncludeStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TREE_SITTER_RPMSPEC_INCLUDE_H_
@@ -0,0 +1,37 @@
+#ifndef TREE_SITTER_RPMSPEC_INPUT_H_
+#define TREE_SITTER_RPMSPEC_INPUT_H_
+
+#include <tree_sitter/api.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Statistics about a single parse.
+typedef struct TSRpmspecParseStats {
+    uint64_t bytes;
+    uint32_t nodes;
+    uint64_t parse_time_ns;
+    bool has_error;
+} TSRpmspecParseStats;
+
+// Parse the spec file at `path` with `parser`, which must have a language
+// set. The file is memory-mapped and handed to the parser through a TSInput
+// read callback, so it is neither copied nor kept in a heap buffer. The
+// mapping is released before returning; the tree does not reference it.
+//
+// `old_tree` may be NULL, and so may `stats`. Returns NULL and sets errno
+// if the file cannot be read or the parse fails.
+TSTree *tree_sitter_rpmspec_parse_file(TSParser *parser,
+                                       const TSTree *old_tree,
+                                       const char *path,
+                                       TSRpmspecParseStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TREE_SITTER_RPMSPEC_INPUT_H_
@@ -0,0 +1,117 @@
+#ifndef TREE_SITTER_RPMSPEC_MACROS_H_
+#define TREE_SITTER_RPMSPEC_MACROS_H_
+
+#include <tree_sitter/api.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A macro table that previews what rpm would expand, without running rpm.
+//
+// tree_sitter_rpmspec_macros_load() walks a tree once and records %define,
+// %global, %undefine, %bcond*, the Name, Version, Release, Epoch, Summary,
+// License and URL tags of the main package, and the conditional
+// definitions in %{?name:%define ...}. The condition of every %if is
+// expanded and evaluated, and only the taken branch is walked. %ifarch and
+// %ifos are evaluated once a target is set and otherwise walk all of their
+// branches.
+//
+// Expansion is lazy: a definition is expanded the first time it is used
+// and the result is kept until the table changes. Shell expansions %(...),
+// expressions %[...], %{lua:...}, macro arguments and macros that are not
+// defined are kept as written.
+typedef struct TSRpmspecMacros TSRpmspecMacros;
+
+typedef struct TSRpmspecMacrosStats {
+    uint32_t definitions;  // Definitions recorded by the last load
+    uint32_t conditions;   // %if and %elif conditions evaluated
+    uint32_t unresolved_conditions; // Conditions taken as false on error
+    uint64_t expansions;   // Macro values expanded
+    uint64_t memo_hits;    // Macro values taken from the memo
+    uint32_t walked;       // Children of the root walked
+    uint32_t replayed;     // Children of the root replayed by an update
+    uint32_t uses;         // Macros read by the children walked
+} TSRpmspecMacrosStats;
+
+// Returns NULL if out of memory.
+TSRpmspecMacros *tree_sitter_rpmspec_macros_new(void);
+
+void tree_sitter_rpmspec_macros_delete(TSRpmspecMacros *self);
+
+// Define a macro that every load starts from, like `rpm --define`, e.g.
+// "dist" as ".fc40" or "_bindir" as "/usr/bin". Returns false if out of
+// memory.
+bool tree_sitter_rpmspec_macros_define(TSRpmspecMacros *self,
+                                       const char *name,
+                                       const char *body);
+
+// Evaluate %ifarch, %ifnarch, %elifarch, %ifos, %ifnos and %elifos for a
+// target like `rpmbuild --target`, e.g. "x86_64" and "linux". Also
+// predefines %_arch, %_target_cpu, %_os and %_target_os, and the arch
+// groups of rpm (%ix86, %arm, %power64, ...) that are not defined yet. A
+// NULL `arch` or `os` leaves those conditionals unevaluated. Build options
+// are predefined macros as well: `--with docs` is "_with_docs" and
+// `--without tests` is "_without_tests". Returns false if out of memory.
+bool tree_sitter_rpmspec_macros_set_target(TSRpmspecMacros *self,
+                                           const char *arch,
+                                           const char *os);
+
+// Drop what the previous load recorded and record the definitions of
+// `tree`, which was parsed from `source`. The table does not keep
+// references to the tree or the source. Returns false if out of memory.
+bool tree_sitter_rpmspec_macros_load(TSRpmspecMacros *self,
+                                     const TSTree *tree,
+                                     const char *source);
+
+// Bring the table up to date with an edit without walking the whole tree
+// again. `old_tree` is the tree last loaded or updated, edited with
+// ts_tree_edit(), and `new_tree` was parsed from `source` with it.
+//
+// Every child of the root records the macros it defined and read. Children
+// that ts_tree_get_changed_ranges() and ts_node_has_changes() leave alone
+// replay their definitions unless one of the macros they read was defined
+// differently before them; only the others are walked again. Memoized
+// values are kept unless a macro they were expanded from changed. Falls
+// back to a load if the table was not loaded from `old_tree` or a macro was
+// predefined since. Returns false if out of memory.
+bool tree_sitter_rpmspec_macros_update(TSRpmspecMacros *self,
+                                       const TSTree *old_tree,
+                                       const TSTree *new_tree,
+                                       const char *source);
+
+// The bodies of the conditional branches that the last load or update knows
+// are not taken, in source order. A branch whose condition cannot be
+// evaluated is not listed. The ranges are owned by the table and valid
+// until the next load, update or set_target; pass them to
+// tree_sitter_rpmspec_deps_extractor_set_dead_ranges() to skip those
+// branches.
+const TSRange *
+tree_sitter_rpmspec_macros_dead_ranges(const TSRpmspecMacros *self,
+                                       uint32_t *count);
+
+// The expanded value of the macro `name`, owned by the table and valid
+// until the next define or load. NULL if it is not defined.
+const char *tree_sitter_rpmspec_macros_get(TSRpmspecMacros *self,
+                                           const char *name,
+                                           uint32_t *length);
+
+// Expand `length` bytes of `text`, e.g. the source of a node. Returns a
+// NUL-terminated string to release with free(), or NULL if out of memory.
+// `expanded_length` may be NULL.
+char *tree_sitter_rpmspec_macros_expand(TSRpmspecMacros *self,
+                                        const char *text,
+                                        uint32_t length,
+                                        uint32_t *expanded_length);
+
+void tree_sitter_rpmspec_macros_stats(const TSRpmspecMacros *self,
+                                      TSRpmspecMacrosStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TREE_SITTER_RPMSPEC_MACROS_H_
@@ -0,0 +1,132 @@
+#ifndef TREE_SITTER_RPMSPEC_SNAPSHOT_H_
+#define TREE_SITTER_RPMSPEC_SNAPSHOT_H_
+
+#include <tree_sitter/api.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A read-only, serialized copy of a tree that can be memory-mapped and
+// queried without the source being parsed again.
+//
+// A snapshot file is a header followed by one TSRpmspecSnapshotNode per node
+// in pre-order, for every symbol of the language the indices of its nodes,
+// and a copy of the source. It is written in the byte order of the host and
+// records a fingerprint of the symbol and field names of the language and
+// which variant of it, e.g. tree_sitter_rpmspec_lazy_changelog(), made the
+// tree, so a snapshot of a regenerated parser or of another variant is
+// rejected instead of misread.
+typedef struct TSRpmspecSnapshot TSRpmspecSnapshot;
+
+enum {
+    TSRpmspecSnapshotNamed = 1 << 0,
+    TSRpmspecSnapshotExtra = 1 << 1,
+    TSRpmspecSnapshotMissing = 1 << 2,
+    TSRpmspecSnapshotHasError = 1 << 3,
+};
+
+// The node at index `i` spans `start_byte` to `end_byte` and is followed by
+// its `descendant_count` descendants. Its first child, if any, is at `i + 1`
+// and the next sibling of a child `c` is at `c + 1 + descendant_count` of
+// `c`. `field` is the field of the node in its parent, or 0.
+typedef struct TSRpmspecSnapshotNode {
+    uint32_t start_byte;
+    uint32_t end_byte;
+    uint32_t descendant_count;
+    TSSymbol symbol;
+    uint8_t field;
+    uint8_t flags;
+} TSRpmspecSnapshotNode;
+
+typedef struct TSRpmspecSnapshotCacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t rejected; // Snapshots found but stale, corrupt or unreadable
+} TSRpmspecSnapshotCacheStats;
+
+// The content hash that cached snapshots are named after. Two sources with
+// the same hash share a file; the copy of the source decides which one it
+// holds.
+uint64_t tree_sitter_rpmspec_snapshot_hash(const char *source,
+                                           uint32_t length);
+
+// Serialize `tree`, which was parsed from `length` bytes of `source`, into
+// a buffer to release with free(). Returns NULL and sets errno if out of
+// memory or the language has more fields than a snapshot can hold.
+void *tree_sitter_rpmspec_snapshot_serialize(const TSTree *tree,
+                                             const char *source,
+                                             uint32_t length,
+                                             size_t *size);
+
+// Serialize `tree` into the file `path`, replaced in one rename() so that
+// concurrent readers never see a partial file. Returns false and sets errno
+// on error.
+bool tree_sitter_rpmspec_snapshot_save(const TSTree *tree,
+                                       const char *source,
+                                       uint32_t length,
+                                       const char *path);
+
+// Map the snapshot file `path`. Returns NULL and sets errno to ESTALE if it
+// was written for another version of `language`, to EINVAL if it is not a
+// snapshot, or as open() and mmap() do.
+TSRpmspecSnapshot *
+tree_sitter_rpmspec_snapshot_open(const char *path,
+                                  const TSLanguage *language);
+
+// Use `size` bytes at `data` as a snapshot of `language` without copying
+// them; they must stay valid and aligned to 8 bytes until the snapshot is
+// deleted. Errors are those of tree_sitter_rpmspec_snapshot_open().
+TSRpmspecSnapshot *
+tree_sitter_rpmspec_snapshot_from_buffer(const void *data,
+                                         size_t size,
+                                         const TSLanguage *language);
+
+void tree_sitter_rpmspec_snapshot_delete(TSRpmspecSnapshot *self);
+
+// Whether the snapshot was made from `length` bytes of `source`, compared
+// byte for byte.
+bool tree_sitter_rpmspec_snapshot_matches(const TSRpmspecSnapshot *self,
+                                          const char *source,
+                                          uint32_t length);
+
+// The snapshot file for `source` in the directory `directory`, written
+// first by parsing `source` with `parser` if there is none or it is stale.
+// Specs that did not change since they were last seen are never parsed
+// again. Each variant of the language has its own file for a source. `stats` may be NULL. Returns NULL and sets errno on error, but a
+// snapshot that cannot be written to the directory is still returned.
+TSRpmspecSnapshot *
+tree_sitter_rpmspec_snapshot_cache_get(const char *directory,
+                                       TSParser *parser,
+                                       const char *source,
+                                       uint32_t length,
+                                       TSRpmspecSnapshotCacheStats *stats);
+
+// All nodes in pre-order, the root first. Owned by the snapshot.
+const TSRpmspecSnapshotNode *
+tree_sitter_rpmspec_snapshot_nodes(const TSRpmspecSnapshot *self,
+                                   uint32_t *count);
+
+// The indices of the nodes of `symbol` in pre-order, e.g. of
+// ts_language_symbol_for_name(language, "dependency_tag", 14, true). Owned
+// by the snapshot; NULL if there are none. ERROR nodes are listed under
+// ts_builtin_sym_error.
+const uint32_t *
+tree_sitter_rpmspec_snapshot_nodes_of_symbol(const TSRpmspecSnapshot *self,
+                                             TSSymbol symbol,
+                                             uint32_t *count);
+
+// The index of the first child of node `index` in the field `field`, or
+// UINT32_MAX if there is none.
+uint32_t tree_sitter_rpmspec_snapshot_child_by_field(
+    const TSRpmspecSnapshot *self, uint32_t index, TSFieldId field);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TREE_SITTER_RPMSPEC_SNAPSHOT_H_
@@ -9,6 +9,10 @@ extern "C" {
 
 const TSLanguage *tree_sitter_rpmspec(void);
 
+// Same grammar, but every %changelog entry is parsed as a single node
+// without children. Use it when the changelog is not needed.
+const TSLanguage *tree_sitter_rpmspec_lazy_changelog(void);
+
 #ifdef __cplusplus
 }
 #endif
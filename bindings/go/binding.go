@@ -2,7 +2,7 @@ package tree_sitter_rpmspec
 
 // #cgo CFLAGS: -std=c11 -fPIC
 // #include "../../src/parser.c"
-// // NOTE: if your language has an external scanner, add it here.
+// #include "../../src/scanner.c"
 import "C"
 
 import "unsafe"
@@ -11,3 +11,9 @@ import "unsafe"
 func Language() unsafe.Pointer {
 	return unsafe.Pointer(C.tree_sitter_rpmspec())
 }
+
+// Get the lazy changelog variant of the Language, which parses every
+// %changelog entry as a single node without children.
+func LanguageLazyChangelog() unsafe.Pointer {
+	return unsafe.Pointer(C.tree_sitter_rpmspec_lazy_changelog())
+}
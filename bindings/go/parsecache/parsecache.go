@@ -0,0 +1,256 @@
+// Package parsecache shares parsed spec trees between goroutines.
+//
+// A Cache checks parsers out of a pool, keeps the trees it parsed keyed on
+// the SHA-256 of their source and drops the least recently used ones once
+// their estimated size exceeds a bound. Goroutines asking for the same
+// source at the same time wait for a single parse.
+package parsecache
+
+import (
+	"container/list"
+	"crypto/sha256"
+	"errors"
+	"sync"
+	"time"
+
+	tree_sitter "github.com/tree-sitter/go-tree-sitter"
+	tree_sitter_rpmspec "gitlab.com/cryptomilk/tree-sitter-rpmspec/bindings/go"
+)
+
+// DefaultMaxBytes is the size bound of a Cache whose Options leave it 0.
+const DefaultMaxBytes = 64 << 20
+
+// Trees do not report their size. An entry is taken to cost its source and
+// this much per node, which is about what the runtime allocates for a node
+// with children.
+const nodeBytes = 48
+
+// ErrClosed is returned by Parse after Close.
+var ErrClosed = errors.New("parsecache: cache is closed")
+
+// ErrParse is returned when the parser gives up without a tree.
+var ErrParse = errors.New("parsecache: parse failed")
+
+type Options struct {
+	// Language to parse with, Language() of the binding if nil.
+	Language *tree_sitter.Language
+	// Upper bound of the estimated size of the cached trees in bytes.
+	MaxBytes int64
+	// Parsers kept idle in the pool, 4 if 0. More are created under load
+	// and closed when they come back to a full pool.
+	MaxIdleParsers int
+}
+
+type Stats struct {
+	Hits      uint64 // Trees found in the cache
+	Misses    uint64 // Trees parsed
+	Shared    uint64 // Trees another goroutine was parsing already
+	Evictions uint64 // Trees dropped to stay below MaxBytes
+	ParseTime time.Duration
+	Entries   int
+	Bytes     int64 // Estimated size of the cached trees
+}
+
+type key [sha256.Size]byte
+
+type entry struct {
+	key   key
+	tree  *tree_sitter.Tree
+	bytes int64
+}
+
+// A parse in progress that other goroutines can wait for. Each waiter is
+// handed its own copy, because the cached tree may be evicted and closed
+// before a waiter gets to copy it.
+type call struct {
+	done    chan struct{}
+	waiters int
+	trees   chan *tree_sitter.Tree
+	err     error
+}
+
+type Cache struct {
+	language *tree_sitter.Language
+	maxBytes int64
+
+	mu       sync.Mutex
+	lru      list.List // of *entry, most recently used first
+	entries  map[key]*list.Element
+	inflight map[key]*call
+	stats    Stats
+	closed   bool
+
+	// A sync.Pool would drop parsers on garbage collection without
+	// closing them, leaking the memory of the runtime.
+	poolMu     sync.Mutex
+	parsers    []*tree_sitter.Parser
+	maxIdle    int
+	poolClosed bool
+}
+
+func New(options Options) *Cache {
+	c := &Cache{
+		language: options.Language,
+		maxBytes: options.MaxBytes,
+		entries:  make(map[key]*list.Element),
+		inflight: make(map[key]*call),
+		maxIdle:  options.MaxIdleParsers,
+	}
+	if c.language == nil {
+		c.language = tree_sitter.NewLanguage(tree_sitter_rpmspec.Language())
+	}
+	if c.maxBytes <= 0 {
+		c.maxBytes = DefaultMaxBytes
+	}
+	if c.maxIdle <= 0 {
+		c.maxIdle = 4
+	}
+	return c
+}
+
+// Parse returns the tree of source, parsing it only if no tree of the same
+// content is cached. The tree is the caller's own copy and must be closed;
+// it stays valid when the cache drops its entry.
+func (c *Cache) Parse(source []byte) (*tree_sitter.Tree, error) {
+	k := key(sha256.Sum256(source))
+
+	c.mu.Lock()
+	if c.closed {
+		c.mu.Unlock()
+		return nil, ErrClosed
+	}
+	if element, ok := c.entries[k]; ok {
+		c.lru.MoveToFront(element)
+		c.stats.Hits++
+		tree := element.Value.(*entry).tree.Clone()
+		c.mu.Unlock()
+		return tree, nil
+	}
+	if pending, ok := c.inflight[k]; ok {
+		c.stats.Shared++
+		pending.waiters++
+		c.mu.Unlock()
+		<-pending.done
+		if pending.err != nil {
+			return nil, pending.err
+		}
+		return <-pending.trees, nil
+	}
+	pending := &call{done: make(chan struct{})}
+	c.inflight[k] = pending
+	c.stats.Misses++
+	c.mu.Unlock()
+
+	start := time.Now()
+	tree, err := c.parse(source)
+	elapsed := time.Since(start)
+
+	c.mu.Lock()
+	delete(c.inflight, k)
+	c.stats.ParseTime += elapsed
+	pending.err = err
+	if err == nil {
+		pending.trees = make(chan *tree_sitter.Tree, pending.waiters)
+		for i := 0; i < pending.waiters; i++ {
+			pending.trees <- tree.Clone()
+		}
+		if !c.closed {
+			c.insert(k, tree.Clone(), len(source))
+		}
+	}
+	c.mu.Unlock()
+	close(pending.done)
+
+	return tree, err
+}
+
+// Stats returns the counters since the cache was created.
+func (c *Cache) Stats() Stats {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+
+	stats := c.stats
+	stats.Entries = len(c.entries)
+	return stats
+}
+
+// Close drops every cached tree and pooled parser. Trees returned by Parse
+// stay valid.
+func (c *Cache) Close() {
+	c.mu.Lock()
+	c.closed = true
+	for element := c.lru.Front(); element != nil; element = element.Next() {
+		element.Value.(*entry).tree.Close()
+	}
+	c.lru.Init()
+	c.entries = make(map[key]*list.Element)
+	c.stats.Bytes = 0
+	c.mu.Unlock()
+
+	c.poolMu.Lock()
+	for _, parser := range c.parsers {
+		parser.Close()
+	}
+	c.parsers = nil
+	c.poolClosed = true
+	c.poolMu.Unlock()
+}
+
+func (c *Cache) parse(source []byte) (*tree_sitter.Tree, error) {
+	parser, err := c.getParser()
+	if err != nil {
+		return nil, err
+	}
+	tree := parser.Parse(source, nil)
+	c.putParser(parser)
+	if tree == nil {
+		return nil, ErrParse
+	}
+	return tree, nil
+}
+
+// Called with c.mu held.
+func (c *Cache) insert(k key, tree *tree_sitter.Tree, length int) {
+	bytes := int64(length) + int64(tree.RootNode().DescendantCount())*nodeBytes
+
+	c.entries[k] = c.lru.PushFront(&entry{key: k, tree: tree, bytes: bytes})
+	c.stats.Bytes += bytes
+
+	// The newest entry is kept even if it alone is over the bound
+	for c.stats.Bytes > c.maxBytes && c.lru.Len() > 1 {
+		oldest := c.lru.Remove(c.lru.Back()).(*entry)
+		delete(c.entries, oldest.key)
+		c.stats.Bytes -= oldest.bytes
+		c.stats.Evictions++
+		oldest.tree.Close()
+	}
+}
+
+func (c *Cache) getParser() (*tree_sitter.Parser, error) {
+	c.poolMu.Lock()
+	if n := len(c.parsers); n > 0 {
+		parser := c.parsers[n-1]
+		c.parsers = c.parsers[:n-1]
+		c.poolMu.Unlock()
+		return parser, nil
+	}
+	c.poolMu.Unlock()
+
+	parser := tree_sitter.NewParser()
+	if err := parser.SetLanguage(c.language); err != nil {
+		parser.Close()
+		return nil, err
+	}
+	return parser, nil
+}
+
+func (c *Cache) putParser(parser *tree_sitter.Parser) {
+	c.poolMu.Lock()
+	defer c.poolMu.Unlock()
+
+	if c.poolClosed || len(c.parsers) >= c.maxIdle {
+		parser.Close()
+		return
+	}
+	c.parsers = append(c.parsers, parser)
+}
@@ -0,0 +1,88 @@
+package parsecache_test
+
+import (
+	"fmt"
+	"sync"
+	"testing"
+
+	"gitlab.com/cryptomilk/tree-sitter-rpmspec/bindings/go/parsecache"
+)
+
+func spec(name string) []byte {
+	return []byte(fmt.Sprintf("Name: %s\nVersion: 1.0\n", name))
+}
+
+func TestParseIsCached(t *testing.T) {
+	cache := parsecache.New(parsecache.Options{})
+	defer cache.Close()
+
+	for i := 0; i < 3; i++ {
+		tree, err := cache.Parse(spec("foo"))
+		if err != nil {
+			t.Fatal(err)
+		}
+		if kind := tree.RootNode().Kind(); kind != "spec" {
+			t.Errorf("root is %q", kind)
+		}
+		tree.Close()
+	}
+
+	stats := cache.Stats()
+	if stats.Misses != 1 || stats.Hits != 2 || stats.Entries != 1 {
+		t.Errorf("unexpected stats %+v", stats)
+	}
+	if stats.ParseTime <= 0 || stats.Bytes <= 0 {
+		t.Errorf("unexpected stats %+v", stats)
+	}
+}
+
+func TestConcurrentParsesAreShared(t *testing.T) {
+	cache := parsecache.New(parsecache.Options{})
+	defer cache.Close()
+
+	var wg sync.WaitGroup
+	for i := 0; i < 16; i++ {
+		wg.Add(1)
+		go func(i int) {
+			defer wg.Done()
+			tree, err := cache.Parse(spec(fmt.Sprint(i % 4)))
+			if err != nil {
+				t.Error(err)
+				return
+			}
+			tree.Close()
+		}(i)
+	}
+	wg.Wait()
+
+	stats := cache.Stats()
+	if stats.Misses != 4 || stats.Hits+stats.Shared != 12 {
+		t.Errorf("unexpected stats %+v", stats)
+	}
+}
+
+func TestLeastRecentlyUsedIsEvicted(t *testing.T) {
+	cache := parsecache.New(parsecache.Options{MaxBytes: 1})
+	defer cache.Close()
+
+	first, err := cache.Parse(spec("foo"))
+	if err != nil {
+		t.Fatal(err)
+	}
+	second, err := cache.Parse(spec("bar"))
+	if err != nil {
+		t.Fatal(err)
+	}
+
+	// A tree handed out stays valid after its entry is dropped
+	if first.RootNode().Kind() != "spec" {
+		t.Error("evicted tree is not valid")
+	}
+	first.Close()
+	second.Close()
+
+	stats := cache.Stats()
+	if stats.Evictions != 1 || stats.Entries != 1 {
+		t.Errorf("unexpected stats %+v", stats)
+	}
+}
@@ -1,19 +1,192 @@
 #include <napi.h>
 
+#ifdef RPMSPEC_PARSE_ASYNC
+#include <tree_sitter/api.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+#endif
+
 typedef struct TSLanguage TSLanguage;
 
 extern "C" TSLanguage *tree_sitter_rpmspec();
+extern "C" TSLanguage *tree_sitter_rpmspec_lazy_changelog();
 
 // "tree-sitter", "language" hashed with BLAKE2
 const napi_type_tag LANGUAGE_TYPE_TAG = {
   0x8AF2E5212AD58ABF, 0xD5006CAD83ABBA16
 };
 
+#ifdef RPMSPEC_PARSE_ASYNC
+// Every node of a parsed tree takes this many words of the node table, see
+// index.d.ts for the layout.
+constexpr uint32_t NODE_FIELDS = 5;
+constexpr uint32_t NO_PARENT = 0xFFFFFFFF;
+
+enum NodeFlags : uint32_t {
+    NODE_NAMED = 1,
+    NODE_ERROR = 2,
+    NODE_MISSING = 4,
+};
+
+// Parses a source on the libuv thread pool and flattens the tree into a node
+// table, so the main thread only has to copy one buffer.
+class ParseWorker : public Napi::AsyncWorker {
+  public:
+    ParseWorker(Napi::Env env, const TSLanguage *language)
+        : Napi::AsyncWorker(env),
+          deferred_(Napi::Promise::Deferred::New(env)),
+          language_(language) {}
+
+    // JS strings are parsed as UTF-16, so offsets are string indices.
+    void SetSource(std::u16string source) { utf16_ = std::move(source); }
+    void SetSource(std::string source) { utf8_ = std::move(source); }
+
+    Napi::Promise Promise() const { return deferred_.Promise(); }
+
+  protected:
+    void Execute() override {
+        TSParser *parser = ts_parser_new();
+        TSTree *tree = nullptr;
+
+        if (ts_parser_set_language(parser, language_)) {
+            if (!utf16_.empty()) {
+                tree = ts_parser_parse_string_encoding(
+                    parser, nullptr,
+                    reinterpret_cast<const char *>(utf16_.data()),
+                    static_cast<uint32_t>(utf16_.size() * 2),
+                    TSInputEncodingUTF16LE);
+            } else {
+                tree = ts_parser_parse_string(parser, nullptr, utf8_.data(),
+                                              static_cast<uint32_t>(utf8_.size()));
+            }
+        }
+        ts_parser_delete(parser);
+
+        if (tree == nullptr) {
+            SetError("Parsing failed");
+            return;
+        }
+
+        Flatten(ts_tree_root_node(tree));
+        ts_tree_delete(tree);
+    }
+
+    void OnOK() override {
+        Napi::Env env = Env();
+        auto buffer = Napi::ArrayBuffer::New(env, nodes_.size() * sizeof(uint32_t));
+        std::memcpy(buffer.Data(), nodes_.data(), buffer.ByteLength());
+
+        auto result = Napi::Object::New(env);
+        result["hasError"] = Napi::Boolean::New(env, has_error_);
+        result["nodes"] = Napi::Uint32Array::New(env, nodes_.size(), buffer, 0);
+        deferred_.Resolve(result);
+    }
+
+    void OnError(const Napi::Error &error) override {
+        deferred_.Reject(error.Value());
+    }
+
+  private:
+    void Flatten(TSNode root) {
+        uint32_t divisor = utf16_.empty() ? 1 : 2;
+        std::vector<uint32_t> parents;
+
+        has_error_ = ts_node_has_error(root);
+        nodes_.reserve(ts_node_descendant_count(root) * NODE_FIELDS);
+
+        TSTreeCursor cursor = ts_tree_cursor_new(root);
+        for (;;) {
+            TSNode node = ts_tree_cursor_current_node(&cursor);
+            uint32_t flags = (ts_node_is_named(node) ? NODE_NAMED : 0) |
+                             (ts_node_is_error(node) ? NODE_ERROR : 0) |
+                             (ts_node_is_missing(node) ? NODE_MISSING : 0);
+            uint32_t index = static_cast<uint32_t>(nodes_.size() / NODE_FIELDS);
+
+            nodes_.push_back(ts_node_symbol(node));
+            nodes_.push_back(ts_node_start_byte(node) / divisor);
+            nodes_.push_back(ts_node_end_byte(node) / divisor);
+            nodes_.push_back(parents.empty() ? NO_PARENT : parents.back());
+            nodes_.push_back(flags);
+
+            if (ts_tree_cursor_goto_first_child(&cursor)) {
+                parents.push_back(index);
+                continue;
+            }
+            while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+                if (!ts_tree_cursor_goto_parent(&cursor)) {
+                    ts_tree_cursor_delete(&cursor);
+                    return;
+                }
+                parents.pop_back();
+            }
+        }
+    }
+
+    Napi::Promise::Deferred deferred_;
+    const TSLanguage *language_;
+    std::u16string utf16_;
+    std::string utf8_;
+    std::vector<uint32_t> nodes_;
+    bool has_error_ = false;
+};
+
+// _parseAsync(source: string | Buffer, lazyChangelog: boolean): Promise
+Napi::Value ParseAsync(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    bool lazy_changelog = info.Length() > 1 && info[1].ToBoolean();
+    auto *worker = new ParseWorker(env, lazy_changelog
+                                            ? tree_sitter_rpmspec_lazy_changelog()
+                                            : tree_sitter_rpmspec());
+
+    if (info.Length() > 0 && info[0].IsString()) {
+        worker->SetSource(info[0].As<Napi::String>().Utf16Value());
+    } else if (info.Length() > 0 && info[0].IsBuffer()) {
+        auto buffer = info[0].As<Napi::Buffer<char>>();
+        worker->SetSource(std::string(buffer.Data(), buffer.Length()));
+    } else {
+        delete worker;
+        throw Napi::TypeError::New(env, "source must be a string or a Buffer");
+    }
+
+    Napi::Promise promise = worker->Promise();
+    worker->Queue();
+    return promise;
+}
+
+// The names of all node types, indexed by the symbol stored in a node table.
+Napi::Array NodeTypeNames(Napi::Env env, const TSLanguage *language) {
+    uint32_t count = ts_language_symbol_count(language);
+    auto names = Napi::Array::New(env, count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        names[i] = Napi::String::New(env, ts_language_symbol_name(language, i));
+    }
+
+    return names;
+}
+#endif
+
 Napi::Object Init(Napi::Env env, Napi::Object exports) {
     exports["name"] = Napi::String::New(env, "rpmspec");
     auto language = Napi::External<TSLanguage>::New(env, tree_sitter_rpmspec());
     language.TypeTag(&LANGUAGE_TYPE_TAG);
     exports["language"] = language;
+
+    auto lazy_changelog = Napi::Object::New(env);
+    lazy_changelog["name"] = Napi::String::New(env, "rpmspec");
+    auto lazy_changelog_language =
+        Napi::External<TSLanguage>::New(env, tree_sitter_rpmspec_lazy_changelog());
+    lazy_changelog_language.TypeTag(&LANGUAGE_TYPE_TAG);
+    lazy_changelog["language"] = lazy_changelog_language;
+    exports["lazyChangelog"] = lazy_changelog;
+
+#ifdef RPMSPEC_PARSE_ASYNC
+    exports["_parseAsync"] = Napi::Function::New(env, ParseAsync, "parseAsync");
+    exports["_nodeTypeNames"] = NodeTypeNames(env, tree_sitter_rpmspec());
+#endif
+
     return exports;
 }
 
@@ -7,3 +7,18 @@ test("can load grammar", () => {
   const parser = new (require("tree-sitter"))();
   assert.doesNotThrow(() => parser.setLanguage(require(".")));
 });
+
+test("can compile the highlights query", () => {
+  const language = require(".");
+  const query = language.highlightsQuery();
+  assert.strictEqual(query, language.highlightsQuery());
+});
+
+test("can parse asynchronously", { skip: process.platform !== "linux" }, async () => {
+  const language = require(".");
+  const tree = await language.parseAsync("Name: foo\nVersion: 1.0\n");
+  assert.strictEqual(tree.hasError, false);
+  assert.strictEqual(tree.types[tree.nodes[0]], "spec");
+  assert.strictEqual(tree.nodes[2], 23);
+  assert.strictEqual(tree.nodes[3], 0xffffffff);
+});
@@ -18,10 +18,43 @@ type NodeInfo =
       children: ChildNode[];
     });
 
+/**
+ * A tree parsed by `parseAsync()`, flattened into a node table.
+ *
+ * Each node takes five consecutive words of `nodes`, in pre-order: the node
+ * type (an index into `types`), the start and end index, the index of the
+ * parent node (`0xFFFFFFFF` for the root) and flags (1 named, 2 error,
+ * 4 missing). Indices are string indices for a string source and byte
+ * offsets for a Buffer.
+ */
+type ParsedTree = {
+  hasError: boolean;
+  nodes: Uint32Array;
+  types: string[];
+};
+
+type ParseOptions = {
+  /** Parse with the lazy changelog variant. */
+  lazyChangelog?: boolean;
+};
+
 type Language = {
   name: string;
   language: unknown;
   nodeTypeInfo: NodeInfo[];
+  /** The syntax highlighting query. */
+  HIGHLIGHTS_QUERY: string;
+  /** The query injecting bash into scriptlet bodies. */
+  INJECTIONS_QUERY: string;
+  /** The highlights query, compiled once and shared by the process. */
+  highlightsQuery(): import("tree-sitter").Query;
+  /** Parse a spec on the libuv thread pool without blocking the event loop. */
+  parseAsync(source: string | Buffer, options?: ParseOptions): Promise<ParsedTree>;
+  /** Variant that parses every %changelog entry as one node without children. */
+  lazyChangelog: {
+    name: string;
+    language: unknown;
+  };
 };
 
 declare const language: Language;
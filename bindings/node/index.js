@@ -9,3 +9,62 @@ module.exports =
 try {
   module.exports.nodeTypeInfo = require("../../src/node-types.json");
 } catch (_) {}
+
+let highlightsQuery;
+
+Object.defineProperty(module.exports, "HIGHLIGHTS_QUERY", {
+  configurable: true,
+  enumerable: true,
+  get() {
+    const source = require("fs").readFileSync(
+      require("path").join(root, "queries", "highlights.scm"),
+      "utf8",
+    );
+    Object.defineProperty(module.exports, "HIGHLIGHTS_QUERY", {
+      value: source,
+      enumerable: true,
+    });
+    return source;
+  },
+});
+
+Object.defineProperty(module.exports, "INJECTIONS_QUERY", {
+  configurable: true,
+  enumerable: true,
+  get() {
+    const source = require("fs").readFileSync(
+      require("path").join(root, "queries", "injections.scm"),
+      "utf8",
+    );
+    Object.defineProperty(module.exports, "INJECTIONS_QUERY", {
+      value: source,
+      enumerable: true,
+    });
+    return source;
+  },
+});
+
+// Compiling the query is expensive, so it is compiled on first use and
+// shared by the whole process. Requires the tree-sitter peer dependency.
+module.exports.highlightsQuery = function highlightsQuery() {
+  if (highlightsQuery === undefined) {
+    const { Query } = require("tree-sitter");
+    highlightsQuery = new Query(module.exports, module.exports.HIGHLIGHTS_QUERY);
+  }
+  return highlightsQuery;
+};
+
+// Parse on the libuv thread pool. Only available on Linux, where the addon
+// links against the runtime in the addon of the tree-sitter peer dependency.
+module.exports.parseAsync = function parseAsync(source, options = {}) {
+  const binding = module.exports;
+  if (typeof binding._parseAsync !== "function") {
+    return Promise.reject(
+      new Error("parseAsync() is not available, rebuild with tree-sitter installed"),
+    );
+  }
+  return binding._parseAsync(source, !!options.lazyChangelog).then((tree) => {
+    tree.types = binding._nodeTypeNames;
+    return tree;
+  });
+};
@@ -1,3 +1,5 @@
+from os import path
+from tempfile import TemporaryDirectory
 from unittest import TestCase
 
 import tree_sitter, tree_sitter_rpmspec
@@ -9,3 +11,46 @@ class TestLanguage(TestCase):
             tree_sitter.Language(tree_sitter_rpmspec.language())
         except Exception:
             self.fail("Error loading Rpmspec grammar")
+
+    def test_highlights_query(self):
+        query = tree_sitter_rpmspec.highlights_query()
+        self.assertIsInstance(query, tree_sitter.Query)
+        self.assertIs(query, tree_sitter_rpmspec.highlights_query())
+
+    def test_injections_query(self):
+        language = tree_sitter.Language(tree_sitter_rpmspec.language())
+        tree_sitter.Query(language, tree_sitter_rpmspec.INJECTIONS_QUERY)
+
+    def test_parse_many(self):
+        with TemporaryDirectory() as tmp:
+            paths = []
+            for name in ("a.spec", "b.spec", "c.spec"):
+                paths.append(path.join(tmp, name))
+                with open(paths[-1], "w") as f:
+                    f.write(f"Name: {name[0]}\nVersion: 1.0\n")
+
+            trees = tree_sitter_rpmspec.parse_many(paths, workers=2)
+            self.assertEqual(len(trees), 3)
+            self.assertEqual(trees[1].root_node.text, b"Name: b\nVersion: 1.0\n")
+
+            summaries = tree_sitter_rpmspec.parse_many(paths, summary=True)
+            self.assertEqual([s["path"] for s in summaries], paths)
+            self.assertFalse(any(s["has_error"] for s in summaries))
+
+    def test_lazy_changelog(self):
+        parser = tree_sitter.Parser(
+            tree_sitter.Language(tree_sitter_rpmspec.language_lazy_changelog())
+        )
+        tree = parser.parse(
+            b"%changelog\n"
+            b"* Fri Jun 21 2002 Alice <alice@alice.com> - 1.0-1\n"
+            b"- first entry\n"
+            b"* Thu Jun 20 2002 Alice <alice@alice.com> - 0.9-1\n"
+            b"- second entry\n"
+        )
+        changelog = tree.root_node.children[0]
+        entries = [
+            child for child in changelog.children if child.type == "changelog_entry"
+        ]
+        self.assertEqual(len(entries), 2)
+        self.assertTrue(all(entry.child_count == 0 for entry in entries))
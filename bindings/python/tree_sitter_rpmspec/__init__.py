@@ -1,5 +1,59 @@
 "Rpmspec grammar for tree-sitter"
 
-from ._binding import language
+from importlib.resources import files as _files
+from threading import Lock as _Lock
 
-__all__ = ["language"]
+from ._binding import language, language_lazy_changelog
+from ._parse import parse_many
+
+_highlights_query = None
+_highlights_query_lock = _Lock()
+
+
+def _get_query(name, file):
+    query = _files(f"{__package__}.queries") / file
+    globals()[name] = query.read_text()
+    return globals()[name]
+
+
+def __getattr__(name):
+    if name == "HIGHLIGHTS_QUERY":
+        return _get_query("HIGHLIGHTS_QUERY", "highlights.scm")
+    if name == "INJECTIONS_QUERY":
+        return _get_query("INJECTIONS_QUERY", "injections.scm")
+
+    raise AttributeError(f"module {__name__!r} has no attribute {name!r}")
+
+
+def highlights_query():
+    """Get the compiled highlights query.
+
+    The query is compiled on first use and shared by the whole process.
+    Requires the ``tree-sitter`` package (the ``core`` extra).
+    """
+    global _highlights_query
+
+    with _highlights_query_lock:
+        if _highlights_query is None:
+            from tree_sitter import Language, Query
+
+            source = _get_query("HIGHLIGHTS_QUERY", "highlights.scm")
+            _highlights_query = Query(Language(language()), source)
+    return _highlights_query
+
+
+__all__ = [
+    "language",
+    "language_lazy_changelog",
+    "highlights_query",
+    "parse_many",
+    "HIGHLIGHTS_QUERY",
+    "INJECTIONS_QUERY",
+]
+
+
+def __dir__():
+    return sorted(__all__ + [
+        "__all__", "__builtins__", "__cached__", "__doc__", "__file__",
+        "__loader__", "__name__", "__package__", "__path__", "__spec__",
+    ])
@@ -1 +1,27 @@
+from os import PathLike
+from typing import Any, Final, Iterable, Literal, overload
+
+from tree_sitter import Query, Tree
+
+HIGHLIGHTS_QUERY: Final[str]
+INJECTIONS_QUERY: Final[str]
+
 def language() -> int: ...
+def language_lazy_changelog() -> int: ...
+def highlights_query() -> Query: ...
+
+@overload
+def parse_many(
+    paths: Iterable[str | PathLike[str]],
+    workers: int | None = None,
+    summary: Literal[False] = False,
+    lazy_changelog: bool = False,
+) -> list[Tree]: ...
+@overload
+def parse_many(
+    paths: Iterable[str | PathLike[str]],
+    workers: int | None = None,
+    *,
+    summary: Literal[True],
+    lazy_changelog: bool = False,
+) -> list[dict[str, Any]]: ...
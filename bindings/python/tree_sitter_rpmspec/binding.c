@@ -4,10 +4,16 @@ typedef struct TSLanguage TSLanguage;
 
 TSLanguage *tree_sitter_rpmspec(void);
 
+TSLanguage *tree_sitter_rpmspec_lazy_changelog(void);
+
 static PyObject* _binding_language(PyObject *Py_UNUSED(self), PyObject *Py_UNUSED(args)) {
     return PyCapsule_New(tree_sitter_rpmspec(), "tree_sitter.Language", NULL);
 }
 
+static PyObject* _binding_language_lazy_changelog(PyObject *Py_UNUSED(self), PyObject *Py_UNUSED(args)) {
+    return PyCapsule_New(tree_sitter_rpmspec_lazy_changelog(), "tree_sitter.Language", NULL);
+}
+
 static struct PyModuleDef_Slot slots[] = {
 #ifdef Py_GIL_DISABLED
     {Py_mod_gil, Py_MOD_GIL_NOT_USED},
@@ -18,6 +24,8 @@ static struct PyModuleDef_Slot slots[] = {
 static PyMethodDef methods[] = {
     {"language", _binding_language, METH_NOARGS,
      "Get the tree-sitter language for this grammar."},
+    {"language_lazy_changelog", _binding_language_lazy_changelog, METH_NOARGS,
+     "Get the language variant that parses %changelog entries as opaque nodes."},
     {NULL, NULL, 0, NULL}
 };
 
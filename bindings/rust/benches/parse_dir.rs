@@ -0,0 +1,60 @@
+//! Throughput of `parse_dir()` by number of threads, in specs per second.
+//!
+//! Parses the corpus of `bench/fetch-corpus.sh`, or the directory or file
+//! named by `RPMSPEC_BENCH_CORPUS`, once per iteration on pools of 1 to 64
+//! threads:
+//!
+//! ```sh
+//! cargo bench --features parallel --bench parse_dir
+//! ```
+
+use std::path::PathBuf;
+
+use criterion::{criterion_group, criterion_main, BenchmarkId, Criterion, Throughput};
+
+const THREADS: &[usize] = &[1, 2, 4, 8, 16, 32, 64];
+
+fn corpus() -> PathBuf {
+    match std::env::var_os("RPMSPEC_BENCH_CORPUS") {
+        Some(path) => PathBuf::from(path),
+        None => {
+            let root = PathBuf::from(env!("CARGO_MANIFEST_DIR"));
+            let corpus = root.join("bench/corpus");
+            if corpus.is_dir() {
+                corpus
+            } else {
+                root.join("example.spec")
+            }
+        }
+    }
+}
+
+fn parse_dir(c: &mut Criterion) {
+    let corpus = corpus();
+    // A first pass brings the corpus into the page cache
+    let specs = tree_sitter_rpmspec::parse_dir(&corpus)
+        .expect("Error walking the corpus")
+        .filter(|spec| spec.is_ok())
+        .count();
+    assert!(specs > 0, "no spec files found, see bench/README.md");
+
+    let mut group = c.benchmark_group("parse_dir");
+    group.throughput(Throughput::Elements(specs as u64));
+    group.sample_size(10);
+    for &threads in THREADS {
+        let pool = rayon::ThreadPoolBuilder::new()
+            .num_threads(threads)
+            .build()
+            .expect("Error building the thread pool");
+        group.bench_with_input(BenchmarkId::from_parameter(threads), &pool, |b, pool| {
+            b.iter(|| {
+                let parsed = tree_sitter_rpmspec::parse_dir_in(pool, &corpus).unwrap();
+                assert_eq!(parsed.filter(|spec| spec.is_ok()).count(), specs);
+            })
+        });
+    }
+    group.finish();
+}
+
+criterion_group!(benches, parse_dir);
+criterion_main!(benches);
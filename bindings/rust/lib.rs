@@ -22,25 +22,56 @@
 
 use tree_sitter_language::LanguageFn;
 
+#[cfg(feature = "parallel")]
+pub mod parallel;
+#[cfg(feature = "parallel")]
+pub use parallel::{parse_dir, parse_dir_in};
+
 extern "C" {
     fn tree_sitter_rpmspec() -> *const ();
+    fn tree_sitter_rpmspec_lazy_changelog() -> *const ();
 }
 
 /// The tree-sitter [`LanguageFn`] for this grammar.
 pub const LANGUAGE: LanguageFn = unsafe { LanguageFn::from_raw(tree_sitter_rpmspec) };
 
+/// A variant of [`LANGUAGE`] that parses every `%changelog` entry as a single
+/// `changelog_entry` node without children.
+///
+/// Use it when the changelog is not needed, e.g. to extract dependencies.
+pub const LANGUAGE_LAZY_CHANGELOG: LanguageFn =
+    unsafe { LanguageFn::from_raw(tree_sitter_rpmspec_lazy_changelog) };
+
 /// The content of the [`node-types.json`][] file for this grammar.
 ///
 /// [`node-types.json`]: https://tree-sitter.github.io/tree-sitter/using-parsers#static-node-types
 pub const NODE_TYPES: &str = include_str!("../../src/node-types.json");
 
+/// The syntax highlighting query for this grammar.
+pub const HIGHLIGHTS_QUERY: &str = include_str!("../../queries/highlights.scm");
+
+/// The language injection query for this grammar, which injects bash into
+/// scriptlet bodies and `%(...)` expansions, one injection per scriptlet.
+pub const INJECTIONS_QUERY: &str = include_str!("../../queries/injections.scm");
+
 // NOTE: uncomment these to include any queries that this grammar contains:
 
-// pub const HIGHLIGHTS_QUERY: &str = include_str!("../../queries/highlights.scm");
-// pub const INJECTIONS_QUERY: &str = include_str!("../../queries/injections.scm");
 // pub const LOCALS_QUERY: &str = include_str!("../../queries/locals.scm");
 // pub const TAGS_QUERY: &str = include_str!("../../queries/tags.scm");
 
+/// The compiled [`HIGHLIGHTS_QUERY`].
+///
+/// Compiling the query is expensive, so it is compiled on first use and shared
+/// by the whole process. Requires the `query-cache` feature.
+#[cfg(feature = "query-cache")]
+pub fn highlights_query() -> &'static tree_sitter::Query {
+    static QUERY: std::sync::OnceLock<tree_sitter::Query> = std::sync::OnceLock::new();
+    QUERY.get_or_init(|| {
+        tree_sitter::Query::new(&LANGUAGE.into(), HIGHLIGHTS_QUERY)
+            .expect("Error compiling the highlights query")
+    })
+}
+
 #[cfg(test)]
 mod tests {
     #[test]
@@ -50,4 +81,70 @@ mod tests {
             .set_language(&super::LANGUAGE.into())
             .expect("Error loading Rpmspec parser");
     }
+
+    #[test]
+    fn test_highlights_query() {
+        tree_sitter::Query::new(&super::LANGUAGE.into(), super::HIGHLIGHTS_QUERY)
+            .expect("Error compiling the highlights query");
+    }
+
+    #[test]
+    fn test_injections_query() {
+        tree_sitter::Query::new(&super::LANGUAGE.into(), super::INJECTIONS_QUERY)
+            .expect("Error compiling the injections query");
+    }
+
+    #[cfg(feature = "query-cache")]
+    #[test]
+    fn test_highlights_query_cache() {
+        assert!(std::ptr::eq(
+            super::highlights_query(),
+            super::highlights_query()
+        ));
+    }
+
+    #[cfg(feature = "parallel")]
+    #[test]
+    fn test_parse_dir() {
+        let dir = std::env::temp_dir().join(format!("rpmspec-parse-dir-{}", std::process::id()));
+        std::fs::create_dir_all(dir.join("sub")).unwrap();
+        std::fs::write(dir.join("a.spec"), "Name: a\n").unwrap();
+        std::fs::write(dir.join("sub/b.spec"), "Name: b\n").unwrap();
+        std::fs::write(dir.join("empty.spec"), "").unwrap();
+        std::fs::write(dir.join("README"), "not a spec").unwrap();
+
+        let parsed = super::parse_dir(&dir).unwrap();
+        assert_eq!(parsed.len(), 3);
+        let mut names = parsed
+            .map(|spec| {
+                let spec = spec.unwrap();
+                assert!(!spec.tree.root_node().has_error());
+                assert_eq!(spec.tree.root_node().end_byte(), spec.source().len());
+                spec.path.file_name().unwrap().to_owned()
+            })
+            .collect::<Vec<_>>();
+        names.sort();
+        assert_eq!(names, ["a.spec", "b.spec", "empty.spec"]);
+
+        std::fs::remove_dir_all(&dir).unwrap();
+    }
+
+    #[test]
+    fn test_lazy_changelog() {
+        let mut parser = tree_sitter::Parser::new();
+        parser
+            .set_language(&super::LANGUAGE_LAZY_CHANGELOG.into())
+            .expect("Error loading Rpmspec parser");
+        let tree = parser
+            .parse(
+                "%changelog\n\
+                 * Fri Jun 21 2002 Alice <alice@alice.com> - 1.0-1\n\
+                 - first entry\n",
+                None,
+            )
+            .unwrap();
+        let entry = tree.root_node().child(0).unwrap().child(1).unwrap();
+        assert_eq!(entry.kind(), "changelog_entry");
+        assert_eq!(entry.child_count(), 0);
+    }
 }
@@ -0,0 +1,175 @@
+//! Parsing every spec file of a directory tree on a [rayon][] thread pool.
+//!
+//! Each worker thread keeps one [`Parser`] for the lifetime of the pool, and
+//! files are memory-mapped instead of read into a buffer. Parsed files are
+//! streamed back in the order they finish, so a caller can start on the first
+//! trees while the rest are still being parsed.
+//!
+//! [rayon]: https://docs.rs/rayon
+
+use std::cell::RefCell;
+use std::fs::{self, File};
+use std::io;
+use std::path::{Path, PathBuf};
+use std::sync::mpsc;
+use std::time::{Duration, Instant};
+
+use memmap2::Mmap;
+use rayon::prelude::*;
+use rayon::ThreadPool;
+use tree_sitter::{Parser, Tree};
+
+/// Parsed files waiting to be taken off the iterator, per worker thread.
+const QUEUED_PER_THREAD: usize = 4;
+
+thread_local! {
+    static PARSER: RefCell<Option<Parser>> = const { RefCell::new(None) };
+}
+
+/// A spec file parsed by [`parse_dir`].
+pub struct ParsedSpec {
+    /// The path of the file.
+    pub path: PathBuf,
+    /// The tree, which references byte offsets into [`ParsedSpec::source`].
+    pub tree: Tree,
+    /// The time spent in the parser, without reading the file.
+    pub parse_time: Duration,
+    source: Option<Mmap>,
+}
+
+impl ParsedSpec {
+    /// The content of the file, still mapped.
+    pub fn source(&self) -> &[u8] {
+        self.source.as_deref().unwrap_or(&[])
+    }
+}
+
+/// The results of [`parse_dir`], one item per spec file in the order they
+/// were parsed.
+pub struct ParseDir {
+    receiver: mpsc::IntoIter<io::Result<ParsedSpec>>,
+    len: usize,
+}
+
+impl ParseDir {
+    /// The number of spec files found.
+    pub fn len(&self) -> usize {
+        self.len
+    }
+
+    /// Whether no spec file was found.
+    pub fn is_empty(&self) -> bool {
+        self.len == 0
+    }
+}
+
+impl Iterator for ParseDir {
+    type Item = io::Result<ParsedSpec>;
+
+    fn next(&mut self) -> Option<Self::Item> {
+        self.receiver.next()
+    }
+}
+
+/// Parse every `*.spec` file below `path`, or `path` itself if it is a file,
+/// on the global rayon pool.
+///
+/// A file that cannot be read yields an error item and the other files are
+/// still parsed. Returns an error only if the directory tree cannot be
+/// walked. The workers wait while the iterator is not consumed, so it must
+/// not be consumed from a thread of the same pool.
+pub fn parse_dir<P: AsRef<Path>>(path: P) -> io::Result<ParseDir> {
+    let paths = collect(path.as_ref())?;
+    let threads = rayon::current_num_threads();
+    Ok(spawn(paths, threads, rayon::spawn))
+}
+
+/// Like [`parse_dir`], on `pool` instead of the global pool.
+pub fn parse_dir_in<P: AsRef<Path>>(pool: &ThreadPool, path: P) -> io::Result<ParseDir> {
+    let paths = collect(path.as_ref())?;
+    Ok(spawn(paths, pool.current_num_threads(), |job| {
+        pool.spawn(job)
+    }))
+}
+
+fn spawn<F>(paths: Vec<PathBuf>, threads: usize, spawner: F) -> ParseDir
+where
+    F: FnOnce(Box<dyn FnOnce() + Send>),
+{
+    let len = paths.len();
+    let (sender, receiver) = mpsc::sync_channel(threads * QUEUED_PER_THREAD);
+
+    spawner(Box::new(move || {
+        // A send only fails once the iterator was dropped; the remaining
+        // files are then parsed for nothing, but stop being queued.
+        paths.into_par_iter().for_each_with(sender, |sender, path| {
+            let _ = sender.send(parse_file(path));
+        });
+    }));
+
+    ParseDir {
+        receiver: receiver.into_iter(),
+        len,
+    }
+}
+
+fn parse_file(path: PathBuf) -> io::Result<ParsedSpec> {
+    let file = File::open(&path)?;
+    // mmap() rejects empty mappings, an empty file parses from "".
+    let source = if file.metadata()?.len() > 0 {
+        // SAFETY: the mapping is read-only; a file truncated while mapped
+        // raises SIGBUS, as with any mmap() of files that others may change.
+        Some(unsafe { Mmap::map(&file)? })
+    } else {
+        None
+    };
+    let bytes = source.as_deref().unwrap_or(&[]);
+
+    let start = Instant::now();
+    let tree = PARSER.with(|parser| {
+        let mut parser = parser.borrow_mut();
+        let parser = parser.get_or_insert_with(|| {
+            let mut parser = Parser::new();
+            parser
+                .set_language(&crate::LANGUAGE.into())
+                .expect("Error loading Rpmspec parser");
+            parser
+        });
+        parser.parse(bytes, None)
+    });
+    let parse_time = start.elapsed();
+
+    let tree = tree.ok_or_else(|| io::Error::new(io::ErrorKind::Other, "parse failed"))?;
+    Ok(ParsedSpec {
+        path,
+        tree,
+        parse_time,
+        source,
+    })
+}
+
+/// The spec files below `path`, sorted so runs are comparable.
+fn collect(path: &Path) -> io::Result<Vec<PathBuf>> {
+    let mut paths = Vec::new();
+    if fs::metadata(path)?.is_dir() {
+        walk(path, &mut paths)?;
+        paths.sort();
+    } else {
+        paths.push(path.to_path_buf());
+    }
+    Ok(paths)
+}
+
+fn walk(dir: &Path, paths: &mut Vec<PathBuf>) -> io::Result<()> {
+    for entry in fs::read_dir(dir)? {
+        let entry = entry?;
+        let path = entry.path();
+        let file_type = entry.file_type()?;
+        if file_type.is_dir() {
+            walk(&path, paths)?;
+        } else if file_type.is_file() && path.extension().map_or(false, |ext| ext == "spec") {
+            paths.push(path);
+        }
+    }
+    Ok(())
+}
@@ -55,11 +55,28 @@ const BLANK = /( |\t)+/; // One or more spaces or tabs
 module.exports = grammar({
     name: 'rpmspec',
 
+    // Tokens produced by the external scanner in src/scanner.c
+    externals: ($) => [
+        $._shell_content, // Raw shell text in scriptlet bodies
+        $._changelog_entry_text, // Whole changelog entry (lazy changelog only)
+        $._tag_name, // Preamble tag names: Name, Version, Source0, ...
+        $._dependency_tag_name, // Provides, Conflicts, BuildArch, ...
+        $._qualified_dependency_tag_name, // Requires and BuildRequires
+        $._builtin_name, // Builtin macro names: basename, dirname, ...
+        $._tag_value, // Tag values of several words without macros
+        $._endif, // %endif up to the end of its line
+        $._error_sentinel, // Only valid during error recovery
+    ],
+
     // Grammar conflicts resolution
     conflicts: ($) => [
-        [$.expression, $.tags],
-        [$.shell_block, $.string],
-        [$._macro_expansion_call_nested],
+        // Inline calls do not end at a newline, so their last argument
+        // cannot be told apart from the rest of the macro body. prec.right
+        // on the builtin variant resolves the shift/reduce choices between
+        // its arguments and the body statically, and generate then builds
+        // no fork for this entry. The entry stays for the argument kinds
+        // the precedence does not reach: generate only warns about an
+        // unused conflict, but fails on a needed one that is not declared.
         [$.macro_expansion_call_inline],
     ],
 
@@ -247,39 +264,9 @@ module.exports = grammar({
             choice(
                 $.macro_source,
                 $.macro_patch,
-                'basename',
-                'dirname',
-                'dnl',
-                'dump',
-                'echo',
-                'error',
-                'exists',
-                'expand',
-                'expr',
-                'getdirconf',
-                'getenv',
-                'getncpus',
-                'gsub',
-                'len',
-                'load',
-                'lower',
-                'lua',
-                'macrobody',
-                'quote',
-                'rep',
-                'reverse',
-                'rpmversion',
-                'shrink',
-                'sub',
-                'suffix',
-                'trace',
-                'u2p',
-                'shescape',
-                'uncompress',
-                'upper',
-                'url2path',
-                'verbose',
-                'warn'
+                // basename, dirname, dnl, dump, echo, error, expand, lua, ...
+                // See builtin_names in src/scanner.c
+                $._builtin_name
             ),
 
         macro_source: ($) =>
@@ -362,14 +349,22 @@ module.exports = grammar({
                         token.immediate(NEWLINE)
                     ),
                     // Builtin macros with arguments - require space after builtin
-                    seq(
-                        optional(field('operator', token.immediate('!'))),
-                        $.builtin,
-                        token.immediate(BLANK),
-                        repeat1(
-                            choice(
-                                field('option', $.macro_option),
-                                field('argument', $._macro_argument)
+                    //
+                    // Like rpm, the call takes the rest of the body as its
+                    // arguments. Resolving this statically keeps the parser
+                    // from forking at every argument and comparing the
+                    // nested expansions of both versions when they merge,
+                    // which grows with the nesting depth.
+                    prec.right(
+                        seq(
+                            optional(field('operator', token.immediate('!'))),
+                            $.builtin,
+                            token.immediate(BLANK),
+                            repeat1(
+                                choice(
+                                    field('option', $.macro_option),
+                                    field('argument', $._call_argument)
+                                )
                             )
                         )
                     ),
@@ -381,7 +376,7 @@ module.exports = grammar({
                         repeat1(
                             choice(
                                 field('option', $.macro_option),
-                                field('argument', $._macro_argument)
+                                field('argument', $._call_argument)
                             )
                         ),
                         token.immediate(NEWLINE)
@@ -411,7 +406,7 @@ module.exports = grammar({
                         repeat1(
                             choice(
                                 field('option', $.macro_option),
-                                field('argument', $._macro_argument)
+                                field('argument', $._call_argument)
                             )
                         )
                     ),
@@ -423,7 +418,7 @@ module.exports = grammar({
                         repeat1(
                             choice(
                                 field('option', $.macro_option),
-                                field('argument', $._macro_argument)
+                                field('argument', $._call_argument)
                             )
                         )
                     )
@@ -452,10 +447,19 @@ module.exports = grammar({
                 )
             ),
 
+        // Arguments of calls that are not terminated by a newline. Every
+        // argument is a single primary expression: allowing concatenations
+        // here made every split of "a b c" into arguments a valid parse and
+        // the parser forked at each argument.
+        _call_argument: ($) => $._primary_expression,
+
         // Macro arguments: values that can be passed to parametric macros
         // Excludes newlines to stop parsing at line end
-        _macro_argument: ($) =>
-            choice($.macro_simple_expansion, $.macro_expansion, $._literal),
+        //
+        // Macro expansions are reached through _primary_expression, which
+        // always won the reduce/reduce conflict thanks to its precedence.
+        // Listing them here again only duplicated every argument state.
+        _macro_argument: ($) => $._literal,
 
         //// Complex Macro Expansion: %{name}
         //
@@ -830,6 +834,13 @@ module.exports = grammar({
             ),
 
         // %if
+        //
+        // %endif is lexed by the scanner together with the end of its line,
+        // which may be the end of the file. A missing %endif is then
+        // recovered by inserting one MISSING token in front of whatever
+        // cannot continue the block (the end of the file, a stray token),
+        // instead of turning the whole block into an ERROR node, and text
+        // after %endif on the same line is still an error.
         if_statement: ($) =>
             seq(
                 '%if',
@@ -838,8 +849,7 @@ module.exports = grammar({
                 optional(field('consequence', $._conditional_block)),
                 repeat(field('alternative', $.elif_clause)),
                 optional(field('alternative', $.else_clause)),
-                '%endif',
-                token.immediate(NEWLINE)
+                alias($._endif, '%endif')
             ),
 
         elif_clause: ($) =>
@@ -875,8 +885,7 @@ module.exports = grammar({
                 optional(field('consequence', $._conditional_block)),
                 repeat(field('alternative', $.elifarch_clause)),
                 optional(field('alternative', $.else_clause)),
-                '%endif',
-                token.immediate(NEWLINE)
+                alias($._endif, '%endif')
             ),
 
         elifarch_clause: ($) =>
@@ -905,8 +914,7 @@ module.exports = grammar({
                 optional(field('consequence', $._conditional_block)),
                 repeat(field('alternative', $.elifos_clause)),
                 optional(field('alternative', $.else_clause)),
-                '%endif',
-                token.immediate(NEWLINE)
+                alias($._endif, '%endif')
             ),
 
         elifos_clause: ($) =>
@@ -942,6 +950,11 @@ module.exports = grammar({
         // Preamble: wrapper for tag-value pairs in the package header
         preamble: ($) => seq($.tags),
 
+        // A tag value of several plain words, lexed by the scanner in one
+        // piece. It holds blanks, like the text of a %description, so it is
+        // text rather than a word.
+        _tag_text: ($) => alias($._tag_value, $.text_content),
+
         // Tag-value pairs: the fundamental structure of RPM preamble
         // Format: "Tag: value" or "Tag(qualifier): value"
         // Examples:
@@ -951,23 +964,27 @@ module.exports = grammar({
         tags: ($) =>
             choice(
                 // Regular tags (Source, Name, etc.) - only support literals
+                //
+                // Values of several words without macros, quotes or escapes,
+                // like most Summary lines, are one token from the scanner,
+                // parsed as (text (text_content)) like a %description line
+                // instead of a concatenation of one word per token.
                 seq(
                     $.tag, // Tag name
                     token.immediate(/:( |\t)*/), // Colon separator with optional whitespace
-                    field('value', $._literal), // Simple values (can contain macros)
+                    field(
+                        'value',
+                        choice(alias($._tag_text, $.text), $._literal)
+                    ), // Simple values (can contain macros)
                     token.immediate(NEWLINE) // Must end with newline
                 ),
                 // Dependency tags - support both expressions and literals
                 seq(
                     $.dependency_tag, // Dependency tag name (with optional qualifier)
                     token.immediate(/:( |\t)*/), // Colon separator with optional whitespace
-                    field(
-                        'value',
-                        choice(
-                            $.expression, // For dependencies with version operators
-                            $._literal // For simple values (can contain macros)
-                        )
-                    ),
+                    // Expressions include plain literals, a separate _literal
+                    // choice only made the parser fork on every value
+                    field('value', $.expression),
                     token.immediate(NEWLINE) // Must end with newline
                 )
             ),
@@ -975,43 +992,11 @@ module.exports = grammar({
         // Standard RPM tags: core package metadata fields
         // These are the fundamental tags recognized by RPM
         tag: ($) =>
-            choice(
-                // Automatic dependency generation control
-                'AutoProv', // Enable/disable automatic Provides generation
-                'AutoReq', // Enable/disable automatic Requires generation
-                'AutoReqProv', // Enable/disable both AutoReq and AutoProv
-
-                // Package identity and versioning
-                'Name', // Package name (required)
-                'Version', // Package version (required)
-                'Release', // Package release number (required)
-                'Epoch', // Version epoch for upgrade ordering
-
-                // Descriptive metadata
-                'Summary', // One-line package description (required)
-                'License', // Package license (required)
-                'URL', // Project homepage URL
-                'Url', // Alternative spelling of URL
-                'BugUrl', // Bug reporting URL
-                'Packager', // Person/organization who packaged it
-                'Vendor', // Vendor/distributor information
-                'Group', // Package category (deprecated)
-
-                // Build and distribution metadata
-                'BuildRoot', // Build root directory (deprecated)
-                'BuildSystem', // Build system identifier
-                'Distribution', // Target distribution
-                'DistTag', // Distribution tag
-                'ModularityLabel', // Modularity metadata
-                'VCS', // Version control system info
-                'SourceLicense', // License for source code
-
-                // Source and patch control
-                'NoPatch', // Disable specific patches
-                'NoSource', // Exclude sources from SRPM
-                /Patch\d*/, // Patch files: Patch0, Patch1, etc.
-                /Source\d*/ // Source files: Source0, Source1, etc.
-            ),
+            // Package identity (Name, Version, Release, Epoch), descriptive
+            // metadata (Summary, License, URL, ...), build and distribution
+            // metadata, source control (NoSource, Source0, Patch1, ...).
+            // See tag_names in src/scanner.c
+            $._tag_name,
 
         // Dependency qualifiers: specify when dependencies are needed
         // Used with Requires tag to indicate timing of dependency check
@@ -1033,44 +1018,15 @@ module.exports = grammar({
         // These tags specify dependencies, conflicts, and build constraints
         dependency_tag: ($) =>
             choice(
-                // Runtime dependencies (with optional qualifier)
-                seq('Requires', optional(seq('(', $.qualifier, ')'))),
-
-                // Build-time dependencies (with optional qualifier)
-                seq('BuildRequires', optional(seq('(', $.qualifier, ')'))),
-
-                // Build-time dependencies and constraints
-                'BuildRequires', // Packages needed to build this package
-                'BuildConflicts', // Packages that conflict during build
-                'BuildPreReq', // Build prerequisites (deprecated)
-
-                // Architecture specifications
-                'BuildArch', // Target architecture for build
-                'BuildArchitectures', // Multiple target architectures
-                'ExcludeArch', // Architectures to exclude
-                'ExclusiveArch', // Only build on these architectures
-                'ExcludeOS', // Operating systems to exclude
-                'ExclusiveOS', // Only build on these operating systems
-
-                // Package relationships
-                'Provides', // Virtual packages this provides
-                'Conflicts', // Packages this conflicts with
-                'Obsoletes', // Packages this makes obsolete
-                'Requires', // Runtime dependencies
-                'Prereq', // Prerequisites (deprecated)
-                'OrderWithRequires', // Ordering dependency
-
-                // Weak dependencies (suggestions)
-                'Recommends', // Recommended packages
-                'Suggests', // Suggested packages
-                'Supplements', // Supplement other packages
-                'Enhances', // Enhance other packages
-
-                // Installation and documentation
-                'DocDir', // Documentation directory
-                'Prefix', // Installation prefix
-                'Prefixes', // Multiple installation prefixes
-                'RemovePathPostfixes' // Path postfixes to remove
+                // Runtime and build-time dependencies (with optional qualifier)
+                seq(
+                    $._qualified_dependency_tag_name,
+                    optional(seq('(', $.qualifier, ')'))
+                ),
+                // Build constraints, architectures, package relationships,
+                // weak dependencies and installation prefixes.
+                // See tag_names in src/scanner.c
+                $._dependency_tag_name
             ),
 
         ///////////////////////////////////////////////////////////////////////
@@ -1148,11 +1104,17 @@ module.exports = grammar({
                         $.patch_macro, // %patch with specific option support
                         $.macro_expansion_call, // %name [options] [args] - higher precedence when has args
                         $.macro_simple_expansion, // %name - simple expansion
-                        prec(-1, $.string) // Raw shell command text
+                        alias($._shell_text, $.string) // Raw shell command text
                     )
                 )
             ),
 
+        // Shell text: raw shell lines up to the next macro, section or
+        // comment. The external scanner lexes it as a single token, so long
+        // scriptlets neither go through the DFA line by line nor fork the
+        // parser between shell_block and string.
+        _shell_text: ($) => alias($._shell_content, $.string_content),
+
         // %prep scriptlet: prepare source code for building
         // Typically contains %setup (extract sources) and %patch (apply patches)
         // First scriptlet executed in build process
@@ -1568,9 +1530,20 @@ module.exports = grammar({
                     token(seq('%changelog', /[ \t]*/, NEWLINE)),
                     $.section_name
                 ),
-                repeat($.changelog_entry)
+                repeat(
+                    choice(
+                        $.changelog_entry,
+                        alias($._opaque_changelog_entry, $.changelog_entry)
+                    )
+                )
             ),
 
+        // Opaque changelog entry: the external scanner of the lazy changelog
+        // language (tree_sitter_rpmspec_lazy_changelog) lexes the whole entry
+        // as one token, so it has no children. The default language never
+        // produces it.
+        _opaque_changelog_entry: ($) => seq($._changelog_entry_text),
+
         // * Tue May 31 2016 Adam Miller <maxamillion@fedoraproject.org> - 0.1-1
         // * Fri Jun 21 2002 Bob Marley <marley@redhat.com>
 
@@ -1962,6 +1935,7 @@ module.exports = grammar({
         // Word tokens: unquoted identifiers and simple values
         // Excludes whitespace and special characters that have syntactic meaning
         // Used for simple identifiers, paths, and unquoted string values
+        // Tag values of several plain words are text instead, see _tag_text
         word: ($) => token(/([^\s"#%{}()<>|&\\])+/),
 
         // String concatenation: automatic joining of adjacent expressions
@@ -0,0 +1,365 @@
+/*
+ * Bump allocator for batch parsing
+ */
+
+#include <tree_sitter/tree-sitter-rpmspec-arena.h>
+
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_DEFAULT_BLOCK_SIZE (1024 * 1024)
+
+/*
+ * Every allocation starts with a header naming the arena it came from, or
+ * NULL for malloc(). The runtime frees and reallocates through the same
+ * functions, so they can tell the two apart.
+ */
+union header {
+    struct {
+        TSRpmspecArena *arena;
+        size_t size;
+    } h;
+    max_align_t align;
+};
+
+struct block {
+    struct block *next;
+    size_t size;
+    size_t used;
+    alignas(max_align_t) unsigned char data[];
+};
+
+struct TSRpmspecArena {
+    struct block *blocks;
+    size_t block_size;
+    size_t used;
+    size_t peak;
+};
+
+static _Thread_local TSRpmspecArena *current_arena;
+
+static size_t
+align_size(size_t size)
+{
+    const size_t align = alignof(max_align_t);
+
+    return (size + align - 1) & ~(align - 1);
+}
+
+static union header *
+header_of(void *ptr)
+{
+    return (union header *)ptr - 1;
+}
+
+static void *
+arena_take(TSRpmspecArena *arena, size_t size)
+{
+    size_t total = sizeof(union header) + align_size(size);
+    struct block *block = arena->blocks;
+    union header *header;
+
+    if (total < size) {
+        return NULL;
+    }
+    if (block == NULL || block->size - block->used < total) {
+        size_t block_size = arena->block_size;
+
+        if (block_size < total) {
+            block_size = total;
+        }
+        if (block_size > SIZE_MAX - sizeof(*block)) {
+            return NULL;
+        }
+        block = malloc(sizeof(*block) + block_size);
+        if (block == NULL) {
+            return NULL;
+        }
+        block->next = arena->blocks;
+        block->size = block_size;
+        block->used = 0;
+        arena->blocks = block;
+    }
+
+    header = (union header *)(block->data + block->used);
+    header->h.arena = arena;
+    header->h.size = size;
+    block->used += total;
+
+    arena->used += total;
+    if (arena->used > arena->peak) {
+        arena->peak = arena->used;
+    }
+
+    return header + 1;
+}
+
+/* Give the space back if `ptr` is the last allocation of the block */
+static void
+arena_give_back(TSRpmspecArena *arena, void *ptr)
+{
+    union header *header = header_of(ptr);
+    size_t total = sizeof(union header) + align_size(header->h.size);
+    struct block *block = arena->blocks;
+
+    if (block != NULL &&
+        (unsigned char *)header + total == block->data + block->used) {
+        block->used -= total;
+        arena->used -= total;
+    }
+}
+
+static void *
+arena_malloc(size_t size)
+{
+    union header *header;
+
+    if (current_arena != NULL) {
+        return arena_take(current_arena, size);
+    }
+
+    if (size > SIZE_MAX - sizeof(*header)) {
+        return NULL;
+    }
+    header = malloc(sizeof(*header) + size);
+    if (header == NULL) {
+        return NULL;
+    }
+    header->h.arena = NULL;
+    header->h.size = size;
+
+    return header + 1;
+}
+
+static void *
+arena_calloc(size_t count, size_t size)
+{
+    void *ptr;
+
+    if (size != 0 && count > SIZE_MAX / size) {
+        return NULL;
+    }
+
+    /* Arena blocks are reused after a reset, they are not zeroed */
+    ptr = arena_malloc(count * size);
+    if (ptr != NULL) {
+        memset(ptr, 0, count * size);
+    }
+
+    return ptr;
+}
+
+static void
+arena_free(void *ptr)
+{
+    union header *header;
+
+    if (ptr == NULL) {
+        return;
+    }
+
+    header = header_of(ptr);
+    if (header->h.arena == NULL) {
+        free(header);
+    } else if (header->h.arena == current_arena) {
+        /* Anything else is released by the reset */
+        arena_give_back(current_arena, ptr);
+    }
+}
+
+static void *
+arena_realloc(void *ptr, size_t size)
+{
+    union header *header;
+    void *new_ptr;
+
+    if (ptr == NULL) {
+        return arena_malloc(size);
+    }
+
+    header = header_of(ptr);
+    if (header->h.arena == NULL) {
+        if (size > SIZE_MAX - sizeof(*header)) {
+            return NULL;
+        }
+        header = realloc(header, sizeof(*header) + size);
+        if (header == NULL) {
+            return NULL;
+        }
+        header->h.size = size;
+        return header + 1;
+    }
+
+    if (size <= header->h.size) {
+        return ptr;
+    }
+
+    /* Grow the last allocation of the block in place */
+    if (header->h.arena == current_arena) {
+        struct block *block = current_arena->blocks;
+        size_t old_total = sizeof(*header) + align_size(header->h.size);
+        size_t new_total = sizeof(*header) + align_size(size);
+
+        if (block != NULL &&
+            (unsigned char *)header + old_total == block->data + block->used &&
+            new_total > size &&
+            block->size - block->used >= new_total - old_total) {
+            block->used += new_total - old_total;
+            current_arena->used += new_total - old_total;
+            if (current_arena->used > current_arena->peak) {
+                current_arena->peak = current_arena->used;
+            }
+            header->h.size = size;
+            return ptr;
+        }
+    }
+
+    new_ptr = arena_malloc(size);
+    if (new_ptr == NULL) {
+        return NULL;
+    }
+    memcpy(new_ptr, ptr, header->h.size);
+    arena_free(ptr);
+
+    return new_ptr;
+}
+
+void
+tree_sitter_rpmspec_arena_install(void)
+{
+    ts_set_allocator(arena_malloc, arena_calloc, arena_realloc, arena_free);
+}
+
+void
+tree_sitter_rpmspec_arena_uninstall(void)
+{
+    ts_set_allocator(NULL, NULL, NULL, NULL);
+}
+
+void
+tree_sitter_rpmspec_arena_free(void *ptr)
+{
+    arena_free(ptr);
+}
+
+TSRpmspecArena *
+tree_sitter_rpmspec_arena_new(size_t block_size)
+{
+    TSRpmspecArena *self = calloc(1, sizeof(*self));
+
+    if (self == NULL) {
+        return NULL;
+    }
+    self->block_size = block_size > 0 ? block_size : ARENA_DEFAULT_BLOCK_SIZE;
+
+    return self;
+}
+
+static void
+free_blocks(struct block *block)
+{
+    while (block != NULL) {
+        struct block *next = block->next;
+
+        free(block);
+        block = next;
+    }
+}
+
+void
+tree_sitter_rpmspec_arena_delete(TSRpmspecArena *self)
+{
+    if (self == NULL) {
+        return;
+    }
+    if (current_arena == self) {
+        current_arena = NULL;
+    }
+    free_blocks(self->blocks);
+    free(self);
+}
+
+TSRpmspecArena *
+tree_sitter_rpmspec_arena_enter(TSRpmspecArena *self)
+{
+    TSRpmspecArena *previous = current_arena;
+
+    current_arena = self;
+
+    return previous;
+}
+
+void
+tree_sitter_rpmspec_arena_reset(TSRpmspecArena *self)
+{
+    struct block *block = self->blocks;
+    size_t reserved = 0;
+
+    self->used = 0;
+    if (block == NULL) {
+        return;
+    }
+    if (block->next == NULL) {
+        block->used = 0;
+        return;
+    }
+
+    /* Replace the blocks by one that holds all of them */
+    for (; block != NULL; block = block->next) {
+        reserved += block->size;
+    }
+    free_blocks(self->blocks);
+    self->blocks = NULL;
+    if (reserved > SIZE_MAX - sizeof(*self->blocks)) {
+        return;
+    }
+    self->blocks = malloc(sizeof(*self->blocks) + reserved);
+    if (self->blocks != NULL) {
+        self->blocks->next = NULL;
+        self->blocks->size = reserved;
+        self->blocks->used = 0;
+    }
+}
+
+void
+tree_sitter_rpmspec_arena_stats(const TSRpmspecArena *self,
+                                TSRpmspecArenaStats *stats)
+{
+    const struct block *block;
+
+    stats->used = self->used;
+    stats->peak = self->peak;
+    stats->reserved = 0;
+    stats->blocks = 0;
+    for (block = self->blocks; block != NULL; block = block->next) {
+        stats->reserved += block->size;
+        stats->blocks++;
+    }
+}
+
+TSTree *
+tree_sitter_rpmspec_arena_parse(TSRpmspecArena *self,
+                                const TSLanguage *language,
+                                const char *source,
+                                uint32_t length)
+{
+    TSRpmspecArena *previous;
+    TSParser *parser;
+    TSTree *tree = NULL;
+
+    previous = tree_sitter_rpmspec_arena_enter(self);
+
+    parser = ts_parser_new();
+    if (parser != NULL) {
+        if (ts_parser_set_language(parser, language)) {
+            tree = ts_parser_parse_string(parser, NULL, source, length);
+        }
+        ts_parser_delete(parser);
+    }
+
+    tree_sitter_rpmspec_arena_enter(previous);
+
+    return tree;
+}
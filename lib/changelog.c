@@ -0,0 +1,776 @@
+/*
+ * Extracting the ids mentioned in %changelog entries into columns
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <tree_sitter/tree-sitter-rpmspec-changelog.h>
+
+#include "common.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/*
+ * The date is the first child of a header and the version-release its last
+ * changelog_version. Captures come in the order of the source, so the ids of
+ * an entry follow its date and version.
+ */
+static const char changelog_query[] =
+    "(changelog_header . (changelog_date) @date)\n"
+    "(changelog_header (changelog_version) @version)\n"
+    "(changelog_text [(changelog_cve) (changelog_bdu) (changelog_mfsa)\n"
+    "                 (changelog_ove) (changelog_bugid)] @id)\n";
+
+enum changelog_symbol {
+    SYM_PREAMBLE,
+    SYM_TAGS,
+    SYM_TAG,
+    SYM_CHANGELOG,
+    SYM_CVE,
+    SYM_BDU,
+    SYM_MFSA,
+    SYM_OVE,
+    SYM_BUGID,
+    SYM_MAX,
+};
+
+static const char *const changelog_symbol_names[SYM_MAX] = {
+    [SYM_PREAMBLE] = "preamble",
+    [SYM_TAGS] = "tags",
+    [SYM_TAG] = "tag",
+    [SYM_CHANGELOG] = "changelog",
+    [SYM_CVE] = "changelog_cve",
+    [SYM_BDU] = "changelog_bdu",
+    [SYM_MFSA] = "changelog_mfsa",
+    [SYM_OVE] = "changelog_ove",
+    [SYM_BUGID] = "changelog_bugid",
+};
+
+static const char *const month_names[12] = {
+    "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec",
+};
+
+/* The dictionary of the "kind" column, in TSRpmspecChangelogIdKind order */
+static const int32_t kind_offsets[] = {0, 3, 6, 10, 13, 16};
+static const char kind_names[] = "CVEBDUMFSAOVEBUG";
+#define KIND_COUNT 5
+
+/* Buffers of empty columns, Arrow wants them set */
+static const int32_t empty_buffer[1];
+
+#define COLUMN_COUNT 6
+
+struct TSRpmspecChangelogExtractor {
+    TSQuery *query;
+    TSQueryCursor *cursor;
+    uint32_t date_capture;
+    uint32_t version_capture;
+    uint32_t id_capture;
+    TSFieldId value_field;
+    TSSymbol symbols[SYM_MAX];
+};
+
+struct changelog_state {
+    TSRpmspecChangelogExtractor *self;
+    const char *source;
+    TSRpmspecChangelogBatch *batch;
+    const char *package;
+    uint32_t package_length;
+    int32_t package_index;
+    int32_t date;
+    uint32_t version_start;
+    uint32_t version_length;
+};
+
+static bool
+capture_id(const TSQuery *query, const char *name, uint32_t *id)
+{
+    uint32_t count = ts_query_capture_count(query);
+    uint32_t i;
+
+    for (i = 0; i < count; i++) {
+        uint32_t length;
+        const char *capture = ts_query_capture_name_for_id(query, i, &length);
+
+        if (length == strlen(name) && memcmp(capture, name, length) == 0) {
+            *id = i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+TSRpmspecChangelogExtractor *
+tree_sitter_rpmspec_changelog_extractor_new(const TSLanguage *language)
+{
+    TSRpmspecChangelogExtractor *self;
+    TSQueryError error;
+    uint32_t offset;
+
+    self = calloc(1, sizeof(*self));
+    if (self == NULL) {
+        return NULL;
+    }
+
+    if (!rpmspec_resolve_symbols(language, changelog_symbol_names,
+                                 self->symbols, SYM_MAX)) {
+        goto fail;
+    }
+    self->value_field = ts_language_field_id_for_name(language, "value", 5);
+    if (self->value_field == 0) {
+        goto fail;
+    }
+
+    self->query = ts_query_new(language, changelog_query,
+                               (uint32_t)(sizeof(changelog_query) - 1),
+                               &offset, &error);
+    if (self->query == NULL ||
+        !capture_id(self->query, "date", &self->date_capture) ||
+        !capture_id(self->query, "version", &self->version_capture) ||
+        !capture_id(self->query, "id", &self->id_capture)) {
+        goto fail;
+    }
+
+    self->cursor = ts_query_cursor_new();
+    if (self->cursor == NULL) {
+        goto fail;
+    }
+
+    return self;
+
+fail:
+    tree_sitter_rpmspec_changelog_extractor_delete(self);
+    return NULL;
+}
+
+void
+tree_sitter_rpmspec_changelog_extractor_delete(
+    TSRpmspecChangelogExtractor *self)
+{
+    if (self == NULL) {
+        return;
+    }
+    if (self->cursor != NULL) {
+        ts_query_cursor_delete(self->cursor);
+    }
+    if (self->query != NULL) {
+        ts_query_delete(self->query);
+    }
+    free(self);
+}
+
+static void
+strings_free(TSRpmspecStringColumn *column)
+{
+    free(column->offsets);
+    free(column->data);
+    memset(column, 0, sizeof(*column));
+}
+
+void
+tree_sitter_rpmspec_changelog_batch_clear(TSRpmspecChangelogBatch *batch)
+{
+    batch->rows = 0;
+    batch->version.count = 0;
+    batch->id.count = 0;
+    batch->packages.count = 0;
+}
+
+void
+tree_sitter_rpmspec_changelog_batch_free(TSRpmspecChangelogBatch *batch)
+{
+    free(batch->package);
+    free(batch->date);
+    free(batch->kind);
+    free(batch->row);
+    strings_free(&batch->version);
+    strings_free(&batch->id);
+    strings_free(&batch->packages);
+    memset(batch, 0, sizeof(*batch));
+}
+
+static bool
+grow_rows(TSRpmspecChangelogBatch *batch)
+{
+    uint32_t capacity;
+
+    if (batch->rows < batch->row_capacity) {
+        return true;
+    }
+    if (batch->row_capacity > UINT32_MAX / 2) {
+        errno = EOVERFLOW;
+        return false;
+    }
+
+    /* The capacity only grows once every column has grown */
+    capacity = batch->row_capacity > 0 ? batch->row_capacity * 2 : 256;
+    if (!rpmspec_resize((void **)&batch->package, capacity,
+                        sizeof(*batch->package)) ||
+        !rpmspec_resize((void **)&batch->date, capacity,
+                        sizeof(*batch->date)) ||
+        !rpmspec_resize((void **)&batch->kind, capacity,
+                        sizeof(*batch->kind)) ||
+        !rpmspec_resize((void **)&batch->row, capacity,
+                        sizeof(*batch->row))) {
+        return false;
+    }
+    batch->row_capacity = capacity;
+
+    return true;
+}
+
+static bool
+append_string(TSRpmspecStringColumn *column, const char *text, uint32_t length)
+{
+    uint32_t used = column->count > 0 ? (uint32_t)column->offsets[column->count]
+                                      : 0;
+    uint32_t capacity;
+
+    if (length > (uint32_t)INT32_MAX - used) {
+        errno = EOVERFLOW;
+        return false;
+    }
+
+    if (column->count + 2 > column->offset_capacity) {
+        capacity = column->offset_capacity > 0 ? column->offset_capacity * 2
+                                               : 256;
+        if (capacity < column->offset_capacity ||
+            !rpmspec_resize((void **)&column->offsets, capacity,
+                            sizeof(*column->offsets))) {
+            return false;
+        }
+        column->offset_capacity = capacity;
+    }
+    if (used + length > column->data_capacity) {
+        capacity = column->data_capacity > 0 ? column->data_capacity : 4096;
+        while (capacity < used + length) {
+            capacity = capacity > UINT32_MAX / 2 ? UINT32_MAX : capacity * 2;
+        }
+        if (!rpmspec_resize((void **)&column->data, capacity, 1)) {
+            return false;
+        }
+        column->data_capacity = capacity;
+    }
+
+    memcpy(column->data + used, text, length);
+    column->offsets[0] = 0;
+    column->offsets[column->count + 1] = (int32_t)(used + length);
+    column->count++;
+
+    return true;
+}
+
+/* Days since 1970-01-01 of a proleptic Gregorian date */
+static int32_t
+days_from_civil(int32_t year, int32_t month, int32_t day)
+{
+    int32_t era;
+    int32_t year_of_era;
+    int32_t day_of_year;
+    int32_t day_of_era;
+
+    year -= month <= 2;
+    era = (year >= 0 ? year : year - 399) / 400;
+    year_of_era = year - era * 400;
+    day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 +
+                 day_of_year;
+
+    return era * 146097 + day_of_era - 719468;
+}
+
+/* The next field of blanks separated text, empty at the end */
+static const char *
+next_field(const char **text, const char *end, size_t *length)
+{
+    const char *field;
+
+    while (*text < end && (**text == ' ' || **text == '\t')) {
+        (*text)++;
+    }
+    field = *text;
+    while (*text < end && **text != ' ' && **text != '\t') {
+        (*text)++;
+    }
+    *length = (size_t)(*text - field);
+
+    return field;
+}
+
+static int32_t
+parse_number(const char *text, size_t length)
+{
+    int32_t number = 0;
+    size_t i;
+
+    for (i = 0; i < length && i < 4 && text[i] >= '0' && text[i] <= '9';
+         i++) {
+        number = number * 10 + (text[i] - '0');
+    }
+
+    return number;
+}
+
+/* "* Tue May 31 2016", as the changelog_date token has it */
+static int32_t
+parse_date(const char *text, uint32_t length)
+{
+    const char *end = text + length;
+    const char *field;
+    size_t field_length;
+    int32_t month = 1;
+    int32_t day;
+    int32_t i;
+
+    /* Skip "*" and the day of the week */
+    next_field(&text, end, &field_length);
+    next_field(&text, end, &field_length);
+
+    field = next_field(&text, end, &field_length);
+    for (i = 0; i < 12; i++) {
+        if (field_length == 3 && memcmp(field, month_names[i], 3) == 0) {
+            month = i + 1;
+            break;
+        }
+    }
+    field = next_field(&text, end, &field_length);
+    day = parse_number(field, field_length);
+    field = next_field(&text, end, &field_length);
+
+    return days_from_civil(parse_number(field, field_length), month, day);
+}
+
+static bool
+add_id(struct changelog_state *state, TSNode node)
+{
+    TSRpmspecChangelogBatch *batch = state->batch;
+    const TSSymbol *symbols = state->self->symbols;
+    TSSymbol symbol = ts_node_symbol(node);
+    uint32_t start = ts_node_start_byte(node);
+    uint32_t length = ts_node_end_byte(node) - start;
+    TSRpmspecChangelogIdKind kind;
+
+    if (symbol == symbols[SYM_CVE]) {
+        kind = TSRpmspecChangelogCve;
+    } else if (symbol == symbols[SYM_BDU]) {
+        kind = TSRpmspecChangelogBdu;
+    } else if (symbol == symbols[SYM_MFSA]) {
+        kind = TSRpmspecChangelogMfsa;
+    } else if (symbol == symbols[SYM_OVE]) {
+        kind = TSRpmspecChangelogOve;
+    } else {
+        kind = TSRpmspecChangelogBug;
+    }
+
+    /* "(CVE-2024-1234)," leaves the punctuation in the token */
+    while (length > 0 && (state->source[start + length - 1] == ')' ||
+                          state->source[start + length - 1] == ',' ||
+                          state->source[start + length - 1] == '.')) {
+        length--;
+    }
+
+    /* The package is only recorded once the spec has an id */
+    if (state->package_index < 0) {
+        if (!append_string(&batch->packages, state->package,
+                           state->package_length)) {
+            return false;
+        }
+        state->package_index = (int32_t)batch->packages.count - 1;
+    }
+
+    if (!grow_rows(batch) ||
+        !append_string(&batch->version, state->source + state->version_start,
+                       state->version_length)) {
+        return false;
+    }
+    if (!append_string(&batch->id, state->source + start, length)) {
+        batch->version.count--;
+        return false;
+    }
+
+    batch->package[batch->rows] = state->package_index;
+    batch->date[batch->rows] = state->date;
+    batch->kind[batch->rows] = (int8_t)kind;
+    batch->row[batch->rows] = ts_node_start_point(node).row;
+    batch->rows++;
+
+    return true;
+}
+
+static bool
+extract_section(struct changelog_state *state, TSNode changelog)
+{
+    TSRpmspecChangelogExtractor *self = state->self;
+    uint32_t capture_index;
+    TSQueryMatch match;
+
+    ts_query_cursor_exec(self->cursor, self->query, changelog);
+    while (ts_query_cursor_next_capture(self->cursor, &match,
+                                        &capture_index)) {
+        TSQueryCapture capture = match.captures[capture_index];
+        uint32_t start = ts_node_start_byte(capture.node);
+        uint32_t length = ts_node_end_byte(capture.node) - start;
+
+        if (capture.index == self->date_capture) {
+            state->date = parse_date(state->source + start, length);
+            state->version_start = 0;
+            state->version_length = 0;
+        } else if (capture.index == self->version_capture) {
+            state->version_start = start;
+            state->version_length = length;
+        } else if (!add_id(state, capture.node)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* The value of the Name tag of a preamble, as written */
+static bool
+find_name(struct changelog_state *state, TSNode preamble)
+{
+    const TSSymbol *symbols = state->self->symbols;
+    uint32_t count = ts_node_named_child_count(preamble);
+    uint32_t i;
+
+    for (i = 0; i < count; i++) {
+        TSNode tags = ts_node_named_child(preamble, i);
+        TSNode tag = ts_node_named_child(tags, 0);
+        TSNode value;
+        uint32_t start;
+
+        if (ts_node_symbol(tags) != symbols[SYM_TAGS] ||
+            ts_node_symbol(tag) != symbols[SYM_TAG] ||
+            ts_node_end_byte(tag) - ts_node_start_byte(tag) != 4 ||
+            strncasecmp(state->source + ts_node_start_byte(tag), "Name", 4) !=
+                0) {
+            continue;
+        }
+        value = ts_node_child_by_field_id(tags, state->self->value_field);
+        if (ts_node_is_null(value)) {
+            continue;
+        }
+        start = ts_node_start_byte(value);
+        state->package = state->source + start;
+        state->package_length = ts_node_end_byte(value) - start;
+        return true;
+    }
+
+    return false;
+}
+
+bool
+tree_sitter_rpmspec_changelog_extract(TSRpmspecChangelogExtractor *self,
+                                      const TSTree *tree,
+                                      const char *source,
+                                      const char *package,
+                                      TSRpmspecChangelogBatch *batch)
+{
+    struct changelog_state state = {
+        .self = self,
+        .source = source,
+        .batch = batch,
+        .package = package != NULL ? package : "",
+        .package_length = package != NULL ? (uint32_t)strlen(package) : 0,
+        .package_index = -1,
+    };
+    TSNode root = ts_tree_root_node(tree);
+    uint32_t count = ts_node_named_child_count(root);
+    bool named = package != NULL;
+    uint32_t i;
+
+    /* Sections are children of the root, the preamble comes first */
+    for (i = 0; i < count; i++) {
+        TSNode child = ts_node_named_child(root, i);
+        TSSymbol symbol = ts_node_symbol(child);
+
+        if (!named && symbol == self->symbols[SYM_PREAMBLE]) {
+            named = find_name(&state, child);
+        } else if (symbol == self->symbols[SYM_CHANGELOG] &&
+                   !extract_section(&state, child)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Export. Every array and schema of the interface owns a private node that
+ * holds its buffers and the storage of its children and dictionary, so a
+ * consumer that moves a child out only leaves a released struct behind.
+ */
+
+struct export_array {
+    const void *buffers[3];
+    void *owned[2];
+    struct ArrowArray *child_pointers[COLUMN_COUNT];
+    struct ArrowArray children[COLUMN_COUNT];
+    struct ArrowArray dictionary;
+};
+
+struct export_schema {
+    struct ArrowSchema *child_pointers[COLUMN_COUNT];
+    struct ArrowSchema children[COLUMN_COUNT];
+    struct ArrowSchema dictionary;
+};
+
+static void
+release_array(struct ArrowArray *array)
+{
+    struct export_array *node = array->private_data;
+    int64_t i;
+
+    for (i = 0; i < array->n_children; i++) {
+        if (array->children[i]->release != NULL) {
+            array->children[i]->release(array->children[i]);
+        }
+    }
+    if (array->dictionary != NULL && array->dictionary->release != NULL) {
+        array->dictionary->release(array->dictionary);
+    }
+    free(node->owned[0]);
+    free(node->owned[1]);
+    free(node);
+    array->release = NULL;
+}
+
+static void
+release_schema(struct ArrowSchema *schema)
+{
+    struct export_schema *node = schema->private_data;
+    int64_t i;
+
+    for (i = 0; i < schema->n_children; i++) {
+        if (schema->children[i]->release != NULL) {
+            schema->children[i]->release(schema->children[i]);
+        }
+    }
+    if (schema->dictionary != NULL && schema->dictionary->release != NULL) {
+        schema->dictionary->release(schema->dictionary);
+    }
+    free(node);
+    schema->release = NULL;
+}
+
+static struct export_array *
+init_array(struct ArrowArray *array, int64_t length, int64_t n_buffers)
+{
+    struct export_array *node = calloc(1, sizeof(*node));
+    int64_t i;
+
+    memset(array, 0, sizeof(*array));
+    if (node == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    for (i = 0; i < n_buffers; i++) {
+        node->buffers[i] = empty_buffer;
+    }
+    node->buffers[0] = NULL;
+    array->length = length;
+    array->n_buffers = n_buffers;
+    array->buffers = node->buffers;
+    array->private_data = node;
+    array->release = release_array;
+
+    return node;
+}
+
+static struct export_schema *
+init_schema(struct ArrowSchema *schema, const char *format, const char *name)
+{
+    struct export_schema *node = calloc(1, sizeof(*node));
+
+    memset(schema, 0, sizeof(*schema));
+    if (node == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    schema->format = format;
+    schema->name = name;
+    schema->private_data = node;
+    schema->release = release_schema;
+
+    return node;
+}
+
+/* A utf8 array that takes the buffers of `column`, which may be empty */
+static void
+move_strings(struct ArrowArray *array, TSRpmspecStringColumn *column)
+{
+    struct export_array *node = array->private_data;
+
+    if (column->count > 0) {
+        node->buffers[1] = node->owned[0] = column->offsets;
+        node->buffers[2] = node->owned[1] = column->data;
+        if (column->data == NULL) {
+            /* Every string is empty */
+            node->buffers[2] = empty_buffer;
+        }
+        column->offsets = NULL;
+        column->data = NULL;
+    } else {
+        free(column->offsets);
+        free(column->data);
+    }
+}
+
+static const struct {
+    const char *name;
+    const char *format;
+    int64_t n_buffers;
+    const char *dictionary_format;
+} columns[COLUMN_COUNT] = {
+    {"package", "i", 2, "u"},
+    {"version", "u", 3, NULL},
+    {"date", "tdD", 2, NULL},
+    {"kind", "c", 2, "u"},
+    {"id", "u", 3, NULL},
+    {"row", "I", 2, NULL},
+};
+
+static bool
+export_schema(struct ArrowSchema *schema)
+{
+    struct export_schema *node = init_schema(schema, "+s", "");
+    size_t i;
+
+    if (node == NULL) {
+        return false;
+    }
+    schema->n_children = COLUMN_COUNT;
+    schema->children = node->child_pointers;
+    for (i = 0; i < COLUMN_COUNT; i++) {
+        node->child_pointers[i] = &node->children[i];
+    }
+    for (i = 0; i < COLUMN_COUNT; i++) {
+        struct ArrowSchema *child = &node->children[i];
+        struct export_schema *child_node;
+
+        child_node = init_schema(child, columns[i].format, columns[i].name);
+        if (child_node == NULL) {
+            goto fail;
+        }
+        if (columns[i].dictionary_format != NULL) {
+            child->dictionary = &child_node->dictionary;
+            if (init_schema(child->dictionary, columns[i].dictionary_format,
+                            NULL) == NULL) {
+                child->dictionary = NULL;
+                goto fail;
+            }
+        }
+    }
+
+    return true;
+
+fail:
+    {
+        int saved_errno = errno;
+
+        release_schema(schema);
+        errno = saved_errno;
+    }
+    return false;
+}
+
+static bool
+export_array(struct ArrowArray *array, const TSRpmspecChangelogBatch *batch)
+{
+    struct export_array *node = init_array(array, batch->rows, 1);
+    size_t i;
+
+    if (node == NULL) {
+        return false;
+    }
+    array->n_children = COLUMN_COUNT;
+    array->children = node->child_pointers;
+    for (i = 0; i < COLUMN_COUNT; i++) {
+        node->child_pointers[i] = &node->children[i];
+    }
+    for (i = 0; i < COLUMN_COUNT; i++) {
+        struct ArrowArray *child = &node->children[i];
+        struct export_array *child_node;
+        int64_t length;
+
+        child_node = init_array(child, batch->rows, columns[i].n_buffers);
+        if (child_node == NULL) {
+            goto fail;
+        }
+        if (columns[i].dictionary_format != NULL) {
+            length = i == 0 ? batch->packages.count : KIND_COUNT;
+            child->dictionary = &child_node->dictionary;
+            if (init_array(child->dictionary, length, 3) == NULL) {
+                child->dictionary = NULL;
+                goto fail;
+            }
+        }
+    }
+
+    return true;
+
+fail:
+    {
+        int saved_errno = errno;
+
+        release_array(array);
+        errno = saved_errno;
+    }
+    return false;
+}
+
+bool
+tree_sitter_rpmspec_changelog_batch_export(TSRpmspecChangelogBatch *batch,
+                                           struct ArrowSchema *schema,
+                                           struct ArrowArray *array)
+{
+    struct export_array *dictionary;
+    struct ArrowArray **children;
+    void *values[4];
+    size_t i;
+
+    if (!export_schema(schema)) {
+        return false;
+    }
+    if (!export_array(array, batch)) {
+        int saved_errno = errno;
+
+        release_schema(schema);
+        errno = saved_errno;
+        return false;
+    }
+
+    /* Nothing fails from here on, the buffers change hands */
+    children = array->children;
+    values[0] = batch->package;
+    values[1] = batch->date;
+    values[2] = batch->kind;
+    values[3] = batch->row;
+    for (i = 0; i < 4; i++) {
+        static const size_t column[4] = {0, 2, 3, 5};
+        struct export_array *node = children[column[i]]->private_data;
+
+        if (batch->rows > 0) {
+            node->buffers[1] = node->owned[0] = values[i];
+        } else {
+            free(values[i]);
+        }
+    }
+    move_strings(children[1], &batch->version);
+    move_strings(children[4], &batch->id);
+    move_strings(children[0]->dictionary, &batch->packages);
+
+    dictionary = children[3]->dictionary->private_data;
+    dictionary->buffers[1] = kind_offsets;
+    dictionary->buffers[2] = kind_names;
+
+    memset(batch, 0, sizeof(*batch));
+
+    return true;
+}
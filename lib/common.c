@@ -0,0 +1,199 @@
+/*
+ * Helpers shared by the modules of the companion library.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "common.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+uint64_t
+rpmspec_fnv_update(uint64_t hash, const void *data, size_t length)
+{
+    const unsigned char *bytes = data;
+    size_t i;
+
+    for (i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= RPMSPEC_FNV_PRIME;
+    }
+
+    return hash;
+}
+
+bool
+rpmspec_resize(void **array, size_t capacity, size_t size)
+{
+    void *new_array;
+
+    if (size > 0 && capacity > SIZE_MAX / size) {
+        errno = ENOMEM;
+        return false;
+    }
+    new_array = realloc(*array, capacity * size);
+    if (new_array == NULL) {
+        errno = ENOMEM;
+        return false;
+    }
+    *array = new_array;
+
+    return true;
+}
+
+bool
+rpmspec_grow(void **array,
+             size_t *capacity,
+             size_t count,
+             size_t size,
+             size_t initial)
+{
+    size_t new_capacity;
+
+    if (count < *capacity) {
+        return true;
+    }
+    if (*capacity > SIZE_MAX / 2) {
+        errno = ENOMEM;
+        return false;
+    }
+
+    new_capacity = *capacity > 0 ? *capacity * 2 : initial;
+    if (!rpmspec_resize(array, new_capacity, size)) {
+        return false;
+    }
+    *capacity = new_capacity;
+
+    return true;
+}
+
+bool
+rpmspec_grow32(void **array,
+               uint32_t *capacity,
+               uint32_t count,
+               size_t size,
+               uint32_t initial)
+{
+    uint32_t new_capacity;
+
+    if (count < *capacity) {
+        return true;
+    }
+    if (*capacity > UINT32_MAX / 2) {
+        errno = ENOMEM;
+        return false;
+    }
+
+    new_capacity = *capacity > 0 ? *capacity * 2 : initial;
+    if (!rpmspec_resize(array, new_capacity, size)) {
+        return false;
+    }
+    *capacity = new_capacity;
+
+    return true;
+}
+
+bool
+rpmspec_resolve_symbols(const TSLanguage *language,
+                        const char *const *names,
+                        TSSymbol *symbols,
+                        size_t count)
+{
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        symbols[i] = ts_language_symbol_for_name(
+            language, names[i], (uint32_t)strlen(names[i]), true);
+        if (symbols[i] == 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool
+rpmspec_resolve_fields(const TSLanguage *language,
+                       const char *const *names,
+                       TSFieldId *fields,
+                       size_t count)
+{
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        fields[i] = ts_language_field_id_for_name(language, names[i],
+                                                  (uint32_t)strlen(names[i]));
+        if (fields[i] == 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool
+rpmspec_write_file(const char *path, const void *data, size_t size)
+{
+    size_t length = strlen(path);
+    const char *bytes = data;
+    int saved_errno;
+    char *tmp;
+    int fd;
+
+    tmp = malloc(length + sizeof(".XXXXXX"));
+    if (tmp == NULL) {
+        return false;
+    }
+    memcpy(tmp, path, length);
+    memcpy(tmp + length, ".XXXXXX", sizeof(".XXXXXX"));
+
+    fd = mkstemp(tmp);
+    if (fd < 0) {
+        free(tmp);
+        return false;
+    }
+
+    /* mkstemp() creates the file for its owner only */
+    if (fchmod(fd, 0644) != 0) {
+        goto fail;
+    }
+    while (size > 0) {
+        ssize_t written = write(fd, bytes, size);
+
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            goto fail;
+        }
+        bytes += written;
+        size -= (size_t)written;
+    }
+    if (close(fd) != 0) {
+        fd = -1;
+        goto fail;
+    }
+    fd = -1;
+    if (rename(tmp, path) != 0) {
+        goto fail;
+    }
+    free(tmp);
+
+    return true;
+
+fail:
+    saved_errno = errno;
+    if (fd >= 0) {
+        close(fd);
+    }
+    unlink(tmp);
+    free(tmp);
+    errno = saved_errno;
+
+    return false;
+}
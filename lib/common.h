@@ -0,0 +1,77 @@
+/*
+ * Helpers shared by the modules of the companion library: hashing, growing
+ * arrays, resolving symbol and field names and writing cache files. None of
+ * them is exported from the library.
+ */
+
+#ifndef RPMSPEC_LIB_COMMON_H_
+#define RPMSPEC_LIB_COMMON_H_
+
+#include <tree_sitter/api.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define RPMSPEC_INTERNAL __attribute__((visibility("hidden")))
+
+/* 64-bit FNV-1a, for hash tables and cache keys */
+#define RPMSPEC_FNV_OFFSET 0xcbf29ce484222325u
+#define RPMSPEC_FNV_PRIME 0x100000001b3u
+
+RPMSPEC_INTERNAL uint64_t
+rpmspec_fnv_update(uint64_t hash, const void *data, size_t length);
+
+/*
+ * Resize *array to `capacity` elements of `size` bytes. Returns false and
+ * sets errno to ENOMEM if out of memory or the size overflows, leaving
+ * *array as it was.
+ */
+RPMSPEC_INTERNAL bool
+rpmspec_resize(void **array, size_t capacity, size_t size);
+
+/*
+ * Make room for element `count` of *array, doubling *capacity from
+ * `initial` when it is full. Errors are those of rpmspec_resize().
+ */
+RPMSPEC_INTERNAL bool
+rpmspec_grow(void **array,
+             size_t *capacity,
+             size_t count,
+             size_t size,
+             size_t initial);
+
+/* rpmspec_grow() for the 32-bit counts of the public result structs */
+RPMSPEC_INTERNAL bool
+rpmspec_grow32(void **array,
+               uint32_t *capacity,
+               uint32_t count,
+               size_t size,
+               uint32_t initial);
+
+/*
+ * Look up the `count` named symbols in `names` in `language`. Returns false
+ * if one of them is not in it, e.g. because the language is another one.
+ */
+RPMSPEC_INTERNAL bool
+rpmspec_resolve_symbols(const TSLanguage *language,
+                        const char *const *names,
+                        TSSymbol *symbols,
+                        size_t count);
+
+/* rpmspec_resolve_symbols() for field names */
+RPMSPEC_INTERNAL bool
+rpmspec_resolve_fields(const TSLanguage *language,
+                       const char *const *names,
+                       TSFieldId *fields,
+                       size_t count);
+
+/*
+ * Write `size` bytes to the file `path`, replaced in one rename() so that
+ * concurrent readers never see a partial file. Returns false and sets errno
+ * on error.
+ */
+RPMSPEC_INTERNAL bool
+rpmspec_write_file(const char *path, const void *data, size_t size);
+
+#endif /* RPMSPEC_LIB_COMMON_H_ */
@@ -0,0 +1,582 @@
+/*
+ * Extracting package identity and dependencies from a spec tree
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <tree_sitter/tree-sitter-rpmspec-deps.h>
+
+#include "common.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/*
+ * A preamble is a list of `tags` nodes, one per line. The qualifier of a
+ * dependency tag is its only named child, so it is not captured.
+ */
+static const char deps_query[] = "(tags (tag) @tag value: (_) @value)\n"
+                                 "(tags (dependency_tag) @dependency_tag\n"
+                                 "      value: (_) @value)\n";
+
+enum deps_symbol {
+    SYM_PREAMBLE,
+    SYM_PACKAGE,
+    SYM_IF_STATEMENT,
+    SYM_IFARCH_STATEMENT,
+    SYM_IFOS_STATEMENT,
+    SYM_ELIF_CLAUSE,
+    SYM_ELIFARCH_CLAUSE,
+    SYM_ELIFOS_CLAUSE,
+    SYM_ELSE_CLAUSE,
+    SYM_SECTION_NAME,
+    SYM_CONCATENATION,
+    SYM_COMPARISON_OPERATOR,
+    SYM_BOOLEAN_OPERATOR,
+    SYM_PARENTHESIZED_EXPRESSION,
+    SYM_MAX,
+};
+
+static const char *const deps_symbol_names[SYM_MAX] = {
+    [SYM_PREAMBLE] = "preamble",
+    [SYM_PACKAGE] = "package",
+    [SYM_IF_STATEMENT] = "if_statement",
+    [SYM_IFARCH_STATEMENT] = "ifarch_statement",
+    [SYM_IFOS_STATEMENT] = "ifos_statement",
+    [SYM_ELIF_CLAUSE] = "elif_clause",
+    [SYM_ELIFARCH_CLAUSE] = "elifarch_clause",
+    [SYM_ELIFOS_CLAUSE] = "elifos_clause",
+    [SYM_ELSE_CLAUSE] = "else_clause",
+    [SYM_SECTION_NAME] = "section_name",
+    [SYM_CONCATENATION] = "concatenation",
+    [SYM_COMPARISON_OPERATOR] = "comparison_operator",
+    [SYM_BOOLEAN_OPERATOR] = "boolean_operator",
+    [SYM_PARENTHESIZED_EXPRESSION] = "parenthesized_expression",
+};
+
+/* Dependency tags not listed here (BuildArch, Prefix, ...) are skipped */
+static const struct {
+    const char *name;
+    TSRpmspecDependencyKind kind;
+} dependency_kinds[] = {
+    {"BuildConflicts", TSRpmspecBuildConflicts},
+    {"BuildPreReq", TSRpmspecBuildRequires},
+    {"BuildRequires", TSRpmspecBuildRequires},
+    {"Conflicts", TSRpmspecConflicts},
+    {"Enhances", TSRpmspecEnhances},
+    {"Obsoletes", TSRpmspecObsoletes},
+    {"OrderWithRequires", TSRpmspecOrderWithRequires},
+    {"Prereq", TSRpmspecRequires},
+    {"Provides", TSRpmspecProvides},
+    {"Recommends", TSRpmspecRecommends},
+    {"Requires", TSRpmspecRequires},
+    {"Suggests", TSRpmspecSuggests},
+    {"Supplements", TSRpmspecSupplements},
+};
+
+struct TSRpmspecDepsExtractor {
+    TSQuery *query;
+    TSQueryCursor *cursor;
+    uint32_t tag_capture;
+    uint32_t dependency_tag_capture;
+    uint32_t value_capture;
+    TSSymbol symbols[SYM_MAX];
+    const TSRange *dead;
+    uint32_t dead_count;
+};
+
+struct deps_state {
+    TSRpmspecDepsExtractor *self;
+    const char *source;
+    TSRpmspecDeps *deps;
+    uint32_t package;
+};
+
+static bool
+capture_id(const TSQuery *query, const char *name, uint32_t *id)
+{
+    uint32_t count = ts_query_capture_count(query);
+    uint32_t i;
+
+    for (i = 0; i < count; i++) {
+        uint32_t length;
+        const char *capture = ts_query_capture_name_for_id(query, i, &length);
+
+        if (length == strlen(name) && memcmp(capture, name, length) == 0) {
+            *id = i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+TSRpmspecDepsExtractor *
+tree_sitter_rpmspec_deps_extractor_new(const TSLanguage *language)
+{
+    TSRpmspecDepsExtractor *self;
+    TSQueryError error;
+    uint32_t offset;
+
+    self = calloc(1, sizeof(*self));
+    if (self == NULL) {
+        return NULL;
+    }
+
+    if (!rpmspec_resolve_symbols(language, deps_symbol_names, self->symbols,
+                                 SYM_MAX)) {
+        goto fail;
+    }
+
+    self->query = ts_query_new(language, deps_query,
+                               (uint32_t)(sizeof(deps_query) - 1), &offset,
+                               &error);
+    if (self->query == NULL ||
+        !capture_id(self->query, "tag", &self->tag_capture) ||
+        !capture_id(self->query, "dependency_tag",
+                    &self->dependency_tag_capture) ||
+        !capture_id(self->query, "value", &self->value_capture)) {
+        goto fail;
+    }
+
+    self->cursor = ts_query_cursor_new();
+    if (self->cursor == NULL) {
+        goto fail;
+    }
+
+    return self;
+
+fail:
+    tree_sitter_rpmspec_deps_extractor_delete(self);
+    return NULL;
+}
+
+void
+tree_sitter_rpmspec_deps_extractor_delete(TSRpmspecDepsExtractor *self)
+{
+    if (self == NULL) {
+        return;
+    }
+    if (self->cursor != NULL) {
+        ts_query_cursor_delete(self->cursor);
+    }
+    if (self->query != NULL) {
+        ts_query_delete(self->query);
+    }
+    free(self);
+}
+
+void
+tree_sitter_rpmspec_deps_extractor_set_dead_ranges(TSRpmspecDepsExtractor *self,
+                                                   const TSRange *ranges,
+                                                   uint32_t count)
+{
+    self->dead = ranges;
+    self->dead_count = count;
+}
+
+void
+tree_sitter_rpmspec_deps_free(TSRpmspecDeps *deps)
+{
+    free(deps->packages);
+    free(deps->dependencies);
+    memset(deps, 0, sizeof(*deps));
+}
+
+static bool
+is_symbol(const struct deps_state *state, TSNode node, enum deps_symbol sym)
+{
+    return ts_node_symbol(node) == state->self->symbols[sym];
+}
+
+/* Whether `node` lies in a branch that is not taken, by binary search */
+static bool
+is_dead(const struct deps_state *state, TSNode node)
+{
+    const TSRange *dead = state->self->dead;
+    uint32_t start = ts_node_start_byte(node);
+    uint32_t low = 0;
+    uint32_t high = state->self->dead_count;
+
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+
+        if (dead[middle].start_byte <= start) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return low > 0 && ts_node_end_byte(node) <= dead[low - 1].end_byte;
+}
+
+static TSRpmspecSlice
+node_slice(TSNode node)
+{
+    uint32_t start = ts_node_start_byte(node);
+
+    return (TSRpmspecSlice){start, ts_node_end_byte(node) - start};
+}
+
+static bool
+slice_equals(const struct deps_state *state,
+             TSRpmspecSlice slice,
+             const char *name)
+{
+    return slice.length == strlen(name) &&
+           strncasecmp(state->source + slice.start, name, slice.length) == 0;
+}
+
+static bool
+add_dependency(struct deps_state *state,
+               const TSRpmspecDependency *template,
+               TSRpmspecSlice name,
+               TSRpmspecSlice op,
+               TSRpmspecSlice version,
+               uint32_t flags)
+{
+    TSRpmspecDeps *deps = state->deps;
+    TSRpmspecDependency *dep;
+
+    /* "a, b" is a concatenation of the words "a," and "b" */
+    while (name.length > 0 &&
+           state->source[name.start + name.length - 1] == ',') {
+        name.length--;
+    }
+    while (version.length > 0 &&
+           state->source[version.start + version.length - 1] == ',') {
+        version.length--;
+    }
+    if (name.length == 0) {
+        return true;
+    }
+
+    if (!rpmspec_grow32((void **)&deps->dependencies,
+                        &deps->dependency_capacity, deps->dependency_count,
+                        sizeof(*deps->dependencies), 16)) {
+        return false;
+    }
+
+    dep = &deps->dependencies[deps->dependency_count++];
+    *dep = *template;
+    dep->name = name;
+    dep->op = op;
+    dep->version = version;
+    dep->flags = flags;
+
+    return true;
+}
+
+/*
+ * A concatenation holds several dependencies when its parts are separated by
+ * whitespace or a comma: "a, %{name}-libs" is a concatenation of "a,",
+ * "%{name}" and "-libs". Return the slice of the dependency that starts at
+ * the named child `*index` and advance `*index` past it.
+ */
+static TSRpmspecSlice
+next_group(const struct deps_state *state, TSNode node, uint32_t *index)
+{
+    uint32_t count = ts_node_named_child_count(node);
+    TSNode child = ts_node_named_child(node, *index);
+    uint32_t start = ts_node_start_byte(child);
+    uint32_t end = ts_node_end_byte(child);
+
+    for ((*index)++; *index < count; (*index)++) {
+        if (state->source[end - 1] == ',') {
+            break;
+        }
+        child = ts_node_named_child(node, *index);
+        if (ts_node_start_byte(child) != end) {
+            break;
+        }
+        end = ts_node_end_byte(child);
+    }
+
+    return (TSRpmspecSlice){start, end - start};
+}
+
+static bool
+add_value(struct deps_state *state,
+          const TSRpmspecDependency *template,
+          TSNode value)
+{
+    static const TSRpmspecSlice none = {0, 0};
+    TSRpmspecSlice name;
+    TSRpmspecSlice version;
+    TSNode left;
+    TSNode op;
+    TSNode right;
+    uint32_t count;
+    uint32_t i = 0;
+
+    if (is_symbol(state, value, SYM_CONCATENATION)) {
+        count = ts_node_named_child_count(value);
+        while (i < count) {
+            name = next_group(state, value, &i);
+            if (!add_dependency(state, template, name, none, none, 0)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    if (is_symbol(state, value, SYM_PARENTHESIZED_EXPRESSION) ||
+        is_symbol(state, value, SYM_BOOLEAN_OPERATOR)) {
+        return add_dependency(state, template, node_slice(value), none, none,
+                              TS_RPMSPEC_DEPENDENCY_RICH);
+    }
+    if (!is_symbol(state, value, SYM_COMPARISON_OPERATOR)) {
+        return add_dependency(state, template, node_slice(value), none, none,
+                              0);
+    }
+
+    /*
+     * "a, b >= 1" is (comparison_operator (concatenation a b) >= 1) and
+     * "b >= 1, c" has the concatenation on the right. Only the first
+     * operator of a chained comparison is used.
+     */
+    left = ts_node_child(value, 0);
+    op = ts_node_next_sibling(left);
+    right = ts_node_next_sibling(op);
+    if (ts_node_is_null(op) || ts_node_is_null(right)) {
+        return add_dependency(state, template, node_slice(value), none, none,
+                              0);
+    }
+
+    name = node_slice(left);
+    if (is_symbol(state, left, SYM_CONCATENATION)) {
+        count = ts_node_named_child_count(left);
+        for (name = next_group(state, left, &i); i < count;
+             name = next_group(state, left, &i)) {
+            if (!add_dependency(state, template, name, none, none, 0)) {
+                return false;
+            }
+        }
+    }
+
+    i = 0;
+    count = 0;
+    version = node_slice(right);
+    if (is_symbol(state, right, SYM_CONCATENATION)) {
+        count = ts_node_named_child_count(right);
+        version = next_group(state, right, &i);
+    }
+    if (!add_dependency(state, template, name, node_slice(op), version, 0)) {
+        return false;
+    }
+    while (i < count) {
+        name = next_group(state, right, &i);
+        if (!add_dependency(state, template, name, none, none, 0)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool
+add_tag(struct deps_state *state, TSNode tag, TSNode value)
+{
+    TSRpmspecSlice name = node_slice(tag);
+    TSRpmspecDeps *deps = state->deps;
+
+    /* Subpackages inherit the identity of the main package */
+    if (state->package != 0) {
+        return true;
+    }
+
+    if (slice_equals(state, name, "Name")) {
+        deps->name = node_slice(value);
+    } else if (slice_equals(state, name, "Epoch")) {
+        deps->epoch = node_slice(value);
+    } else if (slice_equals(state, name, "Version")) {
+        deps->version = node_slice(value);
+    } else if (slice_equals(state, name, "Release")) {
+        deps->release = node_slice(value);
+    }
+
+    return true;
+}
+
+static bool
+add_dependency_tag(struct deps_state *state, TSNode tag, TSNode value)
+{
+    TSRpmspecDependency template = {0};
+    TSRpmspecSlice name = node_slice(tag);
+    TSNode qualifier;
+    size_t i;
+
+    qualifier = ts_node_named_child(tag, 0);
+    if (!ts_node_is_null(qualifier)) {
+        template.qualifier = node_slice(qualifier);
+    }
+
+    /* The node spans "Requires(post)", cut the name before the qualifier */
+    for (i = 0; i < name.length; i++) {
+        char c = state->source[name.start + i];
+
+        if (c == '(' || c == ' ' || c == '\t') {
+            name.length = (uint32_t)i;
+            break;
+        }
+    }
+
+    for (i = 0; i < sizeof(dependency_kinds) / sizeof(dependency_kinds[0]);
+         i++) {
+        if (slice_equals(state, name, dependency_kinds[i].name)) {
+            break;
+        }
+    }
+    if (i == sizeof(dependency_kinds) / sizeof(dependency_kinds[0])) {
+        return true;
+    }
+
+    template.kind = dependency_kinds[i].kind;
+    template.package = state->package;
+    template.row = ts_node_start_point(tag).row;
+
+    return add_value(state, &template, value);
+}
+
+/* Run the query over a preamble or a %package section */
+static bool
+extract_tags(struct deps_state *state, TSNode node)
+{
+    TSRpmspecDepsExtractor *self = state->self;
+    TSQueryMatch match;
+
+    ts_query_cursor_exec(self->cursor, self->query, node);
+    while (ts_query_cursor_next_match(self->cursor, &match)) {
+        TSNode tag = {0};
+        TSNode value = {0};
+        bool dependency = false;
+        uint16_t i;
+        bool ok;
+
+        for (i = 0; i < match.capture_count; i++) {
+            uint32_t index = match.captures[i].index;
+
+            if (index == self->value_capture) {
+                value = match.captures[i].node;
+            } else {
+                tag = match.captures[i].node;
+                dependency = index == self->dependency_tag_capture;
+            }
+        }
+
+        if (is_dead(state, tag)) {
+            continue;
+        }
+        ok = dependency ? add_dependency_tag(state, tag, value)
+                        : add_tag(state, tag, value);
+        if (!ok) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool
+add_package(struct deps_state *state, TSNode package)
+{
+    TSRpmspecDeps *deps = state->deps;
+    uint32_t start = 0;
+    uint32_t end = 0;
+    uint32_t count;
+    uint32_t i;
+
+    /* Everything between the section name and the first preamble */
+    count = ts_node_child_count(package);
+    for (i = 0; i < count; i++) {
+        TSNode child = ts_node_child(package, i);
+
+        if (is_symbol(state, child, SYM_SECTION_NAME)) {
+            continue;
+        }
+        if (is_symbol(state, child, SYM_PREAMBLE)) {
+            break;
+        }
+        if (start == 0) {
+            start = ts_node_start_byte(child);
+        }
+        if (ts_node_is_named(child)) {
+            end = ts_node_end_byte(child);
+        }
+    }
+
+    if (!rpmspec_grow32((void **)&deps->packages, &deps->package_capacity,
+                        deps->package_count, sizeof(*deps->packages), 16)) {
+        return false;
+    }
+    deps->packages[deps->package_count++] =
+        (TSRpmspecSlice){start, end > start ? end - start : 0};
+    state->package = deps->package_count;
+
+    return extract_tags(state, package);
+}
+
+static bool
+visit_children(struct deps_state *state, TSNode node)
+{
+    uint32_t count = ts_node_named_child_count(node);
+    uint32_t i;
+
+    for (i = 0; i < count; i++) {
+        TSNode child = ts_node_named_child(node, i);
+        TSSymbol symbol = ts_node_symbol(child);
+        const TSSymbol *symbols = state->self->symbols;
+        bool ok = true;
+
+        if (is_dead(state, child)) {
+            continue;
+        }
+        if (symbol == symbols[SYM_PREAMBLE]) {
+            ok = extract_tags(state, child);
+        } else if (symbol == symbols[SYM_PACKAGE]) {
+            ok = add_package(state, child);
+        } else if (symbol == symbols[SYM_IF_STATEMENT] ||
+                   symbol == symbols[SYM_IFARCH_STATEMENT] ||
+                   symbol == symbols[SYM_IFOS_STATEMENT] ||
+                   symbol == symbols[SYM_ELIF_CLAUSE] ||
+                   symbol == symbols[SYM_ELIFARCH_CLAUSE] ||
+                   symbol == symbols[SYM_ELIFOS_CLAUSE] ||
+                   symbol == symbols[SYM_ELSE_CLAUSE]) {
+            /* Branches are kept unless dead, dependencies differ per arch */
+            ok = visit_children(state, child);
+        }
+        /*
+         * Anything else is a section or a macro, its subtree is skipped.
+         * Tags in a conditional after a %package section belong to it.
+         */
+
+        if (!ok) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool
+tree_sitter_rpmspec_deps_extract(TSRpmspecDepsExtractor *self,
+                                 const TSTree *tree,
+                                 const char *source,
+                                 TSRpmspecDeps *deps)
+{
+    struct deps_state state = {
+        .self = self,
+        .source = source,
+        .deps = deps,
+        .package = 0,
+    };
+
+    deps->name = deps->epoch = deps->version = deps->release =
+        (TSRpmspecSlice){0, 0};
+    deps->package_count = 0;
+    deps->dependency_count = 0;
+
+    return visit_children(&state, ts_tree_root_node(tree));
+}
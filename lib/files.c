@@ -0,0 +1,1609 @@
+/*
+ * A path trie of the %files sections of many specs, for ownership lookups
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <tree_sitter/tree-sitter-rpmspec-files.h>
+
+#include "common.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <stdalign.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define INDEX_MAGIC "RPMFIDX"
+#define INDEX_VERSION 1
+#define INDEX_BYTE_ORDER 0x01020304u
+
+/* Longer paths are not indexed, as rpm does not package them either */
+#define MAX_PATH 4096
+
+/* Brace groups expanded per path; rpm expands more, nobody writes more */
+#define MAX_BRACE_GROUPS 8
+
+#define GLOB_CHARS "*?["
+
+/* Flags of an index node */
+#define NODE_GLOB 0x1u          /* The name is a glob */
+#define NODE_GLOB_CHILDREN 0x2u /* Some children are NODE_GLOB */
+
+/*
+ * The header is followed by `node_count` nodes in breadth-first order, the
+ * root first, `owner_count` owners, `package_count` packages and
+ * `string_bytes` of NUL-terminated strings. The children of a node are
+ * consecutive, come after it and are sorted by name; its owners are
+ * consecutive too. An absolute path starts with an empty component, so
+ * "/usr/bin" is "", "usr", "bin" and "README" is a child of the root.
+ */
+struct file_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t node_count;
+    uint32_t owner_count;
+    uint32_t package_count;
+    uint32_t string_bytes;
+};
+
+struct index_node {
+    uint32_t name; /* Offset into the strings */
+    uint32_t first_child;
+    uint32_t child_count;
+    uint32_t first_owner;
+    uint32_t owner_count;
+    uint16_t name_length;
+    uint16_t flags;
+};
+
+struct index_owner {
+    uint32_t package;
+    uint32_t flags;
+};
+
+struct index_package {
+    uint32_t name;
+    uint32_t spec;
+};
+
+_Static_assert(sizeof(struct file_header) % alignof(uint64_t) == 0,
+               "the nodes follow the header unpadded");
+_Static_assert(sizeof(struct index_node) == 24 &&
+                   sizeof(struct index_owner) == 8 &&
+                   sizeof(struct index_package) == 8,
+               "an index has the same layout everywhere");
+
+enum files_symbol {
+    SYM_PREAMBLE,
+    SYM_TAGS,
+    SYM_TAG,
+    SYM_FILES,
+    SYM_FILE,
+    SYM_FILE_QUALIFIER,
+    SYM_STRING,
+    SYM_SECTION_NAME,
+    SYM_DEFATTR,
+    SYM_DOCDIR,
+    SYM_IF_STATEMENT,
+    SYM_IFARCH_STATEMENT,
+    SYM_IFOS_STATEMENT,
+    SYM_ELIF_CLAUSE,
+    SYM_ELIFARCH_CLAUSE,
+    SYM_ELIFOS_CLAUSE,
+    SYM_ELSE_CLAUSE,
+    SYM_MAX,
+};
+
+static const char *const files_symbol_names[SYM_MAX] = {
+    [SYM_PREAMBLE] = "preamble",
+    [SYM_TAGS] = "tags",
+    [SYM_TAG] = "tag",
+    [SYM_FILES] = "files",
+    [SYM_FILE] = "file",
+    [SYM_FILE_QUALIFIER] = "file_qualifier",
+    [SYM_STRING] = "string",
+    [SYM_SECTION_NAME] = "section_name",
+    [SYM_DEFATTR] = "defattr",
+    [SYM_DOCDIR] = "docdir",
+    [SYM_IF_STATEMENT] = "if_statement",
+    [SYM_IFARCH_STATEMENT] = "ifarch_statement",
+    [SYM_IFOS_STATEMENT] = "ifos_statement",
+    [SYM_ELIF_CLAUSE] = "elif_clause",
+    [SYM_ELIFARCH_CLAUSE] = "elifarch_clause",
+    [SYM_ELIFOS_CLAUSE] = "elifos_clause",
+    [SYM_ELSE_CLAUSE] = "else_clause",
+};
+
+/* Qualifiers not listed here (%artifact, %readme, ...) add no flag */
+static const struct {
+    const char *name;
+    uint32_t flag;
+} qualifier_flags[] = {
+    {"config", TSRpmspecFileConfig},   {"dir", TSRpmspecFileDir},
+    {"doc", TSRpmspecFileDoc},         {"exclude", TSRpmspecFileExclude},
+    {"ghost", TSRpmspecFileGhost},     {"license", TSRpmspecFileLicense},
+};
+
+struct buffer {
+    char *data;
+    size_t length;
+    size_t capacity;
+};
+
+/* Strings are offsets into the text of the builder, which moves */
+struct entry {
+    size_t path;
+    uint32_t package;
+    uint32_t flags;
+};
+
+struct package {
+    size_t name;
+    size_t spec;
+};
+
+struct TSRpmspecFilesBuilder {
+    TSSymbol symbols[SYM_MAX];
+    TSFieldId value_field;
+    struct buffer text;
+    struct entry *entries;
+    size_t entry_count;
+    size_t entry_capacity;
+    struct package *packages;
+    size_t package_count;
+    size_t package_capacity;
+};
+
+struct files_state {
+    TSRpmspecFilesBuilder *self;
+    const char *source;
+    TSRpmspecMacros *macros;
+    const TSRange *dead;
+    uint32_t dead_count;
+    size_t spec;
+    size_t first_package; /* The packages of this spec start here */
+    char *name;           /* Of the main package */
+};
+
+struct TSRpmspecFilesIndex {
+    const struct file_header *header;
+    const struct index_node *nodes;
+    const struct index_owner *owners;
+    const struct index_package *packages;
+    const char *strings;
+    void *mapping; /* munmap() on delete */
+    size_t size;
+};
+
+/* Append `length` bytes of `text` and a NUL, and return where they start */
+static bool
+buffer_add(struct buffer *buffer,
+           const char *text,
+           size_t length,
+           size_t *offset)
+{
+    while (buffer->capacity - buffer->length < length + 1) {
+        size_t capacity = buffer->capacity > 0 ? buffer->capacity * 2 : 4096;
+        char *data = realloc(buffer->data, capacity);
+
+        if (data == NULL) {
+            errno = ENOMEM;
+            return false;
+        }
+        buffer->data = data;
+        buffer->capacity = capacity;
+    }
+    *offset = buffer->length;
+    memcpy(buffer->data + buffer->length, text, length);
+    buffer->data[buffer->length + length] = '\0';
+    buffer->length += length + 1;
+
+    return true;
+}
+
+/*
+ * Copy `path` into `normalized` without repeated and trailing slashes.
+ * Return its length, or 0 if it is empty or does not fit.
+ */
+static size_t
+normalize(const char *path, char *normalized)
+{
+    size_t length = 0;
+
+    for (; *path != '\0'; path++) {
+        if (*path == '/' && length > 0 && normalized[length - 1] == '/') {
+            continue;
+        }
+        if (length == MAX_PATH - 1) {
+            return 0;
+        }
+        normalized[length++] = *path;
+    }
+    if (length > 0 && normalized[length - 1] == '/') {
+        length--;
+    }
+    normalized[length] = '\0';
+
+    return length;
+}
+
+TSRpmspecFilesBuilder *
+tree_sitter_rpmspec_files_builder_new(const TSLanguage *language)
+{
+    TSRpmspecFilesBuilder *self;
+
+    self = calloc(1, sizeof(*self));
+    if (self == NULL) {
+        return NULL;
+    }
+
+    if (!rpmspec_resolve_symbols(language, files_symbol_names, self->symbols,
+                                 SYM_MAX)) {
+        goto fail;
+    }
+    self->value_field = ts_language_field_id_for_name(language, "value",
+                                                      sizeof("value") - 1);
+    if (self->value_field == 0) {
+        goto fail;
+    }
+
+    return self;
+
+fail:
+    tree_sitter_rpmspec_files_builder_delete(self);
+    errno = EINVAL;
+    return NULL;
+}
+
+void
+tree_sitter_rpmspec_files_builder_delete(TSRpmspecFilesBuilder *self)
+{
+    if (self == NULL) {
+        return;
+    }
+    free(self->text.data);
+    free(self->entries);
+    free(self->packages);
+    free(self);
+}
+
+static bool
+is_symbol(const struct files_state *state, TSNode node, enum files_symbol sym)
+{
+    return ts_node_symbol(node) == state->self->symbols[sym];
+}
+
+static bool
+is_conditional(const struct files_state *state, TSNode node)
+{
+    return is_symbol(state, node, SYM_IF_STATEMENT) ||
+           is_symbol(state, node, SYM_IFARCH_STATEMENT) ||
+           is_symbol(state, node, SYM_IFOS_STATEMENT) ||
+           is_symbol(state, node, SYM_ELIF_CLAUSE) ||
+           is_symbol(state, node, SYM_ELIFARCH_CLAUSE) ||
+           is_symbol(state, node, SYM_ELIFOS_CLAUSE) ||
+           is_symbol(state, node, SYM_ELSE_CLAUSE);
+}
+
+/* Whether `node` lies in a branch that is not taken, by binary search */
+static bool
+is_dead(const struct files_state *state, TSNode node)
+{
+    const TSRange *dead = state->dead;
+    uint32_t start = ts_node_start_byte(node);
+    uint32_t low = 0;
+    uint32_t high = state->dead_count;
+
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+
+        if (dead[middle].start_byte <= start) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return low > 0 && ts_node_end_byte(node) <= dead[low - 1].end_byte;
+}
+
+/* The text of `node`, expanded if there are macros, to release with free() */
+static char *
+node_text(const struct files_state *state, TSNode node)
+{
+    uint32_t start = ts_node_start_byte(node);
+    uint32_t length = ts_node_end_byte(node) - start;
+    char *text;
+
+    if (state->macros != NULL) {
+        text = tree_sitter_rpmspec_macros_expand(
+            state->macros, state->source + start, length, NULL);
+    } else {
+        text = malloc((size_t)length + 1);
+        if (text != NULL) {
+            memcpy(text, state->source + start, length);
+            text[length] = '\0';
+        }
+    }
+    if (text == NULL) {
+        errno = ENOMEM;
+    }
+
+    return text;
+}
+
+static char *
+copy_string(const char *text, size_t length)
+{
+    char *copy = malloc(length + 1);
+
+    if (copy == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+
+    return copy;
+}
+
+/*
+ * The name of the main package: the "name" macro if there are macros,
+ * otherwise the Name tag of the preamble, and the name of the spec if there
+ * is neither.
+ */
+static char *
+main_name(const struct files_state *state, TSNode root, const char *spec)
+{
+    uint32_t count = ts_node_named_child_count(root);
+    uint32_t length;
+    uint32_t i;
+
+    if (state->macros != NULL) {
+        const char *name =
+            tree_sitter_rpmspec_macros_get(state->macros, "name", &length);
+
+        if (name != NULL) {
+            return copy_string(name, length);
+        }
+    }
+
+    for (i = 0; i < count; i++) {
+        TSNode preamble = ts_node_named_child(root, i);
+        uint32_t tag_count;
+        uint32_t j;
+
+        if (!is_symbol(state, preamble, SYM_PREAMBLE)) {
+            continue;
+        }
+        tag_count = ts_node_named_child_count(preamble);
+        for (j = 0; j < tag_count; j++) {
+            TSNode tags = ts_node_named_child(preamble, j);
+            TSNode tag = ts_node_named_child(tags, 0);
+            TSNode value;
+            uint32_t start;
+
+            if (!is_symbol(state, tags, SYM_TAGS) ||
+                !is_symbol(state, tag, SYM_TAG)) {
+                continue;
+            }
+            start = ts_node_start_byte(tag);
+            if (ts_node_end_byte(tag) - start != sizeof("Name") - 1 ||
+                strncasecmp(state->source + start, "Name",
+                            sizeof("Name") - 1) != 0) {
+                continue;
+            }
+            value = ts_node_child_by_field_id(tags,
+                                              state->self->value_field);
+            if (!ts_node_is_null(value)) {
+                return node_text(state, value);
+            }
+        }
+    }
+
+    return copy_string(spec, strlen(spec));
+}
+
+static bool
+add_package(struct files_state *state, const char *name, uint32_t *package)
+{
+    TSRpmspecFilesBuilder *self = state->self;
+    size_t i;
+
+    /* rpm rejects a second %files of a package, the index merges them */
+    for (i = state->first_package; i < self->package_count; i++) {
+        if (strcmp(self->text.data + self->packages[i].name, name) == 0) {
+            *package = (uint32_t)i;
+            return true;
+        }
+    }
+    if (self->package_count == UINT32_MAX) {
+        errno = EOVERFLOW;
+        return false;
+    }
+    if (!rpmspec_grow((void **)&self->packages, &self->package_capacity,
+                      self->package_count, sizeof(*self->packages), 64) ||
+        !buffer_add(&self->text, name, strlen(name), &i)) {
+        return false;
+    }
+    self->packages[self->package_count].name = i;
+    self->packages[self->package_count].spec = state->spec;
+    *package = (uint32_t)self->package_count++;
+
+    return true;
+}
+
+static bool
+add_path(struct files_state *state,
+         const char *path,
+         uint32_t package,
+         uint32_t flags)
+{
+    TSRpmspecFilesBuilder *self = state->self;
+    char normalized[MAX_PATH];
+    size_t length = normalize(path, normalized);
+    struct entry *entry;
+    size_t offset;
+
+    if (length == 0) {
+        return true;
+    }
+    if (strpbrk(normalized, GLOB_CHARS) != NULL) {
+        flags |= TSRpmspecFileGlob;
+    }
+    if (!rpmspec_grow((void **)&self->entries, &self->entry_capacity,
+                      self->entry_count, sizeof(*self->entries), 64) ||
+        !buffer_add(&self->text, normalized, length, &offset)) {
+        return false;
+    }
+
+    entry = &self->entries[self->entry_count++];
+    entry->path = offset;
+    entry->package = package;
+    entry->flags = flags;
+
+    return true;
+}
+
+/*
+ * The first group of `path` with a comma at its top level, like "{a,b}" in
+ * "/usr/{s,}bin/foo". Groups of macros that were not expanded, "%{...}",
+ * are skipped. Returns false if there is none.
+ */
+static bool
+find_group(const char *path, const char **open, const char **close)
+{
+    const char *p;
+
+    for (p = path; (p = strchr(p, '{')) != NULL;) {
+        bool macro = p > path && p[-1] == '%';
+        bool comma = false;
+        int depth = 0;
+        const char *q;
+
+        for (q = p; *q != '\0'; q++) {
+            if (*q == '{') {
+                depth++;
+            } else if (*q == '}' && --depth == 0) {
+                break;
+            } else if (*q == ',' && depth == 1) {
+                comma = true;
+            }
+        }
+        if (*q == '\0') {
+            return false;
+        }
+        if (!macro && comma) {
+            *open = p;
+            *close = q;
+            return true;
+        }
+        p = q + 1;
+    }
+
+    return false;
+}
+
+/* rpm expands braces like a shell, every alternative is a path of its own */
+static bool
+add_alternatives(struct files_state *state,
+                 const char *path,
+                 uint32_t package,
+                 uint32_t flags,
+                 int groups)
+{
+    size_t path_length = strlen(path);
+    const char *alternative;
+    const char *open;
+    const char *close;
+    int depth = 0;
+    char *expanded;
+    const char *p;
+
+    if (groups == MAX_BRACE_GROUPS || !find_group(path, &open, &close)) {
+        return add_path(state, path, package, flags);
+    }
+
+    expanded = malloc(path_length + 1);
+    if (expanded == NULL) {
+        errno = ENOMEM;
+        return false;
+    }
+    memcpy(expanded, path, (size_t)(open - path));
+
+    for (alternative = p = open + 1; p <= close; p++) {
+        size_t prefix = (size_t)(open - path);
+        size_t length = (size_t)(p - alternative);
+
+        if (*p == '{') {
+            depth++;
+        } else if (*p == '}' && depth > 0) {
+            depth--;
+        } else if ((*p == ',' && depth == 0) || p == close) {
+            memcpy(expanded + prefix, alternative, length);
+            memcpy(expanded + prefix + length, close + 1,
+                   path_length - (size_t)(close + 1 - path) + 1);
+            if (!add_alternatives(state, expanded, package, flags,
+                                  groups + 1)) {
+                free(expanded);
+                return false;
+            }
+            alternative = p + 1;
+        }
+    }
+    free(expanded);
+
+    return true;
+}
+
+/* rpm splits the paths of a line at blanks, except inside double quotes */
+static bool
+add_paths(struct files_state *state,
+          char *text,
+          uint32_t package,
+          uint32_t flags)
+{
+    char *p = text;
+
+    while (*p != '\0') {
+        const char *path;
+        bool quoted;
+
+        while (*p == ' ' || *p == '\t' || *p == '\n') {
+            p++;
+        }
+        if (*p == '\0') {
+            break;
+        }
+        quoted = *p == '"';
+        if (quoted) {
+            p++;
+        }
+        path = p;
+        while (*p != '\0' &&
+               (quoted ? *p != '"' : *p != ' ' && *p != '\t' && *p != '\n')) {
+            p++;
+        }
+        if (*p != '\0') {
+            *p++ = '\0';
+        }
+        if (!add_alternatives(state, path, package, flags, 0)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static uint32_t
+file_qualifier_flag(const struct files_state *state, TSNode qualifier)
+{
+    /* The node starts at the "%" of "%config(noreplace)" */
+    const char *name = state->source + ts_node_start_byte(qualifier) + 1;
+    size_t length = 0;
+    size_t i;
+
+    while (name[length] >= 'a' && name[length] <= 'z') {
+        length++;
+    }
+    for (i = 0; i < sizeof(qualifier_flags) / sizeof(qualifier_flags[0]);
+         i++) {
+        if (strlen(qualifier_flags[i].name) == length &&
+            memcmp(qualifier_flags[i].name, name, length) == 0) {
+            return qualifier_flags[i].flag;
+        }
+    }
+
+    return 0;
+}
+
+static bool
+add_file(struct files_state *state, TSNode file, uint32_t package)
+{
+    uint32_t count = ts_node_named_child_count(file);
+    uint32_t flags = 0;
+    uint32_t i;
+
+    for (i = 0; i < count; i++) {
+        TSNode child = ts_node_named_child(file, i);
+        char *text;
+        bool ok;
+
+        if (is_symbol(state, child, SYM_FILE_QUALIFIER)) {
+            flags |= file_qualifier_flag(state, child);
+            continue;
+        }
+        if (!is_symbol(state, child, SYM_STRING)) {
+            continue;
+        }
+        text = node_text(state, child);
+        if (text == NULL) {
+            return false;
+        }
+        ok = add_paths(state, text, package, flags);
+        free(text);
+        if (!ok) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* The entries of a %files section and the conditionals inside it */
+static bool
+add_entries(struct files_state *state, TSNode node, uint32_t package)
+{
+    uint32_t count = ts_node_named_child_count(node);
+    uint32_t i;
+
+    for (i = 0; i < count; i++) {
+        TSNode child = ts_node_named_child(node, i);
+        bool ok = true;
+
+        if (is_dead(state, child)) {
+            continue;
+        }
+        if (is_symbol(state, child, SYM_FILE)) {
+            ok = add_file(state, child, package);
+        } else if (is_conditional(state, child)) {
+            ok = add_entries(state, child, package);
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* Whether `node` is an argument of the %files line, not an entry */
+static bool
+is_argument(const struct files_state *state, TSNode node)
+{
+    return ts_node_is_named(node) &&
+           !is_symbol(state, node, SYM_SECTION_NAME) &&
+           !is_symbol(state, node, SYM_FILE) &&
+           !is_symbol(state, node, SYM_DEFATTR) &&
+           !is_symbol(state, node, SYM_DOCDIR) && !is_conditional(state, node);
+}
+
+/*
+ * "%files" is the main package, "%files devel" is "<name>-devel" and
+ * "%files -n devel" is "devel". Every "-f list" is indexed as an entry with
+ * TSRpmspecFileList.
+ */
+static bool
+add_files(struct files_state *state, TSNode files)
+{
+    uint32_t count = ts_node_child_count(files);
+    const char *option = "";
+    TSNode name = {0};
+    bool explicit = false;
+    uint32_t package;
+    char *full_name;
+    char *text;
+    uint32_t i;
+    bool ok;
+
+    for (i = 0; i < count; i++) {
+        TSNode child = ts_node_child(files, i);
+
+        if (!ts_node_is_named(child)) {
+            option = ts_node_type(child);
+            continue;
+        }
+        if (is_argument(state, child) && strcmp(option, "-f") != 0) {
+            name = child;
+            explicit = strcmp(option, "-n") == 0;
+        }
+        option = "";
+    }
+
+    if (ts_node_is_null(name)) {
+        full_name = copy_string(state->name, strlen(state->name));
+    } else if (explicit) {
+        full_name = node_text(state, name);
+    } else {
+        text = node_text(state, name);
+        full_name = NULL;
+        if (text != NULL) {
+            size_t length = strlen(state->name);
+
+            full_name = malloc(length + 1 + strlen(text) + 1);
+            if (full_name != NULL) {
+                memcpy(full_name, state->name, length);
+                full_name[length] = '-';
+                strcpy(full_name + length + 1, text);
+            }
+            free(text);
+        }
+    }
+    if (full_name == NULL) {
+        errno = ENOMEM;
+        return false;
+    }
+    ok = add_package(state, full_name, &package);
+    free(full_name);
+    if (!ok) {
+        return false;
+    }
+
+    option = "";
+    for (i = 0; i < count; i++) {
+        TSNode child = ts_node_child(files, i);
+
+        if (!ts_node_is_named(child)) {
+            option = ts_node_type(child);
+            continue;
+        }
+        if (is_argument(state, child) && strcmp(option, "-f") == 0) {
+            text = node_text(state, child);
+            if (text == NULL) {
+                return false;
+            }
+            ok = add_paths(state, text, package, TSRpmspecFileList);
+            free(text);
+            if (!ok) {
+                return false;
+            }
+        }
+        option = "";
+    }
+
+    return add_entries(state, files, package);
+}
+
+/* %files sections and the conditionals around them */
+static bool
+visit_children(struct files_state *state, TSNode node)
+{
+    uint32_t count = ts_node_named_child_count(node);
+    uint32_t i;
+
+    for (i = 0; i < count; i++) {
+        TSNode child = ts_node_named_child(node, i);
+        bool ok = true;
+
+        if (is_dead(state, child)) {
+            continue;
+        }
+        if (is_symbol(state, child, SYM_FILES)) {
+            ok = add_files(state, child);
+        } else if (is_conditional(state, child)) {
+            ok = visit_children(state, child);
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool
+tree_sitter_rpmspec_files_builder_add(TSRpmspecFilesBuilder *self,
+                                      const char *spec,
+                                      const TSTree *tree,
+                                      const char *source,
+                                      TSRpmspecMacros *macros)
+{
+    TSNode root = ts_tree_root_node(tree);
+    struct files_state state = {
+        .self = self,
+        .source = source,
+        .macros = macros,
+        .first_package = self->package_count,
+    };
+    bool ok;
+
+    if (macros != NULL) {
+        state.dead =
+            tree_sitter_rpmspec_macros_dead_ranges(macros, &state.dead_count);
+    }
+    if (!buffer_add(&self->text, spec, strlen(spec), &state.spec)) {
+        return false;
+    }
+    state.name = main_name(&state, root, spec);
+    if (state.name == NULL) {
+        return false;
+    }
+
+    ok = visit_children(&state, root);
+    free(state.name);
+
+    return ok;
+}
+
+/*
+ * An entry while serializing. Sorting them with "/" before every other
+ * byte puts the entries below a directory right after it and before its
+ * siblings, so every node of the trie covers a run of entries.
+ */
+struct sorted_entry {
+    const char *path;
+    uint32_t package;
+    uint32_t flags;
+};
+
+static int
+compare_paths(const char *a, const char *b)
+{
+    for (;; a++, b++) {
+        unsigned char ca = *a == '/' ? 1 : (unsigned char)*a;
+        unsigned char cb = *b == '/' ? 1 : (unsigned char)*b;
+
+        if (ca != cb) {
+            return ca < cb ? -1 : 1;
+        }
+        if (ca == '\0') {
+            return 0;
+        }
+    }
+}
+
+static int
+compare_entries(const void *a, const void *b)
+{
+    const struct sorted_entry *x = a;
+    const struct sorted_entry *y = b;
+    int order = compare_paths(x->path, y->path);
+
+    if (order != 0) {
+        return order;
+    }
+    if (x->package != y->package) {
+        return x->package < y->package ? -1 : 1;
+    }
+    return x->flags < y->flags ? -1 : x->flags > y->flags;
+}
+
+/* The strings of the index, each stored once */
+struct pool {
+    struct buffer text;
+    uint32_t *slots; /* Offset plus one, 0 if free */
+    size_t slot_count;
+    size_t used;
+};
+
+static uint64_t
+hash_string(const char *text, size_t length)
+{
+    return rpmspec_fnv_update(RPMSPEC_FNV_OFFSET, text, length);
+}
+
+static bool
+pool_rehash(struct pool *pool)
+{
+    size_t slot_count = pool->slot_count > 0 ? pool->slot_count * 2 : 1024;
+    uint32_t *slots = calloc(slot_count, sizeof(*slots));
+    size_t i;
+
+    if (slots == NULL) {
+        errno = ENOMEM;
+        return false;
+    }
+    for (i = 0; i < pool->slot_count; i++) {
+        const char *text;
+        size_t slot;
+
+        if (pool->slots[i] == 0) {
+            continue;
+        }
+        text = pool->text.data + pool->slots[i] - 1;
+        slot = hash_string(text, strlen(text)) & (slot_count - 1);
+        while (slots[slot] != 0) {
+            slot = (slot + 1) & (slot_count - 1);
+        }
+        slots[slot] = pool->slots[i];
+    }
+    free(pool->slots);
+    pool->slots = slots;
+    pool->slot_count = slot_count;
+
+    return true;
+}
+
+static bool
+pool_add(struct pool *pool, const char *text, size_t length, uint32_t *offset)
+{
+    size_t slot;
+    size_t added;
+
+    if (pool->used * 2 >= pool->slot_count && !pool_rehash(pool)) {
+        return false;
+    }
+    slot = hash_string(text, length) & (pool->slot_count - 1);
+    while (pool->slots[slot] != 0) {
+        const char *existing = pool->text.data + pool->slots[slot] - 1;
+
+        if (strncmp(existing, text, length) == 0 && existing[length] == '\0') {
+            *offset = pool->slots[slot] - 1;
+            return true;
+        }
+        slot = (slot + 1) & (pool->slot_count - 1);
+    }
+
+    if (pool->text.length + length + 1 >= UINT32_MAX) {
+        errno = EOVERFLOW;
+        return false;
+    }
+    if (!buffer_add(&pool->text, text, length, &added)) {
+        return false;
+    }
+    pool->slots[slot] = (uint32_t)added + 1;
+    pool->used++;
+    *offset = (uint32_t)added;
+
+    return true;
+}
+
+/* The run of sorted entries below a node, and where its name ends in them */
+struct span {
+    size_t first;
+    size_t last;
+    size_t end; /* SIZE_MAX for the root */
+};
+
+struct trie {
+    struct index_node *nodes;
+    size_t node_count;
+    size_t node_capacity;
+    struct span *spans;
+    size_t span_capacity;
+    struct index_owner *owners;
+    size_t owner_count;
+    size_t owner_capacity;
+};
+
+static bool
+add_node(struct trie *trie,
+         struct pool *pool,
+         const char *name,
+         size_t length,
+         struct span span)
+{
+    struct index_node *node;
+    uint32_t offset;
+
+    if (trie->node_count == UINT32_MAX) {
+        errno = EOVERFLOW;
+        return false;
+    }
+    if (!rpmspec_grow((void **)&trie->nodes, &trie->node_capacity,
+                      trie->node_count, sizeof(*trie->nodes), 64) ||
+        !rpmspec_grow((void **)&trie->spans, &trie->span_capacity,
+                      trie->node_count, sizeof(*trie->spans), 64) ||
+        !pool_add(pool, name, length, &offset)) {
+        return false;
+    }
+
+    node = &trie->nodes[trie->node_count];
+    memset(node, 0, sizeof(*node));
+    node->name = offset;
+    node->name_length = (uint16_t)length;
+    for (; length > 0; length--, name++) {
+        if (strchr(GLOB_CHARS, *name) != NULL) {
+            node->flags = NODE_GLOB;
+            break;
+        }
+    }
+    trie->spans[trie->node_count++] = span;
+
+    return true;
+}
+
+/*
+ * Lay the trie out breadth first: the children of a node are appended in
+ * one go when the node is reached, so they are consecutive and already in
+ * order.
+ */
+static bool
+build_trie(struct trie *trie,
+           struct pool *pool,
+           const struct sorted_entry *entries,
+           size_t count)
+{
+    struct span root = {0, count, SIZE_MAX};
+    struct index_node *node;
+    size_t i;
+
+    if (!add_node(trie, pool, "", 0, root)) {
+        return false;
+    }
+
+    for (i = 0; i < trie->node_count; i++) {
+        struct span span = trie->spans[i];
+        size_t first_owner = trie->owner_count;
+        size_t first_child = trie->node_count;
+        size_t start = span.end == SIZE_MAX ? 0 : span.end + 1;
+        size_t e = span.first;
+
+        while (span.end != SIZE_MAX && e < span.last &&
+               entries[e].path[span.end] == '\0') {
+            if (!rpmspec_grow((void **)&trie->owners, &trie->owner_capacity,
+                              trie->owner_count, sizeof(*trie->owners), 64)) {
+                return false;
+            }
+            trie->owners[trie->owner_count].package = entries[e].package;
+            trie->owners[trie->owner_count].flags = entries[e].flags;
+            trie->owner_count++;
+            e++;
+        }
+
+        while (e < span.last) {
+            const char *name = entries[e].path + start;
+            size_t length = strcspn(name, "/");
+            struct span child = {e, e + 1, start + length};
+
+            while (child.last < span.last &&
+                   strncmp(entries[child.last].path + start, name, length) ==
+                       0 &&
+                   (entries[child.last].path[start + length] == '\0' ||
+                    entries[child.last].path[start + length] == '/')) {
+                child.last++;
+            }
+            if (!add_node(trie, pool, name, length, child)) {
+                return false;
+            }
+            if (trie->nodes[trie->node_count - 1].flags & NODE_GLOB) {
+                trie->nodes[i].flags |= NODE_GLOB_CHILDREN;
+            }
+            e = child.last;
+        }
+
+        node = &trie->nodes[i];
+        node->first_child = (uint32_t)first_child;
+        node->child_count = (uint32_t)(trie->node_count - first_child);
+        node->first_owner = (uint32_t)first_owner;
+        node->owner_count = (uint32_t)(trie->owner_count - first_owner);
+    }
+
+    if (trie->owner_count > UINT32_MAX) {
+        errno = EOVERFLOW;
+        return false;
+    }
+
+    return true;
+}
+
+static uint64_t
+index_size(const struct file_header *header)
+{
+    return sizeof(*header) +
+           (uint64_t)header->node_count * sizeof(struct index_node) +
+           (uint64_t)header->owner_count * sizeof(struct index_owner) +
+           (uint64_t)header->package_count * sizeof(struct index_package) +
+           header->string_bytes;
+}
+
+void *
+tree_sitter_rpmspec_files_builder_serialize(TSRpmspecFilesBuilder *self,
+                                            size_t *size)
+{
+    struct sorted_entry *entries;
+    struct index_package *packages = NULL;
+    struct file_header header;
+    struct trie trie = {0};
+    struct pool pool = {0};
+    char *data = NULL;
+    size_t count = 0;
+    uint64_t total;
+    size_t i;
+
+    if (self->package_count > UINT32_MAX) {
+        errno = EOVERFLOW;
+        return NULL;
+    }
+    entries = malloc((self->entry_count > 0 ? self->entry_count : 1) *
+                     sizeof(*entries));
+    packages = malloc((self->package_count > 0 ? self->package_count : 1) *
+                      sizeof(*packages));
+    if (entries == NULL || packages == NULL) {
+        errno = ENOMEM;
+        goto out;
+    }
+
+    for (i = 0; i < self->entry_count; i++) {
+        entries[i].path = self->text.data + self->entries[i].path;
+        entries[i].package = self->entries[i].package;
+        entries[i].flags = self->entries[i].flags;
+    }
+    qsort(entries, self->entry_count, sizeof(*entries), compare_entries);
+    for (i = 0; i < self->entry_count; i++) {
+        if (count == 0 || compare_entries(&entries[count - 1], &entries[i])) {
+            entries[count++] = entries[i];
+        }
+    }
+
+    if (!build_trie(&trie, &pool, entries, count)) {
+        goto out;
+    }
+    for (i = 0; i < self->package_count; i++) {
+        const char *name = self->text.data + self->packages[i].name;
+        const char *spec = self->text.data + self->packages[i].spec;
+
+        if (!pool_add(&pool, name, strlen(name), &packages[i].name) ||
+            !pool_add(&pool, spec, strlen(spec), &packages[i].spec)) {
+            goto out;
+        }
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+    header.version = INDEX_VERSION;
+    header.byte_order = INDEX_BYTE_ORDER;
+    header.node_count = (uint32_t)trie.node_count;
+    header.owner_count = (uint32_t)trie.owner_count;
+    header.package_count = (uint32_t)self->package_count;
+    header.string_bytes = (uint32_t)pool.text.length;
+    total = index_size(&header);
+    if (total > SIZE_MAX) {
+        errno = ENOMEM;
+        goto out;
+    }
+    data = malloc((size_t)total);
+    if (data == NULL) {
+        errno = ENOMEM;
+        goto out;
+    }
+
+    *size = (size_t)total;
+    memcpy(data, &header, sizeof(header));
+    total = sizeof(header);
+    memcpy(data + total, trie.nodes, trie.node_count * sizeof(*trie.nodes));
+    total += trie.node_count * sizeof(*trie.nodes);
+    memcpy(data + total, trie.owners, trie.owner_count * sizeof(*trie.owners));
+    total += trie.owner_count * sizeof(*trie.owners);
+    memcpy(data + total, packages, self->package_count * sizeof(*packages));
+    total += self->package_count * sizeof(*packages);
+    memcpy(data + total, pool.text.data, pool.text.length);
+
+out:
+    free(entries);
+    free(packages);
+    free(trie.nodes);
+    free(trie.spans);
+    free(trie.owners);
+    free(pool.text.data);
+    free(pool.slots);
+
+    return data;
+}
+
+bool
+tree_sitter_rpmspec_files_builder_save(TSRpmspecFilesBuilder *self,
+                                       const char *path)
+{
+    void *data;
+    size_t size;
+    bool ok;
+
+    data = tree_sitter_rpmspec_files_builder_serialize(self, &size);
+    if (data == NULL) {
+        return false;
+    }
+    ok = rpmspec_write_file(path, data, size);
+    free(data);
+
+    return ok;
+}
+
+static bool
+valid_string(const TSRpmspecFilesIndex *self, uint32_t offset)
+{
+    return offset < self->header->string_bytes;
+}
+
+/*
+ * Check everything an index into the file is derived from, so that a
+ * truncated or corrupt file is rejected here and not read out of bounds
+ * later. Children come after their parent, which bounds every walk.
+ */
+static bool
+validate(TSRpmspecFilesIndex *self)
+{
+    const struct file_header *header = self->header;
+    uint32_t i;
+
+    if (self->size < sizeof(*header) ||
+        memcmp(header->magic, INDEX_MAGIC, sizeof(header->magic)) != 0 ||
+        header->byte_order != INDEX_BYTE_ORDER ||
+        header->version != INDEX_VERSION ||
+        index_size(header) != (uint64_t)self->size ||
+        header->node_count == 0 || header->string_bytes == 0) {
+        return false;
+    }
+    self->nodes = (const struct index_node *)(header + 1);
+    self->owners = (const struct index_owner *)(self->nodes +
+                                                header->node_count);
+    self->packages = (const struct index_package *)(self->owners +
+                                                    header->owner_count);
+    self->strings = (const char *)(self->packages + header->package_count);
+
+    /* Every string then ends within the strings */
+    if (self->strings[header->string_bytes - 1] != '\0') {
+        return false;
+    }
+    for (i = 0; i < header->node_count; i++) {
+        const struct index_node *node = &self->nodes[i];
+
+        if ((uint64_t)node->name + node->name_length >= header->string_bytes ||
+            self->strings[node->name + node->name_length] != '\0' ||
+            (node->child_count > 0 && node->first_child <= i) ||
+            (uint64_t)node->first_child + node->child_count >
+                header->node_count ||
+            (uint64_t)node->first_owner + node->owner_count >
+                header->owner_count) {
+            return false;
+        }
+    }
+    for (i = 0; i < header->owner_count; i++) {
+        if (self->owners[i].package >= header->package_count) {
+            return false;
+        }
+    }
+    for (i = 0; i < header->package_count; i++) {
+        if (!valid_string(self, self->packages[i].name) ||
+            !valid_string(self, self->packages[i].spec)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+TSRpmspecFilesIndex *
+tree_sitter_rpmspec_files_index_from_buffer(const void *data, size_t size)
+{
+    TSRpmspecFilesIndex *self;
+
+    if (((uintptr_t)data % alignof(uint64_t)) != 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    self = calloc(1, sizeof(*self));
+    if (self == NULL) {
+        return NULL;
+    }
+    self->header = data;
+    self->size = size;
+    if (!validate(self)) {
+        free(self);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    return self;
+}
+
+TSRpmspecFilesIndex *
+tree_sitter_rpmspec_files_index_open(const char *path)
+{
+    TSRpmspecFilesIndex *self;
+    void *mapping;
+    struct stat sb;
+    int saved_errno;
+    int fd;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &sb) != 0) {
+        goto fail;
+    }
+    if (!S_ISREG(sb.st_mode) || sb.st_size == 0) {
+        errno = EINVAL;
+        goto fail;
+    }
+    mapping = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+        goto fail;
+    }
+    close(fd);
+
+    self = tree_sitter_rpmspec_files_index_from_buffer(mapping,
+                                                       (size_t)sb.st_size);
+    if (self == NULL) {
+        saved_errno = errno;
+        munmap(mapping, (size_t)sb.st_size);
+        errno = saved_errno;
+        return NULL;
+    }
+    self->mapping = mapping;
+
+    return self;
+
+fail:
+    saved_errno = errno;
+    close(fd);
+    errno = saved_errno;
+
+    return NULL;
+}
+
+void
+tree_sitter_rpmspec_files_index_delete(TSRpmspecFilesIndex *self)
+{
+    if (self == NULL) {
+        return;
+    }
+    if (self->mapping != NULL) {
+        munmap(self->mapping, self->size);
+    }
+    free(self);
+}
+
+struct lookup {
+    const TSRpmspecFilesIndex *self;
+    TSRpmspecFilesCallback callback;
+    void *payload;
+    bool find;           /* Matching a pattern against the entries */
+    const char *end;     /* Of the components of the query */
+    uint32_t reported;
+    char query[MAX_PATH]; /* The components, separated by NULs */
+    char path[MAX_PATH];  /* The entry of the node being visited */
+};
+
+static int
+compare_name(const TSRpmspecFilesIndex *self,
+             const struct index_node *node,
+             const char *name,
+             size_t length)
+{
+    size_t shorter = node->name_length < length ? node->name_length : length;
+    int order = memcmp(self->strings + node->name, name, shorter);
+
+    if (order != 0) {
+        return order;
+    }
+    return (node->name_length > length) - (node->name_length < length);
+}
+
+static uint32_t
+find_child(const TSRpmspecFilesIndex *self,
+           const struct index_node *node,
+           const char *name,
+           size_t length)
+{
+    uint32_t low = node->first_child;
+    uint32_t high = node->first_child + node->child_count;
+
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        int order = compare_name(self, &self->nodes[middle], name, length);
+
+        if (order == 0) {
+            return middle;
+        }
+        if (order < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return UINT32_MAX;
+}
+
+/*
+ * Report the owners of node `index`. With `below`, the query is below the
+ * entry, which owns it unless it is a %dir or a file list.
+ */
+static bool
+report(struct lookup *lookup, uint32_t index, bool below)
+{
+    const TSRpmspecFilesIndex *self = lookup->self;
+    const struct index_node *node = &self->nodes[index];
+    uint32_t i;
+
+    for (i = 0; i < node->owner_count; i++) {
+        const struct index_owner *owner = &self->owners[node->first_owner + i];
+        const struct index_package *package = &self->packages[owner->package];
+        TSRpmspecFilesOwner result;
+
+        if (below &&
+            (owner->flags & (TSRpmspecFileDir | TSRpmspecFileList)) != 0) {
+            continue;
+        }
+        result.spec = self->strings + package->spec;
+        result.package = self->strings + package->name;
+        result.path = lookup->path;
+        result.flags = owner->flags;
+        lookup->reported++;
+        if (!lookup->callback(&result, lookup->payload)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool match(struct lookup *lookup,
+                  uint32_t index,
+                  size_t length,
+                  const char *component);
+
+/* Append the name of `child` to the entry of `parent`, `length` bytes */
+static bool
+descend(struct lookup *lookup,
+        uint32_t parent,
+        uint32_t child,
+        size_t length,
+        const char *next)
+{
+    const struct index_node *node = &lookup->self->nodes[child];
+    size_t start = parent == 0 ? 0 : length + 1;
+
+    if (start + node->name_length >= MAX_PATH) {
+        return true;
+    }
+    if (parent != 0) {
+        lookup->path[length] = '/';
+    }
+    memcpy(lookup->path + start, lookup->self->strings + node->name,
+           node->name_length);
+    lookup->path[start + node->name_length] = '\0';
+
+    return match(lookup, child, start + node->name_length, next);
+}
+
+/*
+ * Match `component` and the components after it below node `index`. A
+ * lookup follows the child of the same name and every glob child that
+ * matches; a pattern follows every child it matches.
+ */
+static bool
+match(struct lookup *lookup,
+      uint32_t index,
+      size_t length,
+      const char *component)
+{
+    const TSRpmspecFilesIndex *self = lookup->self;
+    const struct index_node *node = &self->nodes[index];
+    size_t component_length;
+    const char *next;
+    uint32_t exact = UINT32_MAX;
+    uint32_t i;
+
+    if (component > lookup->end) {
+        return report(lookup, index, false);
+    }
+    if (!lookup->find && index != 0 && !report(lookup, index, true)) {
+        return false;
+    }
+
+    component_length = strlen(component);
+    next = component + component_length + 1;
+    if (!lookup->find || strpbrk(component, GLOB_CHARS) == NULL) {
+        exact = find_child(self, node, component, component_length);
+        if (exact != UINT32_MAX &&
+            !descend(lookup, index, exact, length, next)) {
+            return false;
+        }
+        if (lookup->find || !(node->flags & NODE_GLOB_CHILDREN)) {
+            return true;
+        }
+    }
+
+    for (i = node->first_child; i < node->first_child + node->child_count;
+         i++) {
+        const char *name = self->strings + self->nodes[i].name;
+        int matched;
+
+        if (i == exact) {
+            continue;
+        }
+        if (lookup->find) {
+            matched = fnmatch(component, name, FNM_PERIOD);
+        } else if (self->nodes[i].flags & NODE_GLOB) {
+            matched = fnmatch(name, component, FNM_PERIOD);
+        } else {
+            continue;
+        }
+        if (matched == 0 && !descend(lookup, index, i, length, next)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static uint32_t
+run_lookup(const TSRpmspecFilesIndex *self,
+           const char *path,
+           bool find,
+           TSRpmspecFilesCallback callback,
+           void *payload)
+{
+    struct lookup *lookup;
+    size_t length;
+    uint32_t reported;
+    size_t i;
+
+    lookup = malloc(sizeof(*lookup));
+    if (lookup == NULL) {
+        return 0;
+    }
+    length = normalize(path, lookup->query);
+    if (length == 0) {
+        free(lookup);
+        return 0;
+    }
+    for (i = 0; i < length; i++) {
+        if (lookup->query[i] == '/') {
+            lookup->query[i] = '\0';
+        }
+    }
+    lookup->self = self;
+    lookup->callback = callback;
+    lookup->payload = payload;
+    lookup->find = find;
+    lookup->end = lookup->query + length;
+    lookup->reported = 0;
+    lookup->path[0] = '\0';
+
+    match(lookup, 0, 0, lookup->query);
+    reported = lookup->reported;
+    free(lookup);
+
+    return reported;
+}
+
+uint32_t
+tree_sitter_rpmspec_files_index_owners(const TSRpmspecFilesIndex *self,
+                                       const char *path,
+                                       TSRpmspecFilesCallback callback,
+                                       void *payload)
+{
+    return run_lookup(self, path, false, callback, payload);
+}
+
+uint32_t
+tree_sitter_rpmspec_files_index_find(const TSRpmspecFilesIndex *self,
+                                     const char *pattern,
+                                     TSRpmspecFilesCallback callback,
+                                     void *payload)
+{
+    return run_lookup(self, pattern, true, callback, payload);
+}
+
+void
+tree_sitter_rpmspec_files_index_stats(const TSRpmspecFilesIndex *self,
+                                      TSRpmspecFilesIndexStats *stats)
+{
+    stats->packages = self->header->package_count;
+    stats->entries = self->header->owner_count;
+    stats->nodes = self->header->node_count;
+    stats->string_bytes = self->header->string_bytes;
+    stats->size = self->size;
+}
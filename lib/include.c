@@ -0,0 +1,602 @@
+/*
+ * Resolving %include and %load fragments, each parsed once per resolver
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <tree_sitter/tree-sitter-rpmspec-include.h>
+
+#include "common.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* The builtin is matched by name below, the runtime leaves #any-of? to us */
+static const char include_query[] =
+    "(macro_expansion_call (builtin) @name) @directive\n"
+    "(macro_expansion (builtin) @name) @directive\n";
+
+struct fragment {
+    dev_t dev;
+    ino_t ino;
+    char *path;
+    char *source;
+    uint32_t length;
+    TSTree *tree;
+};
+
+struct TSRpmspecIncludeResolver {
+    TSParser *parser;
+    TSQuery *query;
+    TSQueryCursor *cursor;
+    uint32_t name_capture;
+    uint32_t directive_capture;
+    TSFieldId argument_field;
+    TSSymbol definition_symbol;
+    struct fragment *fragments;
+    uint32_t count;
+    uint32_t capacity;
+    /* Open addressing on the file identity, an index + 1 or 0 if free */
+    uint32_t *slots;
+    uint32_t slot_count;
+    TSRpmspecIncludeStats stats;
+};
+
+struct fragment_list {
+    TSRpmspecFragment *items;
+    uint32_t count;
+    uint32_t capacity;
+};
+
+static bool
+capture_id(const TSQuery *query, const char *name, uint32_t *id)
+{
+    uint32_t count = ts_query_capture_count(query);
+    uint32_t i;
+
+    for (i = 0; i < count; i++) {
+        uint32_t length;
+        const char *capture = ts_query_capture_name_for_id(query, i, &length);
+
+        if (length == strlen(name) && memcmp(capture, name, length) == 0) {
+            *id = i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+TSRpmspecIncludeResolver *
+tree_sitter_rpmspec_include_resolver_new(const TSLanguage *language)
+{
+    TSRpmspecIncludeResolver *self;
+    TSQueryError error;
+    uint32_t offset;
+
+    self = calloc(1, sizeof(*self));
+    if (self == NULL) {
+        return NULL;
+    }
+
+    self->definition_symbol = ts_language_symbol_for_name(
+        language, "macro_definition", 16, true);
+    self->argument_field =
+        ts_language_field_id_for_name(language, "argument", 8);
+    if (self->definition_symbol == 0 || self->argument_field == 0) {
+        goto fail;
+    }
+
+    self->query = ts_query_new(language, include_query,
+                               (uint32_t)(sizeof(include_query) - 1), &offset,
+                               &error);
+    if (self->query == NULL ||
+        !capture_id(self->query, "name", &self->name_capture) ||
+        !capture_id(self->query, "directive", &self->directive_capture)) {
+        goto fail;
+    }
+
+    self->cursor = ts_query_cursor_new();
+    self->parser = ts_parser_new();
+    if (self->cursor == NULL || self->parser == NULL ||
+        !ts_parser_set_language(self->parser, language)) {
+        goto fail;
+    }
+
+    return self;
+
+fail:
+    tree_sitter_rpmspec_include_resolver_delete(self);
+    return NULL;
+}
+
+void
+tree_sitter_rpmspec_include_resolver_delete(TSRpmspecIncludeResolver *self)
+{
+    uint32_t i;
+
+    if (self == NULL) {
+        return;
+    }
+    for (i = 0; i < self->count; i++) {
+        ts_tree_delete(self->fragments[i].tree);
+        free(self->fragments[i].source);
+        free(self->fragments[i].path);
+    }
+    free(self->fragments);
+    free(self->slots);
+    if (self->parser != NULL) {
+        ts_parser_delete(self->parser);
+    }
+    if (self->cursor != NULL) {
+        ts_query_cursor_delete(self->cursor);
+    }
+    if (self->query != NULL) {
+        ts_query_delete(self->query);
+    }
+    free(self);
+}
+
+void
+tree_sitter_rpmspec_include_stats(const TSRpmspecIncludeResolver *self,
+                                  TSRpmspecIncludeStats *stats)
+{
+    *stats = self->stats;
+}
+
+void
+tree_sitter_rpmspec_include_fragments_free(TSRpmspecFragment *fragments,
+                                           uint32_t count)
+{
+    uint32_t i;
+
+    for (i = 0; i < count; i++) {
+        ts_tree_delete(fragments[i].tree);
+    }
+    free(fragments);
+}
+
+/*
+ * The cache
+ */
+
+static uint64_t
+hash_file(dev_t dev, ino_t ino)
+{
+    uint64_t hash = RPMSPEC_FNV_OFFSET;
+
+    hash = (hash ^ (uint64_t)dev) * RPMSPEC_FNV_PRIME;
+    hash = (hash ^ (uint64_t)ino) * RPMSPEC_FNV_PRIME;
+
+    return hash;
+}
+
+static uint32_t *
+find_slot(const TSRpmspecIncludeResolver *self, dev_t dev, ino_t ino)
+{
+    uint32_t mask = self->slot_count - 1;
+    uint32_t i = (uint32_t)(hash_file(dev, ino) & mask);
+
+    for (;;) {
+        uint32_t index = self->slots[i];
+
+        if (index == 0 || (self->fragments[index - 1].dev == dev &&
+                           self->fragments[index - 1].ino == ino)) {
+            return &self->slots[i];
+        }
+        i = (i + 1) & mask;
+    }
+}
+
+static bool
+grow_slots(TSRpmspecIncludeResolver *self)
+{
+    uint32_t slot_count = self->slot_count > 0 ? self->slot_count * 2 : 64;
+    uint32_t *slots;
+    uint32_t i;
+
+    if (slot_count < self->slot_count) {
+        errno = ENOMEM;
+        return false;
+    }
+    slots = calloc(slot_count, sizeof(*slots));
+    if (slots == NULL) {
+        errno = ENOMEM;
+        return false;
+    }
+
+    free(self->slots);
+    self->slots = slots;
+    self->slot_count = slot_count;
+    for (i = 0; i < self->count; i++) {
+        *find_slot(self, self->fragments[i].dev, self->fragments[i].ino) =
+            i + 1;
+    }
+
+    return true;
+}
+
+/* Read a whole regular file into a NUL-terminated heap buffer */
+static bool
+read_file(const char *path, char **data, uint32_t *length)
+{
+    struct stat sb;
+    size_t done = 0;
+    int saved_errno;
+    char *buffer = NULL;
+    int fd;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    if (fstat(fd, &sb) != 0) {
+        goto fail;
+    }
+    if (!S_ISREG(sb.st_mode)) {
+        errno = EINVAL;
+        goto fail;
+    }
+    if ((uint64_t)sb.st_size >= UINT32_MAX) {
+        errno = EFBIG;
+        goto fail;
+    }
+
+    buffer = malloc((size_t)sb.st_size + 1);
+    if (buffer == NULL) {
+        errno = ENOMEM;
+        goto fail;
+    }
+    while (done < (size_t)sb.st_size) {
+        ssize_t n = read(fd, buffer + done, (size_t)sb.st_size - done);
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            goto fail;
+        }
+        if (n == 0) {
+            /* Truncated while reading, keep what is there */
+            break;
+        }
+        done += (size_t)n;
+    }
+    close(fd);
+
+    buffer[done] = '\0';
+    *data = buffer;
+    *length = (uint32_t)done;
+
+    return true;
+
+fail:
+    saved_errno = errno;
+    free(buffer);
+    close(fd);
+    errno = saved_errno;
+    return false;
+}
+
+/*
+ * The fragment of `path`, read and parsed on first use. Sets `*fragment` to
+ * NULL if the file cannot be read; returns false only for errors that fail
+ * the whole resolve.
+ */
+static bool
+lookup_fragment(TSRpmspecIncludeResolver *self,
+                const char *path,
+                const struct fragment **fragment)
+{
+    struct fragment *f;
+    struct stat sb;
+    uint32_t *slot;
+
+    *fragment = NULL;
+    if (stat(path, &sb) != 0) {
+        return true;
+    }
+
+    if (self->count * 2 >= self->slot_count && !grow_slots(self)) {
+        return false;
+    }
+    slot = find_slot(self, sb.st_dev, sb.st_ino);
+    if (*slot != 0) {
+        self->stats.hits++;
+        *fragment = &self->fragments[*slot - 1];
+        return true;
+    }
+
+    if (!rpmspec_grow32((void **)&self->fragments, &self->capacity,
+                        self->count, sizeof(*self->fragments), 16)) {
+        return false;
+    }
+
+    f = &self->fragments[self->count];
+    memset(f, 0, sizeof(*f));
+    f->dev = sb.st_dev;
+    f->ino = sb.st_ino;
+    if (!read_file(path, &f->source, &f->length)) {
+        return errno != ENOMEM;
+    }
+    f->path = strdup(path);
+    if (f->path == NULL) {
+        free(f->source);
+        errno = ENOMEM;
+        return false;
+    }
+    f->tree = ts_parser_parse_string(self->parser, NULL, f->source, f->length);
+    if (f->tree == NULL) {
+        free(f->path);
+        free(f->source);
+        errno = ECANCELED;
+        return false;
+    }
+
+    *slot = ++self->count;
+    self->stats.parsed++;
+    *fragment = f;
+
+    return true;
+}
+
+/*
+ * Directives
+ */
+
+/* The byte range from the first argument of `directive` to the last */
+static bool
+target_range(const TSRpmspecIncludeResolver *self,
+             TSNode directive,
+             uint32_t *start,
+             uint32_t *end)
+{
+    TSTreeCursor cursor = ts_tree_cursor_new(directive);
+    bool found = false;
+
+    if (ts_tree_cursor_goto_first_child(&cursor)) {
+        do {
+            TSNode child;
+
+            if (ts_tree_cursor_current_field_id(&cursor) !=
+                self->argument_field) {
+                continue;
+            }
+            child = ts_tree_cursor_current_node(&cursor);
+            if (!found) {
+                *start = ts_node_start_byte(child);
+                found = true;
+            }
+            *end = ts_node_end_byte(child);
+        } while (ts_tree_cursor_goto_next_sibling(&cursor));
+    }
+    ts_tree_cursor_delete(&cursor);
+
+    return found;
+}
+
+static bool
+in_definition(const TSRpmspecIncludeResolver *self, TSNode node)
+{
+    for (node = ts_node_parent(node); !ts_node_is_null(node);
+         node = ts_node_parent(node)) {
+        if (ts_node_symbol(node) == self->definition_symbol) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool
+in_dead_range(TSRpmspecMacros *macros, uint32_t byte)
+{
+    const TSRange *ranges;
+    uint32_t count;
+    uint32_t i;
+
+    if (macros == NULL) {
+        return false;
+    }
+    ranges = tree_sitter_rpmspec_macros_dead_ranges(macros, &count);
+    for (i = 0; i < count; i++) {
+        if (byte >= ranges[i].start_byte && byte < ranges[i].end_byte) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool
+is_blank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+/*
+ * The path a directive names: its target expanded, trimmed and joined to
+ * `base_dir`. NULL with errno 0 if a macro is left in it.
+ */
+static char *
+target_path(const char *text,
+            uint32_t length,
+            const char *base_dir,
+            TSRpmspecMacros *macros)
+{
+    size_t base_length = 0;
+    char *expanded = NULL;
+    char *path;
+
+    if (macros != NULL) {
+        expanded =
+            tree_sitter_rpmspec_macros_expand(macros, text, length, &length);
+        if (expanded == NULL) {
+            errno = ENOMEM;
+            return NULL;
+        }
+        text = expanded;
+    }
+
+    while (length > 0 && is_blank(text[0])) {
+        text++;
+        length--;
+    }
+    while (length > 0 && is_blank(text[length - 1])) {
+        length--;
+    }
+    if (length == 0 || memchr(text, '%', length) != NULL) {
+        free(expanded);
+        errno = 0;
+        return NULL;
+    }
+
+    if (text[0] != '/' && base_dir != NULL && base_dir[0] != '\0') {
+        base_length = strlen(base_dir);
+    }
+    path = malloc(base_length + 1 + length + 1);
+    if (path == NULL) {
+        free(expanded);
+        errno = ENOMEM;
+        return NULL;
+    }
+    if (base_length > 0) {
+        memcpy(path, base_dir, base_length);
+        if (path[base_length - 1] != '/') {
+            path[base_length++] = '/';
+        }
+    }
+    memcpy(path + base_length, text, length);
+    path[base_length + length] = '\0';
+    free(expanded);
+
+    return path;
+}
+
+static bool
+append_fragment(struct fragment_list *list,
+                const struct fragment *f,
+                TSNode directive,
+                bool load)
+{
+    TSRpmspecFragment *item;
+
+    if (!rpmspec_grow32((void **)&list->items, &list->capacity, list->count,
+                        sizeof(*list->items), 8)) {
+        return false;
+    }
+
+    item = &list->items[list->count++];
+    item->path = f->path;
+    item->source = f->source;
+    item->length = f->length;
+    /* A reference to the shared tree, not a copy of its nodes */
+    item->tree = ts_tree_copy(f->tree);
+    item->directive = (TSRange){
+        .start_point = ts_node_start_point(directive),
+        .end_point = ts_node_end_point(directive),
+        .start_byte = ts_node_start_byte(directive),
+        .end_byte = ts_node_end_byte(directive),
+    };
+    item->load = load;
+
+    return true;
+}
+
+static bool
+resolve_directive(TSRpmspecIncludeResolver *self,
+                  const char *source,
+                  const char *base_dir,
+                  TSRpmspecMacros *macros,
+                  TSNode name,
+                  TSNode directive,
+                  struct fragment_list *list)
+{
+    uint32_t name_start = ts_node_start_byte(name);
+    uint32_t name_length = ts_node_end_byte(name) - name_start;
+    const struct fragment *f;
+    uint32_t start;
+    uint32_t end;
+    char *path;
+    bool load;
+
+    if (name_length == 4 && memcmp(source + name_start, "load", 4) == 0) {
+        load = true;
+    } else if (name_length == 7 &&
+               memcmp(source + name_start, "include", 7) == 0) {
+        load = false;
+    } else {
+        return true;
+    }
+    if (!target_range(self, directive, &start, &end) ||
+        in_definition(self, directive) ||
+        in_dead_range(macros, ts_node_start_byte(directive))) {
+        return true;
+    }
+
+    path = target_path(source + start, end - start, base_dir, macros);
+    if (path == NULL) {
+        if (errno != 0) {
+            return false;
+        }
+        self->stats.unresolved++;
+        return true;
+    }
+    if (!lookup_fragment(self, path, &f)) {
+        free(path);
+        return false;
+    }
+    free(path);
+    if (f == NULL) {
+        self->stats.missing++;
+        return true;
+    }
+
+    return append_fragment(list, f, directive, load);
+}
+
+bool
+tree_sitter_rpmspec_include_resolve(TSRpmspecIncludeResolver *self,
+                                    const TSTree *tree,
+                                    const char *source,
+                                    const char *base_dir,
+                                    TSRpmspecMacros *macros,
+                                    TSRpmspecFragment **fragments,
+                                    uint32_t *count)
+{
+    struct fragment_list list = {0};
+    TSQueryMatch match;
+
+    ts_query_cursor_exec(self->cursor, self->query, ts_tree_root_node(tree));
+    while (ts_query_cursor_next_match(self->cursor, &match)) {
+        TSNode name = {0};
+        TSNode directive = {0};
+        uint16_t i;
+
+        for (i = 0; i < match.capture_count; i++) {
+            if (match.captures[i].index == self->name_capture) {
+                name = match.captures[i].node;
+            } else if (match.captures[i].index == self->directive_capture) {
+                directive = match.captures[i].node;
+            }
+        }
+
+        if (!resolve_directive(self, source, base_dir, macros, name,
+                               directive, &list)) {
+            int saved_errno = errno;
+
+            tree_sitter_rpmspec_include_fragments_free(list.items, list.count);
+            errno = saved_errno;
+            return false;
+        }
+    }
+
+    *fragments = list.items;
+    *count = list.count;
+
+    return true;
+}
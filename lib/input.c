@@ -0,0 +1,135 @@
+/*
+ * Parsing spec files through a memory-mapped TSInput
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <tree_sitter/tree-sitter-rpmspec-input.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+struct mapped_file {
+    const char *data;
+    uint32_t size;
+};
+
+static const char *
+read_mapped(void *payload,
+            uint32_t byte_index,
+            TSPoint position,
+            uint32_t *bytes_read)
+{
+    const struct mapped_file *file = payload;
+
+    (void)position;
+
+    if (byte_index >= file->size) {
+        *bytes_read = 0;
+        return "";
+    }
+
+    /* Hand out the rest of the file at once, the lexer walks it in place. */
+    *bytes_read = file->size - byte_index;
+
+    return file->data + byte_index;
+}
+
+static uint64_t
+now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+TSTree *
+tree_sitter_rpmspec_parse_file(TSParser *parser,
+                               const TSTree *old_tree,
+                               const char *path,
+                               TSRpmspecParseStats *stats)
+{
+    struct mapped_file file = {.data = "", .size = 0};
+    void *mapping = NULL;
+    struct stat sb;
+    TSInput input;
+    TSTree *tree;
+    uint64_t start;
+    int saved_errno;
+    int fd;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &sb) != 0) {
+        goto fail;
+    }
+    if (!S_ISREG(sb.st_mode)) {
+        errno = EINVAL;
+        goto fail;
+    }
+    if ((uint64_t)sb.st_size > UINT32_MAX) {
+        errno = EFBIG;
+        goto fail;
+    }
+
+    /* mmap() rejects empty mappings, an empty file parses from "". */
+    if (sb.st_size > 0) {
+        mapping =
+            mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            goto fail;
+        }
+        posix_madvise(mapping, (size_t)sb.st_size, POSIX_MADV_SEQUENTIAL);
+        file.data = mapping;
+        file.size = (uint32_t)sb.st_size;
+    }
+    close(fd);
+
+    input = (TSInput){
+        .payload = &file,
+        .read = read_mapped,
+        .encoding = TSInputEncodingUTF8,
+        .decode = NULL,
+    };
+
+    start = now_ns();
+    tree = ts_parser_parse(parser, old_tree, input);
+
+    if (stats != NULL) {
+        stats->parse_time_ns = now_ns() - start;
+        stats->bytes = file.size;
+        stats->nodes = 0;
+        stats->has_error = false;
+        if (tree != NULL) {
+            TSNode root = ts_tree_root_node(tree);
+
+            stats->nodes = ts_node_descendant_count(root);
+            stats->has_error = ts_node_has_error(root);
+        }
+    }
+
+    if (mapping != NULL) {
+        munmap(mapping, file.size);
+    }
+    if (tree == NULL) {
+        errno = ECANCELED;
+    }
+
+    return tree;
+
+fail:
+    saved_errno = errno;
+    close(fd);
+    errno = saved_errno;
+
+    return NULL;
+}
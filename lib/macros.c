@@ -0,0 +1,2288 @@
+/*
+ * Previewing macro expansion from a spec tree
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <tree_sitter/tree-sitter-rpmspec-macros.h>
+
+#include "common.h"
+
+#include <ctype.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/* rpm gives up on deeper recursion as well */
+#define MACROS_MAX_DEPTH 64
+#define MACROS_MIN_CAPACITY 64
+/* Nesting of ( and unary operators in a condition */
+#define EXPR_MAX_DEPTH 64
+
+enum macros_symbol {
+    SYM_MACRO_DEFINITION,
+    SYM_MACRO_UNDEFINITION,
+    SYM_MACRO_EXPANSION_CALL,
+    SYM_CONDITIONAL_EXPANSION,
+    SYM_TAGS,
+    SYM_TAG,
+    SYM_PACKAGE,
+    SYM_IF_STATEMENT,
+    SYM_IFARCH_STATEMENT,
+    SYM_IFOS_STATEMENT,
+    SYM_ELIF_CLAUSE,
+    SYM_ELIFARCH_CLAUSE,
+    SYM_ELIFOS_CLAUSE,
+    SYM_ELSE_CLAUSE,
+    SYM_CHANGELOG,
+    SYM_IDENTIFIER,
+    SYM_MAX,
+};
+
+static const char *const macros_symbol_names[SYM_MAX] = {
+    [SYM_MACRO_DEFINITION] = "macro_definition",
+    [SYM_MACRO_UNDEFINITION] = "macro_undefinition",
+    [SYM_MACRO_EXPANSION_CALL] = "macro_expansion_call",
+    [SYM_CONDITIONAL_EXPANSION] = "conditional_expansion",
+    [SYM_TAGS] = "tags",
+    [SYM_TAG] = "tag",
+    [SYM_PACKAGE] = "package",
+    [SYM_IF_STATEMENT] = "if_statement",
+    [SYM_IFARCH_STATEMENT] = "ifarch_statement",
+    [SYM_IFOS_STATEMENT] = "ifos_statement",
+    [SYM_ELIF_CLAUSE] = "elif_clause",
+    [SYM_ELIFARCH_CLAUSE] = "elifarch_clause",
+    [SYM_ELIFOS_CLAUSE] = "elifos_clause",
+    [SYM_ELSE_CLAUSE] = "else_clause",
+    [SYM_CHANGELOG] = "changelog",
+    [SYM_IDENTIFIER] = "identifier",
+};
+
+enum macros_field {
+    FIELD_CONDITION,
+    FIELD_CONSEQUENCE,
+    FIELD_NAME,
+    FIELD_OPERATOR,
+    FIELD_VALUE,
+    FIELD_MAX,
+};
+
+static const char *const macros_field_names[FIELD_MAX] = {
+    [FIELD_CONDITION] = "condition",
+    [FIELD_CONSEQUENCE] = "consequence",
+    [FIELD_NAME] = "name",
+    [FIELD_OPERATOR] = "operator",
+    [FIELD_VALUE] = "value",
+};
+
+/*
+ * The arch groups of rpm's macros file, predefined with a target unless
+ * they are defined already
+ */
+static const char *const arch_groups[][2] = {
+    {"ix86", "i386 i486 i586 i686 pentium3 pentium4 athlon geode"},
+    {"x86_64", "x86_64 amd64 em64t"},
+    {"arm32", "armv3l armv4b armv4l armv4tl armv5tl armv5tel armv5tejl armv6l "
+              "armv6hl armv7l armv7hl armv7hnl armv8l armv8hl armv8hnl "
+              "armv8hcnl"},
+    {"arm", "%{arm32}"},
+    {"arm64", "aarch64"},
+    {"power64", "ppc64 ppc64p7 ppc64le"},
+    {"mips32", "mips mipsel mipsr6 mipsr6el"},
+    {"mips64", "mips64 mips64el mips64r6 mips64r6el"},
+    {"mips", "%{mips32} %{mips64}"},
+    {"riscv32", "riscv32"},
+    {"riscv64", "riscv64"},
+    {"riscv", "%{riscv32} %{riscv64}"},
+    {"sparc", "sparc sparcv8 sparcv9 sparcv9v sparc64 sparc64v"},
+    {"alpha", "alpha alphaev56 alphaev6 alphaev67"},
+};
+
+/* Tags of the main package that rpm also defines as macros */
+static const char *const tag_macros[] = {
+    "name", "version", "release", "epoch", "summary", "license", "url",
+};
+
+struct buffer {
+    char *data;
+    size_t length;
+    size_t capacity;
+};
+
+/* A set of macros by id, e.g. the ones read while expanding a value */
+struct uses {
+    uint32_t *ids;
+    uint32_t count;
+    uint32_t capacity;
+    uint64_t mark;
+    uint32_t saved; /* Where its entries start in `saved_marks` */
+};
+
+/* The mark a macro had before it was added to the innermost set of uses */
+struct saved_mark {
+    uint32_t id;
+    uint64_t mark;
+};
+
+struct macro {
+    char *name;
+    uint32_t length;
+    uint32_t hash;
+    uint32_t id; /* Index in `entries`, stable for the life of the table */
+    char *base;  /* From tree_sitter_rpmspec_macros_define() */
+    char *body;  /* NULL if not defined, may be `base` */
+    bool expanding;
+    char *memo;
+    size_t memo_length;
+    uint64_t memo_generation;
+    struct uses memo_uses; /* Macros the memo was expanded from */
+    uint64_t mark;         /* The last set of uses it was added to */
+    uint64_t dirty;        /* The update that changed it */
+    char *previous;        /* The body before the running update */
+};
+
+/* A definition or, without a body, an undefinition */
+struct op {
+    uint32_t id;
+    char *body;
+};
+
+/*
+ * What walking one child of the root did. An update replays the definitions
+ * of a child that was not edited and read no macro that changed, instead of
+ * walking it again.
+ */
+struct segment {
+    struct op *ops;
+    uint32_t op_count;
+    uint32_t op_capacity;
+    struct uses uses;
+    /* Relative to the start of the child */
+    TSRange *dead;
+    uint32_t dead_count;
+    uint32_t dead_capacity;
+    bool in_package;
+    bool in_package_after;
+    uint32_t definitions;
+    uint32_t conditions;
+    uint32_t unresolved_conditions;
+};
+
+struct TSRpmspecMacros {
+    /* Open addressing over `entries`, which never shrinks */
+    struct macro **slots;
+    uint32_t capacity;
+    struct macro **entries;
+    uint32_t count;
+    uint32_t entries_capacity;
+    /* Bumped by every definition, memos of older generations are stale */
+    uint64_t generation;
+    bool failed;
+    TSRpmspecMacrosStats stats;
+
+    /* One per child of the root of the tree last loaded or updated */
+    struct segment *segments;
+    uint32_t segment_count;
+    bool segments_valid;
+
+    /* Where the running walk and expansion record to, or NULL */
+    struct segment *recording;
+    uint32_t recording_byte;
+    TSPoint recording_point;
+    struct uses *uses;
+    uint64_t mark;
+    struct saved_mark *saved_marks;
+    uint32_t saved_count;
+    uint32_t saved_capacity;
+    uint64_t update;
+
+    /* Set by a load */
+    const TSLanguage *language;
+    char *arch;
+    char *os;
+    TSRange *dead;
+    uint32_t dead_count;
+    uint32_t dead_capacity;
+    TSSymbol symbols[SYM_MAX];
+    TSFieldId fields[FIELD_MAX];
+    const char *source;
+    bool in_package;
+};
+
+static void
+expand_text(TSRpmspecMacros *self,
+            struct buffer *out,
+            const char *text,
+            size_t length,
+            int depth);
+
+/*
+ * Buffers
+ */
+
+static void
+buffer_append(TSRpmspecMacros *self,
+              struct buffer *buffer,
+              const char *data,
+              size_t length)
+{
+    if (buffer->length + length + 1 > buffer->capacity) {
+        size_t capacity = buffer->capacity > 0 ? buffer->capacity : 64;
+        char *new_data;
+
+        while (buffer->length + length + 1 > capacity) {
+            capacity *= 2;
+        }
+        new_data = realloc(buffer->data, capacity);
+        if (new_data == NULL) {
+            self->failed = true;
+            return;
+        }
+        buffer->data = new_data;
+        buffer->capacity = capacity;
+    }
+
+    memcpy(buffer->data + buffer->length, data, length);
+    buffer->length += length;
+    buffer->data[buffer->length] = '\0';
+}
+
+static void
+buffer_append_char(TSRpmspecMacros *self, struct buffer *buffer, char c)
+{
+    buffer_append(self, buffer, &c, 1);
+}
+
+/* Make sure the buffer holds a string, even an empty one */
+static void
+buffer_terminate(TSRpmspecMacros *self, struct buffer *buffer)
+{
+    buffer_append(self, buffer, "", 0);
+}
+
+/*
+ * The definition table
+ */
+
+static uint32_t
+hash_name(const char *name, size_t length)
+{
+    uint32_t hash = 2166136261u;
+    size_t i;
+
+    for (i = 0; i < length; i++) {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static struct macro **
+find_slot(struct macro **slots,
+          uint32_t capacity,
+          const char *name,
+          size_t length,
+          uint32_t hash)
+{
+    uint32_t i = hash & (capacity - 1);
+
+    for (;;) {
+        struct macro *m = slots[i];
+
+        if (m == NULL || (m->hash == hash && m->length == length &&
+                          memcmp(m->name, name, length) == 0)) {
+            return &slots[i];
+        }
+        i = (i + 1) & (capacity - 1);
+    }
+}
+
+static bool
+grow_table(TSRpmspecMacros *self)
+{
+    uint32_t capacity = self->capacity * 2;
+    struct macro **slots;
+    uint32_t i;
+
+    slots = calloc(capacity, sizeof(*slots));
+    if (slots == NULL) {
+        return false;
+    }
+    for (i = 0; i < self->count; i++) {
+        struct macro *m = self->entries[i];
+
+        *find_slot(slots, capacity, m->name, m->length, m->hash) = m;
+    }
+    free(self->slots);
+    self->slots = slots;
+    self->capacity = capacity;
+
+    return true;
+}
+
+static struct macro *
+insert(TSRpmspecMacros *self, const char *name, size_t length)
+{
+    uint32_t hash = hash_name(name, length);
+    struct macro **slot;
+    struct macro *m;
+
+    slot = find_slot(self->slots, self->capacity, name, length, hash);
+    if (*slot != NULL) {
+        return *slot;
+    }
+
+    if ((self->count + 1) * 4 > self->capacity * 3) {
+        if (!grow_table(self)) {
+            self->failed = true;
+            return NULL;
+        }
+        slot = find_slot(self->slots, self->capacity, name, length, hash);
+    }
+    if (!rpmspec_grow32((void **)&self->entries, &self->entries_capacity,
+                        self->count, sizeof(*self->entries),
+                        MACROS_MIN_CAPACITY)) {
+        self->failed = true;
+        return NULL;
+    }
+
+    m = calloc(1, sizeof(*m));
+    if (m == NULL || (m->name = malloc(length + 1)) == NULL) {
+        free(m);
+        self->failed = true;
+        return NULL;
+    }
+    memcpy(m->name, name, length);
+    m->name[length] = '\0';
+    m->length = (uint32_t)length;
+    m->hash = hash;
+    m->id = self->count;
+    self->entries[self->count++] = m;
+    *slot = m;
+
+    return m;
+}
+
+/*
+ * Sets of uses nest, the one of a value inside the one of the child of the
+ * root or of the value reading it. A macro only has the mark of the
+ * innermost set, so adding it to that set saves the mark it had, and
+ * uses_end() puts it back for the enclosing set to still see the macro.
+ */
+static void
+uses_begin(TSRpmspecMacros *self, struct uses *uses)
+{
+    uses->count = 0;
+    uses->mark = ++self->mark;
+    uses->saved = self->saved_count;
+}
+
+static void
+uses_end(TSRpmspecMacros *self, struct uses *uses)
+{
+    while (self->saved_count > uses->saved) {
+        struct saved_mark *saved = &self->saved_marks[--self->saved_count];
+
+        self->entries[saved->id]->mark = saved->mark;
+    }
+}
+
+/* Add `m` to `uses`, the innermost set */
+static void
+uses_add(TSRpmspecMacros *self, struct uses *uses, struct macro *m)
+{
+    if (m->mark == uses->mark) {
+        return;
+    }
+    if (!rpmspec_grow32((void **)&uses->ids, &uses->capacity, uses->count,
+                        sizeof(*uses->ids), 8) ||
+        !rpmspec_grow32((void **)&self->saved_marks, &self->saved_capacity,
+                        self->saved_count, sizeof(*self->saved_marks), 16)) {
+        self->failed = true;
+        return;
+    }
+    self->saved_marks[self->saved_count].id = m->id;
+    self->saved_marks[self->saved_count].mark = m->mark;
+    self->saved_count++;
+    m->mark = uses->mark;
+    uses->ids[uses->count++] = m->id;
+}
+
+/* Macros that are not defined are recorded as uses too, they may be later */
+static struct macro *
+lookup(TSRpmspecMacros *self, const char *name, size_t length)
+{
+    struct macro *m;
+
+    if (self->uses != NULL) {
+        m = insert(self, name, length);
+        if (m == NULL) {
+            return NULL;
+        }
+        uses_add(self, self->uses, m);
+    } else {
+        m = *find_slot(self->slots, self->capacity, name, length,
+                       hash_name(name, length));
+    }
+
+    return m != NULL && m->body != NULL ? m : NULL;
+}
+
+static void
+set_body(TSRpmspecMacros *self, struct macro *m, char *body)
+{
+    if (m->body != m->base) {
+        free(m->body);
+    }
+    m->body = body;
+    self->generation++;
+}
+
+/* Copy a body from the source; rpm drops the backslash of a continuation */
+static char *
+copy_body(TSRpmspecMacros *self, const char *text, size_t length)
+{
+    char *body = malloc(length + 1);
+    size_t i;
+    size_t n = 0;
+
+    if (body == NULL) {
+        self->failed = true;
+        return NULL;
+    }
+    for (i = 0; i < length; i++) {
+        if (text[i] == '\\' && i + 1 < length && text[i + 1] == '\n') {
+            continue;
+        }
+        body[n++] = text[i];
+    }
+    body[n] = '\0';
+
+    return body;
+}
+
+/* Remember a definition of the walk, so that an update can replay it */
+static void
+record(TSRpmspecMacros *self, struct macro *m, const char *body)
+{
+    struct segment *segment = self->recording;
+    struct op *op;
+
+    m->dirty = self->update;
+    if (!rpmspec_grow32((void **)&segment->ops, &segment->op_capacity,
+                        segment->op_count, sizeof(*segment->ops), 4)) {
+        self->failed = true;
+        return;
+    }
+    op = &segment->ops[segment->op_count];
+    op->id = m->id;
+    op->body = NULL;
+    if (body != NULL && (op->body = strdup(body)) == NULL) {
+        self->failed = true;
+        return;
+    }
+    segment->op_count++;
+}
+
+static void
+define(TSRpmspecMacros *self,
+       const char *name,
+       size_t length,
+       char *body)
+{
+    struct macro *m;
+
+    if (body == NULL) {
+        return;
+    }
+    m = insert(self, name, length);
+    if (m == NULL) {
+        free(body);
+        return;
+    }
+    if (self->recording != NULL) {
+        record(self, m, body);
+    }
+    set_body(self, m, body);
+    self->stats.definitions++;
+}
+
+static void
+undefine(TSRpmspecMacros *self, const char *name, size_t length)
+{
+    struct macro *m = insert(self, name, length);
+
+    if (m == NULL) {
+        return;
+    }
+    if (self->recording != NULL) {
+        record(self, m, NULL);
+    }
+    if (m->body != NULL) {
+        set_body(self, m, NULL);
+    }
+}
+
+static void
+segment_free(struct segment *segment)
+{
+    uint32_t i;
+
+    for (i = 0; i < segment->op_count; i++) {
+        free(segment->ops[i].body);
+    }
+    free(segment->ops);
+    free(segment->uses.ids);
+    free(segment->dead);
+}
+
+static void
+segments_clear(TSRpmspecMacros *self)
+{
+    uint32_t i;
+
+    for (i = 0; i < self->segment_count; i++) {
+        segment_free(&self->segments[i]);
+    }
+    free(self->segments);
+    self->segments = NULL;
+    self->segment_count = 0;
+    self->segments_valid = false;
+}
+
+TSRpmspecMacros *
+tree_sitter_rpmspec_macros_new(void)
+{
+    TSRpmspecMacros *self = calloc(1, sizeof(*self));
+
+    if (self == NULL) {
+        return NULL;
+    }
+    self->capacity = MACROS_MIN_CAPACITY;
+    self->entries_capacity = MACROS_MIN_CAPACITY;
+    self->slots = calloc(self->capacity, sizeof(*self->slots));
+    self->entries = calloc(self->entries_capacity, sizeof(*self->entries));
+    if (self->slots == NULL || self->entries == NULL) {
+        free(self->slots);
+        free(self->entries);
+        free(self);
+        return NULL;
+    }
+    self->generation = 1;
+
+    return self;
+}
+
+void
+tree_sitter_rpmspec_macros_delete(TSRpmspecMacros *self)
+{
+    uint32_t i;
+
+    if (self == NULL) {
+        return;
+    }
+    for (i = 0; i < self->count; i++) {
+        struct macro *m = self->entries[i];
+
+        if (m->body != m->base) {
+            free(m->body);
+        }
+        free(m->base);
+        free(m->memo);
+        free(m->memo_uses.ids);
+        free(m->name);
+        free(m);
+    }
+    segments_clear(self);
+    free(self->arch);
+    free(self->os);
+    free(self->dead);
+    free(self->entries);
+    free(self->saved_marks);
+    free(self->slots);
+    free(self);
+}
+
+bool
+tree_sitter_rpmspec_macros_define(TSRpmspecMacros *self,
+                                  const char *name,
+                                  const char *body)
+{
+    struct macro *m;
+    char *base;
+
+    self->failed = false;
+    base = copy_body(self, body, strlen(body));
+    if (base == NULL) {
+        return false;
+    }
+    m = insert(self, name, strlen(name));
+    if (m == NULL) {
+        free(base);
+        return false;
+    }
+    if (m->body != m->base) {
+        free(m->body);
+    }
+    free(m->base);
+    m->base = base;
+    m->body = base;
+    self->generation++;
+
+    /* The recorded walk assumed the old predefined macros */
+    segments_clear(self);
+
+    return true;
+}
+
+/*
+ * Expansion
+ */
+
+static bool
+is_name_start(char c)
+{
+    return isalpha((unsigned char)c) || c == '_';
+}
+
+static bool
+is_name_char(char c)
+{
+    return isalnum((unsigned char)c) || c == '_';
+}
+
+/* The index of the bracket closing the one at `open`, or `length` */
+static size_t
+matching(const char *text, size_t length, size_t open)
+{
+    char left = text[open];
+    char right = left == '{' ? '}' : left == '(' ? ')' : ']';
+    size_t level = 0;
+    size_t i;
+
+    for (i = open; i < length; i++) {
+        if (text[i] == left) {
+            level++;
+        } else if (text[i] == right && --level == 0) {
+            return i;
+        }
+    }
+
+    return length;
+}
+
+/* The value of `m`, expanded and memoized. NULL on a recursive definition. */
+static const char *
+macro_value(TSRpmspecMacros *self, struct macro *m, size_t *length, int depth)
+{
+    struct uses *outer = self->uses;
+    struct buffer value = {0};
+    uint32_t i;
+
+    if (m->memo != NULL && m->memo_generation == self->generation) {
+        self->stats.memo_hits++;
+        for (i = 0; outer != NULL && i < m->memo_uses.count; i++) {
+            uses_add(self, outer, self->entries[m->memo_uses.ids[i]]);
+        }
+        *length = m->memo_length;
+        return m->memo;
+    }
+    if (m->expanding || depth >= MACROS_MAX_DEPTH) {
+        return NULL;
+    }
+
+    /* Whoever reads this value reads what it is expanded from as well */
+    uses_begin(self, &m->memo_uses);
+    self->uses = &m->memo_uses;
+    m->expanding = true;
+    expand_text(self, &value, m->body, strlen(m->body), depth + 1);
+    buffer_terminate(self, &value);
+    m->expanding = false;
+    uses_end(self, &m->memo_uses);
+    self->uses = outer;
+    for (i = 0; outer != NULL && i < m->memo_uses.count; i++) {
+        uses_add(self, outer, self->entries[m->memo_uses.ids[i]]);
+    }
+    if (self->failed) {
+        free(value.data);
+        return NULL;
+    }
+    self->stats.expansions++;
+
+    free(m->memo);
+    m->memo = value.data;
+    m->memo_length = value.length;
+    m->memo_generation = self->generation;
+    *length = m->memo_length;
+
+    return m->memo;
+}
+
+static void
+trim(const char **text, size_t *length)
+{
+    while (*length > 0 && isspace((unsigned char)**text)) {
+        (*text)++;
+        (*length)--;
+    }
+    while (*length > 0 && isspace((unsigned char)(*text)[*length - 1])) {
+        (*length)--;
+    }
+}
+
+static bool
+is_defined(TSRpmspecMacros *self,
+           const char *prefix,
+           const char *name,
+           size_t length)
+{
+    char buf[256];
+    size_t prefix_length = strlen(prefix);
+
+    trim(&name, &length);
+    if (prefix_length + length > sizeof(buf)) {
+        return false;
+    }
+    memcpy(buf, prefix, prefix_length);
+    memcpy(buf + prefix_length, name, length);
+
+    return lookup(self, buf, prefix_length + length) != NULL;
+}
+
+/* Builtins that take an argument. Returns false for unsupported ones. */
+static bool
+expand_builtin(TSRpmspecMacros *self,
+               struct buffer *out,
+               const char *name,
+               size_t name_length,
+               const char *arg,
+               size_t arg_length,
+               int depth)
+{
+    struct buffer value = {0};
+    size_t i;
+
+#define IS(s)                                                                  \
+    (name_length == sizeof(s) - 1 && memcmp(name, s, name_length) == 0)
+    if (IS("defined") || IS("undefined")) {
+        bool defined = is_defined(self, "", arg, arg_length);
+
+        buffer_append_char(self, out, defined == IS("defined") ? '1' : '0');
+        return true;
+    }
+    if (IS("with") || IS("without")) {
+        bool defined = is_defined(self, "with_", arg, arg_length);
+
+        buffer_append_char(self, out, defined == IS("with") ? '1' : '0');
+        return true;
+    }
+    if (!IS("expand") && !IS("basename") && !IS("dirname") && !IS("lower") &&
+        !IS("upper") && !IS("len") && !IS("quote")) {
+        return false;
+    }
+
+    expand_text(self, &value, arg, arg_length, depth + 1);
+    buffer_terminate(self, &value);
+    if (self->failed) {
+        free(value.data);
+        return true;
+    }
+
+    if (IS("expand")) {
+        expand_text(self, out, value.data, value.length, depth + 1);
+    } else if (IS("basename")) {
+        const char *slash = strrchr(value.data, '/');
+
+        if (slash != NULL) {
+            buffer_append(self, out, slash + 1, strlen(slash + 1));
+        } else {
+            buffer_append(self, out, value.data, value.length);
+        }
+    } else if (IS("dirname")) {
+        const char *slash = strrchr(value.data, '/');
+
+        buffer_append(self, out, value.data,
+                      slash != NULL ? (size_t)(slash - value.data)
+                                    : value.length);
+    } else if (IS("lower") || IS("upper")) {
+        for (i = 0; i < value.length; i++) {
+            unsigned char c = (unsigned char)value.data[i];
+
+            value.data[i] = (char)(IS("lower") ? tolower(c) : toupper(c));
+        }
+        buffer_append(self, out, value.data, value.length);
+    } else if (IS("len")) {
+        char number[24];
+
+        snprintf(number, sizeof(number), "%zu", value.length);
+        buffer_append(self, out, number, strlen(number));
+    } else {
+        buffer_append(self, out, value.data, value.length);
+    }
+#undef IS
+
+    free(value.data);
+
+    return true;
+}
+
+/*
+ * Expand one macro use. `verbatim` is the whole use, it is kept when the
+ * macro cannot be expanded. `arg` is what follows the name after a colon.
+ */
+static void
+expand_use(TSRpmspecMacros *self,
+           struct buffer *out,
+           const char *verbatim,
+           size_t verbatim_length,
+           const char *body,
+           size_t body_length,
+           int depth)
+{
+    bool conditional = false;
+    bool negate = false;
+    const char *arg = NULL;
+    size_t arg_length = 0;
+    bool has_args = false;
+    const char *name;
+    size_t name_length;
+    struct macro *m;
+    size_t i = 0;
+
+    while (i < body_length && (body[i] == '!' || body[i] == '?')) {
+        if (body[i] == '!') {
+            negate = !negate;
+        } else {
+            conditional = true;
+        }
+        i++;
+    }
+    if (i == body_length || !is_name_start(body[i])) {
+        buffer_append(self, out, verbatim, verbatim_length);
+        return;
+    }
+
+    name = body + i;
+    while (i < body_length && is_name_char(body[i])) {
+        i++;
+    }
+    name_length = (size_t)(body + i - name);
+
+    if (i < body_length && body[i] == ':') {
+        arg = body + i + 1;
+        arg_length = body_length - i - 1;
+    } else if (i < body_length && isspace((unsigned char)body[i])) {
+        arg = body + i + 1;
+        arg_length = body_length - i - 1;
+        has_args = true;
+    } else if (i < body_length) {
+        buffer_append(self, out, verbatim, verbatim_length);
+        return;
+    }
+
+    if (!conditional && arg != NULL &&
+        expand_builtin(self, out, name, name_length, arg, arg_length, depth)) {
+        return;
+    }
+
+    m = lookup(self, name, name_length);
+    if (conditional) {
+        if ((m != NULL) == negate) {
+            return;
+        }
+        if (arg != NULL && !has_args) {
+            expand_text(self, out, arg, arg_length, depth + 1);
+            return;
+        }
+        if (negate) {
+            return;
+        }
+    } else if (m == NULL) {
+        if (name_length == 3 && memcmp(name, "nil", 3) == 0) {
+            return;
+        }
+        buffer_append(self, out, verbatim, verbatim_length);
+        return;
+    }
+
+    /* Arguments of parametric macros are not substituted */
+    {
+        size_t length;
+        const char *value = macro_value(self, m, &length, depth);
+
+        if (value == NULL) {
+            buffer_append(self, out, verbatim, verbatim_length);
+        } else {
+            buffer_append(self, out, value, length);
+        }
+    }
+}
+
+static void
+expand_text(TSRpmspecMacros *self,
+            struct buffer *out,
+            const char *text,
+            size_t length,
+            int depth)
+{
+    size_t i = 0;
+
+    if (depth >= MACROS_MAX_DEPTH) {
+        buffer_append(self, out, text, length);
+        return;
+    }
+
+    while (i < length && !self->failed) {
+        const char *percent = memchr(text + i, '%', length - i);
+        size_t start;
+        size_t end;
+
+        if (percent == NULL) {
+            buffer_append(self, out, text + i, length - i);
+            return;
+        }
+        start = (size_t)(percent - text);
+        buffer_append(self, out, text + i, start - i);
+
+        if (start + 1 == length) {
+            buffer_append_char(self, out, '%');
+            return;
+        }
+
+        switch (text[start + 1]) {
+        case '%':
+            buffer_append_char(self, out, '%');
+            i = start + 2;
+            break;
+        case '{':
+            end = matching(text, length, start + 1);
+            if (end == length) {
+                buffer_append(self, out, text + start, length - start);
+                return;
+            }
+            expand_use(self, out, text + start, end + 1 - start,
+                       text + start + 2, end - start - 2, depth);
+            i = end + 1;
+            break;
+        case '(':
+        case '[':
+            /* Shell commands and expressions are not run */
+            end = matching(text, length, start + 1);
+            end = end < length ? end + 1 : length;
+            buffer_append(self, out, text + start, end - start);
+            i = end;
+            break;
+        default:
+            end = start + 1;
+            while (end < length && (text[end] == '!' || text[end] == '?')) {
+                end++;
+            }
+            if (end == length || !is_name_start(text[end])) {
+                buffer_append_char(self, out, '%');
+                i = start + 1;
+                break;
+            }
+            while (end < length && is_name_char(text[end])) {
+                end++;
+            }
+            expand_use(self, out, text + start, end - start, text + start + 1,
+                       end - start - 1, depth);
+            i = end;
+            break;
+        }
+    }
+}
+
+char *
+tree_sitter_rpmspec_macros_expand(TSRpmspecMacros *self,
+                                  const char *text,
+                                  uint32_t length,
+                                  uint32_t *expanded_length)
+{
+    struct buffer out = {0};
+
+    self->failed = false;
+    expand_text(self, &out, text, length, 0);
+    buffer_terminate(self, &out);
+    if (self->failed) {
+        free(out.data);
+        return NULL;
+    }
+    if (expanded_length != NULL) {
+        *expanded_length = (uint32_t)out.length;
+    }
+
+    return out.data;
+}
+
+const char *
+tree_sitter_rpmspec_macros_get(TSRpmspecMacros *self,
+                               const char *name,
+                               uint32_t *length)
+{
+    struct macro *m = lookup(self, name, strlen(name));
+    const char *value;
+    size_t value_length;
+
+    if (m == NULL) {
+        return NULL;
+    }
+    self->failed = false;
+    value = macro_value(self, m, &value_length, 0);
+    if (value != NULL && length != NULL) {
+        *length = (uint32_t)value_length;
+    }
+
+    return value;
+}
+
+/*
+ * Conditions, evaluated like rpm's expression parser on the expanded text
+ */
+
+struct expr {
+    const char *p;
+    const char *end;
+    int depth;
+};
+
+struct expr_value {
+    bool is_string;
+    long long number;
+    const char *string;
+    size_t length;
+};
+
+static bool expr_or(struct expr *e, struct expr_value *v);
+
+static void
+expr_skip(struct expr *e)
+{
+    while (e->p < e->end && isspace((unsigned char)*e->p)) {
+        e->p++;
+    }
+}
+
+static bool
+expr_accept(struct expr *e, const char *op)
+{
+    size_t length = strlen(op);
+
+    expr_skip(e);
+    if ((size_t)(e->end - e->p) >= length && memcmp(e->p, op, length) == 0) {
+        e->p += length;
+        return true;
+    }
+
+    return false;
+}
+
+static bool
+expr_true(const struct expr_value *v)
+{
+    return v->is_string ? v->length > 0 : v->number != 0;
+}
+
+static bool
+expr_primary(struct expr *e, struct expr_value *v)
+{
+    const char *start;
+
+    expr_skip(e);
+    if (e->p == e->end) {
+        return false;
+    }
+
+    if (*e->p == '(') {
+        e->p++;
+        if (!expr_or(e, v) || !expr_accept(e, ")")) {
+            return false;
+        }
+        return true;
+    }
+
+    if (*e->p == '"') {
+        start = ++e->p;
+        while (e->p < e->end && *e->p != '"') {
+            e->p++;
+        }
+        if (e->p == e->end) {
+            return false;
+        }
+        *v = (struct expr_value){true, 0, start, (size_t)(e->p - start)};
+        e->p++;
+        return true;
+    }
+
+    if (isdigit((unsigned char)*e->p)) {
+        long long number = 0;
+
+        while (e->p < e->end && isdigit((unsigned char)*e->p)) {
+            int digit = *e->p - '0';
+
+            if (number > (LLONG_MAX - digit) / 10) {
+                return false;
+            }
+            number = number * 10 + digit;
+            e->p++;
+        }
+        *v = (struct expr_value){false, number, NULL, 0};
+        return true;
+    }
+
+    /* Unexpanded macros and bare words compare as strings */
+    start = e->p;
+    while (e->p < e->end &&
+           (is_name_char(*e->p) || *e->p == '%' || *e->p == '{' ||
+            *e->p == '}' || *e->p == '?' || *e->p == '.')) {
+        e->p++;
+    }
+    if (e->p == start) {
+        return false;
+    }
+    *v = (struct expr_value){true, 0, start, (size_t)(e->p - start)};
+
+    return true;
+}
+
+/*
+ * Arithmetic that would overflow leaves the condition unresolved rather
+ * than undefined
+ */
+static bool
+expr_arith(char op, long long a, long long b, long long *result)
+{
+    switch (op) {
+    case '*':
+        if (a > 0 ? (b > 0 ? a > LLONG_MAX / b : b < LLONG_MIN / a)
+                  : (b > 0 ? a < LLONG_MIN / b : a != 0 && b < LLONG_MAX / a)) {
+            return false;
+        }
+        *result = a * b;
+        return true;
+    case '/':
+        if (b == 0 || (a == LLONG_MIN && b == -1)) {
+            return false;
+        }
+        *result = a / b;
+        return true;
+    case '+':
+        if (b > 0 ? a > LLONG_MAX - b : a < LLONG_MIN - b) {
+            return false;
+        }
+        *result = a + b;
+        return true;
+    default:
+        if (b < 0 ? a > LLONG_MAX + b : a < LLONG_MIN + b) {
+            return false;
+        }
+        *result = a - b;
+        return true;
+    }
+}
+
+/* Every nested ( and unary operator passes through here */
+static bool
+expr_unary(struct expr *e, struct expr_value *v)
+{
+    bool ok;
+
+    if (e->depth >= EXPR_MAX_DEPTH) {
+        return false;
+    }
+    e->depth++;
+    if (expr_accept(e, "!")) {
+        ok = expr_unary(e, v);
+        if (ok) {
+            *v = (struct expr_value){false, !expr_true(v), NULL, 0};
+        }
+    } else if (expr_accept(e, "-")) {
+        ok = expr_unary(e, v) && !v->is_string &&
+             expr_arith('-', 0, v->number, &v->number);
+    } else {
+        ok = expr_primary(e, v);
+    }
+    e->depth--;
+
+    return ok;
+}
+
+static bool
+expr_mul(struct expr *e, struct expr_value *v)
+{
+    struct expr_value rhs;
+
+    if (!expr_unary(e, v)) {
+        return false;
+    }
+    for (;;) {
+        char op;
+
+        if (expr_accept(e, "*")) {
+            op = '*';
+        } else if (expr_accept(e, "/")) {
+            op = '/';
+        } else {
+            return true;
+        }
+        if (!expr_unary(e, &rhs) || v->is_string || rhs.is_string ||
+            !expr_arith(op, v->number, rhs.number, &v->number)) {
+            return false;
+        }
+    }
+}
+
+static bool
+expr_add(struct expr *e, struct expr_value *v)
+{
+    struct expr_value rhs;
+
+    if (!expr_mul(e, v)) {
+        return false;
+    }
+    for (;;) {
+        char op;
+
+        if (expr_accept(e, "+")) {
+            op = '+';
+        } else if (expr_accept(e, "-")) {
+            op = '-';
+        } else {
+            return true;
+        }
+        if (!expr_mul(e, &rhs) || v->is_string || rhs.is_string ||
+            !expr_arith(op, v->number, rhs.number, &v->number)) {
+            return false;
+        }
+    }
+}
+
+static bool
+expr_compare(struct expr *e, struct expr_value *v)
+{
+    static const char *const ops[] = {"==", "!=", "<=", ">=", "<", ">"};
+    struct expr_value rhs;
+    size_t i;
+    int cmp;
+
+    if (!expr_add(e, v)) {
+        return false;
+    }
+    for (i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+        if (expr_accept(e, ops[i])) {
+            break;
+        }
+    }
+    if (i == sizeof(ops) / sizeof(ops[0])) {
+        return true;
+    }
+    if (!expr_add(e, &rhs) || v->is_string != rhs.is_string) {
+        return false;
+    }
+
+    if (v->is_string) {
+        size_t length = v->length < rhs.length ? v->length : rhs.length;
+
+        cmp = memcmp(v->string, rhs.string, length);
+        if (cmp == 0) {
+            cmp = (v->length > rhs.length) - (v->length < rhs.length);
+        }
+    } else {
+        cmp = (v->number > rhs.number) - (v->number < rhs.number);
+    }
+
+    switch (i) {
+    case 0:
+        cmp = cmp == 0;
+        break;
+    case 1:
+        cmp = cmp != 0;
+        break;
+    case 2:
+        cmp = cmp <= 0;
+        break;
+    case 3:
+        cmp = cmp >= 0;
+        break;
+    case 4:
+        cmp = cmp < 0;
+        break;
+    default:
+        cmp = cmp > 0;
+        break;
+    }
+    *v = (struct expr_value){false, cmp, NULL, 0};
+
+    return true;
+}
+
+static bool
+expr_and(struct expr *e, struct expr_value *v)
+{
+    struct expr_value rhs;
+
+    if (!expr_compare(e, v)) {
+        return false;
+    }
+    while (expr_accept(e, "&&")) {
+        if (!expr_compare(e, &rhs)) {
+            return false;
+        }
+        *v = (struct expr_value){false, expr_true(v) && expr_true(&rhs),
+                                 NULL, 0};
+    }
+
+    return true;
+}
+
+static bool
+expr_or(struct expr *e, struct expr_value *v)
+{
+    struct expr_value rhs;
+
+    if (!expr_and(e, v)) {
+        return false;
+    }
+    while (expr_accept(e, "||")) {
+        if (!expr_and(e, &rhs)) {
+            return false;
+        }
+        *v = (struct expr_value){false, expr_true(v) || expr_true(&rhs),
+                                 NULL, 0};
+    }
+
+    return true;
+}
+
+/* Expand and evaluate a condition. Returns false if it cannot be evaluated. */
+static bool
+evaluate(TSRpmspecMacros *self,
+         const char *text,
+         size_t length,
+         bool *result)
+{
+    struct buffer expanded = {0};
+    struct expr_value v;
+    struct expr e;
+    bool ok;
+
+    expand_text(self, &expanded, text, length, 0);
+    buffer_terminate(self, &expanded);
+    if (self->failed) {
+        free(expanded.data);
+        return false;
+    }
+
+    e = (struct expr){expanded.data, expanded.data + expanded.length, 0};
+    ok = expr_or(&e, &v);
+    expr_skip(&e);
+    ok = ok && e.p == e.end;
+    if (ok) {
+        *result = expr_true(&v);
+    }
+    free(expanded.data);
+
+    return ok;
+}
+
+/*
+ * Walking the tree
+ */
+
+static const char *
+node_text(const TSRpmspecMacros *self, TSNode node, size_t *length)
+{
+    *length = ts_node_end_byte(node) - ts_node_start_byte(node);
+
+    return self->source + ts_node_start_byte(node);
+}
+
+static bool
+resolve_language(TSRpmspecMacros *self, const TSLanguage *language)
+{
+    if (self->language == language) {
+        return true;
+    }
+    if (!rpmspec_resolve_symbols(language, macros_symbol_names, self->symbols,
+                                 SYM_MAX) ||
+        !rpmspec_resolve_fields(language, macros_field_names, self->fields,
+                                FIELD_MAX)) {
+        return false;
+    }
+    self->language = language;
+
+    return true;
+}
+
+static bool
+is_symbol(const TSRpmspecMacros *self, TSNode node, enum macros_symbol sym)
+{
+    return ts_node_symbol(node) == self->symbols[sym];
+}
+
+static void visit(TSRpmspecMacros *self, TSNode node);
+
+static void
+visit_macro_definition(TSRpmspecMacros *self, TSNode node)
+{
+    TSTreeCursor cursor = ts_tree_cursor_new(node);
+    TSNode name = {0};
+    bool global = false;
+    uint32_t start = 0;
+    uint32_t end = 0;
+    size_t length;
+    const char *text;
+
+    if (ts_tree_cursor_goto_first_child(&cursor)) {
+        do {
+            TSNode child = ts_tree_cursor_current_node(&cursor);
+            TSFieldId field = ts_tree_cursor_current_field_id(&cursor);
+
+            if (field == self->fields[FIELD_NAME]) {
+                name = child;
+            } else if (field == self->fields[FIELD_VALUE]) {
+                if (end == 0) {
+                    start = ts_node_start_byte(child);
+                }
+                end = ts_node_end_byte(child);
+            } else if (ts_node_is_named(child) && ts_node_is_null(name)) {
+                /* The builtin before the name, define or global */
+                text = node_text(self, child, &length);
+                global = length == 6 && memcmp(text, "global", 6) == 0;
+            }
+        } while (ts_tree_cursor_goto_next_sibling(&cursor));
+    }
+    ts_tree_cursor_delete(&cursor);
+
+    if (ts_node_is_null(name)) {
+        return;
+    }
+    text = node_text(self, name, &length);
+
+    /* %global expands its body right away, %define when it is used */
+    if (global) {
+        struct buffer value = {0};
+        char *body = copy_body(self, self->source + start, end - start);
+
+        if (body == NULL) {
+            return;
+        }
+        expand_text(self, &value, body, strlen(body), 0);
+        buffer_terminate(self, &value);
+        free(body);
+        define(self, text, length, value.data);
+    } else {
+        define(self, text, length,
+               copy_body(self, self->source + start, end - start));
+    }
+}
+
+static void
+visit_tags(TSRpmspecMacros *self, TSNode node)
+{
+    TSNode tag = ts_node_named_child(node, 0);
+    TSNode value;
+    struct buffer expanded = {0};
+    const char *text;
+    size_t length;
+    size_t i;
+
+    if (self->in_package || !is_symbol(self, tag, SYM_TAG)) {
+        return;
+    }
+
+    text = node_text(self, tag, &length);
+    for (i = 0; i < sizeof(tag_macros) / sizeof(tag_macros[0]); i++) {
+        if (strlen(tag_macros[i]) == length &&
+            strncasecmp(tag_macros[i], text, length) == 0) {
+            break;
+        }
+    }
+    if (i == sizeof(tag_macros) / sizeof(tag_macros[0])) {
+        return;
+    }
+
+    value = ts_node_child_by_field_id(node, self->fields[FIELD_VALUE]);
+    if (ts_node_is_null(value)) {
+        return;
+    }
+    text = node_text(self, value, &length);
+    expand_text(self, &expanded, text, length, 0);
+    buffer_terminate(self, &expanded);
+    define(self, tag_macros[i], strlen(tag_macros[i]), expanded.data);
+}
+
+/* %bcond_with NAME, %bcond_without NAME and %bcond NAME DEFAULT */
+static void
+visit_macro_call(TSRpmspecMacros *self, TSNode node)
+{
+    TSNode identifier = ts_node_named_child(node, 0);
+    TSNode args[2];
+    uint32_t arg_count = 0;
+    bool with = false;
+    size_t name_length;
+    const char *name;
+    char buf[256];
+    uint32_t count;
+    uint32_t i;
+
+    if (!is_symbol(self, identifier, SYM_IDENTIFIER)) {
+        return;
+    }
+    name = node_text(self, identifier, &name_length);
+    if (name_length < 5 || memcmp(name, "bcond", 5) != 0) {
+        return;
+    }
+
+    count = ts_node_named_child_count(node);
+    for (i = 1; i < count && arg_count < 2; i++) {
+        args[arg_count++] = ts_node_named_child(node, i);
+    }
+    if (arg_count == 0) {
+        return;
+    }
+
+    {
+        size_t length;
+        const char *text = node_text(self, args[0], &length);
+
+        if (length + 10 > sizeof(buf)) {
+            return;
+        }
+
+        if (name_length == 10 && memcmp(name, "bcond_with", 10) == 0) {
+            with = is_defined(self, "_with_", text, length);
+        } else if (name_length == 13 &&
+                   memcmp(name, "bcond_without", 13) == 0) {
+            with = !is_defined(self, "_without_", text, length);
+        } else if (name_length == 5 && arg_count == 2) {
+            const char *value;
+            size_t value_length;
+
+            value = node_text(self, args[1], &value_length);
+            if (!evaluate(self, value, value_length, &with)) {
+                with = false;
+            }
+            with = with ? !is_defined(self, "_without_", text, length)
+                        : is_defined(self, "_with_", text, length);
+        } else {
+            return;
+        }
+
+        if (with) {
+            memcpy(buf, "with_", 5);
+            memcpy(buf + 5, text, length);
+            define(self, buf, length + 5, copy_body(self, "1", 1));
+        }
+    }
+}
+
+static TSPoint
+point_sub(TSPoint point, TSPoint base)
+{
+    if (point.row == base.row) {
+        return (TSPoint){0, point.column - base.column};
+    }
+
+    return (TSPoint){point.row - base.row, point.column};
+}
+
+static TSPoint
+point_add(TSPoint point, TSPoint base)
+{
+    if (point.row == 0) {
+        return (TSPoint){base.row, base.column + point.column};
+    }
+
+    return (TSPoint){base.row + point.row, point.column};
+}
+
+static bool
+push_range(TSRange **ranges,
+           uint32_t *count,
+           uint32_t *capacity,
+           const TSRange *range)
+{
+    if (!rpmspec_grow32((void **)ranges, capacity, *count, sizeof(**ranges),
+                        8)) {
+        return false;
+    }
+    (*ranges)[(*count)++] = *range;
+
+    return true;
+}
+
+/* A branch body that is not taken for the target */
+static void
+add_dead(TSRpmspecMacros *self, TSRange range)
+{
+    struct segment *segment = self->recording;
+
+    if (!push_range(&self->dead, &self->dead_count, &self->dead_capacity,
+                    &range)) {
+        self->failed = true;
+        return;
+    }
+    if (segment == NULL) {
+        return;
+    }
+    range.start_byte -= self->recording_byte;
+    range.end_byte -= self->recording_byte;
+    range.start_point = point_sub(range.start_point, self->recording_point);
+    range.end_point = point_sub(range.end_point, self->recording_point);
+    if (!push_range(&segment->dead, &segment->dead_count,
+                    &segment->dead_capacity, &range)) {
+        self->failed = true;
+    }
+}
+
+enum branch_kind {
+    BRANCH_IF,
+    BRANCH_ARCH,
+    BRANCH_OS,
+    BRANCH_ELSE,
+};
+
+/* Longer keywords first, they share prefixes */
+static const struct {
+    const char *keyword;
+    enum branch_kind kind;
+    bool negate;
+} branch_keywords[] = {
+    {"%elifarch", BRANCH_ARCH, false}, {"%elifos", BRANCH_OS, false},
+    {"%elif", BRANCH_IF, false},       {"%else", BRANCH_ELSE, false},
+    {"%ifnarch", BRANCH_ARCH, true},   {"%ifarch", BRANCH_ARCH, false},
+    {"%ifnos", BRANCH_OS, true},       {"%ifos", BRANCH_OS, false},
+    {"%if", BRANCH_IF, false},
+};
+
+/* What the earlier branches of an %if, %ifarch or %ifos decided */
+struct chain {
+    bool taken; /* A branch was walked as the taken one */
+    bool known; /* A branch was known to be taken, the rest is dead */
+    bool all;   /* No target for %ifarch or %ifos, every branch is walked */
+};
+
+/* Whether the arch or OS list `text` names `target` */
+static bool
+matches_target(TSRpmspecMacros *self,
+               const char *target,
+               const char *text,
+               size_t length)
+{
+    struct buffer expanded = {0};
+    size_t target_length = strlen(target);
+    bool found = false;
+    size_t i = 0;
+
+    expand_text(self, &expanded, text, length, 0);
+    buffer_terminate(self, &expanded);
+    while (!self->failed && i < expanded.length && !found) {
+        size_t start;
+
+        while (i < expanded.length &&
+               (isspace((unsigned char)expanded.data[i]) ||
+                expanded.data[i] == ',')) {
+            i++;
+        }
+        start = i;
+        while (i < expanded.length &&
+               !isspace((unsigned char)expanded.data[i]) &&
+               expanded.data[i] != ',') {
+            i++;
+        }
+        found = i - start == target_length &&
+                memcmp(expanded.data + start, target, target_length) == 0;
+    }
+    free(expanded.data);
+
+    return found;
+}
+
+/*
+ * Evaluate the header of one branch. Returns false if it cannot be, or if
+ * it is an %ifarch or %ifos without a target.
+ */
+static bool
+evaluate_branch(TSRpmspecMacros *self,
+                TSNode node,
+                struct chain *chain,
+                bool *result,
+                uint32_t *header_end)
+{
+    uint32_t start = ts_node_start_byte(node);
+    uint32_t end = ts_node_end_byte(node);
+    const char *text = self->source + start;
+    const char *newline = memchr(text, '\n', end - start);
+    const char *target;
+    size_t length;
+    size_t i;
+
+    *header_end = newline != NULL ? (uint32_t)(newline - self->source) : end;
+    for (i = 0; i < sizeof(branch_keywords) / sizeof(branch_keywords[0]);
+         i++) {
+        length = strlen(branch_keywords[i].keyword);
+        if (length <= end - start &&
+            memcmp(text, branch_keywords[i].keyword, length) == 0) {
+            break;
+        }
+    }
+    if (i == sizeof(branch_keywords) / sizeof(branch_keywords[0])) {
+        return false;
+    }
+    text += length;
+    length = self->source + *header_end - text;
+
+    switch (branch_keywords[i].kind) {
+    case BRANCH_ELSE:
+        *result = true;
+        return true;
+    case BRANCH_IF:
+        self->stats.conditions++;
+        if (!evaluate(self, text, length, result)) {
+            self->stats.unresolved_conditions++;
+            return false;
+        }
+        return true;
+    default:
+        target = branch_keywords[i].kind == BRANCH_ARCH ? self->arch : self->os;
+        if (target == NULL) {
+            chain->all = true;
+            return false;
+        }
+        self->stats.conditions++;
+        *result = matches_target(self, target, text, length) !=
+                  branch_keywords[i].negate;
+        return true;
+    }
+}
+
+/*
+ * Walk one branch of a conditional, and the branches after it if `node` is
+ * the statement itself. rpm takes the first true branch; one that cannot be
+ * evaluated is taken as false.
+ */
+static void
+visit_branch(TSRpmspecMacros *self, TSNode node, struct chain *chain)
+{
+    TSTreeCursor cursor = ts_tree_cursor_new(node);
+    bool result = false;
+    uint32_t header_end;
+    TSRange body = {0};
+    bool known;
+    bool walk;
+    bool dead;
+
+    known = evaluate_branch(self, node, chain, &result, &header_end);
+    walk = chain->all || (!chain->taken && known && result);
+    dead = !chain->all && (chain->known || (known && !result));
+    chain->taken = chain->taken || walk;
+    chain->known = chain->known || (known && result);
+
+    if (ts_tree_cursor_goto_first_child(&cursor)) {
+        do {
+            TSNode child = ts_tree_cursor_current_node(&cursor);
+
+            if (ts_node_start_byte(child) <= header_end ||
+                !ts_node_is_named(child)) {
+                continue;
+            }
+            if (is_symbol(self, child, SYM_ELIF_CLAUSE) ||
+                is_symbol(self, child, SYM_ELIFARCH_CLAUSE) ||
+                is_symbol(self, child, SYM_ELIFOS_CLAUSE) ||
+                is_symbol(self, child, SYM_ELSE_CLAUSE)) {
+                /* The body ends where the first alternative starts */
+                if (body.end_byte != 0) {
+                    add_dead(self, body);
+                    body.end_byte = 0;
+                }
+                visit_branch(self, child, chain);
+            } else if (walk) {
+                visit(self, child);
+            } else if (dead) {
+                if (body.end_byte == 0) {
+                    body.start_byte = ts_node_start_byte(child);
+                    body.start_point = ts_node_start_point(child);
+                }
+                body.end_byte = ts_node_end_byte(child);
+                body.end_point = ts_node_end_point(child);
+            }
+        } while (ts_tree_cursor_goto_next_sibling(&cursor));
+    }
+    ts_tree_cursor_delete(&cursor);
+    if (body.end_byte != 0) {
+        add_dead(self, body);
+    }
+}
+
+static void
+visit_conditional_expansion(TSRpmspecMacros *self, TSNode node)
+{
+    TSNode condition;
+    TSNode consequence;
+    const char *name;
+    size_t length;
+    bool negate;
+
+    condition = ts_node_child_by_field_id(node, self->fields[FIELD_CONDITION]);
+    consequence =
+        ts_node_child_by_field_id(node, self->fields[FIELD_CONSEQUENCE]);
+    if (ts_node_is_null(condition) || ts_node_is_null(consequence)) {
+        return;
+    }
+    negate = !ts_node_is_null(
+        ts_node_child_by_field_id(node, self->fields[FIELD_OPERATOR]));
+    name = node_text(self, condition, &length);
+    if ((lookup(self, name, length) != NULL) != negate) {
+        visit(self, consequence);
+    }
+}
+
+static void
+visit(TSRpmspecMacros *self, TSNode node)
+{
+    TSSymbol symbol = ts_node_symbol(node);
+    const TSSymbol *symbols = self->symbols;
+    uint32_t count;
+    uint32_t i;
+
+    if (self->failed) {
+        return;
+    }
+
+    if (symbol == symbols[SYM_MACRO_DEFINITION]) {
+        visit_macro_definition(self, node);
+    } else if (symbol == symbols[SYM_MACRO_UNDEFINITION]) {
+        TSNode name =
+            ts_node_child_by_field_id(node, self->fields[FIELD_NAME]);
+        size_t length;
+        const char *text;
+
+        if (!ts_node_is_null(name)) {
+            text = node_text(self, name, &length);
+            undefine(self, text, length);
+        }
+    } else if (symbol == symbols[SYM_TAGS]) {
+        visit_tags(self, node);
+    } else if (symbol == symbols[SYM_PACKAGE]) {
+        self->in_package = true;
+    } else if (symbol == symbols[SYM_IF_STATEMENT] ||
+               symbol == symbols[SYM_IFARCH_STATEMENT] ||
+               symbol == symbols[SYM_IFOS_STATEMENT]) {
+        struct chain chain = {false, false, false};
+
+        visit_branch(self, node, &chain);
+    } else if (symbol == symbols[SYM_CONDITIONAL_EXPANSION]) {
+        visit_conditional_expansion(self, node);
+    } else if (symbol == symbols[SYM_MACRO_EXPANSION_CALL]) {
+        visit_macro_call(self, node);
+    } else if (symbol != symbols[SYM_CHANGELOG]) {
+        count = ts_node_named_child_count(node);
+        for (i = 0; i < count; i++) {
+            visit(self, ts_node_named_child(node, i));
+        }
+    }
+}
+
+/* Walk a child of the root and record what it did into `segment` */
+static void
+walk(TSRpmspecMacros *self, struct segment *segment, TSNode node)
+{
+    uint32_t conditions = self->stats.conditions;
+    uint32_t unresolved = self->stats.unresolved_conditions;
+    uint32_t definitions = self->stats.definitions;
+
+    memset(segment, 0, sizeof(*segment));
+    segment->in_package = self->in_package;
+    if (ts_node_is_named(node)) {
+        uses_begin(self, &segment->uses);
+        self->recording = segment;
+        self->recording_byte = ts_node_start_byte(node);
+        self->recording_point = ts_node_start_point(node);
+        self->uses = &segment->uses;
+        visit(self, node);
+        uses_end(self, &segment->uses);
+        self->recording = NULL;
+        self->uses = NULL;
+        self->stats.uses += segment->uses.count;
+    }
+    segment->in_package_after = self->in_package;
+    segment->definitions = self->stats.definitions - definitions;
+    segment->conditions = self->stats.conditions - conditions;
+    segment->unresolved_conditions =
+        self->stats.unresolved_conditions - unresolved;
+    self->stats.walked++;
+}
+
+/* Whether the definitions of `segment` still hold at this point of a walk */
+static bool
+can_replay(const TSRpmspecMacros *self, const struct segment *segment)
+{
+    uint32_t i;
+
+    if (segment->in_package != self->in_package) {
+        return false;
+    }
+    for (i = 0; i < segment->uses.count; i++) {
+        if (self->entries[segment->uses.ids[i]]->dirty == self->update) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void
+replay(TSRpmspecMacros *self, const struct segment *segment, TSNode node)
+{
+    uint32_t start_byte = ts_node_start_byte(node);
+    TSPoint start_point = ts_node_start_point(node);
+    uint32_t i;
+
+    for (i = 0; i < segment->op_count && !self->failed; i++) {
+        const struct op *op = &segment->ops[i];
+        struct macro *m = self->entries[op->id];
+
+        if (op->body == NULL) {
+            if (m->body != NULL) {
+                set_body(self, m, NULL);
+            }
+        } else {
+            char *body = strdup(op->body);
+
+            if (body == NULL) {
+                self->failed = true;
+                return;
+            }
+            set_body(self, m, body);
+        }
+    }
+    for (i = 0; i < segment->dead_count; i++) {
+        TSRange range = segment->dead[i];
+
+        range.start_byte += start_byte;
+        range.end_byte += start_byte;
+        range.start_point = point_add(range.start_point, start_point);
+        range.end_point = point_add(range.end_point, start_point);
+        if (!push_range(&self->dead, &self->dead_count, &self->dead_capacity,
+                        &range)) {
+            self->failed = true;
+            return;
+        }
+    }
+    self->in_package = segment->in_package_after;
+    self->stats.definitions += segment->definitions;
+    self->stats.conditions += segment->conditions;
+    self->stats.unresolved_conditions += segment->unresolved_conditions;
+    self->stats.replayed++;
+}
+
+/* Drop a segment that is walked again; what it defined may change */
+static void
+discard(TSRpmspecMacros *self, struct segment *segment)
+{
+    uint32_t i;
+
+    for (i = 0; i < segment->op_count; i++) {
+        self->entries[segment->ops[i].id]->dirty = self->update;
+    }
+    segment_free(segment);
+}
+
+/* Back to the predefined macros, keeping what was defined in `previous` */
+static void
+reset(TSRpmspecMacros *self, bool keep_previous)
+{
+    uint32_t i;
+
+    for (i = 0; i < self->count; i++) {
+        struct macro *m = self->entries[i];
+
+        if (keep_previous) {
+            m->previous = m->body;
+        } else if (m->body != m->base) {
+            free(m->body);
+        }
+        m->body = m->base;
+    }
+    self->generation++;
+    memset(&self->stats, 0, sizeof(self->stats));
+    self->in_package = false;
+    self->dead_count = 0;
+}
+
+bool
+tree_sitter_rpmspec_macros_load(TSRpmspecMacros *self,
+                                const TSTree *tree,
+                                const char *source)
+{
+    TSNode root = ts_tree_root_node(tree);
+    TSTreeCursor cursor;
+    uint32_t i = 0;
+
+    self->failed = false;
+    segments_clear(self);
+    if (!resolve_language(self, ts_tree_language(tree))) {
+        return false;
+    }
+
+    reset(self, false);
+    self->source = source;
+    self->segment_count = ts_node_child_count(root);
+    self->segments = calloc(self->segment_count + 1, sizeof(*self->segments));
+    if (self->segments == NULL) {
+        self->segment_count = 0;
+        return false;
+    }
+    cursor = ts_tree_cursor_new(root);
+    if (ts_tree_cursor_goto_first_child(&cursor)) {
+        do {
+            walk(self, &self->segments[i++],
+                 ts_tree_cursor_current_node(&cursor));
+        } while (i < self->segment_count &&
+                 ts_tree_cursor_goto_next_sibling(&cursor));
+    }
+    ts_tree_cursor_delete(&cursor);
+    self->source = NULL;
+    if (self->failed) {
+        segments_clear(self);
+        return false;
+    }
+    self->segments_valid = true;
+
+    return true;
+}
+
+/* Whether an old child of the root stands unchanged in the new tree */
+static bool
+is_unchanged(TSNode old_node,
+             TSNode new_node,
+             const TSRange *ranges,
+             uint32_t range_count)
+{
+    uint32_t start = ts_node_start_byte(new_node);
+    uint32_t end = ts_node_end_byte(new_node);
+    uint32_t i;
+
+    if (ts_node_start_byte(old_node) != start ||
+        ts_node_end_byte(old_node) != end ||
+        ts_node_symbol(old_node) != ts_node_symbol(new_node) ||
+        ts_node_has_changes(old_node)) {
+        return false;
+    }
+    for (i = 0; i < range_count; i++) {
+        if (ranges[i].start_byte < end && ranges[i].end_byte > start) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* After an update, keep the memos that read no macro whose value changed */
+static void
+revalidate_memos(TSRpmspecMacros *self, uint64_t generation)
+{
+    uint32_t i;
+    uint32_t j;
+
+    for (i = 0; i < self->count; i++) {
+        struct macro *m = self->entries[i];
+        bool changed;
+
+        changed = m->previous == NULL || m->body == NULL
+                      ? m->previous != m->body
+                      : strcmp(m->previous, m->body) != 0;
+        if (m->previous != m->base && m->previous != m->body) {
+            free(m->previous);
+        }
+        m->previous = NULL;
+        m->dirty = changed ? self->update : 0;
+    }
+
+    for (i = 0; i < self->count; i++) {
+        struct macro *m = self->entries[i];
+
+        if (m->memo == NULL || m->memo_generation != generation ||
+            m->dirty == self->update) {
+            continue;
+        }
+        for (j = 0; j < m->memo_uses.count; j++) {
+            if (self->entries[m->memo_uses.ids[j]]->dirty == self->update) {
+                break;
+            }
+        }
+        if (j == m->memo_uses.count) {
+            m->memo_generation = self->generation;
+        }
+    }
+}
+
+bool
+tree_sitter_rpmspec_macros_update(TSRpmspecMacros *self,
+                                  const TSTree *old_tree,
+                                  const TSTree *new_tree,
+                                  const char *source)
+{
+    TSNode old_root = ts_tree_root_node(old_tree);
+    TSNode new_root = ts_tree_root_node(new_tree);
+    uint64_t generation = self->generation;
+    struct segment *segments;
+    TSTreeCursor old_cursor;
+    TSTreeCursor new_cursor;
+    uint32_t range_count;
+    uint32_t new_count;
+    TSRange *ranges;
+    uint32_t i = 0;
+    uint32_t j = 0;
+
+    if (!self->segments_valid || self->language != ts_tree_language(new_tree) ||
+        ts_node_child_count(old_root) != self->segment_count) {
+        return tree_sitter_rpmspec_macros_load(self, new_tree, source);
+    }
+
+    self->failed = false;
+    new_count = ts_node_child_count(new_root);
+    segments = calloc(new_count + 1, sizeof(*segments));
+    if (segments == NULL) {
+        return false;
+    }
+    ranges = ts_tree_get_changed_ranges(old_tree, new_tree, &range_count);
+
+    self->update++;
+    reset(self, true);
+    self->source = source;
+
+    /* Both lists of children are ordered, match them up in one pass */
+    old_cursor = ts_tree_cursor_new(old_root);
+    new_cursor = ts_tree_cursor_new(new_root);
+    ts_tree_cursor_goto_first_child(&old_cursor);
+    if (ts_tree_cursor_goto_first_child(&new_cursor)) {
+        do {
+            TSNode new_node = ts_tree_cursor_current_node(&new_cursor);
+            uint32_t start = ts_node_start_byte(new_node);
+            struct segment *reused = NULL;
+
+            for (; i < self->segment_count;
+                 ts_tree_cursor_goto_next_sibling(&old_cursor)) {
+                TSNode old_node = ts_tree_cursor_current_node(&old_cursor);
+
+                if (ts_node_start_byte(old_node) > start) {
+                    break;
+                }
+                if (is_unchanged(old_node, new_node, ranges, range_count)) {
+                    reused = &self->segments[i++];
+                    ts_tree_cursor_goto_next_sibling(&old_cursor);
+                    break;
+                }
+                discard(self, &self->segments[i++]);
+            }
+
+            if (reused != NULL && can_replay(self, reused)) {
+                replay(self, reused, new_node);
+                segments[j] = *reused;
+            } else {
+                if (reused != NULL) {
+                    discard(self, reused);
+                }
+                walk(self, &segments[j], new_node);
+            }
+            j++;
+        } while (j < new_count &&
+                 ts_tree_cursor_goto_next_sibling(&new_cursor));
+    }
+    ts_tree_cursor_delete(&old_cursor);
+    ts_tree_cursor_delete(&new_cursor);
+    for (; i < self->segment_count; i++) {
+        discard(self, &self->segments[i]);
+    }
+    free(ranges);
+
+    free(self->segments);
+    self->segments = segments;
+    self->segment_count = new_count;
+    self->source = NULL;
+    revalidate_memos(self, generation);
+    if (self->failed) {
+        segments_clear(self);
+        return false;
+    }
+    self->segments_valid = true;
+
+    return true;
+}
+
+static char *
+copy_target(const char *target)
+{
+    return target != NULL ? strdup(target) : NULL;
+}
+
+bool
+tree_sitter_rpmspec_macros_set_target(TSRpmspecMacros *self,
+                                      const char *arch,
+                                      const char *os)
+{
+    char *new_arch = copy_target(arch);
+    char *new_os = copy_target(os);
+    size_t i;
+
+    if ((arch != NULL && new_arch == NULL) || (os != NULL && new_os == NULL)) {
+        free(new_arch);
+        free(new_os);
+        return false;
+    }
+    free(self->arch);
+    free(self->os);
+    self->arch = new_arch;
+    self->os = new_os;
+
+    if (arch != NULL) {
+        for (i = 0; i < sizeof(arch_groups) / sizeof(arch_groups[0]); i++) {
+            struct macro *m;
+
+            m = *find_slot(self->slots, self->capacity, arch_groups[i][0],
+                           strlen(arch_groups[i][0]),
+                           hash_name(arch_groups[i][0],
+                                     strlen(arch_groups[i][0])));
+            if ((m == NULL || m->base == NULL) &&
+                !tree_sitter_rpmspec_macros_define(self, arch_groups[i][0],
+                                                   arch_groups[i][1])) {
+                return false;
+            }
+        }
+        if (!tree_sitter_rpmspec_macros_define(self, "_arch", arch) ||
+            !tree_sitter_rpmspec_macros_define(self, "_target_cpu", arch)) {
+            return false;
+        }
+    }
+    if (os != NULL &&
+        (!tree_sitter_rpmspec_macros_define(self, "_os", os) ||
+         !tree_sitter_rpmspec_macros_define(self, "_target_os", os))) {
+        return false;
+    }
+
+    /* The recorded walk took every branch of %ifarch and %ifos */
+    segments_clear(self);
+
+    return true;
+}
+
+const TSRange *
+tree_sitter_rpmspec_macros_dead_ranges(const TSRpmspecMacros *self,
+                                       uint32_t *count)
+{
+    *count = self->dead_count;
+
+    return self->dead;
+}
+
+void
+tree_sitter_rpmspec_macros_stats(const TSRpmspecMacros *self,
+                                 TSRpmspecMacrosStats *stats)
+{
+    *stats = self->stats;
+}
@@ -0,0 +1,599 @@
+/*
+ * Serialized, memory-mappable snapshots of spec trees
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <tree_sitter/tree-sitter-rpmspec-snapshot.h>
+#include <tree_sitter/tree-sitter-rpmspec.h>
+
+#include "common.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdalign.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SNAPSHOT_MAGIC "RPMSNAP"
+#define SNAPSHOT_VERSION 2
+#define SNAPSHOT_BYTE_ORDER 0x01020304u
+#define SNAPSHOT_SUFFIX ".snap"
+
+/*
+ * The header is followed by `node_count` nodes, `symbol_count + 2` offsets
+ * into the symbol index, `node_count` node indices sorted by symbol and the
+ * `content_length` bytes of the source. The last slot of the index holds the
+ * ERROR nodes, whose symbol is not below `symbol_count`.
+ */
+struct file_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t content_hash;
+    uint64_t language_hash;
+    uint32_t content_length;
+    uint32_t symbol_count;
+    uint32_t node_count;
+    uint32_t variant;
+};
+
+_Static_assert(sizeof(struct file_header) % alignof(uint64_t) == 0,
+               "the nodes follow the header unpadded");
+_Static_assert(sizeof(TSRpmspecSnapshotNode) == 16,
+               "a node has the same layout everywhere");
+
+struct TSRpmspecSnapshot {
+    const struct file_header *header;
+    const TSRpmspecSnapshotNode *nodes;
+    const uint32_t *offsets;
+    const uint32_t *indices;
+    void *mapping;  /* munmap() on delete */
+    void *buffer;   /* free() on delete */
+    size_t size;
+};
+
+struct stack {
+    uint32_t *items;
+    uint32_t count;
+    uint32_t capacity;
+};
+
+uint64_t
+tree_sitter_rpmspec_snapshot_hash(const char *source, uint32_t length)
+{
+    return rpmspec_fnv_update(RPMSPEC_FNV_OFFSET, source, length);
+}
+
+/*
+ * The variants of the language share all tables and differ only in their
+ * external scanner, so their trees differ while their symbols do not. The
+ * language pointer tells them apart within a process; the number saved for
+ * it is the same in every process.
+ */
+enum {
+    VARIANT_DEFAULT = 0,
+    VARIANT_LAZY_CHANGELOG = 1,
+};
+
+static uint32_t
+language_variant(const TSLanguage *language)
+{
+    return language == tree_sitter_rpmspec_lazy_changelog()
+               ? VARIANT_LAZY_CHANGELOG
+               : VARIANT_DEFAULT;
+}
+
+/* Symbol ids and field ids change whenever the parser is regenerated */
+static uint64_t
+language_hash(const TSLanguage *language)
+{
+    uint32_t symbol_count = ts_language_symbol_count(language);
+    uint32_t field_count = ts_language_field_count(language);
+    uint64_t hash = RPMSPEC_FNV_OFFSET;
+    uint32_t i;
+
+    hash = rpmspec_fnv_update(hash, &symbol_count, sizeof(symbol_count));
+    hash = rpmspec_fnv_update(hash, &field_count, sizeof(field_count));
+    for (i = 0; i < symbol_count; i++) {
+        const char *name = ts_language_symbol_name(language, (TSSymbol)i);
+
+        if (name != NULL) {
+            hash = rpmspec_fnv_update(hash, name, strlen(name) + 1);
+        }
+    }
+    for (i = 1; i <= field_count; i++) {
+        const char *name =
+            ts_language_field_name_for_id(language, (TSFieldId)i);
+
+        if (name != NULL) {
+            hash = rpmspec_fnv_update(hash, name, strlen(name) + 1);
+        }
+    }
+
+    return hash;
+}
+
+static uint64_t
+snapshot_size(uint32_t node_count,
+              uint32_t symbol_count,
+              uint32_t content_length)
+{
+    return sizeof(struct file_header) +
+           (uint64_t)node_count * sizeof(TSRpmspecSnapshotNode) +
+           ((uint64_t)symbol_count + 2) * sizeof(uint32_t) +
+           (uint64_t)node_count * sizeof(uint32_t) + content_length;
+}
+
+/* The copy of the source after the symbol index */
+static const char *
+snapshot_content(const struct file_header *header)
+{
+    const TSRpmspecSnapshotNode *nodes =
+        (const TSRpmspecSnapshotNode *)(header + 1);
+    const uint32_t *indices = (const uint32_t *)(nodes + header->node_count) +
+                              header->symbol_count + 2;
+
+    return (const char *)(indices + header->node_count);
+}
+
+/* The slot of the symbol index a symbol is kept in */
+static uint32_t
+symbol_slot(TSSymbol symbol, uint32_t symbol_count)
+{
+    return symbol < symbol_count ? symbol : symbol_count;
+}
+
+static bool
+stack_push(struct stack *stack, uint32_t item)
+{
+    if (!rpmspec_grow32((void **)&stack->items, &stack->capacity,
+                        stack->count, sizeof(*stack->items), 64)) {
+        return false;
+    }
+    stack->items[stack->count++] = item;
+
+    return true;
+}
+
+static void
+set_node(TSRpmspecSnapshotNode *node, const TSTreeCursor *cursor)
+{
+    TSNode current = ts_tree_cursor_current_node(cursor);
+
+    node->start_byte = ts_node_start_byte(current);
+    node->end_byte = ts_node_end_byte(current);
+    node->descendant_count = 0;
+    node->symbol = ts_node_symbol(current);
+    node->field = (uint8_t)ts_tree_cursor_current_field_id(cursor);
+    node->flags = 0;
+    if (ts_node_is_named(current)) {
+        node->flags |= TSRpmspecSnapshotNamed;
+    }
+    if (ts_node_is_extra(current)) {
+        node->flags |= TSRpmspecSnapshotExtra;
+    }
+    if (ts_node_is_missing(current)) {
+        node->flags |= TSRpmspecSnapshotMissing;
+    }
+    if (ts_node_has_error(current)) {
+        node->flags |= TSRpmspecSnapshotHasError;
+    }
+}
+
+/*
+ * Write the nodes in pre-order. A node is finished, and its descendants
+ * counted, when the cursor leaves it for its next sibling or its parent.
+ */
+static bool
+write_nodes(const TSTree *tree,
+            TSRpmspecSnapshotNode *nodes,
+            uint32_t node_count)
+{
+    TSTreeCursor cursor = ts_tree_cursor_new(ts_tree_root_node(tree));
+    struct stack open = {0};
+    uint32_t count = 0;
+    bool ok = false;
+
+    errno = EINVAL;
+    for (;;) {
+        if (count == node_count) {
+            goto out;
+        }
+        if (!stack_push(&open, count)) {
+            errno = ENOMEM;
+            goto out;
+        }
+        set_node(&nodes[count++], &cursor);
+        if (ts_tree_cursor_goto_first_child(&cursor)) {
+            continue;
+        }
+        for (;;) {
+            uint32_t top = open.items[--open.count];
+
+            nodes[top].descendant_count = count - top - 1;
+            if (ts_tree_cursor_goto_next_sibling(&cursor)) {
+                break;
+            }
+            if (!ts_tree_cursor_goto_parent(&cursor)) {
+                ok = count == node_count;
+                goto out;
+            }
+        }
+    }
+
+out:
+    free(open.items);
+    ts_tree_cursor_delete(&cursor);
+
+    return ok;
+}
+
+void *
+tree_sitter_rpmspec_snapshot_serialize(const TSTree *tree,
+                                       const char *source,
+                                       uint32_t length,
+                                       size_t *size)
+{
+    const TSLanguage *language = ts_tree_language(tree);
+    uint32_t symbol_count = ts_language_symbol_count(language);
+    uint32_t node_count = ts_node_descendant_count(ts_tree_root_node(tree));
+    TSRpmspecSnapshotNode *nodes;
+    struct file_header *header;
+    uint32_t *offsets;
+    uint32_t *indices;
+    uint64_t total;
+    uint32_t i;
+
+    if (ts_language_field_count(language) > UINT8_MAX) {
+        errno = EOVERFLOW;
+        return NULL;
+    }
+    total = snapshot_size(node_count, symbol_count, length);
+    if (total > SIZE_MAX) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    header = calloc(1, (size_t)total);
+    if (header == NULL) {
+        return NULL;
+    }
+    nodes = (TSRpmspecSnapshotNode *)(header + 1);
+    offsets = (uint32_t *)(nodes + node_count);
+    indices = offsets + symbol_count + 2;
+
+    memcpy(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic));
+    header->version = SNAPSHOT_VERSION;
+    header->byte_order = SNAPSHOT_BYTE_ORDER;
+    header->content_hash = tree_sitter_rpmspec_snapshot_hash(source, length);
+    header->language_hash = language_hash(language);
+    header->content_length = length;
+    header->symbol_count = symbol_count;
+    header->node_count = node_count;
+    header->variant = language_variant(language);
+    memcpy((char *)snapshot_content(header), source, length);
+
+    if (!write_nodes(tree, nodes, node_count)) {
+        free(header);
+        return NULL;
+    }
+
+    /* A counting sort keeps the nodes of a symbol in pre-order */
+    for (i = 0; i < node_count; i++) {
+        offsets[symbol_slot(nodes[i].symbol, symbol_count) + 1]++;
+    }
+    for (i = 0; i <= symbol_count; i++) {
+        offsets[i + 1] += offsets[i];
+    }
+    for (i = 0; i < node_count; i++) {
+        indices[offsets[symbol_slot(nodes[i].symbol, symbol_count)]++] = i;
+    }
+    for (i = symbol_count + 1; i > 0; i--) {
+        offsets[i] = offsets[i - 1];
+    }
+    offsets[0] = 0;
+
+    *size = (size_t)total;
+
+    return header;
+}
+
+bool
+tree_sitter_rpmspec_snapshot_save(const TSTree *tree,
+                                  const char *source,
+                                  uint32_t length,
+                                  const char *path)
+{
+    void *data;
+    size_t size;
+    bool ok;
+
+    data = tree_sitter_rpmspec_snapshot_serialize(tree, source, length, &size);
+    if (data == NULL) {
+        return false;
+    }
+    ok = rpmspec_write_file(path, data, size);
+    free(data);
+
+    return ok;
+}
+
+/*
+ * Check everything an index into the snapshot is derived from, so that a
+ * truncated or corrupt file is rejected here and not read out of bounds
+ * later.
+ */
+static bool
+validate(TSRpmspecSnapshot *self, const TSLanguage *language)
+{
+    const struct file_header *header = self->header;
+    uint32_t symbol_count;
+    uint32_t node_count;
+    uint32_t i;
+
+    if (self->size < sizeof(*header) ||
+        memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 ||
+        header->byte_order != SNAPSHOT_BYTE_ORDER) {
+        errno = EINVAL;
+        return false;
+    }
+    if (header->version != SNAPSHOT_VERSION ||
+        header->variant != language_variant(language) ||
+        header->symbol_count != ts_language_symbol_count(language) ||
+        header->language_hash != language_hash(language)) {
+        errno = ESTALE;
+        return false;
+    }
+
+    symbol_count = header->symbol_count;
+    node_count = header->node_count;
+    if (node_count == 0 ||
+        snapshot_size(node_count, symbol_count, header->content_length) !=
+            (uint64_t)self->size) {
+        errno = EINVAL;
+        return false;
+    }
+    self->nodes = (const TSRpmspecSnapshotNode *)(header + 1);
+    self->offsets = (const uint32_t *)(self->nodes + node_count);
+    self->indices = self->offsets + symbol_count + 2;
+
+    if (self->nodes[0].descendant_count != node_count - 1) {
+        errno = EINVAL;
+        return false;
+    }
+    for (i = 0; i < node_count; i++) {
+        const TSRpmspecSnapshotNode *node = &self->nodes[i];
+
+        if (node->descendant_count >= node_count - i ||
+            node->start_byte > node->end_byte ||
+            node->end_byte > header->content_length ||
+            self->indices[i] >= node_count) {
+            errno = EINVAL;
+            return false;
+        }
+    }
+    if (self->offsets[0] != 0 ||
+        self->offsets[symbol_count + 1] != node_count) {
+        errno = EINVAL;
+        return false;
+    }
+    for (i = 0; i <= symbol_count; i++) {
+        if (self->offsets[i] > self->offsets[i + 1]) {
+            errno = EINVAL;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+TSRpmspecSnapshot *
+tree_sitter_rpmspec_snapshot_from_buffer(const void *data,
+                                         size_t size,
+                                         const TSLanguage *language)
+{
+    TSRpmspecSnapshot *self;
+
+    if (((uintptr_t)data % alignof(uint64_t)) != 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    self = calloc(1, sizeof(*self));
+    if (self == NULL) {
+        return NULL;
+    }
+    self->header = data;
+    self->size = size;
+    if (!validate(self, language)) {
+        int saved_errno = errno;
+
+        free(self);
+        errno = saved_errno;
+        return NULL;
+    }
+
+    return self;
+}
+
+TSRpmspecSnapshot *
+tree_sitter_rpmspec_snapshot_open(const char *path, const TSLanguage *language)
+{
+    TSRpmspecSnapshot *self;
+    void *mapping;
+    struct stat sb;
+    int saved_errno;
+    int fd;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &sb) != 0) {
+        goto fail;
+    }
+    if (!S_ISREG(sb.st_mode) || sb.st_size == 0) {
+        errno = EINVAL;
+        goto fail;
+    }
+    mapping = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+        goto fail;
+    }
+    close(fd);
+
+    self = tree_sitter_rpmspec_snapshot_from_buffer(
+        mapping, (size_t)sb.st_size, language);
+    if (self == NULL) {
+        saved_errno = errno;
+        munmap(mapping, (size_t)sb.st_size);
+        errno = saved_errno;
+        return NULL;
+    }
+    self->mapping = mapping;
+
+    return self;
+
+fail:
+    saved_errno = errno;
+    close(fd);
+    errno = saved_errno;
+
+    return NULL;
+}
+
+void
+tree_sitter_rpmspec_snapshot_delete(TSRpmspecSnapshot *self)
+{
+    if (self == NULL) {
+        return;
+    }
+    if (self->mapping != NULL) {
+        munmap(self->mapping, self->size);
+    }
+    free(self->buffer);
+    free(self);
+}
+
+bool
+tree_sitter_rpmspec_snapshot_matches(const TSRpmspecSnapshot *self,
+                                     const char *source,
+                                     uint32_t length)
+{
+    return self->header->content_length == length &&
+           memcmp(snapshot_content(self->header), source, length) == 0;
+}
+
+TSRpmspecSnapshot *
+tree_sitter_rpmspec_snapshot_cache_get(const char *directory,
+                                       TSParser *parser,
+                                       const char *source,
+                                       uint32_t length,
+                                       TSRpmspecSnapshotCacheStats *stats)
+{
+    const TSLanguage *language = ts_parser_language(parser);
+    uint64_t hash = tree_sitter_rpmspec_snapshot_hash(source, length);
+    TSRpmspecSnapshot *self;
+    char path[4096];
+    void *data;
+    TSTree *tree;
+    size_t size;
+
+    if (language == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+    /* Variants of the language parse the same spec into different trees */
+    if (snprintf(path, sizeof(path), "%s/%016llx-%u" SNAPSHOT_SUFFIX,
+                 directory, (unsigned long long)hash,
+                 (unsigned)language_variant(language)) >= (int)sizeof(path)) {
+        errno = ENAMETOOLONG;
+        return NULL;
+    }
+
+    self = tree_sitter_rpmspec_snapshot_open(path, language);
+    if (self != NULL && tree_sitter_rpmspec_snapshot_matches(self, source,
+                                                             length)) {
+        if (stats != NULL) {
+            stats->hits++;
+        }
+        return self;
+    }
+    if (stats != NULL) {
+        if (self != NULL || errno != ENOENT) {
+            stats->rejected++;
+        }
+        stats->misses++;
+    }
+    tree_sitter_rpmspec_snapshot_delete(self);
+
+    tree = ts_parser_parse_string(parser, NULL, source, length);
+    if (tree == NULL) {
+        errno = ECANCELED;
+        return NULL;
+    }
+    data = tree_sitter_rpmspec_snapshot_serialize(tree, source, length, &size);
+    ts_tree_delete(tree);
+    if (data == NULL) {
+        return NULL;
+    }
+
+    /* The cache is best effort, the caller gets the snapshot either way */
+    rpmspec_write_file(path, data, size);
+
+    self = tree_sitter_rpmspec_snapshot_from_buffer(data, size, language);
+    if (self == NULL) {
+        free(data);
+        return NULL;
+    }
+    self->buffer = data;
+
+    return self;
+}
+
+const TSRpmspecSnapshotNode *
+tree_sitter_rpmspec_snapshot_nodes(const TSRpmspecSnapshot *self,
+                                   uint32_t *count)
+{
+    *count = self->header->node_count;
+
+    return self->nodes;
+}
+
+const uint32_t *
+tree_sitter_rpmspec_snapshot_nodes_of_symbol(const TSRpmspecSnapshot *self,
+                                             TSSymbol symbol,
+                                             uint32_t *count)
+{
+    uint32_t slot = symbol_slot(symbol, self->header->symbol_count);
+    uint32_t start = self->offsets[slot];
+
+    *count = self->offsets[slot + 1] - start;
+
+    return *count > 0 ? self->indices + start : NULL;
+}
+
+uint32_t
+tree_sitter_rpmspec_snapshot_child_by_field(const TSRpmspecSnapshot *self,
+                                            uint32_t index,
+                                            TSFieldId field)
+{
+    const TSRpmspecSnapshotNode *nodes = self->nodes;
+    uint32_t end;
+    uint32_t i;
+
+    if (index >= self->header->node_count || field == 0) {
+        return UINT32_MAX;
+    }
+    end = index + 1 + nodes[index].descendant_count;
+    for (i = index + 1; i < end; i += 1 + nodes[i].descendant_count) {
+        if (nodes[i].field == field) {
+            return i;
+        }
+    }
+
+    return UINT32_MAX;
+}
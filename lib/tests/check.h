@@ -0,0 +1,45 @@
+/*
+ * Assertions and fixtures shared by the library tests
+ */
+
+#ifndef RPMSPEC_LIB_TESTS_CHECK_H_
+#define RPMSPEC_LIB_TESTS_CHECK_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Unlike assert(), also checked in release builds */
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+                    #cond);                                                  \
+            exit(1);                                                         \
+        }                                                                    \
+    } while (0)
+
+/* The contents of `path`, NUL-terminated, to release with free() */
+static inline char *
+read_file(const char *path, uint32_t *length)
+{
+    FILE *fp = fopen(path, "rb");
+    char *data;
+    long size;
+
+    CHECK(fp != NULL);
+    CHECK(fseek(fp, 0, SEEK_END) == 0);
+    size = ftell(fp);
+    CHECK(size >= 0);
+    rewind(fp);
+    data = malloc((size_t)size + 1);
+    CHECK(data != NULL);
+    CHECK(fread(data, 1, (size_t)size, fp) == (size_t)size);
+    fclose(fp);
+    data[size] = '\0';
+    *length = (uint32_t)size;
+
+    return data;
+}
+
+#endif /* RPMSPEC_LIB_TESTS_CHECK_H_ */
@@ -0,0 +1,74 @@
+/*
+ * Tests for the arena allocator
+ */
+
+#include <tree_sitter/tree-sitter-rpmspec-arena.h>
+#include <tree_sitter/tree-sitter-rpmspec.h>
+
+#include "check.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int
+main(int argc, char **argv)
+{
+    TSRpmspecArenaStats stats;
+    TSRpmspecArena *arena;
+    TSParser *parser;
+    char *expected;
+    char *actual;
+    uint32_t size;
+    TSTree *tree;
+    char *source;
+    int i;
+
+    CHECK(argc == 2);
+    source = read_file(argv[1], &size);
+
+    /* Reference tree with the system allocator */
+    parser = ts_parser_new();
+    CHECK(ts_parser_set_language(parser, tree_sitter_rpmspec()));
+    tree = ts_parser_parse_string(parser, NULL, source, size);
+    CHECK(tree != NULL);
+    expected = ts_node_string(ts_tree_root_node(tree));
+    ts_tree_delete(tree);
+    ts_parser_delete(parser);
+
+    tree_sitter_rpmspec_arena_install();
+
+    /* A small block size makes the first parse span several blocks */
+    arena = tree_sitter_rpmspec_arena_new(4096);
+    CHECK(arena != NULL);
+
+    for (i = 0; i < 3; i++) {
+        tree = tree_sitter_rpmspec_arena_parse(arena, tree_sitter_rpmspec(),
+                                               source, size);
+        CHECK(tree != NULL);
+
+        /* Allocated outside the arena, it outlives the reset */
+        actual = ts_node_string(ts_tree_root_node(tree));
+        tree_sitter_rpmspec_arena_stats(arena, &stats);
+        CHECK(stats.used > 0);
+        CHECK(stats.peak >= stats.used);
+
+        tree_sitter_rpmspec_arena_reset(arena);
+        CHECK(strcmp(actual, expected) == 0);
+        tree_sitter_rpmspec_arena_free(actual);
+    }
+
+    /* The blocks were merged by the first reset */
+    tree_sitter_rpmspec_arena_stats(arena, &stats);
+    CHECK(stats.used == 0);
+    CHECK(stats.blocks == 1);
+    CHECK(stats.reserved >= stats.peak);
+
+    tree_sitter_rpmspec_arena_delete(arena);
+    tree_sitter_rpmspec_arena_uninstall();
+
+    free(expected);
+    free(source);
+
+    return 0;
+}
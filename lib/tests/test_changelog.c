@@ -0,0 +1,115 @@
+/*
+ * Tests for the changelog id extractor
+ */
+
+#include <tree_sitter/tree-sitter-rpmspec-changelog.h>
+#include <tree_sitter/tree-sitter-rpmspec.h>
+
+#include "check.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char spec[] =
+    "Name:           foo\n"
+    "Version:        1.2\n"
+    "\n"
+    "%description\n"
+    "Fixes CVE-2000-0001 in the description, not a changelog id.\n"
+    "\n"
+    "%changelog\n"
+    "* Tue May 31 2016 Jane Doe <jane@example.com> - 1.2-3\n"
+    "- Fix CVE-2016-1234, CVE-2016-5678\n"
+    "- Fix rhbz#42\n"
+    "\n"
+    "* Thu Jan 01 1970 John Doe <john@example.com>\n"
+    "- Apply MFSA-2015-01 and BDU:2015-00001\n";
+
+static int
+string_is(const TSRpmspecStringColumn *column, uint32_t i, const char *text)
+{
+    int32_t start = column->offsets[i];
+    int32_t length = column->offsets[i + 1] - start;
+
+    return (size_t)length == strlen(text) &&
+           memcmp(column->data + start, text, (size_t)length) == 0;
+}
+
+int
+main(void)
+{
+    TSRpmspecChangelogExtractor *extractor;
+    TSRpmspecChangelogBatch batch = {0};
+    struct ArrowSchema schema;
+    struct ArrowArray array;
+    TSParser *parser;
+    TSTree *tree;
+
+    parser = ts_parser_new();
+    CHECK(ts_parser_set_language(parser, tree_sitter_rpmspec()));
+    tree = ts_parser_parse_string(parser, NULL, spec, sizeof(spec) - 1);
+    CHECK(tree != NULL);
+
+    extractor =
+        tree_sitter_rpmspec_changelog_extractor_new(tree_sitter_rpmspec());
+    CHECK(extractor != NULL);
+    CHECK(tree_sitter_rpmspec_changelog_extract(extractor, tree, spec, NULL,
+                                                &batch));
+
+    CHECK(batch.rows == 5);
+    CHECK(batch.packages.count == 1);
+    CHECK(string_is(&batch.packages, 0, "foo"));
+
+    CHECK(batch.kind[0] == TSRpmspecChangelogCve);
+    CHECK(string_is(&batch.id, 0, "CVE-2016-1234"));
+    CHECK(string_is(&batch.version, 0, "1.2-3"));
+    CHECK(batch.date[0] == 16952);
+    CHECK(batch.row[0] == 8);
+
+    /* The comma after an id is not part of it */
+    CHECK(string_is(&batch.id, 1, "CVE-2016-5678"));
+    CHECK(batch.kind[2] == TSRpmspecChangelogBug);
+    CHECK(string_is(&batch.id, 2, "rhbz#42"));
+
+    /* A header without a version-release */
+    CHECK(batch.kind[3] == TSRpmspecChangelogMfsa);
+    CHECK(batch.kind[4] == TSRpmspecChangelogBdu);
+    CHECK(string_is(&batch.version, 3, ""));
+    CHECK(batch.date[4] == 0);
+
+    /* Extractions append, with the package given */
+    CHECK(tree_sitter_rpmspec_changelog_extract(extractor, tree, spec, "bar",
+                                                &batch));
+    CHECK(batch.rows == 10);
+    CHECK(batch.package[9] == 1);
+    CHECK(string_is(&batch.packages, 1, "bar"));
+
+    CHECK(tree_sitter_rpmspec_changelog_batch_export(&batch, &schema, &array));
+    CHECK(batch.rows == 0);
+    CHECK(strcmp(schema.format, "+s") == 0);
+    CHECK(schema.n_children == 6 && array.n_children == 6);
+    CHECK(strcmp(schema.children[2]->name, "date") == 0);
+    CHECK(strcmp(schema.children[2]->format, "tdD") == 0);
+    CHECK(array.length == 10);
+    CHECK(((const int32_t *)array.children[2]->buffers[1])[0] == 16952);
+    CHECK(array.children[0]->dictionary->length == 2);
+    CHECK(array.children[3]->dictionary->length == 5);
+    array.release(&array);
+    schema.release(&schema);
+    CHECK(array.release == NULL && schema.release == NULL);
+
+    /* The batch is reusable after an export */
+    CHECK(tree_sitter_rpmspec_changelog_extract(extractor, tree, spec, NULL,
+                                                &batch));
+    CHECK(batch.rows == 5);
+    tree_sitter_rpmspec_changelog_batch_clear(&batch);
+    CHECK(batch.rows == 0);
+
+    tree_sitter_rpmspec_changelog_batch_free(&batch);
+    tree_sitter_rpmspec_changelog_extractor_delete(extractor);
+    ts_tree_delete(tree);
+    ts_parser_delete(parser);
+
+    return 0;
+}
@@ -0,0 +1,120 @@
+/*
+ * Tests for the dependency extractor
+ */
+
+#include <tree_sitter/tree-sitter-rpmspec-deps.h>
+#include <tree_sitter/tree-sitter-rpmspec.h>
+
+#include "check.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char spec[] =
+    "Name:           foo\n"
+    "Version:        1.2\n"
+    "Release:        3%{?dist}\n"
+    "BuildRequires:  gcc >= 12\n"
+    "BuildRequires:  cmake, make\n"
+    "Requires(post): systemd\n"
+    "Requires:       (bar or baz)\n"
+    "BuildArch:      noarch\n"
+    "\n"
+    "%description\n"
+    "Requires: not-a-dependency\n"
+    "\n"
+    "%package devel\n"
+    "Summary:        Development files\n"
+    "Requires:       foo = %{version}-%{release}\n"
+    "\n"
+    "%if 0%{?fedora}\n"
+    "Recommends:     qux\n"
+    "%endif\n"
+    "\n"
+    "%build\n"
+    "echo 'Requires: not-a-dependency'\n"
+    "\n"
+    "%changelog\n"
+    "* Mon Jan 01 2024 Jane Doe <jane@example.com> - 1.2-3\n"
+    "- Requires: not-a-dependency\n";
+
+static int
+slice_is(TSRpmspecSlice slice, const char *text)
+{
+    return slice.length == strlen(text) &&
+           memcmp(spec + slice.start, text, slice.length) == 0;
+}
+
+int
+main(void)
+{
+    TSRpmspecDepsExtractor *extractor;
+    TSRpmspecDeps deps = {0};
+    const TSRpmspecDependency *d;
+    TSParser *parser;
+    TSTree *tree;
+
+    parser = ts_parser_new();
+    CHECK(ts_parser_set_language(parser, tree_sitter_rpmspec()));
+    tree = ts_parser_parse_string(parser, NULL, spec, sizeof(spec) - 1);
+    CHECK(tree != NULL);
+
+    extractor = tree_sitter_rpmspec_deps_extractor_new(tree_sitter_rpmspec());
+    CHECK(extractor != NULL);
+    CHECK(tree_sitter_rpmspec_deps_extract(extractor, tree, spec, &deps));
+
+    CHECK(slice_is(deps.name, "foo"));
+    CHECK(slice_is(deps.version, "1.2"));
+    CHECK(slice_is(deps.release, "3%{?dist}"));
+    CHECK(deps.epoch.length == 0);
+
+    CHECK(deps.package_count == 1);
+    CHECK(slice_is(deps.packages[0], "devel"));
+
+    /* BuildArch and everything outside the preambles are skipped */
+    CHECK(deps.dependency_count == 7);
+    d = deps.dependencies;
+
+    CHECK(d[0].kind == TSRpmspecBuildRequires);
+    CHECK(d[0].package == 0);
+    CHECK(d[0].row == 3);
+    CHECK(slice_is(d[0].name, "gcc"));
+    CHECK(slice_is(d[0].op, ">="));
+    CHECK(slice_is(d[0].version, "12"));
+
+    CHECK(slice_is(d[1].name, "cmake"));
+    CHECK(d[1].op.length == 0);
+    CHECK(slice_is(d[2].name, "make"));
+    CHECK(d[1].row == d[2].row);
+
+    CHECK(d[3].kind == TSRpmspecRequires);
+    CHECK(slice_is(d[3].qualifier, "post"));
+    CHECK(slice_is(d[3].name, "systemd"));
+
+    CHECK(d[4].flags & TS_RPMSPEC_DEPENDENCY_RICH);
+    CHECK(slice_is(d[4].name, "(bar or baz)"));
+    CHECK(d[4].qualifier.length == 0);
+
+    CHECK(d[5].package == 1);
+    CHECK(slice_is(d[5].name, "foo"));
+    CHECK(slice_is(d[5].op, "="));
+    CHECK(slice_is(d[5].version, "%{version}-%{release}"));
+
+    /* A conditional after %package belongs to it */
+    CHECK(d[6].kind == TSRpmspecRecommends);
+    CHECK(d[6].package == 1);
+    CHECK(slice_is(d[6].name, "qux"));
+
+    /* The record is reused */
+    CHECK(tree_sitter_rpmspec_deps_extract(extractor, tree, spec, &deps));
+    CHECK(deps.dependency_count == 7);
+    CHECK(deps.package_count == 1);
+
+    tree_sitter_rpmspec_deps_free(&deps);
+    tree_sitter_rpmspec_deps_extractor_delete(extractor);
+    ts_tree_delete(tree);
+    ts_parser_delete(parser);
+
+    return 0;
+}
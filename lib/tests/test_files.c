@@ -0,0 +1,177 @@
+/*
+ * Tests for the %files ownership index
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <tree_sitter/tree-sitter-rpmspec-files.h>
+#include <tree_sitter/tree-sitter-rpmspec.h>
+
+#include "check.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static const char spec[] =
+    "Name:           foo\n"
+    "Version:        1.2\n"
+    "\n"
+    "%package devel\n"
+    "Summary:        Development files\n"
+    "\n"
+    "%files -f %{name}.lang\n"
+    "%license LICENSE\n"
+    "%dir %{_datadir}/foo\n"
+    "%{_bindir}/foo\n"
+    "%{_libdir}/libfoo.so.*\n"
+    "%{_datadir}/foo/data\n"
+    "%ifarch s390x\n"
+    "%{_bindir}/foo-s390x\n"
+    "%endif\n"
+    "\n"
+    "%files devel\n"
+    "%{_includedir}/foo\n"
+    "%{_bindir}/{foo,bar}-config\n"
+    "\n"
+    "%files -n python3-foo\n"
+    "%exclude %{_libdir}/python3/foo/tests\n"
+    "%{_libdir}/python3/foo\n";
+
+struct owners {
+    char text[1024];
+};
+
+/* Append "package path flags;" for every owner */
+static bool
+collect(const TSRpmspecFilesOwner *owner, void *payload)
+{
+    struct owners *owners = payload;
+    size_t length = strlen(owners->text);
+
+    CHECK(strcmp(owner->spec, "foo.spec") == 0);
+    snprintf(owners->text + length, sizeof(owners->text) - length,
+             "%s %s %x;", owner->package, owner->path, owner->flags);
+
+    return true;
+}
+
+static const char *
+owners_of(const TSRpmspecFilesIndex *index, const char *path)
+{
+    static struct owners owners;
+
+    owners.text[0] = '\0';
+    tree_sitter_rpmspec_files_index_owners(index, path, collect, &owners);
+
+    return owners.text;
+}
+
+static const char *
+find(const TSRpmspecFilesIndex *index, const char *pattern)
+{
+    static struct owners owners;
+
+    owners.text[0] = '\0';
+    tree_sitter_rpmspec_files_index_find(index, pattern, collect, &owners);
+
+    return owners.text;
+}
+
+int
+main(void)
+{
+    char path[] = "/tmp/rpmspec-test-files-XXXXXX";
+    TSRpmspecFilesIndexStats stats;
+    TSRpmspecFilesBuilder *builder;
+    TSRpmspecFilesIndex *index;
+    TSRpmspecMacros *macros;
+    TSParser *parser;
+    TSTree *tree;
+    void *data;
+    size_t size;
+    int fd;
+
+    parser = ts_parser_new();
+    CHECK(ts_parser_set_language(parser, tree_sitter_rpmspec()));
+    tree = ts_parser_parse_string(parser, NULL, spec, sizeof(spec) - 1);
+    CHECK(tree != NULL);
+
+    macros = tree_sitter_rpmspec_macros_new();
+    CHECK(macros != NULL);
+    CHECK(tree_sitter_rpmspec_macros_define(macros, "_bindir", "/usr/bin"));
+    CHECK(tree_sitter_rpmspec_macros_define(macros, "_libdir", "/usr/lib64"));
+    CHECK(tree_sitter_rpmspec_macros_define(macros, "_datadir",
+                                            "/usr/share"));
+    CHECK(tree_sitter_rpmspec_macros_define(macros, "_includedir",
+                                            "/usr/include"));
+    CHECK(tree_sitter_rpmspec_macros_set_target(macros, "x86_64", "linux"));
+    CHECK(tree_sitter_rpmspec_macros_load(macros, tree, spec));
+
+    builder = tree_sitter_rpmspec_files_builder_new(tree_sitter_rpmspec());
+    CHECK(builder != NULL);
+    CHECK(tree_sitter_rpmspec_files_builder_add(builder, "foo.spec", tree,
+                                                spec, macros));
+    data = tree_sitter_rpmspec_files_builder_serialize(builder, &size);
+    CHECK(data != NULL);
+    index = tree_sitter_rpmspec_files_index_from_buffer(data, size);
+    CHECK(index != NULL);
+
+    tree_sitter_rpmspec_files_index_stats(index, &stats);
+    CHECK(stats.packages == 3);
+    CHECK(stats.entries == 11);
+    CHECK(stats.size == size);
+
+    CHECK(strcmp(owners_of(index, "/usr/bin/foo"), "foo /usr/bin/foo 0;") ==
+          0);
+    CHECK(strcmp(owners_of(index, "/usr/lib64/libfoo.so.1"),
+                 "foo /usr/lib64/libfoo.so.* 40;") == 0);
+    CHECK(strcmp(owners_of(index, "/usr/bin/bar-config"),
+                 "foo-devel /usr/bin/bar-config 0;") == 0);
+    CHECK(strcmp(owners_of(index, "foo.lang"), "foo foo.lang 80;") == 0);
+    CHECK(strcmp(owners_of(index, "LICENSE"), "foo LICENSE 4;") == 0);
+
+    /* A %dir owns the directory, a directory without it what is below */
+    CHECK(strcmp(owners_of(index, "/usr/share/foo"),
+                 "foo /usr/share/foo 1;") == 0);
+    CHECK(strcmp(owners_of(index, "/usr/share/foo/other"), "") == 0);
+    CHECK(strcmp(owners_of(index, "/usr/include/foo/foo.h"),
+                 "foo-devel /usr/include/foo 0;") == 0);
+    CHECK(strcmp(owners_of(index, "/usr/lib64/python3/foo/tests/a.py"),
+                 "python3-foo /usr/lib64/python3/foo 0;"
+                 "python3-foo /usr/lib64/python3/foo/tests 20;") == 0);
+
+    /* The %ifarch branch is not taken on x86_64 */
+    CHECK(strcmp(owners_of(index, "/usr/bin/foo-s390x"), "") == 0);
+
+    CHECK(strcmp(find(index, "/usr/bin/*-config"),
+                 "foo-devel /usr/bin/bar-config 0;"
+                 "foo-devel /usr/bin/foo-config 0;") == 0);
+    CHECK(strcmp(find(index, "/usr/lib*/libfoo*"),
+                 "foo /usr/lib64/libfoo.so.* 40;") == 0);
+
+    /* Truncated indices are rejected */
+    CHECK(tree_sitter_rpmspec_files_index_from_buffer(data, size - 1) ==
+          NULL);
+    tree_sitter_rpmspec_files_index_delete(index);
+
+    fd = mkstemp(path);
+    CHECK(fd >= 0);
+    close(fd);
+    CHECK(tree_sitter_rpmspec_files_builder_save(builder, path));
+    index = tree_sitter_rpmspec_files_index_open(path);
+    CHECK(index != NULL);
+    CHECK(strcmp(owners_of(index, "/usr/bin/foo-config"),
+                 "foo-devel /usr/bin/foo-config 0;") == 0);
+    tree_sitter_rpmspec_files_index_delete(index);
+    unlink(path);
+
+    free(data);
+    tree_sitter_rpmspec_files_builder_delete(builder);
+    tree_sitter_rpmspec_macros_delete(macros);
+    ts_tree_delete(tree);
+    ts_parser_delete(parser);
+
+    return 0;
+}
@@ -0,0 +1,146 @@
+/*
+ * Tests for the %include and %load fragment resolver
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <tree_sitter/tree-sitter-rpmspec-include.h>
+#include <tree_sitter/tree-sitter-rpmspec.h>
+
+#include "check.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static const char fragment[] = "%global common_flag 1\n";
+
+static const char spec_one[] =
+    "Name: one\n"
+    "%include macros.common\n";
+
+static const char spec_two[] =
+    "Name: two\n"
+    "%define load_it() %load macros.common\n"
+    "%{load:macros.common}\n"
+    "%include %{common}\n"
+    "%if 0\n"
+    "%include macros.common\n"
+    "%endif\n"
+    "%include missing.inc\n"
+    "%include %{undefined}/x.inc\n";
+
+static TSTree *
+parse(TSParser *parser, const char *source)
+{
+    TSTree *tree = ts_parser_parse_string(parser, NULL, source,
+                                          (uint32_t)strlen(source));
+
+    CHECK(tree != NULL);
+    CHECK(!ts_node_has_error(ts_tree_root_node(tree)));
+
+    return tree;
+}
+
+static bool
+starts_with(const char *source, TSRange range, const char *text)
+{
+    size_t length = strlen(text);
+
+    return range.end_byte - range.start_byte >= length &&
+           memcmp(source + range.start_byte, text, length) == 0;
+}
+
+int
+main(void)
+{
+    const TSLanguage *language = tree_sitter_rpmspec();
+    TSRpmspecIncludeResolver *resolver;
+    TSRpmspecFragment *one_fragments;
+    TSRpmspecFragment *two_fragments;
+    TSRpmspecIncludeStats stats;
+    char directory[] = "test_include_XXXXXX";
+    TSRpmspecMacros *macros;
+    uint32_t one_count;
+    uint32_t two_count;
+    TSTree *one;
+    TSTree *two;
+    char path[256];
+    TSParser *parser;
+    FILE *fp;
+
+    CHECK(mkdtemp(directory) != NULL);
+    snprintf(path, sizeof(path), "%s/macros.common", directory);
+    fp = fopen(path, "w");
+    CHECK(fp != NULL);
+    fputs(fragment, fp);
+    fclose(fp);
+
+    parser = ts_parser_new();
+    CHECK(ts_parser_set_language(parser, language));
+    resolver = tree_sitter_rpmspec_include_resolver_new(language);
+    CHECK(resolver != NULL);
+
+    /* A literal target, parsed on first use */
+    one = parse(parser, spec_one);
+    CHECK(tree_sitter_rpmspec_include_resolve(resolver, one, spec_one,
+                                              directory, NULL, &one_fragments,
+                                              &one_count));
+    CHECK(one_count == 1);
+    CHECK(!one_fragments[0].load);
+    CHECK(starts_with(spec_one, one_fragments[0].directive,
+                      "%include macros.common"));
+    CHECK(one_fragments[0].length == strlen(fragment));
+    CHECK(strcmp(one_fragments[0].source, fragment) == 0);
+    CHECK(strcmp(one_fragments[0].path, path) == 0);
+    tree_sitter_rpmspec_include_stats(resolver, &stats);
+    CHECK(stats.parsed == 1 && stats.hits == 0);
+
+    /*
+     * The same file through %{load:...} and an expanded path of another
+     * spelling comes from the cache. The body of a definition and a branch
+     * not taken are skipped.
+     */
+    two = parse(parser, spec_two);
+    macros = tree_sitter_rpmspec_macros_new();
+    CHECK(macros != NULL);
+    CHECK(tree_sitter_rpmspec_macros_define(macros, "common",
+                                            "./macros.common"));
+    CHECK(tree_sitter_rpmspec_macros_load(macros, two, spec_two));
+    CHECK(tree_sitter_rpmspec_include_resolve(resolver, two, spec_two,
+                                              directory, macros,
+                                              &two_fragments, &two_count));
+    CHECK(two_count == 2);
+    CHECK(two_fragments[0].load);
+    CHECK(starts_with(spec_two, two_fragments[0].directive,
+                      "%{load:macros.common}"));
+    CHECK(!two_fragments[1].load);
+    CHECK(starts_with(spec_two, two_fragments[1].directive,
+                      "%include %{common}"));
+    CHECK(two_fragments[0].source == one_fragments[0].source);
+    CHECK(two_fragments[1].source == one_fragments[0].source);
+    tree_sitter_rpmspec_include_stats(resolver, &stats);
+    CHECK(stats.parsed == 1);
+    CHECK(stats.hits == 2);
+    CHECK(stats.missing == 1);
+    CHECK(stats.unresolved == 1);
+
+    /* The copies outlive the resolver */
+    tree_sitter_rpmspec_include_resolver_delete(resolver);
+    CHECK(strcmp(ts_node_type(ts_tree_root_node(two_fragments[1].tree)),
+                 "spec") == 0);
+    CHECK(ts_node_named_child_count(ts_tree_root_node(one_fragments[0].tree)) ==
+          1);
+
+    tree_sitter_rpmspec_include_fragments_free(one_fragments, one_count);
+    tree_sitter_rpmspec_include_fragments_free(two_fragments, two_count);
+    tree_sitter_rpmspec_macros_delete(macros);
+    ts_tree_delete(one);
+    ts_tree_delete(two);
+    ts_parser_delete(parser);
+    CHECK(unlink(path) == 0);
+    CHECK(rmdir(directory) == 0);
+
+    return 0;
+}
@@ -0,0 +1,61 @@
+/*
+ * Tests for tree_sitter_rpmspec_parse_file()
+ */
+
+#include <tree_sitter/tree-sitter-rpmspec-input.h>
+#include <tree_sitter/tree-sitter-rpmspec.h>
+
+#include "check.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+int
+main(int argc, char **argv)
+{
+    TSRpmspecParseStats stats;
+    const char *empty = "test_input_empty.spec";
+    TSParser *parser;
+    struct stat sb;
+    TSTree *tree;
+    FILE *fp;
+
+    CHECK(argc == 2);
+
+    parser = ts_parser_new();
+    CHECK(ts_parser_set_language(parser, tree_sitter_rpmspec()));
+
+    /* A spec file */
+    CHECK(stat(argv[1], &sb) == 0);
+    tree = tree_sitter_rpmspec_parse_file(parser, NULL, argv[1], &stats);
+    CHECK(tree != NULL);
+    CHECK(stats.bytes == (uint64_t)sb.st_size);
+    CHECK(stats.nodes == ts_node_descendant_count(ts_tree_root_node(tree)));
+    CHECK(stats.nodes > 1);
+    CHECK(strcmp(ts_node_type(ts_tree_root_node(tree)), "spec") == 0);
+    ts_tree_delete(tree);
+
+    /* An empty file */
+    fp = fopen(empty, "w");
+    CHECK(fp != NULL);
+    fclose(fp);
+    tree = tree_sitter_rpmspec_parse_file(parser, NULL, empty, &stats);
+    remove(empty);
+    CHECK(tree != NULL);
+    CHECK(stats.bytes == 0);
+    CHECK(!stats.has_error);
+    ts_tree_delete(tree);
+
+    /* A missing file */
+    errno = 0;
+    tree = tree_sitter_rpmspec_parse_file(parser, NULL, "missing.spec", NULL);
+    CHECK(tree == NULL);
+    CHECK(errno == ENOENT);
+
+    ts_parser_delete(parser);
+
+    return 0;
+}
@@ -0,0 +1,407 @@
+/*
+ * Tests for the macro table
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <tree_sitter/tree-sitter-rpmspec-deps.h>
+#include <tree_sitter/tree-sitter-rpmspec-macros.h>
+#include <tree_sitter/tree-sitter-rpmspec.h>
+
+#include "check.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char spec[] =
+    "%global commit abc123\n"
+    "%define shortcommit %(c=%{commit}; echo ${c:0:7})\n"
+    "%bcond_without docs\n"
+    "%bcond_with tests\n"
+    "\n"
+    "Name:           foo\n"
+    "Version:        1.2\n"
+    "Release:        3%{?dist}\n"
+    "\n"
+    "%if %{with docs}\n"
+    "%global docdir %{_datadir}/doc/%{name}\n"
+    "%else\n"
+    "%global docdir none\n"
+    "%endif\n"
+    "\n"
+    "%if 0%{?fedora} >= 40\n"
+    "%define branch rawhide\n"
+    "%elif 0%{?fedora}\n"
+    "%define branch stable\n"
+    "%else\n"
+    "%define branch other\n"
+    "%endif\n"
+    "\n"
+    "%{!?python3_pkgversion:%global python3_pkgversion 3}\n"
+    "%undefine _hardened_build\n"
+    "\n"
+    "%description\n"
+    "Foo.\n"
+    "\n"
+    "%package devel\n"
+    "Summary:        Development files\n"
+    "Version:        9\n"
+    "\n"
+    "%description devel\n"
+    "Foo development files.\n";
+
+static const char other_spec[] = "Name: bar\n";
+
+static const char arch_spec[] = "Name:           foo\n"
+                                "%ifarch %{ix86} x86_64\n"
+                                "BuildRequires:  nasm\n"
+                                "%elifarch aarch64\n"
+                                "BuildRequires:  arm-tools\n"
+                                "%else\n"
+                                "BuildRequires:  generic\n"
+                                "%endif\n"
+                                "%ifnos linux\n"
+                                "%global not_linux 1\n"
+                                "%endif\n";
+
+/* %c reads %a again, through %b, after the %global read it */
+static const char nested_spec[] = "%define a x\n"
+                                  "%define b %{a}\n"
+                                  "%define c %{a}%{b}\n"
+                                  "%global d %{a}%{c}\n";
+
+/* Conditions rpm would reject, each guarding a definition */
+static const char *const unresolvable_conditions[] = {
+    "9223372036854775807 + 1",
+    "0 - 9223372036854775807 - 2",
+    "99999999999999999999 > 0",
+    "4294967296 * 4294967296",
+    "(0 - 9223372036854775807 - 1) / (0 - 1)",
+    "1 / 0",
+};
+
+static void
+check_macro(TSRpmspecMacros *macros, const char *name, const char *value)
+{
+    const char *actual = tree_sitter_rpmspec_macros_get(macros, name, NULL);
+
+    if (value == NULL ? actual != NULL
+                      : actual == NULL || strcmp(actual, value) != 0) {
+        fprintf(stderr, "%%%s is \"%s\", expected \"%s\"\n", name,
+                actual != NULL ? actual : "(undefined)",
+                value != NULL ? value : "(undefined)");
+        exit(1);
+    }
+}
+
+static TSTree *
+parse(TSParser *parser, const char *source)
+{
+    TSTree *tree;
+
+    tree = ts_parser_parse_string(parser, NULL, source,
+                                  (uint32_t)strlen(source));
+    CHECK(tree != NULL);
+
+    return tree;
+}
+
+static TSPoint
+point_at(const char *source, uint32_t byte)
+{
+    TSPoint point = {0, 0};
+    uint32_t i;
+
+    for (i = 0; i < byte; i++) {
+        if (source[i] == '\n') {
+            point.row++;
+            point.column = 0;
+        } else {
+            point.column++;
+        }
+    }
+
+    return point;
+}
+
+/* Replace `from` by `to` in `*source`, editing and reparsing `*tree` */
+static TSTree *
+edit(TSParser *parser, TSTree *tree, char **source, const char *from,
+     const char *to)
+{
+    const char *at = strstr(*source, from);
+    TSInputEdit input_edit;
+    char *edited;
+    size_t start;
+
+    CHECK(at != NULL);
+    start = (size_t)(at - *source);
+    edited = malloc(strlen(*source) - strlen(from) + strlen(to) + 1);
+    CHECK(edited != NULL);
+    memcpy(edited, *source, start);
+    strcpy(edited + start, to);
+    strcat(edited, at + strlen(from));
+
+    input_edit.start_byte = (uint32_t)start;
+    input_edit.old_end_byte = (uint32_t)(start + strlen(from));
+    input_edit.new_end_byte = (uint32_t)(start + strlen(to));
+    input_edit.start_point = point_at(*source, input_edit.start_byte);
+    input_edit.old_end_point = point_at(*source, input_edit.old_end_byte);
+    input_edit.new_end_point = point_at(edited, input_edit.new_end_byte);
+    ts_tree_edit(tree, &input_edit);
+
+    free(*source);
+    *source = edited;
+
+    return ts_parser_parse_string(parser, tree, edited,
+                                  (uint32_t)strlen(edited));
+}
+
+static void
+check_update(TSParser *parser, TSRpmspecMacros *macros)
+{
+    TSRpmspecMacrosStats stats;
+    char *source = strdup(spec);
+    uint64_t memo_hits;
+    TSTree *new_tree;
+    TSTree *tree;
+
+    CHECK(source != NULL);
+    tree = parse(parser, source);
+    CHECK(tree_sitter_rpmspec_macros_load(macros, tree, source));
+    check_macro(macros, "commit", "abc123");
+
+    /* Only the edited tag and what reads %version are walked again */
+    new_tree = edit(parser, tree, &source, "Version:        1.2",
+                    "Version:        1.3");
+    CHECK(tree_sitter_rpmspec_macros_update(macros, tree, new_tree, source));
+    ts_tree_delete(tree);
+    tree = new_tree;
+    tree_sitter_rpmspec_macros_stats(macros, &stats);
+    CHECK(stats.replayed > 0);
+    check_macro(macros, "version", "1.3");
+    check_macro(macros, "docdir", "/usr/share/doc/foo");
+
+    /* %commit did not change, its value is still memoized */
+    memo_hits = stats.memo_hits;
+    check_macro(macros, "commit", "abc123");
+    tree_sitter_rpmspec_macros_stats(macros, &stats);
+    CHECK(stats.memo_hits == memo_hits + 1);
+
+    /* The %if that reads the bcond was not edited but is walked again */
+    new_tree = edit(parser, tree, &source, "%bcond_without docs",
+                    "%bcond_with docs");
+    CHECK(tree_sitter_rpmspec_macros_update(macros, tree, new_tree, source));
+    ts_tree_delete(tree);
+    tree = new_tree;
+    check_macro(macros, "with_docs", NULL);
+    check_macro(macros, "docdir", "none");
+    check_macro(macros, "branch", "rawhide");
+
+    ts_tree_delete(tree);
+    free(source);
+}
+
+static void
+check_target(TSParser *parser, const char *arch, const char *dependency,
+             uint32_t expected_dead)
+{
+    TSRpmspecDepsExtractor *extractor;
+    TSRpmspecMacros *macros;
+    TSRpmspecDeps deps = {0};
+    const TSRange *dead;
+    uint32_t count;
+    TSTree *tree;
+
+    macros = tree_sitter_rpmspec_macros_new();
+    CHECK(macros != NULL);
+    CHECK(tree_sitter_rpmspec_macros_set_target(macros, arch, "linux"));
+    tree = parse(parser, arch_spec);
+    CHECK(tree_sitter_rpmspec_macros_load(macros, tree, arch_spec));
+    check_macro(macros, "_target_cpu", arch);
+    check_macro(macros, "not_linux", NULL);
+
+    dead = tree_sitter_rpmspec_macros_dead_ranges(macros, &count);
+    CHECK(count == expected_dead);
+
+    /* Only the dependency of the live branch is left */
+    extractor = tree_sitter_rpmspec_deps_extractor_new(tree_sitter_rpmspec());
+    CHECK(extractor != NULL);
+    tree_sitter_rpmspec_deps_extractor_set_dead_ranges(extractor, dead, count);
+    CHECK(tree_sitter_rpmspec_deps_extract(extractor, tree, arch_spec, &deps));
+    CHECK(deps.dependency_count == 1);
+    CHECK(deps.dependencies[0].name.length == strlen(dependency));
+    CHECK(memcmp(arch_spec + deps.dependencies[0].name.start, dependency,
+                 strlen(dependency)) == 0);
+
+    tree_sitter_rpmspec_deps_free(&deps);
+    tree_sitter_rpmspec_deps_extractor_delete(extractor);
+    tree_sitter_rpmspec_macros_delete(macros);
+    ts_tree_delete(tree);
+}
+
+/*
+ * Arithmetic past the range of a long long and nesting past the limit
+ * leave a condition unresolved, which takes it as false
+ */
+static void
+check_unresolvable(TSParser *parser)
+{
+    size_t count = sizeof(unresolvable_conditions) /
+                   sizeof(unresolvable_conditions[0]);
+    TSRpmspecMacrosStats stats;
+    TSRpmspecMacros *macros;
+    char source[4096];
+    size_t length = 0;
+    TSTree *tree;
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        length += (size_t)snprintf(source + length, sizeof(source) - length,
+                                   "%%if %s\n%%global taken%zu 1\n%%endif\n",
+                                   unresolvable_conditions[i], i);
+    }
+    length += (size_t)snprintf(source + length, sizeof(source) - length,
+                               "%%if ");
+    for (i = 0; i < 1000; i++) {
+        source[length++] = '(';
+    }
+    source[length++] = '1';
+    for (i = 0; i < 1000; i++) {
+        source[length++] = ')';
+    }
+    length += (size_t)snprintf(source + length, sizeof(source) - length,
+                               "\n%%global nested 1\n%%endif\n"
+                               "%%if 9223372036854775807 - 1 + 1 > 0\n"
+                               "%%global in_range 1\n%%endif\n");
+    CHECK(length < sizeof(source) - 1);
+
+    macros = tree_sitter_rpmspec_macros_new();
+    CHECK(macros != NULL);
+    tree = parse(parser, source);
+    CHECK(tree_sitter_rpmspec_macros_load(macros, tree, source));
+    for (i = 0; i < count; i++) {
+        char name[32];
+
+        snprintf(name, sizeof(name), "taken%zu", i);
+        check_macro(macros, name, NULL);
+    }
+    check_macro(macros, "nested", NULL);
+    check_macro(macros, "in_range", "1");
+
+    tree_sitter_rpmspec_macros_stats(macros, &stats);
+    CHECK(stats.conditions == count + 2);
+    CHECK(stats.unresolved_conditions == count + 1);
+
+    tree_sitter_rpmspec_macros_delete(macros);
+    ts_tree_delete(tree);
+}
+
+/* A macro read by nested values is a single use of the %global */
+static void
+check_nested_uses(TSParser *parser)
+{
+    TSRpmspecMacrosStats stats;
+    TSRpmspecMacros *macros;
+    char *source = strdup(nested_spec);
+    TSTree *new_tree;
+    TSTree *tree;
+
+    CHECK(source != NULL);
+    macros = tree_sitter_rpmspec_macros_new();
+    CHECK(macros != NULL);
+    tree = parse(parser, source);
+    CHECK(tree_sitter_rpmspec_macros_load(macros, tree, source));
+    check_macro(macros, "d", "xxx");
+
+    /* %a, %c and %b */
+    tree_sitter_rpmspec_macros_stats(macros, &stats);
+    CHECK(stats.uses == 3);
+
+    new_tree = edit(parser, tree, &source, "%define a x", "%define a y");
+    CHECK(tree_sitter_rpmspec_macros_update(macros, tree, new_tree, source));
+    check_macro(macros, "d", "yyy");
+
+    tree_sitter_rpmspec_macros_delete(macros);
+    ts_tree_delete(new_tree);
+    ts_tree_delete(tree);
+    free(source);
+}
+
+int
+main(void)
+{
+    const char *nvr = "%{name}-%{version}-%{release}";
+    TSRpmspecMacrosStats stats;
+    TSRpmspecMacros *macros;
+    TSParser *parser;
+    uint32_t length;
+    TSTree *tree;
+    char *value;
+
+    parser = ts_parser_new();
+    CHECK(ts_parser_set_language(parser, tree_sitter_rpmspec()));
+
+    macros = tree_sitter_rpmspec_macros_new();
+    CHECK(macros != NULL);
+    CHECK(tree_sitter_rpmspec_macros_define(macros, "dist", ".fc40"));
+    CHECK(tree_sitter_rpmspec_macros_define(macros, "fedora", "40"));
+    CHECK(tree_sitter_rpmspec_macros_define(macros, "_datadir", "/usr/share"));
+    CHECK(tree_sitter_rpmspec_macros_define(macros, "_hardened_build", "1"));
+
+    tree = parse(parser, spec);
+    CHECK(tree_sitter_rpmspec_macros_load(macros, tree, spec));
+    ts_tree_delete(tree);
+
+    check_macro(macros, "name", "foo");
+    check_macro(macros, "version", "1.2");
+    check_macro(macros, "release", "3.fc40");
+    check_macro(macros, "with_docs", "1");
+    check_macro(macros, "with_tests", NULL);
+    check_macro(macros, "docdir", "/usr/share/doc/foo");
+    check_macro(macros, "branch", "rawhide");
+    check_macro(macros, "python3_pkgversion", "3");
+    check_macro(macros, "_hardened_build", NULL);
+    check_macro(macros, "shortcommit", "%(c=%{commit}; echo ${c:0:7})");
+
+    value = tree_sitter_rpmspec_macros_expand(macros, nvr, strlen(nvr),
+                                              &length);
+    CHECK(value != NULL);
+    CHECK(strcmp(value, "foo-1.2-3.fc40") == 0);
+    CHECK(length == strlen(value));
+    free(value);
+
+    /* The elif is not evaluated once the %if was taken */
+    tree_sitter_rpmspec_macros_stats(macros, &stats);
+    CHECK(stats.conditions == 2);
+    CHECK(stats.unresolved_conditions == 0);
+
+    /* %{name} was expanded once and then taken from the memo */
+    CHECK(stats.memo_hits > 0);
+
+    /* A new load starts from the predefined macros again */
+    tree = parse(parser, other_spec);
+    CHECK(tree_sitter_rpmspec_macros_load(macros, tree, other_spec));
+    ts_tree_delete(tree);
+
+    check_macro(macros, "name", "bar");
+    check_macro(macros, "docdir", NULL);
+    check_macro(macros, "_hardened_build", "1");
+    check_macro(macros, "dist", ".fc40");
+
+    check_update(parser, macros);
+    check_unresolvable(parser);
+    check_nested_uses(parser);
+
+    /* The %ifnos body is dead as well */
+    check_target(parser, "x86_64", "nasm", 3);
+    check_target(parser, "i686", "nasm", 3);
+    check_target(parser, "aarch64", "arm-tools", 3);
+    check_target(parser, "s390x", "generic", 3);
+
+    tree_sitter_rpmspec_macros_delete(macros);
+    ts_parser_delete(parser);
+
+    return 0;
+}
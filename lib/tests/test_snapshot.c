@@ -0,0 +1,226 @@
+/*
+ * Tests for tree snapshots
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <tree_sitter/tree-sitter-rpmspec-snapshot.h>
+#include <tree_sitter/tree-sitter-rpmspec.h>
+
+#include "check.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Every node of the tree is in the snapshot, in the same order */
+static void
+check_nodes(const TSTree *tree, const TSRpmspecSnapshot *snapshot)
+{
+    TSTreeCursor cursor = ts_tree_cursor_new(ts_tree_root_node(tree));
+    const TSRpmspecSnapshotNode *nodes;
+    uint32_t count;
+    uint32_t i = 0;
+
+    nodes = tree_sitter_rpmspec_snapshot_nodes(snapshot, &count);
+    CHECK(count == ts_node_descendant_count(ts_tree_root_node(tree)));
+    CHECK(nodes[0].descendant_count == count - 1);
+
+    for (;;) {
+        TSNode node = ts_tree_cursor_current_node(&cursor);
+
+        CHECK(i < count);
+        CHECK(nodes[i].symbol == ts_node_symbol(node));
+        CHECK(nodes[i].start_byte == ts_node_start_byte(node));
+        CHECK(nodes[i].end_byte == ts_node_end_byte(node));
+        CHECK(nodes[i].descendant_count + 1 == ts_node_descendant_count(node));
+        CHECK(nodes[i].field == ts_tree_cursor_current_field_id(&cursor));
+        CHECK(!(nodes[i].flags & TSRpmspecSnapshotNamed) ==
+              !ts_node_is_named(node));
+        i++;
+
+        if (ts_tree_cursor_goto_first_child(&cursor)) {
+            continue;
+        }
+        while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+            if (!ts_tree_cursor_goto_parent(&cursor)) {
+                CHECK(i == count);
+                ts_tree_cursor_delete(&cursor);
+                return;
+            }
+        }
+    }
+}
+
+static void
+check_queries(const TSRpmspecSnapshot *snapshot,
+              const TSLanguage *language,
+              const char *source)
+{
+    TSSymbol tags = ts_language_symbol_for_name(language, "tags", 4, true);
+    TSFieldId value = ts_language_field_id_for_name(language, "value", 5);
+    const TSRpmspecSnapshotNode *nodes;
+    const uint32_t *indices;
+    uint32_t count;
+    uint32_t child;
+    uint32_t total;
+    uint32_t i;
+
+    nodes = tree_sitter_rpmspec_snapshot_nodes(snapshot, &total);
+    indices = tree_sitter_rpmspec_snapshot_nodes_of_symbol(snapshot, tags,
+                                                           &count);
+    CHECK(indices != NULL);
+    CHECK(count > 0);
+    for (i = 0; i < count; i++) {
+        CHECK(nodes[indices[i]].symbol == tags);
+        CHECK(i == 0 || indices[i - 1] < indices[i]);
+    }
+
+    /* The value of the first tag, e.g. "Name: foo" */
+    child = tree_sitter_rpmspec_snapshot_child_by_field(snapshot, indices[0],
+                                                        value);
+    CHECK(child != UINT32_MAX);
+    CHECK(nodes[child].start_byte > nodes[indices[0]].start_byte);
+    CHECK(nodes[child].end_byte <= nodes[indices[0]].end_byte);
+    CHECK(source[nodes[child].start_byte] != ' ');
+
+    CHECK(tree_sitter_rpmspec_snapshot_child_by_field(snapshot, 0, value) ==
+          UINT32_MAX);
+    CHECK(tree_sitter_rpmspec_snapshot_child_by_field(snapshot, total, value) ==
+          UINT32_MAX);
+}
+
+static void
+check_cache(TSParser *parser, char *source, uint32_t length)
+{
+    const TSLanguage *language = ts_parser_language(parser);
+    TSRpmspecSnapshotCacheStats stats = {0};
+    char directory[] = "test_snapshot_XXXXXX";
+    TSRpmspecSnapshot *snapshot;
+    char lazy_path[256];
+    char path[256];
+    TSParser *lazy;
+    FILE *fp;
+
+    CHECK(mkdtemp(directory) != NULL);
+    snprintf(path, sizeof(path), "%s/%016llx-0.snap", directory,
+             (unsigned long long)tree_sitter_rpmspec_snapshot_hash(source,
+                                                                   length));
+
+    /* Parsed once, then mapped */
+    snapshot = tree_sitter_rpmspec_snapshot_cache_get(directory, parser,
+                                                      source, length, &stats);
+    CHECK(snapshot != NULL);
+    tree_sitter_rpmspec_snapshot_delete(snapshot);
+    CHECK(stats.misses == 1 && stats.hits == 0 && stats.rejected == 0);
+    CHECK(access(path, R_OK) == 0);
+
+    snapshot = tree_sitter_rpmspec_snapshot_cache_get(directory, parser,
+                                                      source, length, &stats);
+    CHECK(snapshot != NULL);
+    CHECK(tree_sitter_rpmspec_snapshot_matches(snapshot, source, length));
+    tree_sitter_rpmspec_snapshot_delete(snapshot);
+    CHECK(stats.misses == 1 && stats.hits == 1);
+
+    /* A truncated file is rejected and written again */
+    fp = fopen(path, "r+b");
+    CHECK(fp != NULL);
+    CHECK(ftruncate(fileno(fp), 100) == 0);
+    fclose(fp);
+    errno = 0;
+    CHECK(tree_sitter_rpmspec_snapshot_open(path, language) == NULL);
+    CHECK(errno == EINVAL);
+    snapshot = tree_sitter_rpmspec_snapshot_cache_get(directory, parser,
+                                                      source, length, &stats);
+    CHECK(snapshot != NULL);
+    tree_sitter_rpmspec_snapshot_delete(snapshot);
+    CHECK(stats.misses == 2 && stats.rejected == 1);
+
+    /* The lazy changelog variant has a file of its own */
+    lazy = ts_parser_new();
+    CHECK(ts_parser_set_language(lazy, tree_sitter_rpmspec_lazy_changelog()));
+    errno = 0;
+    CHECK(tree_sitter_rpmspec_snapshot_open(
+              path, tree_sitter_rpmspec_lazy_changelog()) == NULL);
+    CHECK(errno == ESTALE);
+    snapshot = tree_sitter_rpmspec_snapshot_cache_get(directory, lazy, source,
+                                                      length, &stats);
+    CHECK(snapshot != NULL);
+    tree_sitter_rpmspec_snapshot_delete(snapshot);
+    CHECK(stats.misses == 3 && stats.rejected == 1);
+    snapshot = tree_sitter_rpmspec_snapshot_cache_get(directory, parser,
+                                                      source, length, &stats);
+    CHECK(snapshot != NULL);
+    tree_sitter_rpmspec_snapshot_delete(snapshot);
+    CHECK(stats.hits == 2);
+    snprintf(lazy_path, sizeof(lazy_path), "%s/%016llx-1.snap", directory,
+             (unsigned long long)tree_sitter_rpmspec_snapshot_hash(source,
+                                                                   length));
+    CHECK(unlink(lazy_path) == 0);
+    ts_parser_delete(lazy);
+
+    /* Other content is another key */
+    source[0] = source[0] == '#' ? '%' : '#';
+    snapshot = tree_sitter_rpmspec_snapshot_cache_get(directory, parser,
+                                                      source, length, &stats);
+    CHECK(snapshot != NULL);
+    tree_sitter_rpmspec_snapshot_delete(snapshot);
+    CHECK(stats.misses == 4 && stats.hits == 2);
+    unlink(path);
+    snprintf(path, sizeof(path), "%s/%016llx-0.snap", directory,
+             (unsigned long long)tree_sitter_rpmspec_snapshot_hash(source,
+                                                                   length));
+    unlink(path);
+    CHECK(rmdir(directory) == 0);
+}
+
+int
+main(int argc, char **argv)
+{
+    const TSLanguage *language = tree_sitter_rpmspec();
+    TSRpmspecSnapshot *snapshot;
+    TSParser *parser;
+    uint32_t length;
+    char *source;
+    TSTree *tree;
+    void *data;
+    size_t size;
+
+    CHECK(argc == 2);
+    source = read_file(argv[1], &length);
+
+    parser = ts_parser_new();
+    CHECK(ts_parser_set_language(parser, language));
+    tree = ts_parser_parse_string(parser, NULL, source, length);
+    CHECK(tree != NULL);
+
+    data = tree_sitter_rpmspec_snapshot_serialize(tree, source, length, &size);
+    CHECK(data != NULL);
+    snapshot = tree_sitter_rpmspec_snapshot_from_buffer(data, size, language);
+    CHECK(snapshot != NULL);
+    CHECK(tree_sitter_rpmspec_snapshot_matches(snapshot, source, length));
+    CHECK(!tree_sitter_rpmspec_snapshot_matches(snapshot, source, length - 1));
+    source[length - 1] ^= 1;
+    CHECK(!tree_sitter_rpmspec_snapshot_matches(snapshot, source, length));
+    source[length - 1] ^= 1;
+    check_nodes(tree, snapshot);
+    check_queries(snapshot, language, source);
+    tree_sitter_rpmspec_snapshot_delete(snapshot);
+
+    /* A buffer that is cut short is not a snapshot */
+    errno = 0;
+    CHECK(tree_sitter_rpmspec_snapshot_from_buffer(data, size - 4, language) ==
+          NULL);
+    CHECK(errno == EINVAL);
+    free(data);
+
+    check_cache(parser, source, length);
+
+    ts_tree_delete(tree);
+    ts_parser_delete(parser);
+    free(source);
+
+    return 0;
+}
@@ -1,12 +1,18 @@
 ; Specific parametric macro expansion rules (must come first)
+;
+; The macro name is always the first named child. Anchoring it lets the query
+; cursor drop the pattern after the first child instead of trying it against
+; every argument.
 (macro_expansion_call
-  (builtin) @function.macro)
-
-(macro_expansion_call
-  (identifier) @function.macro)
+  .
+  [
+    (builtin)
+    (identifier)
+  ] @function.macro)
 
+; The options are captured by the (macro_option) rule below
 (macro_expansion_call
-  option: (macro_option) @variable.parameter
+  option: (macro_option)
   argument: [
     (word) @variable.parameter
     (concatenation
@@ -18,23 +24,23 @@
 ; Highlight macro options in parametric expansions
 (macro_option) @variable.parameter
 
-; Macro expansion rules
+; Macro expansion rules, the builtin itself is captured by (builtin) below
 (macro_expansion
-  (builtin) @variable.builtin
+  .
+  (builtin)
   argument: (_) @variable.parameter)
 
 (macro_expansion
-  (identifier) @variable
+  .
+  (identifier)
   argument: [
     (word) @variable.parameter
     (concatenation
       (word) @variable.parameter)
   ])
 
-; Macro expansion without arguments
-(macro_expansion
-  (builtin) @variable.builtin)
 (macro_expansion
+  .
   (identifier) @variable)
 
 ; Macro definition and undefinition
@@ -61,21 +67,19 @@
 (special_variable_name) @constant
 (builtin) @variable.builtin
 
-(setup_macro
-  argument: [
-    (setup_flag) @variable.parameter
-    (setup_source_option) @variable.parameter
-    ((setup_name_option
-      directory: (_) @string) @variable.parameter)
-  ])
+; %setup and %patch options only occur in their macros, matching them
+; directly avoids keeping a state open for every macro argument
+[
+  (setup_flag)
+  (setup_source_option)
+  (patch_flag)
+  (patch_number_option)
+  (patch_string_option)
+  (patch_long_option)
+] @variable.parameter
 
-(patch_macro
-  [
-    (patch_flag) @variable.parameter
-    (patch_number_option) @variable.parameter
-    (patch_string_option) @variable.parameter
-    (patch_long_option) @variable.parameter
-  ])
+(setup_name_option
+  directory: (_) @string) @variable.parameter
 
 [
   (tag)
@@ -90,40 +94,25 @@
 ;(string) @string
 (quoted_string) @string
 
-(description
-  (section_name) @function.builtin)
-(package
-  (section_name) @function.builtin)
-(files
-  (section_name) @function.builtin)
-(changelog
-  (section_name) @function.builtin)
-
-(changelog_version) @constant
-(changelog_cve) @constant
-(changelog_bdu) @constant
-(changelog_mfsa) @constant
-(changelog_ove) @constant
-(changelog_bugid) @constant
-(changelog_email) @string.special
-(changelog_url) @string.special
-(changelog_date) @constant
-(changelog_bullet) @constant
-
-(prep_scriptlet
-  (section_name) @function.builtin)
-(generate_buildrequires
-  (section_name) @function.builtin)
-(conf_scriptlet
-  (section_name) @function.builtin)
-(build_scriptlet
-  (section_name) @function.builtin)
-(install_scriptlet
-  (section_name) @function.builtin)
-(check_scriptlet
-  (section_name) @function.builtin)
-(clean_scriptlet
-  (section_name) @function.builtin)
+; Section names only occur as the header of their section. Matching them
+; directly avoids a pattern state that lives through the whole section body.
+(section_name) @function.builtin
+
+[
+  (changelog_version)
+  (changelog_cve)
+  (changelog_bdu)
+  (changelog_mfsa)
+  (changelog_ove)
+  (changelog_bugid)
+  (changelog_date)
+  (changelog_bullet)
+] @constant
+
+[
+  (changelog_email)
+  (changelog_url)
+] @string.special
 
 [
   "%pre"
@@ -0,0 +1,14 @@
+; Scriptlet bodies and %(...) expansions are shell and injected as bash.
+;
+; Every scriptlet is an injection of its own rather than one combined
+; injection for the whole file, so a host that parses injections lazily only
+; parses the scriptlets in the visible range. The macro expansions stay part
+; of the bash text, where they read as words, and keep the highlighting of
+; the rpmspec tree.
+((shell_block) @injection.content
+  (#set! injection.language "bash")
+  (#set! injection.include-children))
+
+((shell_command) @injection.content
+  (#set! injection.language "bash")
+  (#set! injection.include-children))
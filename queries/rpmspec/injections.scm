@@ -0,0 +1 @@
+../injections.scm
\ No newline at end of file
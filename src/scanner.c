@@ -0,0 +1,719 @@
+/*
+ * External scanner for tree-sitter-rpmspec
+ *
+ * Scriptlet bodies (%build, %install, %post, ...) are mostly plain shell
+ * text. Lexing them through the generated DFA one line at a time is slow on
+ * large sections, so the raw text between macros is consumed here in one
+ * piece: a shell content token runs across lines until the next '%' that
+ * starts a macro or section, or the next line that starts a comment.
+ *
+ * Preamble tag names (Name, BuildRequires, ...) and the names of builtin
+ * macros are recognised here too. As keywords of the identifier word token
+ * every one of them was lexed as an identifier first and then matched again
+ * by the generated keyword lexer; a binary search over the sorted tables
+ * below does both in one pass. %endif is lexed here with the rest of its
+ * line, which must be empty.
+ *
+ * The scanner also backs the lazy changelog language variant returned by
+ * tree_sitter_rpmspec_lazy_changelog(). It shares all tables with the
+ * default language, but its scanner lexes every %changelog entry as one
+ * opaque token instead of leaving it to the fine-grained changelog rules.
+ */
+
+#include "tree_sitter/parser.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif !defined(__wasm__)
+#include <pthread.h>
+#endif
+
+#ifndef TS_PUBLIC
+#ifdef TREE_SITTER_HIDE_SYMBOLS
+#define TS_PUBLIC
+#elif defined(_WIN32)
+#define TS_PUBLIC __declspec(dllexport)
+#else
+#define TS_PUBLIC __attribute__((visibility("default")))
+#endif
+#endif
+
+enum TokenType {
+    SHELL_CONTENT,
+    CHANGELOG_ENTRY,
+    TAG_NAME,
+    DEPENDENCY_TAG_NAME,
+    QUALIFIED_DEPENDENCY_TAG_NAME,
+    BUILTIN_NAME,
+    TAG_VALUE,
+    ENDIF,
+    ERROR_SENTINEL,
+};
+
+struct keyword {
+    const char *name;
+    enum TokenType token;
+};
+
+/*
+ * Preamble tags, sorted with strcmp(). Source<N> and Patch<N> are handled
+ * in scan_tag_name().
+ */
+static const struct keyword tag_names[] = {
+    {"AutoProv", TAG_NAME},      /* Automatic Provides generation */
+    {"AutoReq", TAG_NAME},       /* Automatic Requires generation */
+    {"AutoReqProv", TAG_NAME},   /* Both AutoReq and AutoProv */
+    {"BugUrl", TAG_NAME},        /* Bug reporting URL */
+    {"BuildArch", DEPENDENCY_TAG_NAME},
+    {"BuildArchitectures", DEPENDENCY_TAG_NAME},
+    {"BuildConflicts", DEPENDENCY_TAG_NAME},
+    {"BuildPreReq", DEPENDENCY_TAG_NAME}, /* Deprecated */
+    {"BuildRequires", QUALIFIED_DEPENDENCY_TAG_NAME},
+    {"BuildRoot", TAG_NAME},     /* Deprecated */
+    {"BuildSystem", TAG_NAME},   /* Build system identifier */
+    {"Conflicts", DEPENDENCY_TAG_NAME},
+    {"DistTag", TAG_NAME},
+    {"Distribution", TAG_NAME},
+    {"DocDir", DEPENDENCY_TAG_NAME},
+    {"Enhances", DEPENDENCY_TAG_NAME},
+    {"Epoch", TAG_NAME},
+    {"ExcludeArch", DEPENDENCY_TAG_NAME},
+    {"ExcludeOS", DEPENDENCY_TAG_NAME},
+    {"ExclusiveArch", DEPENDENCY_TAG_NAME},
+    {"ExclusiveOS", DEPENDENCY_TAG_NAME},
+    {"Group", TAG_NAME},         /* Deprecated */
+    {"License", TAG_NAME},
+    {"ModularityLabel", TAG_NAME},
+    {"Name", TAG_NAME},
+    {"NoPatch", TAG_NAME},
+    {"NoSource", TAG_NAME},
+    {"Obsoletes", DEPENDENCY_TAG_NAME},
+    {"OrderWithRequires", DEPENDENCY_TAG_NAME},
+    {"Packager", TAG_NAME},
+    {"Prefix", DEPENDENCY_TAG_NAME},
+    {"Prefixes", DEPENDENCY_TAG_NAME},
+    {"Prereq", DEPENDENCY_TAG_NAME}, /* Deprecated */
+    {"Provides", DEPENDENCY_TAG_NAME},
+    {"Recommends", DEPENDENCY_TAG_NAME},
+    {"Release", TAG_NAME},
+    {"RemovePathPostfixes", DEPENDENCY_TAG_NAME},
+    {"Requires", QUALIFIED_DEPENDENCY_TAG_NAME},
+    {"SourceLicense", TAG_NAME},
+    {"Suggests", DEPENDENCY_TAG_NAME},
+    {"Summary", TAG_NAME},
+    {"Supplements", DEPENDENCY_TAG_NAME},
+    {"URL", TAG_NAME},
+    {"Url", TAG_NAME},
+    {"VCS", TAG_NAME},
+    {"Vendor", TAG_NAME},
+    {"Version", TAG_NAME},
+};
+
+/* Builtin macros, sorted with strcmp(). */
+static const struct keyword builtin_names[] = {
+    {"basename", BUILTIN_NAME},   {"dirname", BUILTIN_NAME},
+    {"dnl", BUILTIN_NAME},        {"dump", BUILTIN_NAME},
+    {"echo", BUILTIN_NAME},       {"error", BUILTIN_NAME},
+    {"exists", BUILTIN_NAME},     {"expand", BUILTIN_NAME},
+    {"expr", BUILTIN_NAME},       {"getdirconf", BUILTIN_NAME},
+    {"getenv", BUILTIN_NAME},     {"getncpus", BUILTIN_NAME},
+    {"gsub", BUILTIN_NAME},       {"include", BUILTIN_NAME},
+    {"len", BUILTIN_NAME},        {"load", BUILTIN_NAME},
+    {"lower", BUILTIN_NAME},      {"lua", BUILTIN_NAME},
+    {"macrobody", BUILTIN_NAME},  {"quote", BUILTIN_NAME},
+    {"rep", BUILTIN_NAME},        {"reverse", BUILTIN_NAME},
+    {"rpmversion", BUILTIN_NAME}, {"shescape", BUILTIN_NAME},
+    {"shrink", BUILTIN_NAME},     {"sub", BUILTIN_NAME},
+    {"suffix", BUILTIN_NAME},     {"trace", BUILTIN_NAME},
+    {"u2p", BUILTIN_NAME},        {"uncompress", BUILTIN_NAME},
+    {"upper", BUILTIN_NAME},      {"url2path", BUILTIN_NAME},
+    {"verbose", BUILTIN_NAME},    {"warn", BUILTIN_NAME},
+};
+
+/* Longer than any keyword above */
+#define KEYWORD_MAX 24
+
+typedef struct {
+    bool lazy_changelog;
+} Scanner;
+
+const TSLanguage *tree_sitter_rpmspec(void);
+
+/* The scanner is stateless, so every parser can share these. */
+static Scanner default_scanner = {.lazy_changelog = false};
+static Scanner lazy_changelog_scanner = {.lazy_changelog = true};
+
+static inline void
+advance(TSLexer *lexer)
+{
+    lexer->advance(lexer, false);
+}
+
+static inline void
+skip(TSLexer *lexer)
+{
+    lexer->advance(lexer, true);
+}
+
+static inline bool
+is_blank(int32_t c)
+{
+    return c == ' ' || c == '\t' || c == '\v' || c == '\f';
+}
+
+static inline bool
+is_newline(int32_t c)
+{
+    return c == '\n' || c == '\r';
+}
+
+/* Characters that continue an identifier, see the identifier rule. */
+static inline bool
+is_identifier_char(int32_t c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           (c >= '0' && c <= '9') || c == '_' || c == '$' || c > 0x7f;
+}
+
+/*
+ * A binary search of its own: bsearch() is not among the libc functions
+ * web-tree-sitter gives to wasm side modules.
+ */
+static const struct keyword *
+lookup_keyword(const struct keyword *table, size_t count, const char *name)
+{
+    size_t low = 0;
+    size_t high = count;
+
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        int cmp = strcmp(name, table[mid].name);
+
+        if (cmp == 0) {
+            return &table[mid];
+        }
+        if (cmp < 0) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Read the identifier at the current position into buffer. Returns false if
+ * there is none, it is too long to be a keyword or it has a character
+ * outside ASCII, which no keyword has and which must not be truncated into
+ * one.
+ */
+static bool
+read_identifier(TSLexer *lexer, char *buffer)
+{
+    size_t len = 0;
+
+    while (is_identifier_char(lexer->lookahead)) {
+        if (len == KEYWORD_MAX || lexer->lookahead > 0x7f) {
+            return false;
+        }
+        buffer[len++] = (char)lexer->lookahead;
+        advance(lexer);
+    }
+    buffer[len] = '\0';
+
+    return len > 0;
+}
+
+static bool
+has_digit_suffix(const char *name, const char *prefix)
+{
+    size_t len = strlen(prefix);
+
+    if (strncmp(name, prefix, len) != 0) {
+        return false;
+    }
+    for (name += len; *name != '\0'; name++) {
+        if (*name < '0' || *name > '9') {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * A tag name is directly followed by the ':' separator, Requires and
+ * BuildRequires may also be followed by a '(qualifier)'.
+ */
+static bool
+scan_tag_name(TSLexer *lexer, const bool *valid_symbols)
+{
+    char name[KEYWORD_MAX + 1];
+    const struct keyword *keyword;
+    enum TokenType token;
+
+    if (!read_identifier(lexer, name)) {
+        return false;
+    }
+    lexer->mark_end(lexer);
+
+    keyword = lookup_keyword(tag_names,
+                             sizeof(tag_names) / sizeof(tag_names[0]),
+                             name);
+    if (keyword != NULL) {
+        token = keyword->token;
+    } else if (has_digit_suffix(name, "Source") ||
+               has_digit_suffix(name, "Patch")) {
+        token = TAG_NAME;
+    } else {
+        return false;
+    }
+
+    if (!valid_symbols[token]) {
+        return false;
+    }
+    if (lexer->lookahead != ':' &&
+        !(token == QUALIFIED_DEPENDENCY_TAG_NAME && lexer->lookahead == '(')) {
+        return false;
+    }
+
+    lexer->result_symbol = token;
+
+    return true;
+}
+
+static bool
+scan_builtin_name(TSLexer *lexer)
+{
+    char name[KEYWORD_MAX + 1];
+
+    if (!read_identifier(lexer, name)) {
+        return false;
+    }
+    if (lookup_keyword(builtin_names,
+                       sizeof(builtin_names) / sizeof(builtin_names[0]),
+                       name) == NULL) {
+        return false;
+    }
+
+    lexer->mark_end(lexer);
+    lexer->result_symbol = BUILTIN_NAME;
+
+    return true;
+}
+
+static bool
+scan_keyword(TSLexer *lexer, const bool *valid_symbols)
+{
+    bool tags = valid_symbols[TAG_NAME] || valid_symbols[DEPENDENCY_TAG_NAME] ||
+                valid_symbols[QUALIFIED_DEPENDENCY_TAG_NAME];
+
+    if (!tags && !valid_symbols[BUILTIN_NAME]) {
+        return false;
+    }
+
+    while (is_blank(lexer->lookahead) || is_newline(lexer->lookahead)) {
+        skip(lexer);
+    }
+
+    /* Tags start with an upper case letter, builtins with a lower case one. */
+    if (lexer->lookahead >= 'A' && lexer->lookahead <= 'Z') {
+        return tags && scan_tag_name(lexer, valid_symbols);
+    }
+    if (lexer->lookahead >= 'a' && lexer->lookahead <= 'z') {
+        return valid_symbols[BUILTIN_NAME] && scan_builtin_name(lexer);
+    }
+
+    return false;
+}
+
+/*
+ * The value of a regular tag when it is several words without anything the
+ * grammar would turn into structure: macros, quotes, escapes, comments or
+ * braces. Such a value, e.g. most Summary lines, becomes one text_content
+ * token up to the last non-blank character of the line instead of one word
+ * per word. Single words are left to the DFA so they keep their integer,
+ * version and word tokens.
+ */
+static bool
+scan_tag_value(TSLexer *lexer)
+{
+    bool pending_blank = false;
+    bool words = false;
+
+    while (!lexer->eof(lexer) && !is_newline(lexer->lookahead)) {
+        int32_t c = lexer->lookahead;
+
+        switch (c) {
+        case '%':
+        case '"':
+        case '\\':
+        case '#':
+        case '{':
+        case '}':
+            return false;
+        default:
+            break;
+        }
+
+        advance(lexer);
+        if (is_blank(c)) {
+            pending_blank = true;
+            continue;
+        }
+        if (pending_blank) {
+            words = true;
+            pending_blank = false;
+        }
+        lexer->mark_end(lexer);
+    }
+
+    if (!words) {
+        return false;
+    }
+    lexer->result_symbol = TAG_VALUE;
+
+    return true;
+}
+
+/*
+ * A '%' followed by whitespace or the end of input does not start a macro,
+ * RPM keeps it as is. The same goes for the '%%' escape.
+ */
+static bool
+consume_literal_percent(TSLexer *lexer)
+{
+    advance(lexer);
+
+    if (lexer->eof(lexer) || is_blank(lexer->lookahead) ||
+        is_newline(lexer->lookahead)) {
+        return true;
+    }
+    if (lexer->lookahead == '%') {
+        advance(lexer);
+        return true;
+    }
+
+    return false;
+}
+
+/*
+ * Skip the line break and the indentation of the next line. Returns false
+ * if the next line cannot continue the shell text.
+ */
+static bool
+continue_on_next_line(TSLexer *lexer)
+{
+    while (is_newline(lexer->lookahead) || is_blank(lexer->lookahead)) {
+        advance(lexer);
+    }
+
+    if (lexer->eof(lexer)) {
+        return false;
+    }
+
+    /* Leave comments to the extras and lines starting with '%' to the
+     * grammar, they may be sections, conditionals or macro calls. */
+    return lexer->lookahead != '#' && lexer->lookahead != '%';
+}
+
+/* Shell text from the current position, after `has_content` text so far */
+static bool
+scan_shell_text(TSLexer *lexer, bool has_content)
+{
+    while (!lexer->eof(lexer)) {
+        int32_t c = lexer->lookahead;
+
+        if (c == '%') {
+            if (!consume_literal_percent(lexer)) {
+                break;
+            }
+            has_content = true;
+            lexer->mark_end(lexer);
+            continue;
+        }
+
+        if (c == '\\') {
+            /* Escaped characters, including escaped line breaks. */
+            advance(lexer);
+            if (!lexer->eof(lexer)) {
+                if (lexer->lookahead == '\r') {
+                    advance(lexer);
+                }
+                advance(lexer);
+            }
+            has_content = true;
+            lexer->mark_end(lexer);
+            continue;
+        }
+
+        if (is_newline(c)) {
+            if (!continue_on_next_line(lexer)) {
+                break;
+            }
+            continue;
+        }
+
+        advance(lexer);
+        if (!is_blank(c)) {
+            has_content = true;
+            lexer->mark_end(lexer);
+        }
+    }
+
+    if (has_content) {
+        lexer->result_symbol = SHELL_CONTENT;
+    }
+
+    return has_content;
+}
+
+static bool
+scan_shell_content(TSLexer *lexer)
+{
+    while (is_blank(lexer->lookahead) || is_newline(lexer->lookahead)) {
+        skip(lexer);
+    }
+
+    if (lexer->lookahead == '#') {
+        return false;
+    }
+
+    return scan_shell_text(lexer, false);
+}
+
+static bool
+skip_to_percent(TSLexer *lexer)
+{
+    while (is_blank(lexer->lookahead) || is_newline(lexer->lookahead)) {
+        skip(lexer);
+    }
+
+    return lexer->lookahead == '%';
+}
+
+/*
+ * A '%' where a block may end: %endif with the blanks after it and the line
+ * break, which may be missing at the end of input. Anything else on the
+ * line leaves %endif unrecognised, so the parser reports it. In shell text
+ * the '%' may also be a literal one that the shell content goes on from.
+ */
+static bool
+scan_percent(TSLexer *lexer, bool shell)
+{
+    const char *keyword;
+
+    if (consume_literal_percent(lexer)) {
+        if (!shell) {
+            return false;
+        }
+        lexer->mark_end(lexer);
+        return scan_shell_text(lexer, true);
+    }
+
+    for (keyword = "endif"; *keyword != '\0'; keyword++) {
+        if (lexer->lookahead != *keyword) {
+            return false;
+        }
+        advance(lexer);
+    }
+    while (is_blank(lexer->lookahead)) {
+        advance(lexer);
+    }
+    if (lexer->lookahead == '\r') {
+        advance(lexer);
+    }
+    if (lexer->lookahead == '\n') {
+        advance(lexer);
+    } else if (!lexer->eof(lexer)) {
+        return false;
+    }
+
+    lexer->result_symbol = ENDIF;
+
+    return true;
+}
+
+/*
+ * Consume a whole changelog entry: the "* <date> ..." header and every line
+ * after it up to the next line that starts with '*' (the next entry) or '%'
+ * (the next section), or the end of input.
+ */
+static bool
+scan_changelog_entry(TSLexer *lexer)
+{
+    while (is_blank(lexer->lookahead) || is_newline(lexer->lookahead)) {
+        skip(lexer);
+    }
+
+    if (lexer->lookahead != '*') {
+        return false;
+    }
+
+    while (!lexer->eof(lexer)) {
+        int32_t c = lexer->lookahead;
+
+        advance(lexer);
+        if (is_newline(c)) {
+            if (lexer->lookahead == '*' || lexer->lookahead == '%') {
+                break;
+            }
+        } else if (!is_blank(c)) {
+            lexer->mark_end(lexer);
+        }
+    }
+
+    lexer->result_symbol = CHANGELOG_ENTRY;
+
+    return true;
+}
+
+void *
+tree_sitter_rpmspec_external_scanner_create(void)
+{
+    return &default_scanner;
+}
+
+static void *
+lazy_changelog_scanner_create(void)
+{
+    return &lazy_changelog_scanner;
+}
+
+void
+tree_sitter_rpmspec_external_scanner_destroy(void *payload)
+{
+    (void)payload;
+}
+
+unsigned
+tree_sitter_rpmspec_external_scanner_serialize(void *payload, char *buffer)
+{
+    (void)payload;
+    (void)buffer;
+
+    return 0;
+}
+
+void
+tree_sitter_rpmspec_external_scanner_deserialize(void *payload,
+                                                 const char *buffer,
+                                                 unsigned length)
+{
+    (void)payload;
+    (void)buffer;
+    (void)length;
+}
+
+bool
+tree_sitter_rpmspec_external_scanner_scan(void *payload,
+                                          TSLexer *lexer,
+                                          const bool *valid_symbols)
+{
+    const Scanner *scanner = payload;
+
+    /* During error recovery every symbol is valid; let the DFA handle text
+     * instead of swallowing the rest of the section. Keywords and %endif
+     * are still recognised, as the keyword lexer did. */
+    if (valid_symbols[ERROR_SENTINEL]) {
+        if (skip_to_percent(lexer)) {
+            return scan_percent(lexer, false);
+        }
+        return scan_keyword(lexer, valid_symbols);
+    }
+
+    if (valid_symbols[ENDIF] && skip_to_percent(lexer)) {
+        return scan_percent(lexer, valid_symbols[SHELL_CONTENT]);
+    }
+
+    if (valid_symbols[SHELL_CONTENT]) {
+        return scan_shell_content(lexer);
+    }
+
+    if (valid_symbols[CHANGELOG_ENTRY] && scanner->lazy_changelog) {
+        return scan_changelog_entry(lexer);
+    }
+
+    if (valid_symbols[TAG_VALUE]) {
+        return scan_tag_value(lexer);
+    }
+
+    return scan_keyword(lexer, valid_symbols);
+}
+
+static TSLanguage lazy_changelog_language;
+
+/*
+ * The variant is a copy of the generated language with another scanner
+ * create callback. This holds across ABI versions because the copy is made
+ * by this file, compiled with the parser.h that parser.c was generated
+ * with. The struct assignment copies whatever fields that ABI has, and
+ * external_scanner.create is a member of every ABI with external scanners.
+ * Every pointer in the struct refers to static tables of parser.c, which
+ * the runtime never frees for a native language, so sharing them is safe;
+ * the other scanner callbacks get their payload from create() and need no
+ * change. A parser.c generated without externals has no create callback to
+ * replace, and then the variant parses exactly like the default language.
+ */
+static void
+init_lazy_changelog_language(void)
+{
+    lazy_changelog_language = *tree_sitter_rpmspec();
+    lazy_changelog_language.external_scanner.create =
+        lazy_changelog_scanner_create;
+}
+
+#ifdef _WIN32
+static INIT_ONCE lazy_changelog_once = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK
+init_lazy_changelog_language_once(PINIT_ONCE once, PVOID param, PVOID *ctx)
+{
+    (void)once;
+    (void)param;
+    (void)ctx;
+
+    init_lazy_changelog_language();
+
+    return TRUE;
+}
+#elif defined(__wasm__)
+/* web-tree-sitter loads the parser as a side module that runs on a single
+ * thread and can only import a few libc functions, pthread_once() is not
+ * one of them. */
+static bool lazy_changelog_initialized;
+#else
+static pthread_once_t lazy_changelog_once = PTHREAD_ONCE_INIT;
+#endif
+
+/*
+ * The lazy changelog variant of the language. Every %changelog entry is a
+ * childless changelog_entry node, which makes parsing specs with a long
+ * history much cheaper when the changelog is not needed. To get the
+ * fine-grained tree of an entry, parse the %changelog line and the entry's
+ * range with tree_sitter_rpmspec() and ts_parser_set_included_ranges().
+ */
+TS_PUBLIC const TSLanguage *
+tree_sitter_rpmspec_lazy_changelog(void)
+{
+#ifdef _WIN32
+    InitOnceExecuteOnce(&lazy_changelog_once,
+                        init_lazy_changelog_language_once,
+                        NULL,
+                        NULL);
+#elif defined(__wasm__)
+    if (!lazy_changelog_initialized) {
+        init_lazy_changelog_language();
+        lazy_changelog_initialized = true;
+    }
+#else
+    pthread_once(&lazy_changelog_once, init_lazy_changelog_language);
+#endif
+
+    return &lazy_changelog_language;
+}